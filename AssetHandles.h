@@ -0,0 +1,198 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// An interned asset name.  Constructing one from a string literal in a constexpr
+// context hashes it at compile time, so per-frame lookups never build a std::string.
+// Names ignore (ASCII) case, like AssetIndex, so "Sphere" and "sphere" are one asset.
+struct AssetName
+{
+	uint64_t Id;
+
+	constexpr explicit AssetName(const char* name) : Id(Hash(name)) {}
+	explicit AssetName(const std::string& name) : Id(Hash(name.c_str())) {}
+
+	// 64 bit FNV-1a of the lower case name
+	static constexpr uint64_t Hash(const char* name)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (; *name; name++)
+		{
+			hash ^= (uint8_t)ToLower(*name);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	static constexpr char ToLower(char c)
+	{
+		return c >= 'A' && c <= 'Z' ? (char)(c - 'A' + 'a') : c;
+	}
+};
+
+constexpr AssetName operator"" _asset(const char* name, size_t)
+{
+	return AssetName(name);
+}
+
+// A typed index into an AssetTable.  The generation makes handles to removed assets
+// fail to resolve instead of pointing at whatever reused the slot.
+template<typename Tag>
+struct AssetHandle
+{
+	uint32_t Index;
+	uint32_t Generation;
+
+	AssetHandle() : Index(0), Generation(0) {}
+	AssetHandle(uint32_t index, uint32_t generation) : Index(index), Generation(generation) {}
+
+	bool IsValid() const { return Generation != 0; }
+	bool operator==(const AssetHandle& other) const { return Index == other.Index && Generation == other.Generation; }
+	bool operator!=(const AssetHandle& other) const { return !(*this == other); }
+};
+
+struct MeshTag {};
+struct SpriteFontTag {};
+struct TextureTag {};
+struct PixelShaderTag {};
+struct VertexShaderTag {};
+struct ComputeShaderTag {};
+
+typedef AssetHandle<MeshTag> MeshHandle;
+typedef AssetHandle<SpriteFontTag> SpriteFontHandle;
+typedef AssetHandle<TextureTag> TextureHandle;
+typedef AssetHandle<PixelShaderTag> PixelShaderHandle;
+typedef AssetHandle<VertexShaderTag> VertexShaderHandle;
+typedef AssetHandle<ComputeShaderTag> ComputeShaderHandle;
+
+// Assets of one type in a dense array, found by interned name or by handle
+template<typename T, typename Handle>
+class AssetTable
+{
+public:
+	// Like map insertion, an existing asset with the same name is kept.  A different name
+	// that hashes the same is reported and returns an invalid handle, rather than the
+	// other asset's.
+	Handle Add(const std::string& name, T value)
+	{
+		return Add(AssetName(name), name, value);
+	}
+
+	// For a name already interned
+	Handle Add(AssetName interned, const std::string& name, T value)
+	{
+		uint64_t id = interned.Id;
+		auto it = lookup.find(id);
+		if (it != lookup.end())
+		{
+			if (!SameName(slots[it->second].Name, name))
+			{
+				printf("Asset name %s collides with %s\n", name.c_str(), slots[it->second].Name.c_str());
+				return Handle();
+			}
+			return Handle(it->second, slots[it->second].Generation);
+		}
+
+		uint32_t index;
+		if (freeSlots.empty())
+		{
+			index = (uint32_t)slots.size();
+			slots.push_back({});
+		}
+		else
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+
+		Slot& slot = slots[index];
+		slot.Value = value;
+		slot.Name = name;
+		slot.Generation = nextGeneration++;
+		slot.Alive = true;
+		lookup[id] = index;
+		count++;
+		return Handle(index, slot.Generation);
+	}
+
+	Handle Find(AssetName name) const
+	{
+		auto it = lookup.find(name.Id);
+		if (it == lookup.end())
+			return Handle();
+
+		return Handle(it->second, slots[it->second].Generation);
+	}
+
+	// Stale or invalid handles resolve to an empty T
+	T Get(Handle handle) const
+	{
+		if (!IsCurrent(handle))
+			return T();
+
+		return slots[handle.Index].Value;
+	}
+
+	// Swaps the asset behind a handle, leaving the handle and name valid
+	bool Replace(Handle handle, T value)
+	{
+		if (!IsCurrent(handle))
+			return false;
+
+		slots[handle.Index].Value = value;
+		return true;
+	}
+
+	bool Remove(Handle handle)
+	{
+		if (!IsCurrent(handle))
+			return false;
+
+		Slot& slot = slots[handle.Index];
+		lookup.erase(AssetName(slot.Name).Id);
+		slot.Value = T();
+		slot.Alive = false;
+		freeSlots.push_back(handle.Index);
+		count--;
+		return true;
+	}
+
+	bool IsCurrent(Handle handle) const
+	{
+		return handle.IsValid() && handle.Index < slots.size() &&
+			slots[handle.Index].Alive && slots[handle.Index].Generation == handle.Generation;
+	}
+
+	size_t Size() const { return count; }
+
+private:
+	static bool SameName(const std::string& a, const std::string& b)
+	{
+		if (a.size() != b.size())
+			return false;
+
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (AssetName::ToLower(a[i]) != AssetName::ToLower(b[i]))
+				return false;
+		}
+		return true;
+	}
+
+	struct Slot
+	{
+		T Value;
+		std::string Name;
+		uint32_t Generation;
+		bool Alive;
+	};
+
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+	std::unordered_map<uint64_t, uint32_t> lookup;
+	uint32_t nextGeneration = 1;
+	size_t count = 0;
+};
@@ -0,0 +1,126 @@
+#include "AssetIndex.h"
+#include <algorithm>
+
+using namespace std;
+
+// Extension priorities.  Cooked DDS files come first, then the order on-demand loading
+// has always searched in.
+struct AssetExtension
+{
+	const char* Extension;
+	AssetKind Kind;
+	int Priority;
+};
+
+static const AssetExtension assetExtensions[] =
+{
+	{ ".obj", ASSET_MESH, 0 },
+	{ ".dds", ASSET_TEXTURE, 0 },
+	{ ".jpg", ASSET_TEXTURE, 1 },
+	{ ".png", ASSET_TEXTURE, 2 },
+	{ ".tif", ASSET_TEXTURE, 3 },
+	{ ".spritefont", ASSET_SPRITEFONT, 0 },
+};
+
+void AssetIndex::Clear()
+{
+	for (auto& kind : entries)
+		kind.clear();
+}
+
+void AssetIndex::AddFile(const std::string& path)
+{
+	AssetKind kind;
+	string name;
+	int priority;
+	if (!Classify(path, kind, name, priority))
+		return;
+
+	vector<Candidate>& candidates = entries[kind][ToKey(name)];
+	for (auto& c : candidates)
+	{
+		if (c.Path == path)
+			return;
+	}
+
+	auto position = upper_bound(candidates.begin(), candidates.end(), priority,
+		[](int p, const Candidate& c) { return p < c.Priority; });
+	candidates.insert(position, { path, priority });
+}
+
+void AssetIndex::RemoveFile(const std::string& path)
+{
+	AssetKind kind;
+	string name;
+	int priority;
+	if (!Classify(path, kind, name, priority))
+		return;
+
+	auto it = entries[kind].find(ToKey(name));
+	if (it == entries[kind].end())
+		return;
+
+	vector<Candidate>& candidates = it->second;
+	candidates.erase(remove_if(candidates.begin(), candidates.end(),
+		[&path](const Candidate& c) { return c.Path == path; }), candidates.end());
+
+	if (candidates.empty())
+		entries[kind].erase(it);
+}
+
+bool AssetIndex::Find(AssetKind kind, const std::string& name, std::string& path)
+{
+	auto it = entries[kind].find(ToKey(name));
+	if (it == entries[kind].end())
+		return false;
+
+	path = it->second.front().Path;
+	return true;
+}
+
+void AssetIndex::ForEach(AssetKind kind, std::function<void(const std::string& name, const std::string& path)> callback)
+{
+	for (auto& entry : entries[kind])
+	{
+		AssetKind fileKind;
+		string name;
+		int priority;
+		Classify(entry.second.front().Path, fileKind, name, priority);
+		callback(name, entry.second.front().Path);
+	}
+}
+
+std::string AssetIndex::ToKey(const std::string& name)
+{
+	string key = name;
+	transform(key.begin(), key.end(), key.begin(), [](char c) { return (char)tolower(c); });
+	return key;
+}
+
+bool AssetIndex::Classify(const std::string& path, AssetKind& kind, std::string& name, int& priority)
+{
+	size_t dot = path.find_last_of('.');
+	if (dot == string::npos)
+		return false;
+
+	string extension = path.substr(dot);
+	transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower(c); });
+
+	for (auto& e : assetExtensions)
+	{
+		if (extension != e.Extension)
+			continue;
+
+		size_t slash = path.find_last_of("/\\");
+		size_t nameStart = slash == string::npos ? 0 : slash + 1;
+		if (dot <= nameStart)
+			return false;
+
+		kind = e.Kind;
+		priority = e.Priority;
+		name = path.substr(nameStart, dot - nameStart);
+		return true;
+	}
+
+	return false;
+}
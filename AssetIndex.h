@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+
+enum AssetKind
+{
+	ASSET_MESH,
+	ASSET_TEXTURE,
+	ASSET_SPRITEFONT,
+	ASSET_KIND_COUNT
+};
+
+// Maps asset names (file names without extension) to the file that should be loaded
+// for them, so on-demand lookups don't touch the filesystem.  When several files
+// share a name, the extension with the highest priority wins.  Names match without
+// regard to case, like the Windows file lookups this replaces.
+class AssetIndex
+{
+public:
+	void Clear();
+
+	// Files with extensions that aren't assets are ignored
+	void AddFile(const std::string& path);
+	void RemoveFile(const std::string& path);
+
+	bool Find(AssetKind kind, const std::string& name, std::string& path);
+	void ForEach(AssetKind kind, std::function<void(const std::string& name, const std::string& path)> callback);
+
+	size_t GetAssetCount(AssetKind kind) { return entries[kind].size(); }
+
+	// Kind, name and priority of a path, lower priority values winning
+	static bool Classify(const std::string& path, AssetKind& kind, std::string& name, int& priority);
+
+private:
+	static std::string ToKey(const std::string& name);
+
+	struct Candidate
+	{
+		std::string Path;
+		int Priority;
+	};
+
+	// Candidates are kept sorted by priority, so the front one is always the answer
+	std::unordered_map<std::string, std::vector<Candidate>> entries[ASSET_KIND_COUNT];
+};
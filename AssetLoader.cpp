@@ -0,0 +1,44 @@
+#include "AssetLoader.h"
+#include <cstdio>
+
+using namespace std;
+
+AssetLoader::AssetLoader(JobSystem* Jobs)
+	:
+	jobs(Jobs),
+	clockStart(chrono::high_resolution_clock::now())
+{
+}
+
+void AssetLoader::Restart()
+{
+	clockStart = chrono::high_resolution_clock::now();
+	timeline.clear();
+}
+
+double AssetLoader::GetClockMs()
+{
+	return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - clockStart).count();
+}
+
+std::future<void> AssetLoader::Submit(std::function<void()> job)
+{
+	if (jobs)
+		return jobs->Submit(job);
+
+	//Done before returning, so the future is already ready
+	packaged_task<void()> task(job);
+	future<void> done = task.get_future();
+	task();
+	return done;
+}
+
+void AssetLoader::PrintTimeline()
+{
+	printf("Asset load timeline (ms since Initialize):\n");
+	for (auto& t : timeline)
+	{
+		printf("  %-10s %-32s worker %2d  queued %8.2f  decode %8.2f - %8.2f  create %8.2f - %8.2f\n",
+			t.Type.c_str(), t.Name.c_str(), t.WorkerIndex, t.QueuedMs, t.DecodeStartMs, t.DecodeEndMs, t.CreateStartMs, t.CreateEndMs);
+	}
+}
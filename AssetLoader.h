@@ -0,0 +1,197 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AssetHandles.h"
+#include "JobSystem.h"
+
+// When each stage of an asset's load happened, in milliseconds since the loader's clock started
+struct AssetLoadTiming
+{
+	std::string Name;
+	std::string Type;
+	int WorkerIndex;
+	double QueuedMs;
+	double DecodeStartMs;
+	double DecodeEndMs;
+	double CreateStartMs;
+	double CreateEndMs;
+};
+
+// The clock, workers and timeline that asset loads share.  Plain C++ with no D3D:
+// decoding runs on the job system, and creating resources from what was decoded is
+// left to whoever finishes the asset.  Without a job system, decodes run on the
+// calling thread as they're queued, one asset after another.
+class AssetLoader
+{
+public:
+	AssetLoader(JobSystem* Jobs = 0);
+
+	void SetJobSystem(JobSystem* jobs) { this->jobs = jobs; }
+	JobSystem* GetJobSystem() { return jobs; }
+
+	// Zeroes the clock and clears the timeline
+	void Restart();
+	double GetClockMs();
+
+	std::future<void> Submit(std::function<void()> job);
+
+	void Record(const AssetLoadTiming& timing) { timeline.push_back(timing); }
+	const std::vector<AssetLoadTiming>& GetTimeline() { return timeline; }
+	void PrintTimeline();
+
+private:
+	JobSystem* jobs;
+	std::chrono::high_resolution_clock::time_point clockStart;
+	std::vector<AssetLoadTiming> timeline;
+};
+
+// Assets of one type queued on an AssetLoader: Data is what decoding produces, and T
+// what finishing creates from it.  Pending assets are found by AssetName, so without
+// regard to case, like the asset tables and the index.  Only the thread that queues
+// and finishes touches the queue; decode jobs only touch their own asset.
+template<typename Data, typename T>
+class AssetLoadQueue
+{
+public:
+	struct Pending
+	{
+		std::string Path;
+		std::string Name;
+		AssetLoadTiming Timing;
+		bool Failed;
+		Data Decoded;
+		std::future<void> DecodeJob;
+		std::promise<T> Created;
+		std::shared_future<T> Result;
+	};
+
+	// Decode returns false if the file couldn't be read
+	typedef std::function<bool(Pending&)> DecodeFunction;
+	typedef std::function<T(Pending&)> FinishFunction;
+
+	AssetLoadQueue(AssetLoader& Loader) : loader(Loader) {}
+
+	// Starts decoding, from data with whatever the decode needs to know filled in.
+	// Returns false, queueing nothing, if the name is already pending.
+	bool Queue(const std::string& path, const std::string& name, const std::string& type, Data data, DecodeFunction decode);
+	bool IsPending(const std::string& name) const { return pending.count(AssetName(name).Id) != 0; }
+
+	// Resolves once the asset is finished.  False if it isn't pending.
+	bool GetResult(const std::string& name, std::shared_future<T>& result) const;
+
+	// Finishes one asset now, waiting on its decode.  False if it isn't pending.
+	bool Finish(const std::string& name, const FinishFunction& finish, T& result);
+
+	// Finishes every decoded asset, stopping early once the loader's clock passes the
+	// deadline (when there is one)
+	void FinishReady(const FinishFunction& finish, double deadlineMs = 0);
+
+	size_t Size() const { return pending.size(); }
+
+private:
+	T FinishPending(Pending& asset, const FinishFunction& finish);
+
+	AssetLoader& loader;
+	std::unordered_map<uint64_t, std::shared_ptr<Pending>> pending;
+};
+
+template<typename Data, typename T>
+inline bool AssetLoadQueue<Data, T>::Queue(const std::string& path, const std::string& name, const std::string& type, Data data, DecodeFunction decode)
+{
+	uint64_t id = AssetName(name).Id;
+	if (pending.count(id))
+		return false;
+
+	std::shared_ptr<Pending> asset = std::make_shared<Pending>();
+	asset->Path = path;
+	asset->Name = name;
+	asset->Failed = false;
+	asset->Decoded = std::move(data);
+	asset->Result = asset->Created.get_future().share();
+	asset->Timing = {};
+	asset->Timing.Name = name;
+	asset->Timing.Type = type;
+	asset->Timing.WorkerIndex = -1;
+	asset->Timing.QueuedMs = loader.GetClockMs();
+	pending[id] = asset;
+
+	AssetLoader* timer = &loader;
+	asset->DecodeJob = loader.Submit([asset, decode, timer]() {
+		asset->Timing.WorkerIndex = JobSystem::GetCurrentWorkerIndex();
+		asset->Timing.DecodeStartMs = timer->GetClockMs();
+		asset->Failed = !decode(*asset);
+		asset->Timing.DecodeEndMs = timer->GetClockMs();
+	});
+	return true;
+}
+
+template<typename Data, typename T>
+inline bool AssetLoadQueue<Data, T>::GetResult(const std::string& name, std::shared_future<T>& result) const
+{
+	auto it = pending.find(AssetName(name).Id);
+	if (it == pending.end())
+		return false;
+
+	result = it->second->Result;
+	return true;
+}
+
+template<typename Data, typename T>
+inline bool AssetLoadQueue<Data, T>::Finish(const std::string& name, const FinishFunction& finish, T& result)
+{
+	auto it = pending.find(AssetName(name).Id);
+	if (it == pending.end())
+		return false;
+
+	//Out of the queue first, so finish can look the name up without finding itself
+	std::shared_ptr<Pending> asset = it->second;
+	pending.erase(it);
+	result = FinishPending(*asset, finish);
+	return true;
+}
+
+template<typename Data, typename T>
+inline void AssetLoadQueue<Data, T>::FinishReady(const FinishFunction& finish, double deadlineMs)
+{
+	//Finishing can queue or finish other assets, so it works from a list of ids
+	std::vector<uint64_t> ready;
+	for (auto& entry : pending)
+	{
+		if (entry.second->DecodeJob.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			ready.push_back(entry.first);
+	}
+
+	for (uint64_t id : ready)
+	{
+		if (deadlineMs > 0 && loader.GetClockMs() >= deadlineMs)
+			return;
+
+		auto it = pending.find(id);
+		if (it == pending.end())
+			continue;
+
+		std::shared_ptr<Pending> asset = it->second;
+		pending.erase(it);
+		FinishPending(*asset, finish);
+	}
+}
+
+template<typename Data, typename T>
+inline T AssetLoadQueue<Data, T>::FinishPending(Pending& asset, const FinishFunction& finish)
+{
+	asset.DecodeJob.wait();
+
+	asset.Timing.CreateStartMs = loader.GetClockMs();
+	T created = finish(asset);
+	asset.Timing.CreateEndMs = loader.GetClockMs();
+
+	loader.Record(asset.Timing);
+	asset.Created.set_value(created);
+	return created;
+}
@@ -5,15 +5,33 @@
 
 #include <DDSTextureLoader.h>
 #include <WICTextureLoader.h>
+#include <wincodec.h>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+#include "TextureCooker.h"
+#include "Profiler.h"
 
 using namespace DirectX;
 using namespace std;
 
 Assets* Assets::instance;
 
+//Kept next to the compiled shaders, which is where they are looked up from
+static const char* shaderReflectionCacheFile = "ShaderReflection.cache";
+
+//A sky is a folder of six faces, cooked into one cube next to them
+static const char* skyFaces[6] = { "right", "left", "up", "down", "front", "back" };
+static const char* skyCubemapFile = "cubemap.dds";
+
 Assets::~Assets()
 {
-
+	//Both jobs use this object
+	if (assetPoll.valid())
+		assetPoll.wait();
+	if (cookJob.valid())
+		cookJob.wait();
 }
 
 void Assets::Initialize(std::string rootAssetPath, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, bool allowOnDemandLoading, bool printLoadingProgress)
@@ -28,40 +46,327 @@ void Assets::Initialize(std::string rootAssetPath, Microsoft::WRL::ComPtr<ID3D11
 
 	if (!EndsWith(rootAssetPath, "/"))
 		rootAssetPath += "/";
+
+	if (!jobs)
+		jobs = make_unique<JobSystem>();
+	loader.SetJobSystem(jobs.get());
+	loader.Restart();
+
+	//One walk of the tree up front, after which the watcher keeps the index current
+	assetIndex.Clear();
+	assetWatcher.reset();
+	if (!this->rootAssetPath.empty())
+	{
+		assetWatcher = make_unique<DirectoryWatcher>(GetFullPathTo(this->rootAssetPath));
+		ApplyFileChanges(assetWatcher->Poll(), false);
+	}
+
+	//Shaders seen on an earlier run skip reflection
+	shaderReflectionCache.Load(GetFullPathTo(shaderReflectionCacheFile));
+	ISimpleShader::ReflectionCache = &shaderReflectionCache;
+	shaderPermutations.Initialize(device, context, GetExePath_Wide());
+
+	//Only the baseline matters here, shaders are found by name
+	shaderWatcher = make_unique<DirectoryWatcher>(GetExePath());
+	shaderWatcher->Poll();
 }
 
-void Assets::LoadAllAssets()
+void Assets::Update(float dt)
 {
-	if (rootAssetPath.empty())
+	PROFILE_SCOPE("Assets::Update");
+	UpdateTextureStreaming();
+
+	//Picks up shaders loaded on demand or hot reloaded since the last save
+	if (shaderReflectionCache.IsDirty())
+		shaderReflectionCache.Save(GetFullPathTo(shaderReflectionCacheFile));
+
+	if (!assetWatcher)
 		return;
 
-	for (auto& item : experimental::filesystem::recursive_directory_iterator(GetFullPathTo(rootAssetPath))) {
+	if (assetPoll.valid())
+	{
+		if (assetPoll.wait_for(chrono::seconds(0)) != future_status::ready)
+			return;
+
+		assetPoll.get();
+		ApplyFileChanges(polledChanges, false);
+		ApplyFileChanges(polledShaderChanges, true);
+		polledChanges.clear();
+		polledShaderChanges.clear();
+	}
 
-		if (item.status().type() == experimental::filesystem::file_type::regular)
-		{
-			string itemPath = item.path().string();
+	UpdateCooks();
+	ApplyReloads();
 
-			replace(itemPath.begin(), itemPath.end(), '\\', '/');
+	timeSinceAssetPoll += dt;
+	if (timeSinceAssetPoll < assetPollInterval)
+		return;
+	timeSinceAssetPoll = 0;
+
+	//The polled change lists belong to the job until assetPoll is ready
+	bool pollShaders = hotReload;
+	assetPoll = jobs->Submit([this, pollShaders]() {
+		polledChanges = assetWatcher->Poll();
+		if (pollShaders)
+			polledShaderChanges = shaderWatcher->Poll();
+	});
+}
 
-			if (EndsWith(itemPath, ".obj"))
-			{
-				LoadMesh(itemPath, RemoveFileExtension(item.path().filename().string()));
-			}
-			if (EndsWith(itemPath, ".jpg") || EndsWith(itemPath, ".png") || EndsWith(itemPath, ".tif"))
-			{
-				LoadTexture(itemPath, RemoveFileExtension(item.path().filename().string()));
-			}
-			if (EndsWith(itemPath, ".dds"))
-			{
-				LoadDDSTexture(itemPath, RemoveFileExtension(item.path().filename().string()));
-			}
-			if (EndsWith(itemPath, ".spritefont"))
+void Assets::ApplyFileChanges(const std::vector<FileChange>& changes, bool shaderDirectory)
+{
+	for (auto& change : changes)
+	{
+		if (change.Type == FileChange::MODIFIED)
+		{
+			//An edited source image is cooked again, and the new DDS is then reloaded like any other change
+			string prefix = shaderDirectory ? "" : GetPackedTexturePrefix(change.Path);
+			bool cook = !shaderDirectory && NeedsCooking(change.Path);
+			bool pack = !prefix.empty() && NeedsPacking(prefix);
+			if (hotReload && (cook || pack))
 			{
-				LoadSpriteFont(itemPath, RemoveFileExtension(item.path().filename().string()));
+				//A cook already waiting will see this edit too
+				bool queued = false;
+				for (auto& waiting : queuedCooks)
+					queued |= waiting.Path == change.Path;
+				if (!queued)
+					queuedCooks.push_back({ change.Path, prefix, cook, pack });
 			}
+			else if (hotReload)
+				QueueReload(change.Path, shaderDirectory);
+			continue;
+		}
+
+		if (shaderDirectory)
+			continue;
+
+		//Sky builds its cube from the files itself, so they aren't loaded as textures too
+		if (change.Type == FileChange::ADDED && GetSkyFolder(change.Path).empty())
+			assetIndex.AddFile(change.Path);
+		else if (change.Type == FileChange::REMOVED)
+			assetIndex.RemoveFile(change.Path);
+	}
+}
+
+void Assets::UpdateCooks()
+{
+	if (cookJob.valid())
+	{
+		if (cookJob.wait_for(chrono::seconds(0)) != future_status::ready)
+			return;
+
+		//The cooked files are whole by now, so they're safe to reload
+		cookJob.get();
+		if (runningCook.Cook)
+			QueueReload(RemoveFileExtension(runningCook.Path) + ".dds", false);
+		if (runningCook.Pack)
+			QueueReload(runningCook.Prefix + "_rma.dds", false);
+	}
+
+	if (queuedCooks.empty())
+		return;
+
+	runningCook = queuedCooks.front();
+	queuedCooks.erase(queuedCooks.begin());
+	QueuedCook cook = runningCook;
+	cookJob = jobs->Submit([this, cook]() {
+		if (cook.Cook)
+			CookTexture(cook.Path);
+		if (cook.Pack)
+			CookPackedTexture(cook.Prefix);
+	});
+}
+
+void Assets::QueueReload(const std::string& path, bool isShader)
+{
+	for (auto& pending : pendingReloads)
+	{
+		if (pending->Path == path)
+			return;
+	}
+
+	shared_ptr<PendingReload> reload = make_shared<PendingReload>();
+	reload->Path = path;
+	reload->Kind = ASSET_KIND_COUNT;
+	reload->IsShader = isShader;
+	reload->IsDDS = false;
+	reload->Failed = false;
+
+	//Only assets that are actually loaded have anything to swap
+	if (isShader)
+	{
+		if (!EndsWith(path, ".cso"))
+			return;
+
+		reload->Name = RemoveFileExtension(path.substr(path.find_last_of('/') + 1));
+		AssetName name(reload->Name);
+		if (!pixelShaders.Find(name).IsValid() && !vertexShaders.Find(name).IsValid() && !computeShaders.Find(name).IsValid())
+			return;
+	}
+	else
+	{
+		int priority;
+		string indexedPath;
+		if (!AssetIndex::Classify(path, reload->Kind, reload->Name, priority))
+			return;
+
+		//A file hidden by a higher priority one with the same name isn't live
+		if (!assetIndex.Find(reload->Kind, reload->Name, indexedPath) || indexedPath != path)
+			return;
+
+		if (reload->Kind == ASSET_MESH && !meshes.Find(AssetName(reload->Name)).IsValid())
+			return;
+		if (reload->Kind == ASSET_TEXTURE && !textures.Find(AssetName(reload->Name)).IsValid())
+			return;
+		if (reload->Kind == ASSET_SPRITEFONT)
+			return;
+
+		//Streamed textures re-read just the mips they have resident
+		int streamed = reload->Kind == ASSET_TEXTURE ? FindStreamedTexture(textures.Find(AssetName(reload->Name))) : -1;
+		if (streamed >= 0)
+		{
+			QueueMipUpload(streamed, textureResidency->GetResidentMip(streamed), true);
+			return;
+		}
+
+		reload->IsDDS = EndsWith(path, ".dds");
+	}
+
+	reload->Decoded = jobs->Submit([this, reload]() {
+		if (reload->IsShader)
+			reload->Failed = FAILED(D3DReadFileToBlob(ToWideString(reload->Path).c_str(), reload->ShaderBlob.GetAddressOf()));
+		else if (reload->Kind == ASSET_MESH)
+			reload->Failed = !LoadOBJ(reload->Path.c_str(), reload->Geometry);
+		else if (reload->IsDDS)
+			reload->Failed = !ReadFileBytes(reload->Path, reload->FileData);
+		else
+			reload->Failed = !DecodeImage(reload->Path, reload->Image);
+	});
+	pendingReloads.push_back(reload);
+}
+
+void Assets::ApplyReloads()
+{
+	if (pendingReloads.empty() || !device)
+		return;
+
+	//All or nothing, so a shader and the mesh or texture saved alongside it change on the same frame
+	for (auto& reload : pendingReloads)
+	{
+		if (reload->Decoded.wait_for(chrono::seconds(0)) != future_status::ready)
+			return;
+	}
+
+	for (auto& reload : pendingReloads)
+		ApplyReload(*reload);
+
+	pendingReloads.clear();
+}
+
+void Assets::ApplyReload(PendingReload& reload)
+{
+	if (reload.Failed)
+	{
+		printf("Hot reload failed, keeping the old version: %s\n", reload.Path.c_str());
+		return;
+	}
+
+	if (printLoadingProgress)
+	{
+		printf("Hot reloading: ");
+		printf(reload.Name.c_str());
+		printf("\n");
+	}
+
+	AssetName name(reload.Name);
+	if (reload.IsShader)
+	{
+		//Rebuilt in place, so every material holding the shader sees it
+		shared_ptr<SimplePixelShader> ps = pixelShaders.Get(pixelShaders.Find(name));
+		shared_ptr<SimpleVertexShader> vs = vertexShaders.Get(vertexShaders.Find(name));
+		shared_ptr<SimpleComputeShader> cs = computeShaders.Get(computeShaders.Find(name));
+		if (ps)
+			ps->LoadShaderBlob(reload.ShaderBlob);
+		if (vs)
+			vs->LoadShaderBlob(reload.ShaderBlob);
+		if (cs)
+			cs->LoadShaderBlob(reload.ShaderBlob);
+
+		//A new .cso means the source changed, so its permutations are rebuilt too
+		shaderPermutations.Reload(reload.Name);
+		return;
+	}
+
+	if (reload.Kind == ASSET_MESH)
+	{
+		shared_ptr<Mesh> mesh = meshes.Get(meshes.Find(name));
+		if (mesh)
+			mesh->Reload(reload.Geometry, device);
+		return;
+	}
+
+	TextureHandle handle = textures.Find(name);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> oldTexture = textures.Get(handle);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> newTexture = CreateTextureFromData(reload.IsDDS, reload.Image, reload.FileData);
+	if (!oldTexture || !newTexture)
+		return;
+
+	//When the shape is unchanged, copy into the existing texture so views handed out earlier update too
+	Microsoft::WRL::ComPtr<ID3D11Resource> oldResource;
+	Microsoft::WRL::ComPtr<ID3D11Resource> newResource;
+	oldTexture->GetResource(oldResource.GetAddressOf());
+	newTexture->GetResource(newResource.GetAddressOf());
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> oldTexture2D;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> newTexture2D;
+	if (SUCCEEDED(oldResource.As(&oldTexture2D)) && SUCCEEDED(newResource.As(&newTexture2D)))
+	{
+		D3D11_TEXTURE2D_DESC oldDesc;
+		D3D11_TEXTURE2D_DESC newDesc;
+		oldTexture2D->GetDesc(&oldDesc);
+		newTexture2D->GetDesc(&newDesc);
+		if (oldDesc.Width == newDesc.Width && oldDesc.Height == newDesc.Height && oldDesc.MipLevels == newDesc.MipLevels &&
+			oldDesc.ArraySize == newDesc.ArraySize && oldDesc.Format == newDesc.Format)
+		{
+			context->CopyResource(oldResource.Get(), newResource.Get());
+			return;
 		}
 	}
 
+	//Otherwise only lookups by name or handle can see the new one
+	textures.Replace(handle, newTexture);
+}
+
+void Assets::LoadAllAssets()
+{
+	PROFILE_SCOPE("Assets::LoadAllAssets");
+	LoadAllAssetsAsync();
+
+	while (!ProcessPendingAssets())
+		this_thread::yield();
+
+	if (printLoadingProgress)
+		PrintLoadTimeline();
+}
+
+void Assets::LoadAllAssetsAsync()
+{
+	if (rootAssetPath.empty())
+		return;
+
+	assetIndex.ForEach(ASSET_MESH, [this](const string& name, const string& path) {
+		QueueMesh(path, name + ".obj");
+	});
+	assetIndex.ForEach(ASSET_TEXTURE, [this](const string& name, const string& path) {
+		QueueTexture(path, name + path.substr(path.find_last_of('.')), EndsWith(path, ".dds"));
+	});
+	assetIndex.ForEach(ASSET_SPRITEFONT, [this](const string& name, const string& path) {
+		QueueSpriteFont(path, name + ".spritefont");
+	});
+
+	//Shaders are small and SimpleShader reads them itself, so they load here while the workers decode
+	if (!device)
+		return;
+
 	for (auto& item : experimental::filesystem::recursive_directory_iterator(GetFullPathTo(".")))
 	{
 		std::string itemPath = item.path().filename().string();
@@ -71,6 +376,316 @@ void Assets::LoadAllAssets()
 			LoadUnknownShader(itemPath, item.path().filename().string());
 		}
 	}
+
+	if (shaderReflectionCache.IsDirty())
+		shaderReflectionCache.Save(GetFullPathTo(shaderReflectionCacheFile));
+}
+
+bool Assets::ProcessPendingAssets(float budgetMs)
+{
+	PROFILE_SCOPE("Assets::ProcessPendingAssets");
+	double deadline = budgetMs > 0 ? GetLoadClockMs() + budgetMs : 0;
+
+	pendingMeshes.FinishReady([this](MeshLoadQueue::Pending& pending) { return FinishMesh(pending); }, deadline);
+	pendingSpriteFonts.FinishReady([this](SpriteFontLoadQueue::Pending& pending) { return FinishSpriteFont(pending); }, deadline);
+	pendingTextures.FinishReady([this](TextureLoadQueue::Pending& pending) { return FinishTexture(pending); }, deadline);
+
+	return GetPendingAssetCount() == 0;
+}
+
+unsigned int Assets::GetPendingAssetCount()
+{
+	return (unsigned int)(pendingMeshes.Size() + pendingSpriteFonts.Size() + pendingTextures.Size());
+}
+
+void Assets::CookTextures()
+{
+	PROFILE_SCOPE("Assets::CookTextures");
+	if (rootAssetPath.empty())
+		return;
+
+	vector<string> sources;
+	vector<string> packs;
+	vector<string> skies;
+	error_code error;
+	experimental::filesystem::recursive_directory_iterator it(GetFullPathTo(rootAssetPath), error);
+	for (; !error && it != experimental::filesystem::recursive_directory_iterator(); it.increment(error))
+	{
+		string path = it->path().string();
+		replace(path.begin(), path.end(), '\\', '/');
+		if (NeedsCooking(path))
+			sources.push_back(path);
+
+		string prefix = GetPackedTexturePrefix(path);
+		if (!prefix.empty() && find(packs.begin(), packs.end(), prefix) == packs.end() && NeedsPacking(prefix))
+			packs.push_back(prefix);
+
+		string skyFolder = GetSkyFolder(path);
+		if (!skyFolder.empty() && find(skies.begin(), skies.end(), skyFolder) == skies.end() && NeedsSkyCooking(skyFolder))
+			skies.push_back(skyFolder);
+	}
+
+	//One at a time, since each cook already spreads its blocks over every core
+	for (auto& path : sources)
+	{
+		if (CookTexture(path))
+			assetIndex.AddFile(RemoveFileExtension(path) + ".dds");
+	}
+
+	for (auto& prefix : packs)
+	{
+		if (CookPackedTexture(prefix))
+			assetIndex.AddFile(prefix + "_rma.dds");
+	}
+
+	for (auto& folder : skies)
+		CookSky(folder);
+}
+
+//The material a roughness, metal or AO map belongs to, or empty for other files
+std::string Assets::GetPackedTexturePrefix(const std::string& path)
+{
+	static const char* suffixes[] = { "_roughness", "_metal", "_ao" };
+
+	AssetKind kind;
+	string name;
+	int priority;
+	if (!AssetIndex::Classify(path, kind, name, priority) || kind != ASSET_TEXTURE || EndsWith(path, ".dds"))
+		return "";
+
+	string stem = RemoveFileExtension(path);
+	for (auto suffix : suffixes)
+	{
+		if (EndsWith(stem, suffix))
+			return stem.substr(0, stem.size() - strlen(suffix));
+	}
+	return "";
+}
+
+std::string Assets::FindSourceImage(const std::string& stem)
+{
+	static const char* extensions[] = { ".png", ".jpg", ".tif" };
+	for (auto extension : extensions)
+	{
+		if (experimental::filesystem::exists(stem + extension))
+			return stem + extension;
+	}
+	return "";
+}
+
+bool Assets::NeedsPacking(const std::string& prefix)
+{
+	string sources[3] = { FindSourceImage(prefix + "_roughness"), FindSourceImage(prefix + "_metal"), FindSourceImage(prefix + "_ao") };
+	if (sources[0].empty() || sources[1].empty())
+		return false;
+
+	error_code error;
+	auto packedTime = experimental::filesystem::last_write_time(prefix + "_rma.dds", error);
+	if (error)
+		return true;
+
+	for (auto& source : sources)
+	{
+		if (!source.empty() && packedTime < experimental::filesystem::last_write_time(source, error))
+			return true;
+	}
+	return false;
+}
+
+//Roughness, metal and AO (white without one) in red, green and blue of a BC7 map
+bool Assets::CookPackedTexture(const std::string& prefix)
+{
+	string sources[3] = { FindSourceImage(prefix + "_roughness"), FindSourceImage(prefix + "_metal"), FindSourceImage(prefix + "_ao") };
+	if (sources[0].empty() || sources[1].empty())
+		return false;
+
+	double start = GetLoadClockMs();
+	DecodedImage images[3];
+	PackSource packSources[3] = {};
+	for (int i = 0; i < 3; i++)
+	{
+		if (sources[i].empty())
+			continue;
+		if (!DecodeImage(sources[i], images[i]))
+			return false;
+		packSources[i] = { images[i].Pixels.data(), images[i].Width, images[i].Height };
+	}
+
+	vector<uint8_t> packed;
+	unsigned int width;
+	unsigned int height;
+	TextureCooker::PackChannels(packSources, 3, packed, width, height);
+
+	CookedTexture cooked;
+	TextureCooker::Cook(packed.data(), width, height, COOKED_BC7, cooked);
+	if (!TextureCooker::WriteDDS(prefix + "_rma.dds", cooked))
+	{
+		printf("Failed to write packed texture for %s\n", prefix.c_str());
+		return false;
+	}
+
+	if (printLoadingProgress)
+		printf("Packed Texture: %s_rma from %s in %.0f ms\n", prefix.substr(prefix.find_last_of('/') + 1).c_str(), sources[2].empty() ? "roughness and metal" : "roughness, metal and AO", GetLoadClockMs() - start);
+	return true;
+}
+
+//The folder a sky face or cooked cube is in, or empty for other files
+std::string Assets::GetSkyFolder(const std::string& path)
+{
+	AssetKind kind;
+	string name;
+	int priority;
+	size_t slash = path.find_last_of("/\\");
+	if (!AssetIndex::Classify(path, kind, name, priority) || kind != ASSET_TEXTURE || slash == string::npos)
+		return "";
+
+	bool skyFile = path.substr(slash + 1) == skyCubemapFile;
+	for (auto face : skyFaces)
+		skyFile = skyFile || (name == face && !EndsWith(path, ".dds"));
+	if (!skyFile)
+		return "";
+
+	//Only a folder with all six faces is a sky
+	string folder = path.substr(0, slash);
+	for (auto face : skyFaces)
+	{
+		if (FindSourceImage(folder + "/" + face).empty())
+			return "";
+	}
+	return folder;
+}
+
+bool Assets::NeedsSkyCooking(const std::string& folder)
+{
+	error_code error;
+	auto cookedTime = experimental::filesystem::last_write_time(folder + "/" + skyCubemapFile, error);
+	bool missing = (bool)error;
+
+	for (auto face : skyFaces)
+	{
+		string source = FindSourceImage(folder + "/" + face);
+		if (source.empty())
+			return false;
+		if (!missing && cookedTime < experimental::filesystem::last_write_time(source, error))
+			return true;
+	}
+	return missing;
+}
+
+//Six faces in one BC7 cube with mips, which loads without decoding or copying faces
+bool Assets::CookSky(const std::string& folder)
+{
+	PROFILE_SCOPE("Assets::CookSky");
+	double start = GetLoadClockMs();
+
+	//Faces go in D3D's order, which is the order of skyFaces
+	DecodedImage images[6];
+	PackSource faces[6];
+	for (int i = 0; i < 6; i++)
+	{
+		string source = FindSourceImage(folder + "/" + skyFaces[i]);
+		if (source.empty() || !DecodeImage(source, images[i]))
+			return false;
+		faces[i] = { images[i].Pixels.data(), images[i].Width, images[i].Height };
+	}
+
+	CookedTexture cooked[6];
+	if (!TextureCooker::CookCube(faces, COOKED_BC7, cooked))
+	{
+		printf("Sky faces in %s aren't all the same square size\n", folder.c_str());
+		return false;
+	}
+	if (!TextureCooker::WriteCubeDDS(folder + "/" + skyCubemapFile, cooked))
+	{
+		printf("Failed to write cooked sky for %s\n", folder.c_str());
+		return false;
+	}
+
+	if (printLoadingProgress)
+		printf("Cooked Sky: %s to BC7, %u mips in %.0f ms\n", folder.substr(folder.find_last_of('/') + 1).c_str(), cooked[0].MipCount, GetLoadClockMs() - start);
+	return true;
+}
+
+bool Assets::NeedsCooking(const std::string& path)
+{
+	AssetKind kind;
+	string name;
+	int priority;
+	CookedFormat format;
+	if (!AssetIndex::Classify(path, kind, name, priority) || kind != ASSET_TEXTURE || EndsWith(path, ".dds") || !TextureCooker::ChooseFormat(name, format))
+		return false;
+
+	//Up to date when the DDS is at least as new as its source
+	error_code error;
+	auto cookedTime = experimental::filesystem::last_write_time(RemoveFileExtension(path) + ".dds", error);
+	if (error)
+		return true;
+	return cookedTime < experimental::filesystem::last_write_time(path, error);
+}
+
+//Safe on worker threads, as it only touches the files
+bool Assets::CookTexture(const std::string& path)
+{
+	PROFILE_SCOPE("Assets::CookTexture");
+	static const char* formatNames[COOKED_FORMAT_COUNT] = { "BC7", "BC5", "BC4" };
+
+	AssetKind kind;
+	string name;
+	int priority;
+	CookedFormat format;
+	if (!AssetIndex::Classify(path, kind, name, priority) || !TextureCooker::ChooseFormat(name, format))
+		return false;
+
+	double start = GetLoadClockMs();
+	DecodedImage image;
+	if (!DecodeImage(path, image))
+		return false;
+
+	CookedTexture cooked;
+	TextureCooker::Cook(image.Pixels.data(), image.Width, image.Height, format, cooked);
+	if (!TextureCooker::WriteDDS(RemoveFileExtension(path) + ".dds", cooked))
+	{
+		printf("Failed to write cooked texture for %s\n", path.c_str());
+		return false;
+	}
+
+	if (printLoadingProgress)
+		printf("Cooked Texture: %s to %s, %u mips in %.0f ms\n", name.c_str(), formatNames[format], cooked.MipCount, GetLoadClockMs() - start);
+	return true;
+}
+
+void Assets::EnableTextureStreaming(uint64_t budgetBytes, unsigned int tailSize)
+{
+	textureResidency = make_unique<TextureResidency>(budgetBytes, tailSize);
+	streamingTailSize = tailSize;
+	streamedTextures.clear();
+	streamedTextureIds.clear();
+	pendingMipUploads.clear();
+}
+
+void Assets::RequestTextureDetail(TextureHandle texture, float screenPixels, float uvScale)
+{
+	int streamed = FindStreamedTexture(texture);
+	if (streamed < 0 || screenPixels <= 0)
+		return;
+
+	//The coarsest mip that still has a texel for every pixel covered
+	StreamedTexture& s = streamedTextures[streamed];
+	float texelsPerPixel = max(s.Width, s.Height) * uvScale / screenPixels;
+	unsigned int mip = 0;
+	while (texelsPerPixel >= 2.0f && mip + 1 < textureResidency->GetMipCount(streamed))
+	{
+		texelsPerPixel *= 0.5f;
+		mip++;
+	}
+	textureResidency->RequestMip(streamed, mip);
+}
+
+void Assets::SetTextureStreamingPriority(TextureHandle texture, int priority)
+{
+	int streamed = FindStreamedTexture(texture);
+	if (streamed >= 0)
+		textureResidency->SetPriority(streamed, priority);
 }
 
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Assets::CreateSolidColorTexture(std::string textureName, int width, int height, DirectX::XMFLOAT4 color)
@@ -90,86 +705,55 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Assets::CreateFloatTexture(std:
 
 std::shared_ptr<Mesh> Assets::GetMesh(std::string name)
 {
-	auto it = meshes.find(name);
-	if (it != meshes.end())
-		return it->second;
+	auto existing = meshes.Get(meshes.Find(AssetName(name)));
+	if (existing)
+		return existing;
 
-	if (allowOnDemandLoading)
-	{
-		string path = GetFullPathTo(rootAssetPath + name + ".obj");
-		if (experimental::filesystem::exists(path))
-			return LoadMesh(path, name + ".obj");
-		else
-		{
-			for (const auto& entry : experimental::filesystem::directory_iterator(GetFullPathTo(rootAssetPath)))
-			{
-				if (experimental::filesystem::is_directory(entry.status()))
-				{
-					path = entry.path().string() + "\\" + name + ".obj";
-					if (experimental::filesystem::exists(path))
-					{
-						return LoadMesh(path, name + ".obj");
-					}
-				}
-			}
-		}
-	}
+	shared_ptr<Mesh> mesh;
+	if (pendingMeshes.Finish(name, [this](MeshLoadQueue::Pending& pending) { return FinishMesh(pending); }, mesh))
+		return mesh;
+
+	string path;
+	if (allowOnDemandLoading && assetIndex.Find(ASSET_MESH, name, path))
+		return LoadMesh(path, name + ".obj");
 
 	return 0;
 }
 
 std::shared_ptr<DirectX::SpriteFont> Assets::GetSpriteFont(const std::string name)
 {
-	auto it = spriteFonts.find(name);
-	if (it != spriteFonts.end())
-		return it->second;
+	auto existing = spriteFonts.Get(spriteFonts.Find(AssetName(name)));
+	if (existing)
+		return existing;
 
-	if (allowOnDemandLoading)
-	{
-		for (const auto& entry : experimental::filesystem::directory_iterator(GetFullPathTo(rootAssetPath)))
-		{
-			if (experimental::filesystem::is_directory(entry.status()))
-			{
-				string path = entry.path().string() + "\\" + name + ".spritefont";
-				if(experimental::filesystem::exists(path))
-					return LoadSpriteFont(path, name + ".spritefont");
-			}
-		}
-	}
+	shared_ptr<SpriteFont> font;
+	if (pendingSpriteFonts.Finish(name, [this](SpriteFontLoadQueue::Pending& pending) { return FinishSpriteFont(pending); }, font))
+		return font;
+
+	string path;
+	if (allowOnDemandLoading && assetIndex.Find(ASSET_SPRITEFONT, name, path))
+		return LoadSpriteFont(path, name + ".spritefont");
 
 	return 0;
 }
 
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Assets::GetTexture(std::string name)
 {
-	auto it = textures.find(name);
-	if (it != textures.end())
-		return it->second;
-
-	if (allowOnDemandLoading)
-	{
-		for (const auto& entry : experimental::filesystem::directory_iterator(GetFullPathTo(rootAssetPath)))
-		{
-			if (experimental::filesystem::is_directory(entry.status()))
-			{
-				string pathJPG = entry.path().string() + "\\" + name + ".jpg";
-				if (experimental::filesystem::exists(pathJPG))
-					return LoadTexture(pathJPG, name + ".jpg");
-
-				string pathPNG = entry.path().string() + "\\" + name + ".png";
-				if (experimental::filesystem::exists(pathPNG))
-					return LoadTexture(pathPNG, name + ".png");
+	auto existing = textures.Get(textures.Find(AssetName(name)));
+	if (existing)
+		return existing;
 
-				string pathTIF = entry.path().string() + "\\" + name + ".tif";
-				if (experimental::filesystem::exists(pathTIF))
-					return LoadTexture(pathTIF, name + ".tif");
-
-				string pathDDS = entry.path().string() + "\\" + name + ".dds";
-				if (experimental::filesystem::exists(pathDDS))
-					return LoadDDSTexture(pathDDS, name + ".dds");
-			}
-		}
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture;
+	if (pendingTextures.Finish(name, [this](TextureLoadQueue::Pending& pending) { return FinishTexture(pending); }, texture))
+		return texture;
 
+	string path;
+	if (allowOnDemandLoading && assetIndex.Find(ASSET_TEXTURE, name, path))
+	{
+		string filename = name + path.substr(path.find_last_of('.'));
+		if (EndsWith(path, ".dds"))
+			return LoadDDSTexture(path, filename);
+		return LoadTexture(path, filename);
 	}
 
 	return 0;
@@ -177,9 +761,9 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Assets::GetTexture(std::string
 
 std::shared_ptr<SimplePixelShader> Assets::GetPixelShader(std::string name)
 {
-	auto it = pixelShaders.find(name);
-	if (it != pixelShaders.end())
-		return it->second;
+	auto existing = pixelShaders.Get(pixelShaders.Find(AssetName(name)));
+	if (existing)
+		return existing;
 
 	if (allowOnDemandLoading)
 	{
@@ -194,11 +778,27 @@ std::shared_ptr<SimplePixelShader> Assets::GetPixelShader(std::string name)
 	return 0;
 }
 
+std::shared_ptr<SimplePixelShader> Assets::GetPixelShaderPermutation(std::string name, ShaderFeatures features)
+{
+	if (features == SHADER_DEFAULT_FEATURES)
+		return GetPixelShader(name);
+
+	return shaderPermutations.GetPixelShader(name, features);
+}
+
+void Assets::SetShaderSourceDirectory(std::string relativePath)
+{
+	while (!relativePath.empty() && (relativePath.back() == '/' || relativePath.back() == '\\'))
+		relativePath.pop_back();
+
+	shaderPermutations.SetSourceDirectory(GetFullPathTo_Wide(ToWideString(relativePath)));
+}
+
 std::shared_ptr<SimpleVertexShader> Assets::GetVertexShader(std::string name)
 {
-	auto it = vertexShaders.find(name);
-	if (it != vertexShaders.end())
-		return it->second;
+	auto existing = vertexShaders.Get(vertexShaders.Find(AssetName(name)));
+	if (existing)
+		return existing;
 
 	if (allowOnDemandLoading)
 	{
@@ -213,54 +813,565 @@ std::shared_ptr<SimpleVertexShader> Assets::GetVertexShader(std::string name)
 	return 0;
 }
 
+std::shared_ptr<SimpleComputeShader> Assets::GetComputeShader(std::string name)
+{
+	auto existing = computeShaders.Get(computeShaders.Find(AssetName(name)));
+	if (existing)
+		return existing;
+
+	if (allowOnDemandLoading)
+	{
+		string csFileName = name + ".cso";
+		if (experimental::filesystem::exists(GetFullPathTo(csFileName)))
+		{
+			shared_ptr<SimpleComputeShader> cs = LoadComputeShader(csFileName);
+			if (cs) { return cs; }
+		}
+	}
+
+	return 0;
+}
+
+std::shared_future<std::shared_ptr<Mesh>> Assets::GetMeshAsync(std::string name)
+{
+	std::shared_future<std::shared_ptr<Mesh>> pending;
+	if (pendingMeshes.GetResult(name, pending))
+		return pending;
+
+	return MakeReadyFuture(GetMesh(name));
+}
+
+std::shared_future<std::shared_ptr<DirectX::SpriteFont>> Assets::GetSpriteFontAsync(std::string name)
+{
+	std::shared_future<std::shared_ptr<DirectX::SpriteFont>> pending;
+	if (pendingSpriteFonts.GetResult(name, pending))
+		return pending;
+
+	return MakeReadyFuture(GetSpriteFont(name));
+}
+
+std::shared_future<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> Assets::GetTextureAsync(std::string name)
+{
+	std::shared_future<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> pending;
+	if (pendingTextures.GetResult(name, pending))
+		return pending;
+
+	return MakeReadyFuture(GetTexture(name));
+}
+
 void Assets::AddMesh(std::string name, std::shared_ptr<Mesh> mesh)
 {
-	meshes.insert({ name, mesh });
+	meshes.Add(name, mesh);
 }
 
 void Assets::AddSpriteFont(std::string name, std::shared_ptr<DirectX::SpriteFont> sprite)
 {
-	spriteFonts.insert({ name, sprite });
+	spriteFonts.Add(name, sprite);
 }
 
 void Assets::AddTexture(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture)
 {
-	textures.insert({ name, texture });
+	textures.Add(name, texture);
 }
 
 void Assets::AddPixelShader(std::string name, std::shared_ptr<SimplePixelShader> PSShader)
 {
-	pixelShaders.insert({ name, PSShader });
+	pixelShaders.Add(name, PSShader);
 }
 
 void Assets::AddVertexShader(std::string name, std::shared_ptr<SimpleVertexShader> VSShader)
 {
-	vertexShaders.insert({ name, VSShader });
+	vertexShaders.Add(name, VSShader);
+}
+
+void Assets::AddComputeShader(std::string name, std::shared_ptr<SimpleComputeShader> CSShader)
+{
+	computeShaders.Add(name, CSShader);
 }
 
 unsigned int Assets::GetMeshCount()
 {
-	return (unsigned int)meshes.size();
+	return (unsigned int)meshes.Size();
 }
 
 unsigned int Assets::GetSpriteFontCount()
 {
-	return (unsigned int)spriteFonts.size();
+	return (unsigned int)spriteFonts.Size();
 }
 
 unsigned int Assets::GetTextureCount()
 {
-	return (unsigned int)textures.size();
+	return (unsigned int)textures.Size();
 }
 
 unsigned int Assets::GetPixelShaderCount()
 {
-	return (unsigned int)pixelShaders.size();
+	return (unsigned int)pixelShaders.Size();
 }
 
 unsigned int Assets::GetVertexShaderCount()
 {
-	return (unsigned int)vertexShaders.size();
+	return (unsigned int)vertexShaders.Size();
+}
+
+unsigned int Assets::GetComputeShaderCount()
+{
+	return (unsigned int)computeShaders.Size();
+}
+
+void Assets::QueueMesh(std::string path, std::string filename)
+{
+	string name = RemoveFileExtension(filename);
+	if (meshes.Find(AssetName(name)).IsValid())
+		return;
+
+	pendingMeshes.Queue(path, name, "Mesh", MeshData(), [](MeshLoadQueue::Pending& pending) {
+		PROFILE_SCOPE("Decode Mesh");
+		return LoadOBJ(pending.Path.c_str(), pending.Decoded);
+	});
+}
+
+void Assets::QueueSpriteFont(std::string path, std::string filename)
+{
+	string name = RemoveFileExtension(filename);
+	if (spriteFonts.Find(AssetName(name)).IsValid())
+		return;
+
+	pendingSpriteFonts.Queue(path, name, "SpriteFont", vector<uint8_t>(), [this](SpriteFontLoadQueue::Pending& pending) {
+		PROFILE_SCOPE("Read SpriteFont");
+		return ReadFileBytes(pending.Path, pending.Decoded);
+	});
+}
+
+void Assets::QueueTexture(std::string path, std::string filename, bool isDDS)
+{
+	string name = RemoveFileExtension(filename);
+	if (textures.Find(AssetName(name)).IsValid())
+		return;
+
+	DecodedTexture texture = {};
+	texture.IsDDS = isDDS;
+	unsigned int tailSize = textureResidency ? streamingTailSize : 0;
+	pendingTextures.Queue(path, name, isDDS ? "DDSTexture" : "Texture", texture, [this, tailSize](TextureLoadQueue::Pending& pending) {
+		PROFILE_SCOPE("Decode Texture");
+		DecodedTexture& texture = pending.Decoded;
+
+		//DDS data is already in its GPU layout, so only the read happens off thread
+		if (texture.IsDDS)
+			return ReadFileBytes(pending.Path, texture.FileData);
+		if (!DecodeImage(pending.Path, texture.Image))
+			return false;
+
+		//Streamed images only upload their tail to begin with
+		if (tailSize)
+			DownsampleImage(texture.Image, TextureResidency::TailMipFor(texture.Image.Width, texture.Image.Height, tailSize));
+		return true;
+	});
+}
+
+std::shared_ptr<Mesh> Assets::FinishMesh(MeshLoadQueue::Pending& pending)
+{
+	if (printLoadingProgress) {
+		printf("Loading Mesh: ");
+		printf(pending.Name.c_str());
+		printf("\n");
+	}
+
+	std::shared_ptr<Mesh> newMesh;
+	if (device && !pending.Failed)
+	{
+		newMesh = make_shared<Mesh>(pending.Decoded, device);
+		meshes.Add(pending.Name, newMesh);
+	}
+	return newMesh;
+}
+
+std::shared_ptr<DirectX::SpriteFont> Assets::FinishSpriteFont(SpriteFontLoadQueue::Pending& pending)
+{
+	if (printLoadingProgress) {
+		printf("Loading Spritefont: ");
+		printf(pending.Name.c_str());
+		printf("\n");
+	}
+
+	std::shared_ptr<SpriteFont> newSpriteFont;
+	if (device && !pending.Failed)
+	{
+		newSpriteFont = make_shared<SpriteFont>(device.Get(), pending.Decoded.data(), pending.Decoded.size());
+		spriteFonts.Add(pending.Name, newSpriteFont);
+	}
+	return newSpriteFont;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Assets::FinishTexture(TextureLoadQueue::Pending& pending)
+{
+	const DecodedTexture& texture = pending.Decoded;
+	if (printLoadingProgress)
+	{
+		printf(texture.IsDDS ? "Loading DDSTexture: " : "Loading Texture: ");
+		printf(pending.Name.c_str());
+		printf("\n");
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> newTexture;
+	if (device && !pending.Failed)
+	{
+		if (textureResidency)
+			newTexture = CreateStreamedTexture(pending.Name, pending.Path, texture.IsDDS, texture.Image, texture.FileData);
+		else
+		{
+			newTexture = CreateTextureFromData(texture.IsDDS, texture.Image, texture.FileData);
+			textures.Add(pending.Name, newTexture);
+		}
+	}
+	return newTexture;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Assets::CreateTextureFromData(bool isDDS, const DecodedImage& image, const std::vector<uint8_t>& fileData, unsigned int maxSize)
+{
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> newTexture;
+	if (isDDS)
+	{
+		CreateDDSTextureFromMemoryEx(device.Get(), context.Get(), fileData.data(), fileData.size(), maxSize,
+			D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, false, 0, newTexture.GetAddressOf());
+		return newTexture;
+	}
+
+	//Same result as CreateWICTextureFromFile with a context: RGBA8 with a generated mip chain
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = image.Width;
+	textureDesc.Height = image.Height;
+	textureDesc.MipLevels = 0;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+	textureDesc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	device->CreateTexture2D(&textureDesc, 0, texture.GetAddressOf());
+	context->UpdateSubresource(texture.Get(), 0, 0, image.Pixels.data(), image.Width * 4, 0);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = textureDesc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MipLevels = (UINT)-1;
+	device->CreateShaderResourceView(texture.Get(), &srvDesc, newTexture.GetAddressOf());
+	context->GenerateMips(newTexture.Get());
+	return newTexture;
+}
+
+//Runs on worker threads, so it owns its COM initialization
+bool Assets::DecodeImage(std::string path, DecodedImage& image)
+{
+	HRESULT coInit = CoInitializeEx(0, COINIT_MULTITHREADED);
+	bool decoded = false;
+
+	{
+		Microsoft::WRL::ComPtr<IWICImagingFactory> factory;
+		Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+		Microsoft::WRL::ComPtr<IWICBitmapFrameDecode> frame;
+		Microsoft::WRL::ComPtr<IWICFormatConverter> converter;
+
+		if (SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, 0, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory.GetAddressOf()))) &&
+			SUCCEEDED(factory->CreateDecoderFromFilename(ToWideString(path).c_str(), 0, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf())) &&
+			SUCCEEDED(decoder->GetFrame(0, frame.GetAddressOf())) &&
+			SUCCEEDED(factory->CreateFormatConverter(converter.GetAddressOf())) &&
+			SUCCEEDED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, 0, 0, WICBitmapPaletteTypeCustom)))
+		{
+			converter->GetSize(&image.Width, &image.Height);
+			image.SourceWidth = image.Width;
+			image.SourceHeight = image.Height;
+			image.Pixels.resize((size_t)image.Width * image.Height * 4);
+			decoded = SUCCEEDED(converter->CopyPixels(0, image.Width * 4, (UINT)image.Pixels.size(), image.Pixels.data()));
+		}
+	}
+
+	if (SUCCEEDED(coInit))
+		CoUninitialize();
+
+	return decoded;
+}
+
+bool Assets::ReadFileBytes(std::string path, std::vector<uint8_t>& bytes)
+{
+	ifstream file(path, ios::binary | ios::ate);
+	if (!file.is_open())
+		return false;
+
+	bytes.resize((size_t)file.tellg());
+	file.seekg(0);
+	file.read((char*)bytes.data(), bytes.size());
+	return file.good();
+}
+
+//Sizes a file's bits per texel from the format it was created with
+static unsigned int BitsPerTexel(DXGI_FORMAT format, bool& blockCompressed)
+{
+	blockCompressed = true;
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		return 4;
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return 8;
+	}
+
+	blockCompressed = false;
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		return 128;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+		return 64;
+	case DXGI_FORMAT_R8G8_UNORM:
+	case DXGI_FORMAT_R16_FLOAT:
+		return 16;
+	case DXGI_FORMAT_R8_UNORM:
+	case DXGI_FORMAT_A8_UNORM:
+		return 8;
+	default:
+		return 32;
+	}
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Assets::CreateStreamedTexture(std::string name, std::string path, bool isDDS, const DecodedImage& image, const std::vector<uint8_t>& fileData)
+{
+	unsigned int width = image.SourceWidth;
+	unsigned int height = image.SourceHeight;
+	if (isDDS && !ReadDDSSize(fileData, width, height))
+	{
+		//Cube maps, arrays and files without a full mip chain load whole
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> wholeTexture = CreateTextureFromData(isDDS, image, fileData);
+		textures.Add(name, wholeTexture);
+		return wholeTexture;
+	}
+
+	unsigned int tailMip = TextureResidency::TailMipFor(width, height, streamingTailSize);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> newTexture = CreateTextureFromData(isDDS, image, fileData, max(width >> tailMip, height >> tailMip));
+	TextureHandle handle = textures.Add(name, newTexture);
+	if (!newTexture || tailMip == 0)
+		return newTexture;
+
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	newTexture->GetResource(resource.GetAddressOf());
+	if (FAILED(resource.As(&texture)))
+		return newTexture;
+
+	D3D11_TEXTURE2D_DESC desc;
+	texture->GetDesc(&desc);
+	bool blockCompressed;
+	unsigned int bitsPerTexel = BitsPerTexel(desc.Format, blockCompressed);
+
+	StreamedTexture streamed;
+	streamed.Path = path;
+	streamed.IsDDS = isDDS;
+	streamed.Handle = handle;
+	streamed.Width = width;
+	streamed.Height = height;
+	streamed.GpuMip = tailMip;
+
+	int id = textureResidency->AddTexture(width, height, bitsPerTexel, blockCompressed);
+	streamedTextures.push_back(streamed);
+	streamedTextureIds[handle.Index] = id;
+	return newTexture;
+}
+
+int Assets::FindStreamedTexture(TextureHandle handle)
+{
+	if (!textureResidency)
+		return -1;
+
+	auto it = streamedTextureIds.find(handle.Index);
+	if (it == streamedTextureIds.end() || streamedTextures[it->second].Handle != handle)
+		return -1;
+	return it->second;
+}
+
+void Assets::UpdateTextureStreaming()
+{
+	if (!textureResidency || !device)
+		return;
+
+	//Finished uploads land here, at the frame boundary
+	for (auto it = pendingMipUploads.begin(); it != pendingMipUploads.end();)
+	{
+		if ((*it)->Decoded.wait_for(chrono::seconds(0)) != future_status::ready)
+		{
+			++it;
+			continue;
+		}
+
+		FinishMipUpload(**it);
+		it = pendingMipUploads.erase(it);
+	}
+
+	//Dropping mips is a GPU copy of what is already there, gaining them needs the file
+	for (auto& change : textureResidency->Update())
+	{
+		if (change.ToMip >= streamedTextures[change.Texture].GpuMip)
+			DropMips(change.Texture, change.ToMip);
+		else
+			QueueMipUpload(change.Texture, change.ToMip, false);
+	}
+}
+
+void Assets::QueueMipUpload(int texture, unsigned int mip, bool reload)
+{
+	shared_ptr<PendingMipUpload> upload = make_shared<PendingMipUpload>();
+	upload->Texture = texture;
+	upload->Mip = mip;
+	upload->Reload = reload;
+	upload->Failed = false;
+
+	string path = streamedTextures[texture].Path;
+	bool isDDS = streamedTextures[texture].IsDDS;
+	upload->Decoded = jobs->Submit([this, upload, path, isDDS]() {
+		PROFILE_SCOPE("Decode Mip");
+		//DDS files skip their larger mips when created, images are shrunk here
+		if (isDDS)
+			upload->Failed = !ReadFileBytes(path, upload->FileData);
+		else
+		{
+			upload->Failed = !DecodeImage(path, upload->Image);
+			if (!upload->Failed)
+				DownsampleImage(upload->Image, upload->Mip);
+		}
+	});
+	pendingMipUploads.push_back(upload);
+}
+
+void Assets::FinishMipUpload(PendingMipUpload& upload)
+{
+	StreamedTexture& streamed = streamedTextures[upload.Texture];
+	if (upload.Failed)
+	{
+		printf("Texture streaming failed to read %s\n", streamed.Path.c_str());
+		return;
+	}
+
+	//Superseded by a later residency change, or already on the GPU
+	if (upload.Mip != textureResidency->GetResidentMip(upload.Texture) || (upload.Mip == streamed.GpuMip && !upload.Reload))
+		return;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> newTexture = CreateTextureFromData(
+		streamed.IsDDS, upload.Image, upload.FileData, max(streamed.Width >> upload.Mip, streamed.Height >> upload.Mip));
+	if (!newTexture)
+		return;
+
+	//Materials hold the handle, so replacing the table entry is enough
+	textures.Replace(streamed.Handle, newTexture);
+	streamed.GpuMip = upload.Mip;
+}
+
+void Assets::DropMips(int texture, unsigned int mip)
+{
+	StreamedTexture& streamed = streamedTextures[texture];
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> oldView = textures.Get(streamed.Handle);
+	if (!oldView || mip == streamed.GpuMip)
+		return;
+
+	Microsoft::WRL::ComPtr<ID3D11Resource> oldResource;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> oldTexture;
+	oldView->GetResource(oldResource.GetAddressOf());
+	if (FAILED(oldResource.As(&oldTexture)))
+		return;
+
+	D3D11_TEXTURE2D_DESC desc;
+	oldTexture->GetDesc(&desc);
+	unsigned int skipped = mip - streamed.GpuMip;
+	if (skipped >= desc.MipLevels)
+		return;
+
+	desc.Width = max(desc.Width >> skipped, 1u);
+	desc.Height = max(desc.Height >> skipped, 1u);
+	desc.MipLevels -= skipped;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> newTexture;
+	if (FAILED(device->CreateTexture2D(&desc, 0, newTexture.GetAddressOf())))
+		return;
+
+	for (unsigned int i = 0; i < desc.MipLevels; i++)
+		context->CopySubresourceRegion(newTexture.Get(), i, 0, 0, 0, oldTexture.Get(), i + skipped, 0);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	oldView->GetDesc(&srvDesc);
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = (UINT)-1;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> newView;
+	if (FAILED(device->CreateShaderResourceView(newTexture.Get(), &srvDesc, newView.GetAddressOf())))
+		return;
+
+	textures.Replace(streamed.Handle, newView);
+	streamed.GpuMip = mip;
+}
+
+//Halves the image down to the given mip
+void Assets::DownsampleImage(DecodedImage& image, unsigned int mip)
+{
+	for (unsigned int level = 0; level < mip && (image.Width > 1 || image.Height > 1); level++)
+	{
+		vector<uint8_t> half;
+		TextureCooker::DownsampleRGBA8(image.Pixels.data(), image.Width, image.Height, half);
+		image.Pixels.swap(half);
+		image.Width = max(image.Width / 2, 1u);
+		image.Height = max(image.Height / 2, 1u);
+	}
+}
+
+//Only plain 2D DDS files with a full mip chain can be streamed
+bool Assets::ReadDDSSize(const std::vector<uint8_t>& fileData, unsigned int& width, unsigned int& height)
+{
+	const size_t headerSize = 4 + 124;
+	if (fileData.size() < headerSize || memcmp(fileData.data(), "DDS ", 4) != 0)
+		return false;
+
+	uint32_t header[31];
+	memcpy(header, &fileData[4], sizeof(header));
+	height = header[2];
+	width = header[3];
+	uint32_t mipCount = header[6];
+	uint32_t fourCC = header[20];
+	uint32_t caps2 = header[27];
+
+	const uint32_t cubeMap = 0x200;
+	const uint32_t volume = 0x200000;
+	if (caps2 & (cubeMap | volume))
+		return false;
+
+	if (fourCC == MAKEFOURCC('D', 'X', '1', '0'))
+	{
+		//DDS_HEADER_DXT10: format, dimension, misc flags, array size
+		uint32_t dx10[4];
+		if (fileData.size() < headerSize + sizeof(dx10))
+			return false;
+		memcpy(dx10, &fileData[headerSize], sizeof(dx10));
+		if (dx10[1] != D3D11_RESOURCE_DIMENSION_TEXTURE2D || (dx10[2] & D3D11_RESOURCE_MISC_TEXTURECUBE) || dx10[3] != 1)
+			return false;
+	}
+
+	return mipCount == TextureResidency::MipCountFor(width, height);
+}
+
+double Assets::GetLoadClockMs()
+{
+	return loader.GetClockMs();
 }
 
 std::shared_ptr<Mesh> Assets::LoadMesh(std::string path, std::string filename)
@@ -273,7 +1384,7 @@ std::shared_ptr<Mesh> Assets::LoadMesh(std::string path, std::string filename)
 
 	std::shared_ptr<Mesh> newMesh = make_shared<Mesh>(path.c_str(), device);
 
-	meshes.insert({ RemoveFileExtension(filename), newMesh });
+	meshes.Add(RemoveFileExtension(filename), newMesh);
 	return newMesh;
 }
 
@@ -287,7 +1398,7 @@ std::shared_ptr<DirectX::SpriteFont> Assets::LoadSpriteFont(std::string path, st
 
 	std::shared_ptr<SpriteFont> newSpriteFont = make_shared<SpriteFont>(device.Get(), ToWideString(path).c_str());
 
-	spriteFonts.insert({ RemoveFileExtension(filename), newSpriteFont });
+	spriteFonts.Add(RemoveFileExtension(filename), newSpriteFont);
 
 	return newSpriteFont;
 }
@@ -305,7 +1416,7 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Assets::LoadTexture(std::string
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> newTexture;
 	CreateWICTextureFromFile(device.Get(), context.Get(), ToWideString(path).c_str(), 0, newTexture.GetAddressOf());
 
-	textures.insert({ RemoveFileExtension(filename), newTexture });
+	textures.Add(RemoveFileExtension(filename), newTexture);
 
 	return newTexture;
 }
@@ -322,37 +1433,29 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Assets::LoadDDSTexture(std::str
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> newDDSTexture;
 	CreateDDSTextureFromFile(device.Get(), context.Get(), ToWideString(path).c_str(), 0, newDDSTexture.GetAddressOf());
 
-	textures.insert({ RemoveFileExtension(filename), newDDSTexture });
+	textures.Add(RemoveFileExtension(filename), newDDSTexture);
 	return newDDSTexture;
 }
 
 void Assets::LoadUnknownShader(std::string path, std::string filename)
 {
-
-	ID3DBlob* shaderBlob;
-	HRESULT hr = D3DReadFileToBlob(GetFullPathTo_Wide(ToWideString(path)).c_str(), &shaderBlob);
+	Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
+	HRESULT hr = D3DReadFileToBlob(GetFullPathTo_Wide(ToWideString(path)).c_str(), shaderBlob.GetAddressOf());
 	if (hr != S_OK)
 	{
 		return;
 	}
 
-	ID3D11ShaderReflection* refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)&refl);
-
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
+	//Also leaves the reflection cached for the load below
+	ShaderReflection reflection;
+	if (!ISimpleShader::ReflectShader(shaderBlob, reflection))
+		return;
 
-	switch (D3D11_SHVER_GET_TYPE(shaderDesc.Version)) {
+	switch (D3D11_SHVER_GET_TYPE(reflection.Version)) {
 	case D3D11_SHVER_VERTEX_SHADER: LoadVertexShader(path); break;
 	case D3D11_SHVER_PIXEL_SHADER: LoadPixelShader(path); break;
+	case D3D11_SHVER_COMPUTE_SHADER: LoadComputeShader(path); break;
 	}
-
-	refl->Release();
-	shaderBlob->Release();
 }
 
 std::shared_ptr<SimplePixelShader> Assets::LoadPixelShader(std::string file)
@@ -368,7 +1471,7 @@ std::shared_ptr<SimplePixelShader> Assets::LoadPixelShader(std::string file)
 	newPixelShader = make_shared<SimplePixelShader>(device.Get(), context.Get(), GetFullPathTo_Wide(ToWideString(file)).c_str());
 	if (!newPixelShader->IsShaderValid()) { return 0; }
 
-	pixelShaders.insert({ RemoveFileExtension(file), newPixelShader });
+	pixelShaders.Add(RemoveFileExtension(file), newPixelShader);
 	return newPixelShader;
 }
 
@@ -385,10 +1488,27 @@ std::shared_ptr<SimpleVertexShader> Assets::LoadVertexShader(std::string file)
 	newVertexShader = make_shared<SimpleVertexShader>(device.Get(), context.Get(), GetFullPathTo_Wide(ToWideString(file)).c_str());
 	if (!newVertexShader->IsShaderValid()) { return 0; }
 
-	vertexShaders.insert({ RemoveFileExtension(file), newVertexShader });
+	vertexShaders.Add(RemoveFileExtension(file), newVertexShader);
 	return newVertexShader;
 }
 
+std::shared_ptr<SimpleComputeShader> Assets::LoadComputeShader(std::string file)
+{
+	if (printLoadingProgress)
+	{
+		printf("Loading Compute Shader: ");
+		printf(file.c_str());
+		printf("\n");
+	}
+
+	shared_ptr<SimpleComputeShader> newComputeShader;
+	newComputeShader = make_shared<SimpleComputeShader>(device.Get(), context.Get(), GetFullPathTo_Wide(ToWideString(file)).c_str());
+	if (!newComputeShader->IsShaderValid()) { return 0; }
+
+	computeShaders.Add(RemoveFileExtension(file), newComputeShader);
+	return newComputeShader;
+}
+
 std::string Assets::GetExePath()
 {
 	string path = ".\\";
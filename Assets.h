@@ -3,6 +3,10 @@
 #include <string>
 #include <memory>
 #include <unordered_map>
+#include <vector>
+#include <future>
+#include <chrono>
+#include <cstdint>
 #include <WICTextureLoader.h>
 #include <wrl/client.h>
 #include <DirectXMath.h>
@@ -10,7 +14,25 @@
 
 #include "Mesh.h"
 #include "SimpleShader.h"
+#include "JobSystem.h"
+#include "AssetLoader.h"
+#include "AssetIndex.h"
+#include "AssetHandles.h"
+#include "DirectoryWatcher.h"
+#include "TextureResidency.h"
+#include "ShaderPermutations.h"
 
+// Tightly packed RGBA8 pixels decoded off the device thread
+struct DecodedImage
+{
+	unsigned int Width;
+	unsigned int Height;
+	std::vector<uint8_t> Pixels;
+
+	// Size in the file, before any downsampling for streaming
+	unsigned int SourceWidth;
+	unsigned int SourceHeight;
+};
 
 class Assets
 {
@@ -31,7 +53,14 @@ private:
 	static Assets* instance;
 	Assets() :
 		allowOnDemandLoading(true),
-		printLoadingProgress(false) {};
+		printLoadingProgress(false),
+		pendingMeshes(loader),
+		pendingSpriteFonts(loader),
+		pendingTextures(loader),
+		timeSinceAssetPoll(0),
+		assetPollInterval(1.0f),
+		hotReload(true),
+		streamingTailSize(0) {};
 #pragma endregion
 public:
 	~Assets();
@@ -43,7 +72,43 @@ public:
 		bool allowOnDemandLoading = false,
 		bool printLoadingProgress = true);
 
+	// Keeps the asset index in sync with the files on disk, polling on a worker thread, and
+	// swaps in hot reloaded assets.  Call once a frame, between frames.
+	void Update(float dt);
+	void SetAssetPollInterval(float seconds) { assetPollInterval = seconds; }
+	// Changed shaders, meshes and textures are reloaded in place, so the shared_ptrs and
+	// handles already handed out see the new versions
+	void SetHotReload(bool enabled) { hotReload = enabled; }
+	bool GetHotReload() { return hotReload; }
+
+	// Converts albedo, normal, roughness, metal and AO images under the root into block
+	// compressed DDS files with mip chains, skipping ones already up to date.  The cooked
+	// files then win over their sources when loading.  Materials with roughness and metal
+	// maps also get a packed <name>_rma map holding roughness, metal and AO.
+	void CookTextures();
+
+	// Loads everything under the root, decoding on worker threads, and returns when it is all created
 	void LoadAllAssets();
+	// Queues everything under the root and returns right away.  Call ProcessPendingAssets
+	// on the device thread until it returns true.
+	void LoadAllAssetsAsync();
+	// Creates the D3D resources for any asset that has finished decoding.  A budget of zero
+	// finishes everything that is ready.  Returns true once nothing is pending.
+	bool ProcessPendingAssets(float budgetMs = 0);
+	unsigned int GetPendingAssetCount();
+
+	// In milliseconds since Initialize
+	const std::vector<AssetLoadTiming>& GetLoadTimeline() { return loader.GetTimeline(); }
+	void PrintLoadTimeline() { loader.PrintTimeline(); }
+
+	// Streams texture mips in by on-screen demand, under a memory budget.  Call before
+	// loading; streamed textures start with only their mips up to tailSize resident.
+	void EnableTextureStreaming(uint64_t budgetBytes, unsigned int tailSize = 64);
+	// Asks for enough detail to cover screenPixels with the texture repeated uvScale times
+	void RequestTextureDetail(TextureHandle texture, float screenPixels, float uvScale);
+	void SetTextureStreamingPriority(TextureHandle texture, int priority);
+	TextureResidency* GetTextureResidency() { return textureResidency.get(); }
+	unsigned int GetPendingMipUploadCount() { return (unsigned int)pendingMipUploads.size(); }
 
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateSolidColorTexture(std::string textureName, int width, int height, DirectX::XMFLOAT4 color);
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateTexture(std::string textureName, int width, int height, DirectX::XMFLOAT4* pixels);
@@ -54,20 +119,175 @@ public:
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetTexture(std::string name);
 	std::shared_ptr<SimplePixelShader> GetPixelShader(std::string name);
 	std::shared_ptr<SimpleVertexShader> GetVertexShader(std::string name);
+	std::shared_ptr<SimpleComputeShader> GetComputeShader(std::string name);
+
+	// A pixel shader built with just the given features, see ShaderPermutations.  The
+	// default features are the shader's own .cso.  Compiling needs the .hlsl files, found
+	// relative to the executable like the asset root.
+	std::shared_ptr<SimplePixelShader> GetPixelShaderPermutation(std::string name, ShaderFeatures features);
+	void SetShaderSourceDirectory(std::string relativePath);
+	size_t GetShaderPermutationCount() { return shaderPermutations.GetPermutationCount(); }
+
+	// The workers decoding runs on, which other per-frame CPU work can share
+	JobSystem* GetJobSystem() { return jobs.get(); }
+
+	// Relative to the executable, like the asset root
+	std::string GetFullPathTo(std::string relativeFilePath);
+	std::wstring GetFullPathTo_Wide(std::wstring relativeFilePath);
+
+	// Handle lookups for per-frame code.  Find* only sees assets that are already loaded,
+	// since an interned name can't be turned back into a file name.
+	MeshHandle FindMesh(AssetName name) { return meshes.Find(name); }
+	SpriteFontHandle FindSpriteFont(AssetName name) { return spriteFonts.Find(name); }
+	TextureHandle FindTexture(AssetName name) { return textures.Find(name); }
+	PixelShaderHandle FindPixelShader(AssetName name) { return pixelShaders.Find(name); }
+	VertexShaderHandle FindVertexShader(AssetName name) { return vertexShaders.Find(name); }
+	ComputeShaderHandle FindComputeShader(AssetName name) { return computeShaders.Find(name); }
+
+	// Loads on demand like GetTexture, for holders that should follow hot reloads
+	TextureHandle GetTextureHandle(std::string name) { GetTexture(name); return textures.Find(AssetName(name)); }
+
+	std::shared_ptr<Mesh> GetMesh(MeshHandle handle) { return meshes.Get(handle); }
+	std::shared_ptr<DirectX::SpriteFont> GetSpriteFont(SpriteFontHandle handle) { return spriteFonts.Get(handle); }
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetTexture(TextureHandle handle) { return textures.Get(handle); }
+	std::shared_ptr<SimplePixelShader> GetPixelShader(PixelShaderHandle handle) { return pixelShaders.Get(handle); }
+	std::shared_ptr<SimpleVertexShader> GetVertexShader(VertexShaderHandle handle) { return vertexShaders.Get(handle); }
+	std::shared_ptr<SimpleComputeShader> GetComputeShader(ComputeShaderHandle handle) { return computeShaders.Get(handle); }
+
+	std::shared_ptr<Mesh> GetMesh(AssetName name) { return meshes.Get(meshes.Find(name)); }
+	std::shared_ptr<DirectX::SpriteFont> GetSpriteFont(AssetName name) { return spriteFonts.Get(spriteFonts.Find(name)); }
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetTexture(AssetName name) { return textures.Get(textures.Find(name)); }
+	std::shared_ptr<SimplePixelShader> GetPixelShader(AssetName name) { return pixelShaders.Get(pixelShaders.Find(name)); }
+	std::shared_ptr<SimpleVertexShader> GetVertexShader(AssetName name) { return vertexShaders.Get(vertexShaders.Find(name)); }
+	std::shared_ptr<SimpleComputeShader> GetComputeShader(AssetName name) { return computeShaders.Get(computeShaders.Find(name)); }
+
+	// Resolve once the asset has been created on the device thread
+	std::shared_future<std::shared_ptr<Mesh>> GetMeshAsync(std::string name);
+	std::shared_future<std::shared_ptr<DirectX::SpriteFont>> GetSpriteFontAsync(std::string name);
+	std::shared_future<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> GetTextureAsync(std::string name);
 
 	void AddMesh(std::string name, std::shared_ptr<Mesh> mesh);
 	void AddSpriteFont(std::string name, std::shared_ptr<DirectX::SpriteFont> sprite);
 	void AddTexture(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture);
 	void AddPixelShader(std::string name, std::shared_ptr<SimplePixelShader> PSShader);
 	void AddVertexShader(std::string name, std::shared_ptr<SimpleVertexShader> VSShader);
+	void AddComputeShader(std::string name, std::shared_ptr<SimpleComputeShader> CSShader);
 
 	unsigned int GetMeshCount();
 	unsigned int GetSpriteFontCount();
 	unsigned int GetTextureCount();
 	unsigned int GetPixelShaderCount();
 	unsigned int GetVertexShaderCount();
+	unsigned int GetComputeShaderCount();
 
 private:
+	// A texture's file read, and decoded unless it's a DDS, on the job system
+	struct DecodedTexture
+	{
+		bool IsDDS;
+		DecodedImage Image;
+		std::vector<uint8_t> FileData;
+	};
+
+	// Assets whose file I/O and decoding runs on the job system, leaving only the
+	// resource creation for the device thread
+	typedef AssetLoadQueue<MeshData, std::shared_ptr<Mesh>> MeshLoadQueue;
+	typedef AssetLoadQueue<std::vector<uint8_t>, std::shared_ptr<DirectX::SpriteFont>> SpriteFontLoadQueue;
+	typedef AssetLoadQueue<DecodedTexture, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> TextureLoadQueue;
+
+	// A changed file being re-read on the job system.  Update swaps every pending
+	// reload in together once they have all been decoded.
+	// A source image edited while hot reloading, with what it cooks into
+	struct QueuedCook
+	{
+		std::string Path;
+		std::string Prefix;
+		bool Cook;
+		bool Pack;
+	};
+
+	struct PendingReload
+	{
+		std::string Path;
+		std::string Name;
+		AssetKind Kind;
+		bool IsShader;
+		bool IsDDS;
+		bool Failed;
+		std::future<void> Decoded;
+
+		MeshData Geometry;
+		DecodedImage Image;
+		std::vector<uint8_t> FileData;
+		Microsoft::WRL::ComPtr<ID3DBlob> ShaderBlob;
+	};
+
+	// A texture with only some of its mips on the GPU.  GpuMip lags the residency
+	// decision while an upload is in flight.
+	struct StreamedTexture
+	{
+		std::string Path;
+		bool IsDDS;
+		TextureHandle Handle;
+		unsigned int Width;
+		unsigned int Height;
+		unsigned int GpuMip;
+	};
+
+	// Finer mips of a streamed texture being read on the job system
+	struct PendingMipUpload
+	{
+		int Texture;
+		unsigned int Mip;
+		bool Reload;
+		bool Failed;
+		std::future<void> Decoded;
+
+		DecodedImage Image;
+		std::vector<uint8_t> FileData;
+	};
+
+	void QueueMesh(std::string path, std::string filename);
+	void QueueSpriteFont(std::string path, std::string filename);
+	void QueueTexture(std::string path, std::string filename, bool isDDS);
+
+	std::shared_ptr<Mesh> FinishMesh(MeshLoadQueue::Pending& pending);
+	std::shared_ptr<DirectX::SpriteFont> FinishSpriteFont(SpriteFontLoadQueue::Pending& pending);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> FinishTexture(TextureLoadQueue::Pending& pending);
+	template<typename T>
+	static std::shared_future<T> MakeReadyFuture(T value);
+
+	void ApplyFileChanges(const std::vector<FileChange>& changes, bool shaderDirectory);
+	void QueueReload(const std::string& path, bool isShader);
+	void UpdateCooks();
+	void ApplyReloads();
+	void ApplyReload(PendingReload& reload);
+	// A non-zero maxSize skips the DDS mips larger than it
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateTextureFromData(bool isDDS, const DecodedImage& image, const std::vector<uint8_t>& fileData, unsigned int maxSize = 0);
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateStreamedTexture(std::string name, std::string path, bool isDDS, const DecodedImage& image, const std::vector<uint8_t>& fileData);
+	int FindStreamedTexture(TextureHandle handle);
+	void UpdateTextureStreaming();
+	void QueueMipUpload(int texture, unsigned int mip, bool reload);
+	void FinishMipUpload(PendingMipUpload& upload);
+	void DropMips(int texture, unsigned int mip);
+	static void DownsampleImage(DecodedImage& image, unsigned int mip);
+	static bool ReadDDSSize(const std::vector<uint8_t>& fileData, unsigned int& width, unsigned int& height);
+
+	bool NeedsCooking(const std::string& path);
+	bool CookTexture(const std::string& path);
+	std::string GetPackedTexturePrefix(const std::string& path);
+	std::string FindSourceImage(const std::string& stem);
+	bool NeedsPacking(const std::string& prefix);
+	bool CookPackedTexture(const std::string& prefix);
+	std::string GetSkyFolder(const std::string& path);
+	bool NeedsSkyCooking(const std::string& folder);
+	bool CookSky(const std::string& folder);
+
+	bool DecodeImage(std::string path, DecodedImage& image);
+	bool ReadFileBytes(std::string path, std::vector<uint8_t>& bytes);
+	double GetLoadClockMs();
+
 	std::shared_ptr<Mesh> LoadMesh(std::string path, std::string filename);
 	std::shared_ptr<DirectX::SpriteFont> LoadSpriteFont(std::string path, std::string filename);
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> LoadTexture(std::string path, std::string filename);
@@ -75,6 +295,7 @@ private:
 	void LoadUnknownShader(std::string path, std::string filename);
 	std::shared_ptr<SimplePixelShader> LoadPixelShader(std::string file);
 	std::shared_ptr<SimpleVertexShader> LoadVertexShader(std::string file);
+	std::shared_ptr<SimpleComputeShader> LoadComputeShader(std::string file);
 
 	Microsoft::WRL::ComPtr<ID3D11Device> device;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
@@ -83,20 +304,60 @@ private:
 
 	bool allowOnDemandLoading;
 
-	std::unordered_map<std::string, std::shared_ptr<Mesh>> meshes;
-	std::unordered_map < std::string, std::shared_ptr < DirectX::SpriteFont>> spriteFonts;
-	std::unordered_map<std::string, std::shared_ptr<SimplePixelShader>> pixelShaders;
-	std::unordered_map<std::string, std::shared_ptr<SimpleVertexShader>> vertexShaders;
-	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textures;
+	AssetTable<std::shared_ptr<Mesh>, MeshHandle> meshes;
+	AssetTable<std::shared_ptr<DirectX::SpriteFont>, SpriteFontHandle> spriteFonts;
+	AssetTable<std::shared_ptr<SimplePixelShader>, PixelShaderHandle> pixelShaders;
+	AssetTable<std::shared_ptr<SimpleVertexShader>, VertexShaderHandle> vertexShaders;
+	AssetTable<std::shared_ptr<SimpleComputeShader>, ComputeShaderHandle> computeShaders;
+	AssetTable<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>, TextureHandle> textures;
+
+	// Asynchronous loading, only touched on the device thread apart from each pending asset's decode job
+	std::unique_ptr<JobSystem> jobs;
+	AssetLoader loader;
+	MeshLoadQueue pendingMeshes;
+	SpriteFontLoadQueue pendingSpriteFonts;
+	TextureLoadQueue pendingTextures;
+
+	// Name to path index used instead of scanning the asset tree on a miss
+	AssetIndex assetIndex;
+	std::unique_ptr<DirectoryWatcher> assetWatcher;
+	std::future<void> assetPoll;
+	std::vector<FileChange> polledChanges;
+	float timeSinceAssetPoll;
+	float assetPollInterval;
+
+	// Hot reloading, with a second watcher for the compiled shaders next to the executable
+	bool hotReload;
+	std::unique_ptr<DirectoryWatcher> shaderWatcher;
+	ShaderReflectionCache shaderReflectionCache;
+	ShaderPermutations shaderPermutations;
+	std::vector<FileChange> polledShaderChanges;
+	std::vector<std::shared_ptr<PendingReload>> pendingReloads;
+
+	// Hot reload cooks run one at a time, so two never write the same file at once
+	std::vector<QueuedCook> queuedCooks;
+	QueuedCook runningCook;
+	std::future<void> cookJob;
+
+	// Texture streaming, off while textureResidency is null.  Residency ids index streamedTextures.
+	std::unique_ptr<TextureResidency> textureResidency;
+	unsigned int streamingTailSize;
+	std::vector<StreamedTexture> streamedTextures;
+	std::unordered_map<uint32_t, int> streamedTextureIds;
+	std::vector<std::shared_ptr<PendingMipUpload>> pendingMipUploads;
 
 	std::string GetExePath();
 	std::wstring GetExePath_Wide();
 
-	std::string GetFullPathTo(std::string relativeFilePath);
-	std::wstring GetFullPathTo_Wide(std::wstring relativeFilePath);
-
 	bool EndsWith(std::string str, std::string ending);
 	std::wstring ToWideString(std::string str);
 	std::string RemoveFileExtension(std::string str);
 };
 
+template<typename T>
+inline std::shared_future<T> Assets::MakeReadyFuture(T value)
+{
+	std::promise<T> promise;
+	promise.set_value(value);
+	return promise.get_future().share();
+}
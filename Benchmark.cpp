@@ -0,0 +1,345 @@
+#include "Benchmark.h"
+#include "Assets.h"
+#include "Profiler.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+using namespace DirectX;
+
+// Texture sets under Assets/Textures with albedo, normal, roughness and metal maps
+static const char* surfaceNames[] = { "bronze", "floor", "paint", "rough", "scratched", "wood" };
+
+Benchmark::Benchmark(BenchmarkOptions Options)
+	:
+	options(Options)
+{
+}
+
+Benchmark::~Benchmark()
+{
+	renderer.reset();
+	delete &Assets::GetInstance();
+}
+
+int Benchmark::Run()
+{
+	Profiler::SetThreadName("Main");
+	srand(options.Seed);
+
+	if (FAILED(InitDirectX()))
+	{
+		fprintf(stderr, "Benchmark: couldn't create the device\n");
+		return 2;
+	}
+
+	//Same assets as the game, but nothing is cooked or watched while measuring
+	Assets& assets = Assets::GetInstance();
+	assets.Initialize("../../Assets/", device, context, true, false);
+	assets.SetHotReload(false);
+	assets.SetShaderSourceDirectory("../../");
+	assets.EnableTextureStreaming(128 * 1024 * 1024);
+	assets.LoadAllAssets();
+	if (!assets.GetPixelShader("PixelShaderPBR") || !assets.GetMesh("sphere"))
+	{
+		fprintf(stderr, "Benchmark: assets or compiled shaders are missing next to the executable\n");
+		return 2;
+	}
+
+	BuildScene();
+
+	// Out a little past the grid, which is 10 units inside the camera orbit
+	GenerateSceneLights(lights, options.Lights, layout.Radius - 5.0f);
+	camera = make_shared<Camera>(0.0f, 0.0f, -layout.Radius, 3.0f, 1.0f, options.Width / (float)options.Height);
+	renderer = make_unique<Renderer>(device, context, nullptr, backBufferRTV, depthStencilView, options.Width, options.Height, sky, entities, emitters, lights, (HWND)0);
+
+	report.AddParameter("entities", options.Entities);
+	report.AddParameter("emitters", options.Emitters);
+	report.AddParameter("lights", (double)lights.size());
+	report.AddParameter("width", options.Width);
+	report.AddParameter("height", options.Height);
+	report.AddParameter("warmup", options.WarmupFrames);
+	report.AddParameter("seed", options.Seed);
+	report.AddParameter("device", BenchmarkOptions::GetDeviceName(options.Device));
+
+	//A device that renders has the frame finish on the GPU too, since nothing presents
+	//to hold the CPU back
+	Microsoft::WRL::ComPtr<ID3D11Query> frameDone;
+	if (options.Device != BENCHMARK_DEVICE_NULL)
+	{
+		D3D11_QUERY_DESC queryDesc = { D3D11_QUERY_EVENT, 0 };
+		device->CreateQuery(&queryDesc, frameDone.GetAddressOf());
+	}
+
+	const float deltaTime = 1.0f / 60.0f;
+	float totalTime = 0;
+	vector<ProfileEvent> events;
+	Profiler::BeginFrame();
+	for (unsigned int frame = 0; frame < options.WarmupFrames + options.Frames; frame++)
+	{
+		uint64_t start = Profiler::Now();
+		Update(deltaTime, totalTime);
+		renderer->Render(camera, materials, deltaTime);
+		if (frameDone)
+		{
+			context->End(frameDone.Get());
+			while (context->GetData(frameDone.Get(), 0, 0, 0) == S_FALSE)
+				;
+		}
+		uint64_t end = Profiler::Now();
+
+		//Closes this frame, so it's the one CollectLastFrame returns
+		Profiler::BeginFrame();
+		if (frame >= options.WarmupFrames)
+		{
+			events.clear();
+			Profiler::CollectLastFrame(events);
+			report.AddFrame(end - start, events);
+		}
+		totalTime += deltaTime;
+	}
+
+	BenchmarkStats stats = report.GetFrameStats();
+	printf("Benchmark: %u frames, %u entities, %u emitters, %u lights\n", report.GetFrameCount(), options.Entities, options.Emitters, (unsigned int)lights.size());
+	printf("Frame ms: mean %.3f  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n", stats.Mean, stats.P50, stats.P95, stats.P99, stats.Max);
+
+	if (!report.WriteJson(options.Output))
+	{
+		fprintf(stderr, "Benchmark: couldn't write %s\n", options.Output.c_str());
+		return 2;
+	}
+
+	if (options.BudgetMs > 0 && stats.P95 > options.BudgetMs)
+	{
+		printf("Over budget: p95 %.3f ms > %.3f ms\n", stats.P95, options.BudgetMs);
+		return 1;
+	}
+	return 0;
+}
+
+HRESULT Benchmark::InitDirectX()
+{
+	unsigned int deviceFlags = 0;
+#if defined(DEBUG) || defined(_DEBUG)
+	deviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
+#endif
+
+	D3D_DRIVER_TYPE driverType = D3D_DRIVER_TYPE_NULL;
+	if (options.Device == BENCHMARK_DEVICE_WARP) driverType = D3D_DRIVER_TYPE_WARP;
+	else if (options.Device == BENCHMARK_DEVICE_HARDWARE) driverType = D3D_DRIVER_TYPE_HARDWARE;
+
+	HRESULT hr = D3D11CreateDevice(0, driverType, 0, deviceFlags, 0, 0, D3D11_SDK_VERSION,
+		device.GetAddressOf(), 0, context.GetAddressOf());
+	if (FAILED(hr)) return hr;
+
+	//An offscreen texture stands in for the swap chain's back buffer
+	D3D11_TEXTURE2D_DESC backBufferDesc = {};
+	backBufferDesc.Width = options.Width;
+	backBufferDesc.Height = options.Height;
+	backBufferDesc.MipLevels = 1;
+	backBufferDesc.ArraySize = 1;
+	backBufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	backBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	backBufferDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+	backBufferDesc.SampleDesc.Count = 1;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> backBuffer;
+	hr = device->CreateTexture2D(&backBufferDesc, 0, backBuffer.GetAddressOf());
+	if (FAILED(hr)) return hr;
+	hr = device->CreateRenderTargetView(backBuffer.Get(), 0, backBufferRTV.GetAddressOf());
+	if (FAILED(hr)) return hr;
+
+	D3D11_TEXTURE2D_DESC depthStencilDesc = backBufferDesc;
+	depthStencilDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+	depthStencilDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> depthBuffer;
+	hr = device->CreateTexture2D(&depthStencilDesc, 0, depthBuffer.GetAddressOf());
+	if (FAILED(hr)) return hr;
+	hr = device->CreateDepthStencilView(depthBuffer.Get(), 0, depthStencilView.GetAddressOf());
+	if (FAILED(hr)) return hr;
+
+	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthStencilView.Get());
+
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (float)options.Width;
+	viewport.Height = (float)options.Height;
+	viewport.MaxDepth = 1.0f;
+	context->RSSetViewports(1, &viewport);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	return S_OK;
+}
+
+// --------------------------------------------------------
+// Builds a scene like Game::LoadAssetsAndCreateEntities,
+// with the entities on a grid and the emitters around it
+// --------------------------------------------------------
+void Benchmark::BuildScene()
+{
+	Assets& instance = Assets::GetInstance();
+
+	D3D11_SAMPLER_DESC sampDesc = {};
+	sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+	sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+	sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+	sampDesc.Filter = D3D11_FILTER_ANISOTROPIC;
+	sampDesc.MaxAnisotropy = 16;
+	sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	device->CreateSamplerState(&sampDesc, samplerOptions.GetAddressOf());
+
+	D3D11_SAMPLER_DESC clampDesc = sampDesc;
+	clampDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	clampDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	clampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	device->CreateSamplerState(&clampDesc, clampSamplerOptions.GetAddressOf());
+
+	sky = make_shared<Sky>(
+		GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\right.png").c_str(),
+		GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\left.png").c_str(),
+		GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\up.png").c_str(),
+		GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\down.png").c_str(),
+		GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\front.png").c_str(),
+		GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\back.png").c_str(),
+		instance.GetMesh("cube"),
+		instance.GetVertexShader("SkyVS"),
+		instance.GetPixelShader("SkyPS"),
+		samplerOptions,
+		device,
+		context);
+
+	// One PBR material per texture set, taking the packed map when it's been cooked as the game does
+	shared_ptr<SimplePixelShader> packedPS = instance.GetPixelShaderPermutation("PixelShaderPBR", SHADER_DEFAULT_FEATURES | SHADER_PACKED_RMA);
+	for (const char* surface : surfaceNames)
+	{
+		string prefix = surface;
+		shared_ptr<Material> material = make_shared<Material>(instance.GetPixelShader("PixelShaderPBR"), instance.GetVertexShader("VertexShader"), prefix + " PBR", XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
+		material->AddSampler("BasicSampler", samplerOptions);
+		material->AddSampler("ClampSampler", clampSamplerOptions);
+		material->AddTextureSRV("Albedo", instance.GetTextureHandle(prefix + "_albedo"));
+		material->AddTextureSRV("NormalMap", instance.GetTextureHandle(prefix + "_normals"));
+
+		TextureHandle packed = instance.GetTextureHandle(prefix + "_rma");
+		if (packed.IsValid() && packedPS)
+		{
+			material->SetPixelShader(packedPS);
+			material->AddTextureSRV("RoughMetalAOMap", packed);
+		}
+		else
+		{
+			material->AddTextureSRV("RoughnessMap", instance.GetTextureHandle(prefix + "_roughness"));
+			material->AddTextureSRV("MetalMap", instance.GetTextureHandle(prefix + "_metal"));
+		}
+		materials.push_back(material);
+	}
+
+	// And a refractive one, which the Renderer draws in its own pass
+	shared_ptr<Material> refractive = make_shared<Material>(instance.GetPixelShader("RefractionPS"), instance.GetVertexShader("VertexShader"), true, 1.8f, "Scratched Refractive", XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
+	refractive->AddSampler("BasicSampler", samplerOptions);
+	refractive->AddSampler("ClampSampler", clampSamplerOptions);
+	refractive->AddTextureSRV("Albedo", instance.GetTextureHandle("scratched_albedo"));
+	refractive->AddTextureSRV("NormalMap", instance.GetTextureHandle("scratched_normals"));
+	refractive->AddTextureSRV("RoughnessMap", instance.GetTextureHandle("scratched_roughness"));
+	refractive->AddTextureSRV("MetalMap", instance.GetTextureHandle("scratched_metal"));
+	materials.push_back(refractive);
+
+	// Spheres on a square grid, cycling through the materials
+	LayOutScene(options.Entities, options.Emitters, layout);
+	for (unsigned int i = 0; i < options.Entities; i++)
+	{
+		shared_ptr<GameEntity> entity = make_shared<GameEntity>(instance.GetMesh("sphere"), materials[i % materials.size()]);
+		XMFLOAT3 start = layout.EntityStarts[i];
+		entity->GetTransform()->SetPosition(start.x, start.y, start.z);
+		entities.push_back(entity);
+	}
+
+	// The game's three emitters, repeated around the grid, each with its own look
+	const char* textures[3] = { "circle_01", "star_06", "smoke_01" };
+	for (unsigned int i = 0; i < options.Emitters; i++)
+	{
+		const SceneEmitter& placed = layout.Emitters[i];
+		shared_ptr<Emitter> emitter = make_shared<Emitter>(placed.MaxParticles, placed.ParticlesPerSecond, placed.Lifetime, context, device, instance.GetTexture(textures[i % 3]), instance.GetVertexShader("ParticleVS"), instance.GetPixelShader("ParticlePS"));
+		emitter->SetAcceleration(placed.Acceleration);
+		emitter->SetStartingVelocity(placed.StartingVelocity);
+		emitter->SetVelocityRange(placed.VelocityRange);
+		switch (i % 3)
+		{
+		case 0:
+			emitter->SetColor(XMFLOAT4(0, 0, .5f, 1.0f), XMFLOAT4(0, .5f, 0, 0.0f));
+			emitter->SetScale(XMFLOAT2(0.1f, 0.1f), XMFLOAT2(1.0f, 1.0f));
+			break;
+		case 1:
+			emitter->SetColor(XMFLOAT4(1, 1, 1, 1.0f), XMFLOAT4(.5f, .5f, 0, 0.2f));
+			emitter->SetScale(XMFLOAT2(0.05f, 0.05f), XMFLOAT2(0.1f, 0.1f));
+			break;
+		default:
+			emitter->SetColor(XMFLOAT4(0.0f, 1.0f, 0.0f, 1.0f), XMFLOAT4(0, 0.0f, 0, 1.0f));
+			emitter->SetScale(XMFLOAT2(0.1f, 0.1f), XMFLOAT2(3.0f, 3.0f));
+			break;
+		}
+
+		if (placed.GPUSimulated)
+			emitter->EnableGPUSimulation(instance.GetComputeShader("ParticleInitDeadListCS"), instance.GetComputeShader("ParticleEmitCS"),
+				instance.GetComputeShader("ParticleUpdateCS"), instance.GetComputeShader("ParticleDrawArgsCS"));
+		if (placed.Sorted)
+		{
+			emitter->SetAlphaBlended(true);
+			emitter->SetSortParticles(true);
+		}
+
+		emitter->GetTransform()->MoveAbsolute(placed.Position.x, placed.Position.y, placed.Position.z);
+		emitters.push_back(emitter);
+	}
+}
+
+// --------------------------------------------------------
+// The game's per-frame work, with the camera orbiting
+// instead of following input
+// --------------------------------------------------------
+void Benchmark::Update(float deltaTime, float totalTime)
+{
+	PROFILE_SCOPE("Game::Update");
+
+	XMFLOAT3 position;
+	float pitch;
+	float yaw;
+	GetSceneCamera(layout, totalTime, position, pitch, yaw);
+	camera->GetTransform()->SetPosition(position.x, position.y, position.z);
+	camera->GetTransform()->SetRotation(pitch, yaw, 0);
+	camera->UpdateViewMatrix();
+
+	Assets::GetInstance().Update(deltaTime);
+
+	// Every third entity spins, the rest bob up and down
+	for (size_t i = 0; i < entities.size(); i++)
+	{
+		Transform* transform = entities[i]->GetTransform();
+		if (IsSceneEntitySpinning(i))
+			transform->Rotate(0, deltaTime, 0);
+		else
+		{
+			XMFLOAT3 position = GetSceneEntityPosition(layout, i, totalTime);
+			transform->SetPosition(position.x, position.y, position.z);
+		}
+	}
+
+	for (auto e : emitters)
+	{
+		PROFILE_SCOPE("Emitter Update");
+		e->UpdateLOD(camera);
+		e->Update(deltaTime);
+	}
+}
+
+std::wstring Benchmark::GetFullPathTo_Wide(std::wstring relativeFilePath)
+{
+	// Relative to the executable, like DXCore's version
+	wchar_t exePath[1024] = {};
+	GetModuleFileNameW(0, exePath, 1024);
+	wchar_t* lastSlash = wcsrchr(exePath, L'\\');
+	if (lastSlash)
+		*lastSlash = 0;
+
+	return std::wstring(exePath) + L"\\" + relativeFilePath;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GameEntity.h"
+#include "Material.h"
+#include "Camera.h"
+#include "Lights.h"
+#include "Sky.h"
+#include "Emitter.h"
+#include "Renderer.h"
+#include "BenchmarkReport.h"
+#include "BenchmarkOptions.h"
+#include "SceneSetup.h"
+
+// Builds a scene from the same assets as the game, sized by the options, and drives
+// the game's per-frame work and the Renderer for a fixed number of frames on a device
+// with no window or swap chain.  Time steps are fixed and the scene is seeded, so runs
+// are comparable.  Frame times and the profiler's scopes go into a JSON report.
+// HeadlessBenchmark replays the same scene's CPU work without Windows.
+class Benchmark
+{
+public:
+	Benchmark(BenchmarkOptions Options);
+	~Benchmark();
+
+	// 0 when the run finished within budget, 1 when it was over, 2 when it couldn't run
+	int Run();
+
+private:
+	HRESULT InitDirectX();
+	void BuildScene();
+	void Update(float deltaTime, float totalTime);
+
+	std::wstring GetFullPathTo_Wide(std::wstring relativeFilePath);
+
+	BenchmarkOptions options;
+	BenchmarkReport report;
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> backBufferRTV;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthStencilView;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerOptions;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> clampSamplerOptions;
+
+	SceneLayout layout;
+	std::vector<std::shared_ptr<GameEntity>> entities;
+	std::vector<std::shared_ptr<Material>> materials;
+	std::vector<std::shared_ptr<Emitter>> emitters;
+	std::vector<Light> lights;
+	std::shared_ptr<Camera> camera;
+	std::shared_ptr<Sky> sky;
+	std::unique_ptr<Renderer> renderer;
+};
@@ -0,0 +1,56 @@
+#include "BenchmarkOptions.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+bool BenchmarkOptions::Parse(int argc, char** argv)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		//Every option takes a value
+		if (i + 1 >= argc)
+			return false;
+
+		const char* option = argv[i];
+		const char* value = argv[++i];
+		unsigned int number = (unsigned int)strtoul(value, 0, 10);
+
+		if (strcmp(option, "--entities") == 0) Entities = number;
+		else if (strcmp(option, "--emitters") == 0) Emitters = number;
+		else if (strcmp(option, "--lights") == 0) Lights = number;
+		else if (strcmp(option, "--frames") == 0) Frames = max(number, 1u);
+		else if (strcmp(option, "--warmup") == 0) WarmupFrames = number;
+		else if (strcmp(option, "--width") == 0) Width = max(number, 1u);
+		else if (strcmp(option, "--height") == 0) Height = max(number, 1u);
+		else if (strcmp(option, "--seed") == 0) Seed = number;
+		else if (strcmp(option, "--output") == 0) Output = value;
+		else if (strcmp(option, "--budget-ms") == 0) BudgetMs = (float)atof(value);
+		else if (strcmp(option, "--assets") == 0) AssetPath = value;
+		else if (strcmp(option, "--device") == 0)
+		{
+			if (strcmp(value, "none") == 0) Device = BENCHMARK_DEVICE_NONE;
+			else if (strcmp(value, "null") == 0) Device = BENCHMARK_DEVICE_NULL;
+			else if (strcmp(value, "warp") == 0) Device = BENCHMARK_DEVICE_WARP;
+			else if (strcmp(value, "hardware") == 0) Device = BENCHMARK_DEVICE_HARDWARE;
+			else return false;
+		}
+		else
+			return false;
+	}
+	return true;
+}
+
+const char* BenchmarkOptions::GetUsage()
+{
+	return "[--entities N] [--emitters N] [--lights N] [--frames N] [--warmup N]\n"
+		"    [--width N] [--height N] [--seed N] [--device none|null|warp|hardware]\n"
+		"    [--output file.json] [--budget-ms MS] [--assets folder]\n";
+}
+
+const char* BenchmarkOptions::GetDeviceName(BenchmarkDevice device)
+{
+	const char* names[] = { "none", "null", "warp", "hardware" };
+	return names[device];
+}
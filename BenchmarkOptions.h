@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+
+// What a benchmark renders on.  NONE is the headless benchmark, which has no device at
+// all; NULL does no rendering, so only the CPU side is measured; WARP and HARDWARE
+// include the GPU work too.
+enum BenchmarkDevice
+{
+	BENCHMARK_DEVICE_NONE,
+	BENCHMARK_DEVICE_NULL,
+	BENCHMARK_DEVICE_WARP,
+	BENCHMARK_DEVICE_HARDWARE
+};
+
+// What to build and how long to run it, shared by the windowed and headless benchmarks
+struct BenchmarkOptions
+{
+	unsigned int Entities = 13;
+	unsigned int Emitters = 3;
+	unsigned int Lights = 32;
+	unsigned int Frames = 600;
+	// Run first and left out of the report, while caches and streaming settle
+	unsigned int WarmupFrames = 60;
+	unsigned int Width = 1280;
+	unsigned int Height = 720;
+	unsigned int Seed = 1;
+	BenchmarkDevice Device = BENCHMARK_DEVICE_NULL;
+	std::string Output = "benchmark.json";
+	// The run fails when the 95th percentile frame is over this, unless it's zero
+	float BudgetMs = 0;
+	// Watched and indexed like the game's asset folder, when set (headless only)
+	std::string AssetPath;
+
+	// Reads --entities, --emitters, --lights, --frames, --warmup, --width, --height,
+	// --seed, --device none|null|warp|hardware, --output, --budget-ms and --assets.
+	// False on anything it doesn't recognise.
+	bool Parse(int argc, char** argv);
+	static const char* GetUsage();
+	static const char* GetDeviceName(BenchmarkDevice device);
+};
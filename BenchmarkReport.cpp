@@ -0,0 +1,138 @@
+#include "BenchmarkReport.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+using namespace std;
+
+// Parameter values and scope names are ours, but keep the JSON valid regardless
+static void AppendEscaped(string& json, const string& text)
+{
+	json += '"';
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			json += '\\';
+		if ((unsigned char)c >= 0x20)
+			json += c;
+	}
+	json += '"';
+}
+
+static void AppendStats(string& json, const BenchmarkStats& stats)
+{
+	char number[256];
+	snprintf(number, sizeof(number), "\"mean\":%.4f,\"min\":%.4f,\"p50\":%.4f,\"p90\":%.4f,\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f",
+		stats.Mean, stats.Min, stats.P50, stats.P90, stats.P95, stats.P99, stats.Max);
+	json += number;
+}
+
+void BenchmarkReport::AddParameter(const std::string& name, double value)
+{
+	char number[64];
+	snprintf(number, sizeof(number), "%.17g", value);
+	parameters.push_back({ name, number });
+}
+
+void BenchmarkReport::AddParameter(const std::string& name, const std::string& value)
+{
+	string json;
+	AppendEscaped(json, value);
+	parameters.push_back({ name, json });
+}
+
+void BenchmarkReport::AddFrame(uint64_t frameNs, const std::vector<ProfileEvent>& events)
+{
+	size_t frame = frameMs.size();
+	frameMs.push_back(frameNs / 1000000.0);
+
+	for (auto& e : events)
+	{
+		if (e.Track != PROFILE_TRACK_CPU)
+			continue;
+
+		auto found = scopeIndices.find(e.Name);
+		if (found == scopeIndices.end())
+		{
+			found = scopeIndices.insert({ e.Name, scopes.size() }).first;
+			scopes.push_back({ e.Name, {}, 0 });
+		}
+
+		//Frames before this scope first ran count as zero
+		ScopeSamples& scope = scopes[found->second];
+		scope.FrameMs.resize(frame + 1, 0.0);
+		scope.FrameMs[frame] += (e.EndNs - e.StartNs) / 1000000.0;
+		scope.Calls++;
+	}
+}
+
+BenchmarkStats BenchmarkReport::Summarize(std::vector<double> samples)
+{
+	BenchmarkStats stats = {};
+	if (samples.empty())
+		return stats;
+
+	sort(samples.begin(), samples.end());
+	auto percentile = [&](double p) {
+		size_t rank = (size_t)ceil(p / 100.0 * samples.size());
+		return samples[rank > 0 ? rank - 1 : 0];
+	};
+
+	double total = 0;
+	for (double s : samples)
+		total += s;
+
+	stats.Mean = total / samples.size();
+	stats.Min = samples.front();
+	stats.P50 = percentile(50);
+	stats.P90 = percentile(90);
+	stats.P95 = percentile(95);
+	stats.P99 = percentile(99);
+	stats.Max = samples.back();
+	return stats;
+}
+
+std::string BenchmarkReport::ToJson()
+{
+	string json = "{\n\"scene\":{";
+	for (size_t i = 0; i < parameters.size(); i++)
+	{
+		json += i ? "," : "";
+		AppendEscaped(json, parameters[i].first);
+		json += ":" + parameters[i].second;
+	}
+
+	char number[64];
+	snprintf(number, sizeof(number), "},\n\"frames\":%u,\n\"frame_ms\":{", GetFrameCount());
+	json += number;
+	AppendStats(json, GetFrameStats());
+	json += "},\n\"scopes\":[";
+
+	for (size_t i = 0; i < scopes.size(); i++)
+	{
+		ScopeSamples& scope = scopes[i];
+		scope.FrameMs.resize(frameMs.size(), 0.0);
+
+		json += i ? ",\n" : "\n";
+		json += "{\"name\":";
+		AppendEscaped(json, scope.Name);
+		snprintf(number, sizeof(number), ",\"calls_per_frame\":%.3f,", frameMs.empty() ? 0.0 : (double)scope.Calls / frameMs.size());
+		json += number;
+		AppendStats(json, Summarize(scope.FrameMs));
+		json += "}";
+	}
+
+	json += "\n]\n}\n";
+	return json;
+}
+
+bool BenchmarkReport::WriteJson(const std::string& path)
+{
+	ofstream file(path, ios::binary);
+	if (!file.is_open())
+		return false;
+
+	file << ToJson();
+	return file.good();
+}
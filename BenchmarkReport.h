@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Profiler.h"
+
+// Summary of one set of samples, all in milliseconds
+struct BenchmarkStats
+{
+	double Mean;
+	double Min;
+	double P50;
+	double P90;
+	double P95;
+	double P99;
+	double Max;
+};
+
+// Gathers frame times and the profiler scopes of each frame over a benchmark run and
+// writes them out as JSON, so a CI job can compare runs and fail on regressions.
+// Scopes are totalled per frame by name, so a scope that runs twice in a frame counts
+// both, and a frame it didn't run in counts as zero.  Plain C++ with no D3D, so
+// reports can be produced and checked anywhere.
+class BenchmarkReport
+{
+public:
+	// Written into the report's "scene" object, to tell runs apart
+	void AddParameter(const std::string& name, double value);
+	void AddParameter(const std::string& name, const std::string& value);
+
+	// Only CPU track events are counted; GPU timings are too late to line up with a frame
+	void AddFrame(uint64_t frameNs, const std::vector<ProfileEvent>& events);
+
+	unsigned int GetFrameCount() { return (unsigned int)frameMs.size(); }
+	BenchmarkStats GetFrameStats() { return Summarize(frameMs); }
+
+	std::string ToJson();
+	bool WriteJson(const std::string& path);
+
+	// Nearest rank percentiles, so every value reported is one that was measured
+	static BenchmarkStats Summarize(std::vector<double> samples);
+
+private:
+	struct ScopeSamples
+	{
+		std::string Name;
+		std::vector<double> FrameMs;
+		uint64_t Calls;
+	};
+
+	// Parameters keep their order, with the value already in JSON
+	std::vector<std::pair<std::string, std::string>> parameters;
+	std::vector<double> frameMs;
+
+	// In the order each was first seen, so reports diff cleanly
+	std::vector<ScopeSamples> scopes;
+	std::unordered_map<std::string, size_t> scopeIndices;
+};
@@ -8,6 +8,8 @@ Camera::Camera(float x, float y, float z, float moveSpeed, float mouseLookSpeed,
 {
 	this->movementSpeed = moveSpeed;
 	this->mouseLookSpeed = mouseLookSpeed;
+	this->nearClip = 0.01f;
+	this->farClip = 100.0f;
 	transform.SetPosition(x, y, z);
 
 	UpdateViewMatrix();
@@ -76,8 +78,8 @@ void Camera::UpdateProjectionMatrix(float aspectRatio)
 	XMMATRIX P = XMMatrixPerspectiveFovLH(
 		0.25f * XM_PI,		// Field of View Angle
 		aspectRatio,		// Aspect ratio
-		0.01f,				// Near clip plane distance
-		100.0f);			// Far clip plane distance
+		nearClip,			// Near clip plane distance
+		farClip);			// Far clip plane distance
 	XMStoreFloat4x4(&projMatrix, P);
 }
 
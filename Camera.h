@@ -20,6 +20,8 @@ public:
 	DirectX::XMFLOAT4X4 GetProjection() { return projMatrix; }
 
 	Transform* GetTransform();
+	float GetNearClip() { return nearClip; }
+	float GetFarClip() { return farClip; }
 
 private:
 	// Camera matrices
@@ -30,5 +32,7 @@ private:
 
 	float movementSpeed;
 	float mouseLookSpeed;
+	float nearClip;
+	float farClip;
 };
 
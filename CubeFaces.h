@@ -0,0 +1,49 @@
+#pragma once
+#include <cmath>
+
+// A cube map's faces in D3D's order (+X, -X, +Y, -Y, +Z, -Z), laid out the way the IBL
+// shaders' face switch addresses them.  Each face's direction is
+// u * uAxis + v * vAxis + normal, with u and v from -1 to 1 across and down it.
+static const float CubeFaceAxes[6][3][3] = {
+	{ { 0, 0, -1 }, { 0, -1, 0 }, { 1, 0, 0 } },
+	{ { 0, 0, 1 }, { 0, -1, 0 }, { -1, 0, 0 } },
+	{ { 1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } },
+	{ { 1, 0, 0 }, { 0, 0, -1 }, { 0, -1, 0 } },
+	{ { 1, 0, 0 }, { 0, -1, 0 }, { 0, 0, 1 } },
+	{ { -1, 0, 0 }, { 0, -1, 0 }, { 0, 0, -1 } } };
+
+// Unit direction through the centre of texel (x, y) on a face size texels across
+inline void GetCubeTexelDirection(unsigned int face, unsigned int x, unsigned int y, unsigned int size, float* direction)
+{
+	const float (&axes)[3][3] = CubeFaceAxes[face];
+	float u = (x + 0.5f) / size * 2 - 1;
+	float v = (y + 0.5f) / size * 2 - 1;
+	for (int a = 0; a < 3; a++)
+		direction[a] = axes[0][a] * u + axes[1][a] * v + axes[2][a];
+
+	float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+	for (int a = 0; a < 3; a++)
+		direction[a] /= length;
+}
+
+// The face a direction points into and where on it, u and v from -1 to 1.  The
+// inverse of CubeFaceAxes.
+inline unsigned int GetCubeFace(float x, float y, float z, float& u, float& v)
+{
+	float ax = std::fabs(x), ay = std::fabs(y), az = std::fabs(z);
+	if (ax >= ay && ax >= az)
+	{
+		u = (x > 0 ? -z : z) / ax;
+		v = -y / ax;
+		return x > 0 ? 0 : 1;
+	}
+	if (ay >= az)
+	{
+		u = x / ay;
+		v = (y > 0 ? z : -z) / ay;
+		return y > 0 ? 2 : 3;
+	}
+	u = (z > 0 ? x : -x) / az;
+	v = -y / az;
+	return z > 0 ? 4 : 5;
+}
@@ -0,0 +1,141 @@
+#include "DDSFile.h"
+
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include <experimental/filesystem>
+#include <algorithm>
+#include <fstream>
+
+using namespace std;
+
+static const uint32_t ddsMagic = 0x20534444;	// "DDS "
+static const uint32_t dx10FourCC = 0x30315844;	// "DX10"
+
+// Bytes per pixel, or per 4x4 block when compressed
+static unsigned int FormatBytes(uint32_t format, bool& blockCompressed)
+{
+	blockCompressed = false;
+	switch (format)
+	{
+	case 2: return 16;						// R32G32B32A32_FLOAT
+	case 10: case 11: return 8;				// R16G16B16A16_FLOAT, _UNORM
+	case 28: case 29: return 4;				// R8G8B8A8_UNORM, _SRGB
+	case 34: case 35: return 4;				// R16G16_FLOAT, _UNORM
+	case 41: return 4;						// R32_FLOAT
+	}
+
+	blockCompressed = true;
+	switch (format)
+	{
+	case 71: case 72: case 80: case 81: return 8;	// BC1, BC4
+	case 74: case 75: case 77: case 78: case 83: case 84: return 16;	// BC2, BC3, BC5
+	case 95: case 96: case 98: case 99: return 16;	// BC6H, BC7
+	}
+	return 0;
+}
+
+size_t DDSFile::RowBytes(uint32_t format, unsigned int width, unsigned int mip)
+{
+	bool blockCompressed;
+	size_t bytes = FormatBytes(format, blockCompressed);
+	width = max(width >> mip, 1u);
+	return blockCompressed ? (width + 3) / 4 * bytes : width * bytes;
+}
+
+size_t DDSFile::MipBytes(uint32_t format, unsigned int width, unsigned int height, unsigned int mip)
+{
+	bool blockCompressed;
+	FormatBytes(format, blockCompressed);
+	height = max(height >> mip, 1u);
+	return RowBytes(format, width, mip) * (blockCompressed ? (height + 3) / 4 : height);
+}
+
+size_t DDSFile::TotalBytes(const DDSDescription& description)
+{
+	size_t slice = 0;
+	for (unsigned int m = 0; m < description.MipCount; m++)
+		slice += MipBytes(description.Format, description.Width, description.Height, m);
+	return slice * description.ArraySize;
+}
+
+bool DDSFile::Write(const std::string& path, const DDSDescription& description, const void* data, size_t size)
+{
+	bool blockCompressed;
+	if (FormatBytes(description.Format, blockCompressed) == 0 || size != TotalBytes(description))
+		return false;
+
+	//Caps, height, width, pixel format and mip count, then linear size or pitch
+	uint32_t flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | (blockCompressed ? 0x80000 : 0x8);
+	uint32_t caps = 0x1000 | 0x8 | 0x400000;	// Texture, complex, mipmap
+	uint32_t cubeCaps = description.Cube ? 0xFE00 : 0;	// Cube map with all six faces
+
+	uint32_t header[32] = {};
+	header[0] = ddsMagic;
+	header[1] = 124;
+	header[2] = flags;
+	header[3] = description.Height;
+	header[4] = description.Width;
+	header[5] = (uint32_t)(blockCompressed ? MipBytes(description.Format, description.Width, description.Height, 0) : RowBytes(description.Format, description.Width, 0));
+	header[7] = description.MipCount;
+	header[19] = 32;
+	header[20] = 0x4;	// Four CC
+	header[21] = dx10FourCC;
+	header[27] = caps;
+	header[28] = cubeCaps;
+
+	//DDS_HEADER_DXT10: format, 2D, cube flag, array size (in cubes for a cube), no alpha mode
+	uint32_t dx10[5] = {
+		description.Format, 3,
+		description.Cube ? 0x4u : 0u,
+		description.Cube ? description.ArraySize / 6 : description.ArraySize,
+		0 };
+
+	//Written beside the target and renamed over it, so a watcher never sees half a file
+	string tempPath = path + ".tmp";
+	{
+		ofstream file(tempPath, ios::binary);
+		if (!file.is_open())
+			return false;
+
+		file.write((const char*)header, sizeof(header));
+		file.write((const char*)dx10, sizeof(dx10));
+		file.write((const char*)data, size);
+		if (!file.good())
+			return false;
+	}
+
+	error_code error;
+	experimental::filesystem::rename(tempPath, path, error);
+	if (!error)
+		return true;
+
+	experimental::filesystem::remove(tempPath, error);
+	return false;
+}
+
+bool DDSFile::Read(const std::string& path, DDSDescription& description, std::vector<uint8_t>& data)
+{
+	ifstream file(path, ios::binary);
+	if (!file.is_open())
+		return false;
+
+	uint32_t header[32];
+	uint32_t dx10[5];
+	if (!file.read((char*)header, sizeof(header)) || header[0] != ddsMagic || header[21] != dx10FourCC)
+		return false;
+	if (!file.read((char*)dx10, sizeof(dx10)) || dx10[1] != 3)
+		return false;
+
+	description.Format = dx10[0];
+	description.Width = header[4];
+	description.Height = header[3];
+	description.MipCount = max(header[7], 1u);
+	description.Cube = (dx10[2] & 0x4) != 0;
+	description.ArraySize = dx10[3] * (description.Cube ? 6 : 1);
+
+	bool blockCompressed;
+	if (FormatBytes(description.Format, blockCompressed) == 0)
+		return false;
+
+	data.resize(TotalBytes(description));
+	return (bool)file.read((char*)data.data(), data.size());
+}
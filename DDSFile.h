@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What a DDS file holds.  Format is a DXGI_FORMAT value.
+struct DDSDescription
+{
+	uint32_t Format;
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int MipCount;
+	// Faces count separately, so a cube is six
+	unsigned int ArraySize;
+	bool Cube;
+};
+
+// Reads and writes DDS files with the DX10 header extension, in the layout D3D uses for
+// subresources: each array slice (or cube face) in turn, with its whole mip chain.  Plain
+// C++ with no D3D, so tools can write files that DDSTextureLoader reads.
+//
+// Only the formats this project produces are known: 8 and 16 bit RGBA, R16G16, float
+// RGBA, R32 float, and BC1 to BC7.
+class DDSFile
+{
+public:
+	static bool Write(const std::string& path, const DDSDescription& description, const void* data, size_t size);
+	static bool Read(const std::string& path, DDSDescription& description, std::vector<uint8_t>& data);
+
+	// Zero for formats it doesn't know
+	static size_t MipBytes(uint32_t format, unsigned int width, unsigned int height, unsigned int mip);
+	static size_t RowBytes(uint32_t format, unsigned int width, unsigned int mip);
+	// Every slice and mip
+	static size_t TotalBytes(const DDSDescription& description);
+};
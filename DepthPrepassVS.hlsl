@@ -0,0 +1,21 @@
+cbuffer externalData : register(b0)
+{
+	matrix world;
+	matrix view;
+	matrix projection;
+};
+
+// --------------------------------------------------------
+// Depth only, before the opaque pass.  Reads the mesh's
+// position only stream, and must work out the position
+// exactly as VertexShader does, since the opaque pass then
+// tests for equal depth.  Precise, like VertexShader's, so
+// the compiler can't reorder or fuse the math differently in
+// the two shaders.
+// --------------------------------------------------------
+float4 main(float3 position : POSITION) : SV_POSITION
+{
+	matrix worldViewProj = mul(projection, mul(view, world));
+	precise float4 screenPosition = mul(worldViewProj, float4(position, 1.0f));
+	return screenPosition;
+}
@@ -0,0 +1,68 @@
+#include "DirectoryWatcher.h"
+
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include <experimental/filesystem>
+#include <algorithm>
+
+using namespace std;
+
+DirectoryWatcher::DirectoryWatcher(std::string RootPath)
+	:
+	rootPath(RootPath)
+{
+}
+
+std::vector<FileChange> DirectoryWatcher::Poll()
+{
+	return ApplyScan(Scan());
+}
+
+std::vector<FileChange> DirectoryWatcher::ApplyScan(const std::unordered_map<std::string, int64_t>& scan)
+{
+	vector<FileChange> changes;
+
+	for (auto& file : scan)
+	{
+		auto previous = files.find(file.first);
+		if (previous == files.end())
+			changes.push_back({ FileChange::ADDED, file.first });
+		else if (previous->second != file.second)
+			changes.push_back({ FileChange::MODIFIED, file.first });
+	}
+
+	for (auto& file : files)
+	{
+		if (scan.find(file.first) == scan.end())
+			changes.push_back({ FileChange::REMOVED, file.first });
+	}
+
+	files = scan;
+	return changes;
+}
+
+std::unordered_map<std::string, int64_t> DirectoryWatcher::Scan()
+{
+	unordered_map<string, int64_t> scan;
+
+	error_code error;
+	experimental::filesystem::recursive_directory_iterator it(rootPath, error);
+	if (error)
+		return scan;
+
+	for (; it != experimental::filesystem::recursive_directory_iterator(); it.increment(error))
+	{
+		if (error)
+			break;
+
+		if (it->status().type() != experimental::filesystem::file_type::regular)
+			continue;
+
+		string path = it->path().string();
+		replace(path.begin(), path.end(), '\\', '/');
+
+		int64_t writeTime = (int64_t)experimental::filesystem::last_write_time(it->path(), error).time_since_epoch().count();
+		scan[path] = error ? 0 : writeTime;
+	}
+
+	return scan;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+struct FileChange
+{
+	enum ChangeType
+	{
+		ADDED,
+		REMOVED,
+		MODIFIED
+	};
+
+	ChangeType Type;
+	std::string Path;
+};
+
+// Polling stand-in for an OS directory watcher.  Each Poll rescans the tree and
+// reports what changed since the last one, so it belongs on a worker thread.
+// The first Poll reports every file as added.
+class DirectoryWatcher
+{
+public:
+	DirectoryWatcher(std::string RootPath);
+
+	std::vector<FileChange> Poll();
+
+	// Diffs a scan against the previous one.  Split out so the change detection
+	// can be driven with made up scans.
+	std::vector<FileChange> ApplyScan(const std::unordered_map<std::string, int64_t>& scan);
+
+	std::string GetRootPath() { return rootPath; }
+	size_t GetFileCount() { return files.size(); }
+
+private:
+	std::unordered_map<std::string, int64_t> Scan();
+
+	std::string rootPath;
+	// Path, with forward slashes, to last write time
+	std::unordered_map<std::string, int64_t> files;
+};
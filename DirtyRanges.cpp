@@ -0,0 +1,103 @@
+#include "DirtyRanges.h"
+#include <algorithm>
+
+using namespace std;
+
+DirtyRanges::DirtyRanges(unsigned int MergeGap)
+	:
+	mergeGap(MergeGap),
+	size(0),
+	merged(true)
+{
+}
+
+void DirtyRanges::Resize(unsigned int count)
+{
+	if (count > size)
+	{
+		unsigned int oldSize = size;
+		size = count;
+		Mark(oldSize, count - oldSize);
+		return;
+	}
+
+	size = count;
+	for (size_t i = 0; i < marks.size();)
+	{
+		DirtyRange& range = marks[i];
+		if (range.First >= size)
+		{
+			marks.erase(marks.begin() + i);
+			continue;
+		}
+		range.Count = min(range.Count, size - range.First);
+		i++;
+	}
+}
+
+void DirtyRanges::Mark(unsigned int first, unsigned int count)
+{
+	if (first >= size)
+		return;
+	count = min(count, size - first);
+	if (count == 0)
+		return;
+
+	//The usual case is one element at a time in order, which can extend the last mark
+	if (!marks.empty())
+	{
+		DirtyRange& last = marks.back();
+		if (first >= last.First && first <= last.First + last.Count + mergeGap)
+		{
+			last.Count = max(last.Count, first + count - last.First);
+			return;
+		}
+	}
+
+	marks.push_back({ first, count });
+	merged = false;
+}
+
+void DirtyRanges::MarkAll()
+{
+	marks.clear();
+	merged = true;
+	if (size > 0)
+		marks.push_back({ 0, size });
+}
+
+void DirtyRanges::Clear()
+{
+	marks.clear();
+	merged = true;
+}
+
+const std::vector<DirtyRange>& DirtyRanges::GetRanges()
+{
+	if (merged || marks.empty())
+		return marks;
+
+	sort(marks.begin(), marks.end(), [](const DirtyRange& a, const DirtyRange& b) { return a.First < b.First; });
+
+	size_t out = 0;
+	for (size_t i = 1; i < marks.size(); i++)
+	{
+		DirtyRange& current = marks[out];
+		const DirtyRange& next = marks[i];
+		if (next.First <= current.First + current.Count + mergeGap)
+			current.Count = max(current.Count, next.First + next.Count - current.First);
+		else
+			marks[++out] = next;
+	}
+	marks.resize(out + 1);
+	merged = true;
+	return marks;
+}
+
+unsigned int DirtyRanges::GetDirtyCount()
+{
+	unsigned int count = 0;
+	for (const DirtyRange& range : GetRanges())
+		count += range.Count;
+	return count;
+}
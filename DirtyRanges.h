@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+
+struct DirtyRange
+{
+	unsigned int First;
+	unsigned int Count;
+};
+
+// Tracks which elements of a CPU-side array have changed since they were last copied to
+// the GPU, so only those get uploaded.  Marks are merged into sorted, non-overlapping
+// ranges, and ranges separated by MergeGap or fewer clean elements are joined, since
+// one slightly larger copy is cheaper than two small ones.
+class DirtyRanges
+{
+public:
+	DirtyRanges(unsigned int MergeGap = 8);
+
+	// Elements added by growing are dirty, ranges past a shrunk end are dropped
+	void Resize(unsigned int count);
+	unsigned int GetSize() { return size; }
+
+	void Mark(unsigned int first, unsigned int count = 1);
+	void MarkAll();
+	void Clear();
+
+	bool IsClean() { return marks.empty(); }
+	const std::vector<DirtyRange>& GetRanges();
+	unsigned int GetDirtyCount();
+
+private:
+	unsigned int mergeGap;
+	unsigned int size;
+	bool merged;
+	std::vector<DirtyRange> marks;
+};
@@ -1,4 +1,12 @@
 #include "Emitter.h"
+#include "Assets.h"
+#include <cfloat>
+#include <cmath>
+
+// Seconds between simulation ticks at each LOD, zero meaning every frame
+static const float lodTickIntervals[EMITTER_LOD_COUNT] = { 0.0f, 1.0f / 15.0f, 0.25f };
+// Fraction of the normal emission rate kept at each LOD
+static const float lodEmissionRates[EMITTER_LOD_COUNT] = { 1.0f, 0.5f, 0.25f };
 
 
 Emitter::Emitter(int NumOfParticles, int ParticlesPerEmission, float ParticleLifetime, Microsoft::WRL::ComPtr<ID3D11DeviceContext> Context, Microsoft::WRL::ComPtr<ID3D11Device> Device, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Texture, std::shared_ptr<SimpleVertexShader> ParticleVS, std::shared_ptr<SimplePixelShader> ParticlePS)
@@ -9,7 +17,17 @@ Emitter::Emitter(int NumOfParticles, int ParticlesPerEmission, float ParticleLif
 	particlePS(ParticlePS),
 	context(Context),
 	device(Device),
-	texture(Texture)
+	texture(Texture),
+	gpuSimulation(false),
+	gpuDeadListInitialized(false),
+	sortParticles(false),
+	alphaBlended(false),
+	sorter(Assets::GetInstance().GetJobSystem()),
+	lod(EMITTER_LOD_NEAR),
+	lodFarDistance(20.0f),
+	lodTimeAccumulated(0),
+	lodFrameCounts(),
+	lodUpdateCounts()
 {
 	particleEmissionFrequency = 1.0f / particlesPerEmission;
 	particles = new Particle[NumOfParticles];
@@ -28,23 +46,10 @@ Emitter::Emitter(int NumOfParticles, int ParticlesPerEmission, float ParticleLif
 	firstDeadIndex = 0;
 	amountOfLiveParticles = 0;
 	timeSinceLastEmit = 0;
+	emitSeed = (unsigned int)rand();
 
 	myTransform = new Transform();
 
-	unsigned int* indices = new unsigned int[NumOfParticles * 6];
-	int indicesIndex = 0;
-	for (int i = 0; i < NumOfParticles * 4; i += 4)
-	{
-		indices[indicesIndex++] = i;
-		indices[indicesIndex++] = i + 1;
-		indices[indicesIndex++] = i + 2;
-		indices[indicesIndex++] = i;
-		indices[indicesIndex++] = i + 2;
-		indices[indicesIndex++] = i + 3;
-	}
-	D3D11_SUBRESOURCE_DATA indexData = {};
-	indexData.pSysMem = indices;
-
 	//Make buffers and stuff
 	D3D11_BUFFER_DESC particleBufferDesc = {};
 	particleBufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
@@ -55,21 +60,12 @@ Emitter::Emitter(int NumOfParticles, int ParticlesPerEmission, float ParticleLif
 	particleBufferDesc.StructureByteStride = sizeof(Particle);
 	device->CreateBuffer(&particleBufferDesc, 0, particleBuffer.GetAddressOf());
 
-	D3D11_BUFFER_DESC indexBufferDesc = {};
-	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexBufferDesc.CPUAccessFlags = 0;
-	indexBufferDesc.ByteWidth = sizeof(unsigned int) * 6 * NumOfParticles;
-	device->CreateBuffer(&indexBufferDesc, &indexData, indexBuffer.GetAddressOf());
-
 	D3D11_SHADER_RESOURCE_VIEW_DESC particleSRVDesc = {};
 	particleSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
 	particleSRVDesc.Buffer.FirstElement = 0;
 	particleSRVDesc.Buffer.NumElements = NumOfParticles;
 	particleSRVDesc.Format = DXGI_FORMAT_UNKNOWN;
 	device->CreateShaderResourceView(particleBuffer.Get(), &particleSRVDesc, particleSRV.GetAddressOf());
-
-	delete[] indices;
 }
 
 Emitter::~Emitter()
@@ -79,8 +75,129 @@ Emitter::~Emitter()
 	delete[] particles;
 }
 
+void Emitter::UpdateLOD(std::shared_ptr<Camera> camera)
+{
+	DirectX::XMFLOAT3 center;
+	float radius;
+	CalculateBounds(center, radius);
+
+	//Frustum planes straight out of the view projection matrix
+	DirectX::XMFLOAT4X4 view = camera->GetView();
+	DirectX::XMFLOAT4X4 projection = camera->GetProjection();
+	DirectX::XMFLOAT4X4 viewProj;
+	DirectX::XMStoreFloat4x4(&viewProj, DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&view), DirectX::XMLoadFloat4x4(&projection)));
+	float m[4][4];
+	memcpy(m, &viewProj, sizeof(m));
+
+	float planes[6][4];
+	for (int i = 0; i < 4; i++)
+	{
+		planes[0][i] = m[i][3] + m[i][0];	//Left
+		planes[1][i] = m[i][3] - m[i][0];	//Right
+		planes[2][i] = m[i][3] + m[i][1];	//Bottom
+		planes[3][i] = m[i][3] - m[i][1];	//Top
+		planes[4][i] = m[i][2];				//Near
+		planes[5][i] = m[i][3] - m[i][2];	//Far
+	}
+
+	bool visible = true;
+	for (int i = 0; i < 6 && visible; i++)
+	{
+		float length = sqrtf(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2]);
+		float distance = planes[i][0] * center.x + planes[i][1] * center.y + planes[i][2] * center.z + planes[i][3];
+		visible = distance >= -radius * length;
+	}
+
+	DirectX::XMFLOAT3 camPos = camera->GetTransform()->GetPosition();
+	float dx = center.x - camPos.x;
+	float dy = center.y - camPos.y;
+	float dz = center.z - camPos.z;
+	float distance = sqrtf(dx * dx + dy * dy + dz * dz) - radius;
+
+	if (!visible)
+		lod = EMITTER_LOD_CULLED;
+	else if (distance > lodFarDistance)
+		lod = EMITTER_LOD_FAR;
+	else
+		lod = EMITTER_LOD_NEAR;
+
+	lodFrameCounts[lod]++;
+}
+
+//Bounding sphere of everything this emitter's particles can reach, scale included
+void Emitter::CalculateBounds(DirectX::XMFLOAT3& center, float& radius)
+{
+	//ParticleVS integrates motion over the normalized age, so a particle moves for one unit of "time"
+	//no matter what lifetimeOfParticle is
+	const float motionTime = 1.0f;
+
+	float start[3] = { startingVelocity.x, startingVelocity.y, startingVelocity.z };
+	float range[3] = { fabsf(velocityRange.x), fabsf(velocityRange.y), fabsf(velocityRange.z) };
+	float accel[3] = { acceleration.x, acceleration.y, acceleration.z };
+	float boundsMin[3];
+	float boundsMax[3];
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		boundsMin[axis] = 0;
+		boundsMax[axis] = 0;
+
+		//p(t) = v * t + a * t * t / 2 is monotonic in v, so only the velocity extremes matter
+		float velocities[2] = { start[axis] - range[axis], start[axis] + range[axis] };
+		for (float v : velocities)
+		{
+			float end = v * motionTime + accel[axis] * motionTime * motionTime / 2.0f;
+			boundsMin[axis] = min(boundsMin[axis], end);
+			boundsMax[axis] = max(boundsMax[axis], end);
+
+			//The turning point, if the particle turns around before it dies
+			if (accel[axis] != 0)
+			{
+				float t = -v / accel[axis];
+				if (t > 0 && t < motionTime)
+				{
+					float turn = v * t + accel[axis] * t * t / 2.0f;
+					boundsMin[axis] = min(boundsMin[axis], turn);
+					boundsMax[axis] = max(boundsMax[axis], turn);
+				}
+			}
+		}
+	}
+
+	DirectX::XMFLOAT3 pos = myTransform->GetPosition();
+	center.x = pos.x + (boundsMin[0] + boundsMax[0]) / 2.0f;
+	center.y = pos.y + (boundsMin[1] + boundsMax[1]) / 2.0f;
+	center.z = pos.z + (boundsMin[2] + boundsMax[2]) / 2.0f;
+
+	float extentX = (boundsMax[0] - boundsMin[0]) / 2.0f;
+	float extentY = (boundsMax[1] - boundsMin[1]) / 2.0f;
+	float extentZ = (boundsMax[2] - boundsMin[2]) / 2.0f;
+	float maxScale = max(max(startScale.x, startScale.y), max(endScale.x, endScale.y));
+	radius = sqrtf(extentX * extentX + extentY * extentY + extentZ * extentZ) + maxScale * 1.41421356f;
+}
+
+float Emitter::GetEmissionInterval()
+{
+	return particleEmissionFrequency / lodEmissionRates[lod];
+}
+
 void Emitter::Update(float dt)
 {
+	//Lower LODs bank time and simulate it all in one bigger step.  Motion is closed form,
+	//so the only cost is coarser emission timing.
+	lodTimeAccumulated += dt;
+	if (lodTimeAccumulated < lodTickIntervals[lod])
+		return;
+	dt = lodTimeAccumulated;
+	lodTimeAccumulated = 0;
+	lodUpdateCounts[lod]++;
+
+	if (gpuSimulation)
+	{
+		UpdateGPU(dt);
+		return;
+	}
+
 	if (amountOfLiveParticles > 0)
 	{
 		if (firstDeadIndex < firstLiveIndex)
@@ -100,10 +217,11 @@ void Emitter::Update(float dt)
 
 	timeSinceLastEmit += dt;
 
-	while (timeSinceLastEmit > particleEmissionFrequency)
+	float emissionInterval = GetEmissionInterval();
+	while (timeSinceLastEmit > emissionInterval)
 	{
 		EmitParticle();
-		timeSinceLastEmit -= particleEmissionFrequency;
+		timeSinceLastEmit -= emissionInterval;
 	}
 
 	D3D11_MAPPED_SUBRESOURCE mapped = {};
@@ -121,18 +239,28 @@ void Emitter::Update(float dt)
 
 void Emitter::Draw(std::shared_ptr<Camera> camera)
 {
+	if (lod == EMITTER_LOD_CULLED)
+		return;
+
 	UINT stride = 0;
 	UINT offset = 0;
 	ID3D11Buffer* nullbuffer = 0;
 	context->IASetVertexBuffers(0, 1, &nullbuffer, &stride, &offset);
-	context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	//Quads are expanded from SV_VertexID alone, so no emitter needs an index buffer
+	context->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
 
 	particlePS->SetShader();
 	particleVS->SetShader();
 
 	particlePS->SetShaderResourceView("Texture", texture);
 
-	particleVS->SetShaderResourceView("ParticleData", particleSRV);
+	bool sorted = sortParticles && !gpuSimulation && amountOfLiveParticles > 0;
+	if (sorted)
+		SortParticles(camera);
+
+	particleVS->SetShaderResourceView("ParticleData", gpuSimulation ? gpuParticleSRV : particleSRV);
+	particleVS->SetShaderResourceView("DrawList", gpuSimulation ? drawListSRV : sortedIndexSRV);
+	particleVS->SetInt("useDrawList", gpuSimulation || sorted);
 	particleVS->SetMatrix4x4("view", camera->GetView());
 	particleVS->SetMatrix4x4("projection", camera->GetProjection());
 	particleVS->SetFloat2("startScale", startScale);
@@ -140,9 +268,95 @@ void Emitter::Draw(std::shared_ptr<Camera> camera)
 	particleVS->SetFloat4("startColor", startColor);
 	particleVS->SetFloat4("endColor", endColor);
 	particleVS->SetFloat3("acceleration", acceleration);
+	//Time banked since the last tick, so skipped frames still move smoothly
+	particleVS->SetFloat("ageOffset", lodTimeAccumulated / lifetimeOfParticle);
 	particleVS->CopyAllBufferData();
 
-	context->DrawIndexed(amountOfLiveParticles * 6, 0, 0);
+	if (!gpuSimulation)
+	{
+		context->Draw(amountOfLiveParticles * 6, 0);
+		return;
+	}
+
+	context->DrawInstancedIndirect(drawArgsBuffer.Get(), 0);
+
+	// The particle buffers are bound as UAVs again next update
+	ID3D11ShaderResourceView* nullSRVs[2] = {};
+	context->VSSetShaderResources(0, 2, nullSRVs);
+}
+
+void Emitter::EnableGPUSimulation(std::shared_ptr<SimpleComputeShader> InitDeadListCS, std::shared_ptr<SimpleComputeShader> EmitCS, std::shared_ptr<SimpleComputeShader> UpdateCS, std::shared_ptr<SimpleComputeShader> DrawArgsCS)
+{
+	initDeadListCS = InitDeadListCS;
+	emitCS = EmitCS;
+	updateCS = UpdateCS;
+	drawArgsCS = DrawArgsCS;
+
+	if (!gpuParticleUAV)
+		CreateGPUResources();
+
+	gpuSimulation = true;
+	gpuDeadListInitialized = false;
+}
+
+//Maps a slot in the uploaded (packed) particle buffer back to the ring buffer
+int Emitter::GetUploadedParticleIndex(int slot)
+{
+	if (firstDeadIndex < firstLiveIndex)
+		return slot < firstDeadIndex ? slot : firstLiveIndex + (slot - firstDeadIndex);
+
+	return (firstLiveIndex + slot) % totalParticlesAmount;
+}
+
+void Emitter::SortParticles(std::shared_ptr<Camera> camera)
+{
+	if (!sortedIndexBuffer)
+	{
+		D3D11_BUFFER_DESC indexDesc = {};
+		indexDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		indexDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		indexDesc.Usage = D3D11_USAGE_DYNAMIC;
+		indexDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		indexDesc.ByteWidth = sizeof(unsigned int) * totalParticlesAmount;
+		indexDesc.StructureByteStride = sizeof(unsigned int);
+		device->CreateBuffer(&indexDesc, 0, sortedIndexBuffer.GetAddressOf());
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC indexSRVDesc = {};
+		indexSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		indexSRVDesc.Buffer.FirstElement = 0;
+		indexSRVDesc.Buffer.NumElements = totalParticlesAmount;
+		indexSRVDesc.Format = DXGI_FORMAT_UNKNOWN;
+		device->CreateShaderResourceView(sortedIndexBuffer.Get(), &indexSRVDesc, sortedIndexSRV.GetAddressOf());
+
+		particleDepths.resize(totalParticlesAmount);
+		sortedIndices.resize(totalParticlesAmount);
+	}
+
+	//View space depth of each particle, using the same motion as ParticleVS
+	DirectX::XMFLOAT4X4 view = camera->GetView();
+	float nearZ = FLT_MAX;
+	float farZ = -FLT_MAX;
+	for (int i = 0; i < amountOfLiveParticles; i++)
+	{
+		Particle& p = particles[GetUploadedParticleIndex(i)];
+		float t = p.Age + lodTimeAccumulated / lifetimeOfParticle;
+		float x = acceleration.x * t * t / 2.0f + p.Velocity.x * t + p.Position.x;
+		float y = acceleration.y * t * t / 2.0f + p.Velocity.y * t + p.Position.y;
+		float z = acceleration.z * t * t / 2.0f + p.Velocity.z * t + p.Position.z;
+
+		float depth = x * view._13 + y * view._23 + z * view._33 + view._43;
+		particleDepths[i] = depth;
+		nearZ = min(nearZ, depth);
+		farZ = max(farZ, depth);
+	}
+
+	//Quantizing over just this emitter's depth range keeps the 16 bit keys precise
+	sorter.SortBackToFront(particleDepths.data(), amountOfLiveParticles, nearZ, farZ, sortedIndices.data());
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	context->Map(sortedIndexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+	memcpy(mapped.pData, sortedIndices.data(), sizeof(unsigned int) * amountOfLiveParticles);
+	context->Unmap(sortedIndexBuffer.Get(), 0);
 }
 
 void Emitter::SetColor(DirectX::XMFLOAT4 newColor, DirectX::XMFLOAT4 newEndColor)
@@ -192,3 +406,182 @@ void Emitter::EmitParticle()
 	firstDeadIndex %= totalParticlesAmount;
 	amountOfLiveParticles++;
 }
+
+void Emitter::CreateGPUResources()
+{
+	//Particle pool, written by the compute shaders and read by ParticleVS
+	Microsoft::WRL::ComPtr<ID3D11Buffer> gpuParticleBuffer;
+	D3D11_BUFFER_DESC poolDesc = {};
+	poolDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+	poolDesc.Usage = D3D11_USAGE_DEFAULT;
+	poolDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	poolDesc.ByteWidth = sizeof(Particle) * totalParticlesAmount;
+	poolDesc.StructureByteStride = sizeof(Particle);
+	device->CreateBuffer(&poolDesc, 0, gpuParticleBuffer.GetAddressOf());
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC poolUAVDesc = {};
+	poolUAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	poolUAVDesc.Buffer.FirstElement = 0;
+	poolUAVDesc.Buffer.NumElements = totalParticlesAmount;
+	poolUAVDesc.Format = DXGI_FORMAT_UNKNOWN;
+	device->CreateUnorderedAccessView(gpuParticleBuffer.Get(), &poolUAVDesc, gpuParticleUAV.GetAddressOf());
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC poolSRVDesc = {};
+	poolSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	poolSRVDesc.Buffer.FirstElement = 0;
+	poolSRVDesc.Buffer.NumElements = totalParticlesAmount;
+	poolSRVDesc.Format = DXGI_FORMAT_UNKNOWN;
+	device->CreateShaderResourceView(gpuParticleBuffer.Get(), &poolSRVDesc, gpuParticleSRV.GetAddressOf());
+
+	//Dead and draw lists are append/consume buffers of particle indices
+	D3D11_BUFFER_DESC listDesc = {};
+	listDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+	listDesc.Usage = D3D11_USAGE_DEFAULT;
+	listDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	listDesc.ByteWidth = sizeof(unsigned int) * totalParticlesAmount;
+	listDesc.StructureByteStride = sizeof(unsigned int);
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC listUAVDesc = {};
+	listUAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	listUAVDesc.Buffer.FirstElement = 0;
+	listUAVDesc.Buffer.NumElements = totalParticlesAmount;
+	listUAVDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_APPEND;
+	listUAVDesc.Format = DXGI_FORMAT_UNKNOWN;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> deadListBuffer;
+	device->CreateBuffer(&listDesc, 0, deadListBuffer.GetAddressOf());
+	device->CreateUnorderedAccessView(deadListBuffer.Get(), &listUAVDesc, deadListUAV.GetAddressOf());
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> drawListBuffer;
+	listDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+	device->CreateBuffer(&listDesc, 0, drawListBuffer.GetAddressOf());
+	device->CreateUnorderedAccessView(drawListBuffer.Get(), &listUAVDesc, drawListUAV.GetAddressOf());
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC listSRVDesc = {};
+	listSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	listSRVDesc.Buffer.FirstElement = 0;
+	listSRVDesc.Buffer.NumElements = totalParticlesAmount;
+	listSRVDesc.Format = DXGI_FORMAT_UNKNOWN;
+	device->CreateShaderResourceView(drawListBuffer.Get(), &listSRVDesc, drawListSRV.GetAddressOf());
+
+	//Single uints that CopyStructureCount writes the list counters into
+	D3D11_BUFFER_DESC counterDesc = {};
+	counterDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	counterDesc.Usage = D3D11_USAGE_DEFAULT;
+	counterDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	counterDesc.ByteWidth = sizeof(unsigned int);
+	counterDesc.StructureByteStride = sizeof(unsigned int);
+	device->CreateBuffer(&counterDesc, 0, deadListCounterBuffer.GetAddressOf());
+	device->CreateBuffer(&counterDesc, 0, drawListCounterBuffer.GetAddressOf());
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC counterSRVDesc = {};
+	counterSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	counterSRVDesc.Buffer.FirstElement = 0;
+	counterSRVDesc.Buffer.NumElements = 1;
+	counterSRVDesc.Format = DXGI_FORMAT_UNKNOWN;
+	device->CreateShaderResourceView(deadListCounterBuffer.Get(), &counterSRVDesc, deadListCounterSRV.GetAddressOf());
+	device->CreateShaderResourceView(drawListCounterBuffer.Get(), &counterSRVDesc, drawListCounterSRV.GetAddressOf());
+
+	//Indirect draw arguments, filled in by ParticleDrawArgsCS
+	D3D11_BUFFER_DESC argsDesc = {};
+	argsDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+	argsDesc.Usage = D3D11_USAGE_DEFAULT;
+	argsDesc.MiscFlags = D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS;
+	argsDesc.ByteWidth = sizeof(unsigned int) * 4;
+	device->CreateBuffer(&argsDesc, 0, drawArgsBuffer.GetAddressOf());
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC argsUAVDesc = {};
+	argsUAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	argsUAVDesc.Buffer.FirstElement = 0;
+	argsUAVDesc.Buffer.NumElements = 4;
+	argsUAVDesc.Format = DXGI_FORMAT_R32_UINT;
+	device->CreateUnorderedAccessView(drawArgsBuffer.Get(), &argsUAVDesc, drawArgsUAV.GetAddressOf());
+}
+
+ParticleSimulationConstants Emitter::GetSimulationConstants(float dt, unsigned int emitCount)
+{
+	ParticleSimulationConstants constants = {};
+	constants.EmitterPosition = myTransform->GetPosition();
+	constants.Lifetime = lifetimeOfParticle;
+	constants.StartingVelocity = startingVelocity;
+	constants.InvLifetime = 1.0f / lifetimeOfParticle;
+	constants.VelocityRange = velocityRange;
+	constants.DeltaTime = dt;
+	constants.EmitCount = emitCount;
+	constants.EmitSeed = emitSeed;
+	constants.MaxParticles = totalParticlesAmount;
+	return constants;
+}
+
+void Emitter::SetSimulationData(std::shared_ptr<SimpleComputeShader> cs, float dt, unsigned int emitCount)
+{
+	ParticleSimulationConstants constants = GetSimulationConstants(dt, emitCount);
+
+	cs->SetShader();
+	cs->SetFloat3("emitterPosition", constants.EmitterPosition);
+	cs->SetFloat("lifetime", constants.Lifetime);
+	cs->SetFloat3("startingVelocity", constants.StartingVelocity);
+	cs->SetFloat("invLifetime", constants.InvLifetime);
+	cs->SetFloat3("velocityRange", constants.VelocityRange);
+	cs->SetFloat("deltaTime", constants.DeltaTime);
+	cs->SetData("emitCount", &constants.EmitCount, sizeof(unsigned int));
+	cs->SetData("emitSeed", &constants.EmitSeed, sizeof(unsigned int));
+	cs->SetData("maxParticles", &constants.MaxParticles, sizeof(unsigned int));
+	cs->CopyAllBufferData();
+}
+
+void Emitter::UpdateGPU(float dt)
+{
+	//Same emission timing as the CPU path, but only the count goes to the GPU
+	unsigned int emitCount = 0;
+	timeSinceLastEmit += dt;
+	float emissionInterval = GetEmissionInterval();
+	while (timeSinceLastEmit > emissionInterval)
+	{
+		emitCount++;
+		timeSinceLastEmit -= emissionInterval;
+	}
+	emitSeed++;
+
+	if (!gpuDeadListInitialized)
+	{
+		SetSimulationData(initDeadListCS, 0, 0);
+		initDeadListCS->SetUnorderedAccessView("Particles", gpuParticleUAV);
+		initDeadListCS->SetUnorderedAccessView("DeadList", deadListUAV, 0);
+		initDeadListCS->DispatchByThreads(totalParticlesAmount, 1, 1);
+		gpuDeadListInitialized = true;
+	}
+
+	//Age everything, rebuilding the draw list from zero
+	SetSimulationData(updateCS, dt, emitCount);
+	updateCS->SetUnorderedAccessView("Particles", gpuParticleUAV);
+	updateCS->SetUnorderedAccessView("DeadList", deadListUAV);
+	updateCS->SetUnorderedAccessView("DrawList", drawListUAV, 0);
+	updateCS->DispatchByThreads(totalParticlesAmount, 1, 1);
+
+	//Spawn into the dead slots, including the ones freed just now
+	if (emitCount > 0)
+	{
+		context->CopyStructureCount(deadListCounterBuffer.Get(), 0, deadListUAV.Get());
+
+		SetSimulationData(emitCS, dt, emitCount);
+		emitCS->SetUnorderedAccessView("Particles", gpuParticleUAV);
+		emitCS->SetUnorderedAccessView("DeadList", deadListUAV);
+		emitCS->SetUnorderedAccessView("DrawList", drawListUAV);
+		emitCS->SetShaderResourceView("DeadListCounter", deadListCounterSRV);
+		emitCS->DispatchByThreads(emitCount, 1, 1);
+	}
+
+	context->CopyStructureCount(drawListCounterBuffer.Get(), 0, drawListUAV.Get());
+
+	drawArgsCS->SetShader();
+	drawArgsCS->SetShaderResourceView("DrawListCounter", drawListCounterSRV);
+	drawArgsCS->SetUnorderedAccessView("DrawArgs", drawArgsUAV);
+	drawArgsCS->DispatchByGroups(1, 1, 1);
+
+	//Unbind everything so ParticleVS can read the buffers
+	ID3D11UnorderedAccessView* nullUAVs[8] = {};
+	ID3D11ShaderResourceView* nullSRVs[8] = {};
+	context->CSSetUnorderedAccessViews(0, 8, nullUAVs, 0);
+	context->CSSetShaderResources(0, 8, nullSRVs);
+}
@@ -5,15 +5,20 @@
 #include "Camera.h"
 #include <wrl/client.h>
 #include "SimpleShader.h"
+#include "ParticleSimulation.h"
+#include "ParticleSort.h"
 #include <memory>
+#include <vector>
 
-struct Particle
+// Simulation detail levels, picked each frame from the emitter's bounds and the camera
+enum EmitterLOD
 {
-	float				Age;
-	DirectX::XMFLOAT3	Position;	// 32 bytes
-	float				Time;
-	DirectX::XMFLOAT3   Velocity;
+	EMITTER_LOD_NEAR,	// Simulated every frame at the full emission rate
+	EMITTER_LOD_FAR,	// Simulated at a reduced tick rate, ParticleVS extrapolates between ticks
+	EMITTER_LOD_CULLED,	// Off screen, simulated rarely and not drawn
+	EMITTER_LOD_COUNT
 };
+
 class Emitter
 {
 private:
@@ -21,6 +26,16 @@ private:
 	void UpdateParticle(int index, float time);
 	float RandomFloat(float min, float max);
 
+	void CreateGPUResources();
+	void UpdateGPU(float dt);
+	void SetSimulationData(std::shared_ptr<SimpleComputeShader> cs, float dt, unsigned int emitCount);
+
+	void CalculateBounds(DirectX::XMFLOAT3& center, float& radius);
+	float GetEmissionInterval();
+
+	int GetUploadedParticleIndex(int slot);
+	void SortParticles(std::shared_ptr<Camera> camera);
+
 	Particle* particles;
 	int firstLiveIndex;
 	int firstDeadIndex;
@@ -47,16 +62,55 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11Device> device;
 
 	Microsoft::WRL::ComPtr<ID3D11Buffer> particleBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> particleSRV;
 
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture;
 	std::shared_ptr<SimpleVertexShader> particleVS;
 	std::shared_ptr<SimplePixelShader> particlePS;
+
+	// GPU simulation path
+	bool gpuSimulation;
+	bool gpuDeadListInitialized;
+	unsigned int emitSeed;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> gpuParticleSRV;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> gpuParticleUAV;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> deadListUAV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> drawListSRV;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> drawListUAV;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> deadListCounterBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> deadListCounterSRV;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> drawListCounterBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> drawListCounterSRV;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> drawArgsBuffer;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> drawArgsUAV;
+
+	std::shared_ptr<SimpleComputeShader> initDeadListCS;
+	std::shared_ptr<SimpleComputeShader> emitCS;
+	std::shared_ptr<SimpleComputeShader> updateCS;
+	std::shared_ptr<SimpleComputeShader> drawArgsCS;
+
+	// Back-to-front sorting for alpha blended emitters (CPU simulation only)
+	bool sortParticles;
+	bool alphaBlended;
+	ParticleSorter sorter;
+	std::vector<float> particleDepths;
+	std::vector<unsigned int> sortedIndices;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> sortedIndexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> sortedIndexSRV;
+
+	// Distance and visibility based LOD
+	EmitterLOD lod;
+	float lodFarDistance;
+	float lodTimeAccumulated;
+	unsigned int lodFrameCounts[EMITTER_LOD_COUNT];
+	unsigned int lodUpdateCounts[EMITTER_LOD_COUNT];
 public:
 	Emitter(int NumOfParticles, int ParticlesPerEmission, float ParticleLifetime, Microsoft::WRL::ComPtr<ID3D11DeviceContext> Context, Microsoft::WRL::ComPtr<ID3D11Device> Device, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Texture, std::shared_ptr<SimpleVertexShader> ParticleVS, std::shared_ptr<SimplePixelShader> ParticlePS);
 	~Emitter();
 
+	// Picks the LOD used by the next Update and Draw
+	void UpdateLOD(std::shared_ptr<Camera> camera);
 	void Update(float dt);
 	void Draw(std::shared_ptr<Camera> camera);
 
@@ -66,6 +120,26 @@ public:
 	void SetAcceleration(DirectX::XMFLOAT3 newAcceleration) { acceleration = newAcceleration; }
 	void SetVelocityRange(DirectX::XMFLOAT3 newVelocityRange) { velocityRange = newVelocityRange; }
 
+	// Moves the simulation onto the GPU.  The CPU ring buffer is no longer used after this.
+	void EnableGPUSimulation(std::shared_ptr<SimpleComputeShader> InitDeadListCS, std::shared_ptr<SimpleComputeShader> EmitCS,
+		std::shared_ptr<SimpleComputeShader> UpdateCS, std::shared_ptr<SimpleComputeShader> DrawArgsCS);
+	bool GetGPUSimulation() { return gpuSimulation; }
+
+	void SetSortParticles(bool sort) { sortParticles = sort; }
+	bool GetSortParticles() { return sortParticles; }
+	void SetAlphaBlended(bool alpha) { alphaBlended = alpha; }
+	bool GetAlphaBlended() { return alphaBlended; }
+
+	EmitterLOD GetLOD() { return lod; }
+	void SetLODFarDistance(float distance) { lodFarDistance = distance; }
+	float GetLODFarDistance() { return lodFarDistance; }
+	// Frames spent at, and simulation ticks run at, each LOD
+	unsigned int GetLODFrameCount(EmitterLOD level) { return lodFrameCounts[level]; }
+	unsigned int GetLODUpdateCount(EmitterLOD level) { return lodUpdateCounts[level]; }
+
+	// The exact constants the compute shaders see, so ParticleSimulationReference can be driven with them
+	ParticleSimulationConstants GetSimulationConstants(float dt, unsigned int emitCount);
+
 	Transform* GetTransform() { return myTransform; }
 };
 
@@ -7,6 +7,8 @@
 #include "Input.h"
 #include "Assets.h"
 #include "Renderer.h"
+#include "Profiler.h"
+#include "SceneSetup.h"
 
 #include "WICTextureLoader.h"
 
@@ -22,9 +24,6 @@
 // For the DirectX Math library
 using namespace DirectX;
 
-// Helper macro for getting a float between min and max
-#define RandomRange(min, max) (float)rand() / RAND_MAX * (max - min) + min
-
 // Helper macros for making texture and shader loading code more succinct
 #define LoadTexture(file, srv) CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(file).c_str(), 0, srv.GetAddressOf())
 #define LoadShader(type, file) std::make_shared<type>(device.Get(), context.Get(), GetFullPathTo_Wide(file).c_str())
@@ -83,7 +82,11 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
+	Profiler::SetThreadName("Main");
 	Assets::GetInstance().Initialize("../../Assets/", device, context, true, true);
+	Assets::GetInstance().SetShaderSourceDirectory("../../");
+	Assets::GetInstance().CookTextures();
+	Assets::GetInstance().EnableTextureStreaming(128 * 1024 * 1024);
 	Assets::GetInstance().LoadAllAssets();
 	// Asset loading and entity creation
 	LoadAssetsAndCreateEntities();
@@ -135,141 +138,166 @@ void Game::LoadAssetsAndCreateEntities()
 	device->CreateSamplerState(&sampDesc, clampSamplerOptions.GetAddressOf());
 
 
-	// Create the sky using 6 images
-	sky = std::make_shared<Sky>(
-		GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\right.png").c_str(),
-		GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\left.png").c_str(),
-		GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\up.png").c_str(),
-		GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\down.png").c_str(),
-		GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\front.png").c_str(),
-		GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\back.png").c_str(),
-		instance.GetMesh("cube"),
-		instance.GetVertexShader("SkyVS"),
-		instance.GetPixelShader("SkyPS"),
-		samplerOptions,
-		device,
-		context);
+	// Create the sky from the cube Assets cooked from its faces, or from the 6 images
+	// themselves when it hasn't been cooked
+	std::wstring skyCube = GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\cubemap.dds");
+	if (GetFileAttributesW(skyCube.c_str()) != INVALID_FILE_ATTRIBUTES)
+	{
+		sky = std::make_shared<Sky>(
+			skyCube.c_str(),
+			instance.GetMesh("cube"),
+			instance.GetVertexShader("SkyVS"),
+			instance.GetPixelShader("SkyPS"),
+			samplerOptions,
+			device,
+			context);
+	}
+	else
+	{
+		sky = std::make_shared<Sky>(
+			GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\right.png").c_str(),
+			GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\left.png").c_str(),
+			GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\up.png").c_str(),
+			GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\down.png").c_str(),
+			GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\front.png").c_str(),
+			GetFullPathTo_Wide(L"..\\..\\Assets\\Skies\\Clouds Blue\\back.png").c_str(),
+			instance.GetMesh("cube"),
+			instance.GetVertexShader("SkyVS"),
+			instance.GetPixelShader("SkyPS"),
+			samplerOptions,
+			device,
+			context);
+	}
+
+	// Roughness and metal come from one packed map when it has been cooked, which
+	// saves a texture fetch per pixel and adds AO
+	auto addSurfaceMaps = [&](std::shared_ptr<Material> material, std::string prefix) {
+		TextureHandle packed = instance.GetTextureHandle(prefix + "_rma");
+		std::shared_ptr<SimplePixelShader> packedPS = instance.GetPixelShaderPermutation("PixelShaderPBR", SHADER_DEFAULT_FEATURES | SHADER_PACKED_RMA);
+		if (packed.IsValid() && packedPS)
+		{
+			material->SetPixelShader(packedPS);
+			material->AddTextureSRV("RoughMetalAOMap", packed);
+			return;
+		}
+		material->AddTextureSRV("RoughnessMap", instance.GetTextureHandle(prefix + "_roughness"));
+		material->AddTextureSRV("MetalMap", instance.GetTextureHandle(prefix + "_metal"));
+	};
 
 	// Create PBR materials
 	std::shared_ptr<Material> cobbleMat2xPBR = std::make_shared<Material>(instance.GetPixelShader("PixelShaderPBR"), instance.GetVertexShader("VertexShader"), "Cobble2x PBR", XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
 	cobbleMat2xPBR->AddSampler("BasicSampler", samplerOptions);
 	cobbleMat2xPBR->AddSampler("ClampSampler", clampSamplerOptions);
-	cobbleMat2xPBR->AddTextureSRV("Albedo", instance.GetTexture("cobblestone_albedo"));
-	cobbleMat2xPBR->AddTextureSRV("NormalMap", instance.GetTexture("cobblestone_normals"));
-	cobbleMat2xPBR->AddTextureSRV("RoughnessMap", instance.GetTexture("cobblestone_roughness"));
-	cobbleMat2xPBR->AddTextureSRV("MetalMap", instance.GetTexture("cobblestone_metal"));
+	cobbleMat2xPBR->AddTextureSRV("Albedo", instance.GetTextureHandle("cobblestone_albedo"));
+	cobbleMat2xPBR->AddTextureSRV("NormalMap", instance.GetTextureHandle("cobblestone_normals"));
+	addSurfaceMaps(cobbleMat2xPBR, "cobblestone");
 	materials.push_back(cobbleMat2xPBR);
 
 	std::shared_ptr<Material> cobbleMat4xPBR = std::make_shared<Material>(instance.GetPixelShader("RefractionPS"), instance.GetVertexShader("VertexShader"), true, 0.3f, "Cobble4x PBR", XMFLOAT3(1, 1, 1), XMFLOAT2(4, 4));
 	cobbleMat4xPBR->AddSampler("BasicSampler", samplerOptions);
 	cobbleMat4xPBR->AddSampler("ClampSampler", clampSamplerOptions);
-	cobbleMat4xPBR->AddTextureSRV("Albedo", instance.GetTexture("cobblestone_albedo"));
-	cobbleMat4xPBR->AddTextureSRV("NormalMap", instance.GetTexture("cobblestone_normals"));
-	cobbleMat4xPBR->AddTextureSRV("RoughnessMap", instance.GetTexture("cobblestone_roughness"));
-	cobbleMat4xPBR->AddTextureSRV("MetalMap", instance.GetTexture("cobblestone_metal"));
+	cobbleMat4xPBR->AddTextureSRV("Albedo", instance.GetTextureHandle("cobblestone_albedo"));
+	cobbleMat4xPBR->AddTextureSRV("NormalMap", instance.GetTextureHandle("cobblestone_normals"));
+	cobbleMat4xPBR->AddTextureSRV("RoughnessMap", instance.GetTextureHandle("cobblestone_roughness"));
+	cobbleMat4xPBR->AddTextureSRV("MetalMap", instance.GetTextureHandle("cobblestone_metal"));
 	materials.push_back(cobbleMat4xPBR);
 
 	std::shared_ptr<Material> floorMatPBR = std::make_shared<Material>(instance.GetPixelShader("PixelShaderPBR"), instance.GetVertexShader("VertexShader"), "Floor PBR", XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
 	floorMatPBR->AddSampler("BasicSampler", samplerOptions);
 	floorMatPBR->AddSampler("ClampSampler", clampSamplerOptions);
-	floorMatPBR->AddTextureSRV("Albedo", instance.GetTexture("floor_albedo"));
-	floorMatPBR->AddTextureSRV("NormalMap", instance.GetTexture("floor_normals"));
-	floorMatPBR->AddTextureSRV("RoughnessMap", instance.GetTexture("floor_roughness"));
-	floorMatPBR->AddTextureSRV("MetalMap", instance.GetTexture("floor_metal"));
+	floorMatPBR->AddTextureSRV("Albedo", instance.GetTextureHandle("floor_albedo"));
+	floorMatPBR->AddTextureSRV("NormalMap", instance.GetTextureHandle("floor_normals"));
+	addSurfaceMaps(floorMatPBR, "floor");
 	materials.push_back(floorMatPBR);
 
 	std::shared_ptr<Material> paintMatPBR = std::make_shared<Material>(instance.GetPixelShader("PixelShaderPBR"), instance.GetVertexShader("VertexShader"), "Paint PBR", XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
 	paintMatPBR->AddSampler("BasicSampler", samplerOptions);
 	paintMatPBR->AddSampler("ClampSampler", clampSamplerOptions);
-	paintMatPBR->AddTextureSRV("Albedo", instance.GetTexture("paint_albedo"));
-	paintMatPBR->AddTextureSRV("NormalMap", instance.GetTexture("floor_normals"));
-	paintMatPBR->AddTextureSRV("RoughnessMap", instance.GetTexture("floor_roughness"));
-	paintMatPBR->AddTextureSRV("MetalMap", instance.GetTexture("floor_metal"));
+	paintMatPBR->AddTextureSRV("Albedo", instance.GetTextureHandle("paint_albedo"));
+	paintMatPBR->AddTextureSRV("NormalMap", instance.GetTextureHandle("floor_normals"));
+	addSurfaceMaps(paintMatPBR, "floor");
 	materials.push_back(paintMatPBR);
 
 	std::shared_ptr<Material> scratchedMatPBR = std::make_shared<Material>(instance.GetPixelShader("RefractionPS"), instance.GetVertexShader("VertexShader"), true, 1.8f, "Scratched PBR", XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
 	scratchedMatPBR->AddSampler("BasicSampler", samplerOptions);
 	scratchedMatPBR->AddSampler("ClampSampler", clampSamplerOptions);
-	scratchedMatPBR->AddTextureSRV("Albedo", instance.GetTexture("scratched_albedo"));
-	scratchedMatPBR->AddTextureSRV("NormalMap", instance.GetTexture("scratched_normals"));
-	scratchedMatPBR->AddTextureSRV("RoughnessMap", instance.GetTexture("scratched_roughness"));
-	scratchedMatPBR->AddTextureSRV("MetalMap", instance.GetTexture("scratched_metal"));
+	scratchedMatPBR->AddTextureSRV("Albedo", instance.GetTextureHandle("scratched_albedo"));
+	scratchedMatPBR->AddTextureSRV("NormalMap", instance.GetTextureHandle("scratched_normals"));
+	scratchedMatPBR->AddTextureSRV("RoughnessMap", instance.GetTextureHandle("scratched_roughness"));
+	scratchedMatPBR->AddTextureSRV("MetalMap", instance.GetTextureHandle("scratched_metal"));
 	materials.push_back(scratchedMatPBR);
 
 	std::shared_ptr<Material> bronzeMatPBR = std::make_shared<Material>(instance.GetPixelShader("PixelShaderPBR"), instance.GetVertexShader("VertexShader"), "Bronze PBR", XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
 	bronzeMatPBR->AddSampler("BasicSampler", samplerOptions);
 	bronzeMatPBR->AddSampler("ClampSampler", clampSamplerOptions);
-	bronzeMatPBR->AddTextureSRV("Albedo", instance.GetTexture("bronze_albedo"));
-	bronzeMatPBR->AddTextureSRV("NormalMap", instance.GetTexture("bronze_normals"));
-	bronzeMatPBR->AddTextureSRV("RoughnessMap", instance.GetTexture("bronze_roughness"));
-	bronzeMatPBR->AddTextureSRV("MetalMap", instance.GetTexture("bronze_metal"));
+	bronzeMatPBR->AddTextureSRV("Albedo", instance.GetTextureHandle("bronze_albedo"));
+	bronzeMatPBR->AddTextureSRV("NormalMap", instance.GetTextureHandle("bronze_normals"));
+	addSurfaceMaps(bronzeMatPBR, "bronze");
 	materials.push_back(bronzeMatPBR);
 
 	std::shared_ptr<Material> roughMatPBR = std::make_shared<Material>(instance.GetPixelShader("PixelShaderPBR"), instance.GetVertexShader("VertexShader"), "Rough PBR", XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
 	roughMatPBR->AddSampler("BasicSampler", samplerOptions);
 	roughMatPBR->AddSampler("ClampSampler", clampSamplerOptions);
-	roughMatPBR->AddTextureSRV("Albedo", instance.GetTexture("rough_albedo"));
-	roughMatPBR->AddTextureSRV("NormalMap", instance.GetTexture("rough_normals"));
-	roughMatPBR->AddTextureSRV("RoughnessMap", instance.GetTexture("rough_roughness"));
-	roughMatPBR->AddTextureSRV("MetalMap", instance.GetTexture("rough_metal"));
+	roughMatPBR->AddTextureSRV("Albedo", instance.GetTextureHandle("rough_albedo"));
+	roughMatPBR->AddTextureSRV("NormalMap", instance.GetTextureHandle("rough_normals"));
+	addSurfaceMaps(roughMatPBR, "rough");
 	materials.push_back(roughMatPBR);
 
 	std::shared_ptr<Material> woodMatPBR = std::make_shared<Material>(instance.GetPixelShader("PixelShaderPBR"), instance.GetVertexShader("VertexShader"), "Wood PBR", XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
 	woodMatPBR->AddSampler("BasicSampler", samplerOptions);
 	woodMatPBR->AddSampler("ClampSampler", clampSamplerOptions);
-	woodMatPBR->AddTextureSRV("Albedo", instance.GetTexture("wood_albedo"));
-	woodMatPBR->AddTextureSRV("NormalMap", instance.GetTexture("wood_normals"));
-	woodMatPBR->AddTextureSRV("RoughnessMap", instance.GetTexture("wood_roughness"));
-	woodMatPBR->AddTextureSRV("MetalMap", instance.GetTexture("wood_metal"));
+	woodMatPBR->AddTextureSRV("Albedo", instance.GetTextureHandle("wood_albedo"));
+	woodMatPBR->AddTextureSRV("NormalMap", instance.GetTextureHandle("wood_normals"));
+	addSurfaceMaps(woodMatPBR, "wood");
 	materials.push_back(woodMatPBR);
 	
 	std::shared_ptr<Material> IBLTestMat1 = std::make_shared<Material>(instance.GetPixelShader("PixelShaderPBR"), instance.GetVertexShader("VertexShader"), "Test PBR", XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
 	IBLTestMat1->AddSampler("BasicSampler", samplerOptions);
 	IBLTestMat1->AddSampler("ClampSampler", clampSamplerOptions);
-	IBLTestMat1->AddTextureSRV("Albedo", instance.GetTexture("white_albedo"));
-	IBLTestMat1->AddTextureSRV("NormalMap", instance.GetTexture("scratched_normals"));
-	IBLTestMat1->AddTextureSRV("RoughnessMap", instance.GetTexture("white_smooth"));
-	IBLTestMat1->AddTextureSRV("MetalMap", instance.GetTexture("paint_metal"));
+	IBLTestMat1->AddTextureSRV("Albedo", instance.GetTextureHandle("white_albedo"));
+	IBLTestMat1->AddTextureSRV("NormalMap", instance.GetTextureHandle("scratched_normals"));
+	IBLTestMat1->AddTextureSRV("RoughnessMap", instance.GetTextureHandle("white_smooth"));
+	IBLTestMat1->AddTextureSRV("MetalMap", instance.GetTextureHandle("paint_metal"));
 	materials.push_back(IBLTestMat1); 
 	std::shared_ptr<Material> IBLTestMat2 = std::make_shared<Material>(instance.GetPixelShader("PixelShaderPBR"), instance.GetVertexShader("VertexShader"), "Test 2 PBR", XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
 	IBLTestMat2->AddSampler("BasicSampler", samplerOptions);
 	IBLTestMat2->AddSampler("ClampSampler", clampSamplerOptions);
-	IBLTestMat2->AddTextureSRV("Albedo", instance.GetTexture("white_albedo"));
-	IBLTestMat2->AddTextureSRV("NormalMap", instance.GetTexture("scratched_normals"));
-	IBLTestMat2->AddTextureSRV("RoughnessMap", instance.GetTexture("white_matte"));
-	IBLTestMat2->AddTextureSRV("MetalMap", instance.GetTexture("paint_metal"));
+	IBLTestMat2->AddTextureSRV("Albedo", instance.GetTextureHandle("white_albedo"));
+	IBLTestMat2->AddTextureSRV("NormalMap", instance.GetTextureHandle("scratched_normals"));
+	IBLTestMat2->AddTextureSRV("RoughnessMap", instance.GetTextureHandle("white_matte"));
+	IBLTestMat2->AddTextureSRV("MetalMap", instance.GetTextureHandle("paint_metal"));
 	materials.push_back(IBLTestMat2);
 	std::shared_ptr<Material> IBLTestMat3 = std::make_shared<Material>(instance.GetPixelShader("PixelShaderPBR"), instance.GetVertexShader("VertexShader"), "Test 3 PBR", XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
 	IBLTestMat3->AddSampler("BasicSampler", samplerOptions);
 	IBLTestMat3->AddSampler("ClampSampler", clampSamplerOptions);
-	IBLTestMat3->AddTextureSRV("Albedo", instance.GetTexture("white_albedo"));
-	IBLTestMat3->AddTextureSRV("NormalMap", instance.GetTexture("scratched_normals"));
-	IBLTestMat3->AddTextureSRV("RoughnessMap", instance.GetTexture("white_rough"));
-	IBLTestMat3->AddTextureSRV("MetalMap", instance.GetTexture("paint_metal"));
+	IBLTestMat3->AddTextureSRV("Albedo", instance.GetTextureHandle("white_albedo"));
+	IBLTestMat3->AddTextureSRV("NormalMap", instance.GetTextureHandle("scratched_normals"));
+	IBLTestMat3->AddTextureSRV("RoughnessMap", instance.GetTextureHandle("white_rough"));
+	IBLTestMat3->AddTextureSRV("MetalMap", instance.GetTextureHandle("paint_metal"));
 	materials.push_back(IBLTestMat3);
 	std::shared_ptr<Material> IBLTestMat4 = std::make_shared<Material>(instance.GetPixelShader("PixelShaderPBR"), instance.GetVertexShader("VertexShader"), "Test 4 PBR", XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
 	IBLTestMat4->AddSampler("BasicSampler", samplerOptions);
 	IBLTestMat4->AddSampler("ClampSampler", clampSamplerOptions);
-	IBLTestMat4->AddTextureSRV("Albedo", instance.GetTexture("white_albedo"));
-	IBLTestMat4->AddTextureSRV("NormalMap", instance.GetTexture("scratched_normals"));
-	IBLTestMat4->AddTextureSRV("RoughnessMap", instance.GetTexture("white_smooth"));
-	IBLTestMat4->AddTextureSRV("MetalMap", instance.GetTexture("bronze_metal"));
+	IBLTestMat4->AddTextureSRV("Albedo", instance.GetTextureHandle("white_albedo"));
+	IBLTestMat4->AddTextureSRV("NormalMap", instance.GetTextureHandle("scratched_normals"));
+	IBLTestMat4->AddTextureSRV("RoughnessMap", instance.GetTextureHandle("white_smooth"));
+	IBLTestMat4->AddTextureSRV("MetalMap", instance.GetTextureHandle("bronze_metal"));
 	materials.push_back(IBLTestMat4);
 	std::shared_ptr<Material> IBLTestMat5 = std::make_shared<Material>(instance.GetPixelShader("PixelShaderPBR"), instance.GetVertexShader("VertexShader"), "Test 5 PBR", XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
 	IBLTestMat5->AddSampler("BasicSampler", samplerOptions);
 	IBLTestMat5->AddSampler("ClampSampler", clampSamplerOptions);
-	IBLTestMat5->AddTextureSRV("Albedo", instance.GetTexture("white_albedo"));
-	IBLTestMat5->AddTextureSRV("NormalMap", instance.GetTexture("scratched_normals"));
-	IBLTestMat5->AddTextureSRV("RoughnessMap", instance.GetTexture("white_matte"));
-	IBLTestMat5->AddTextureSRV("MetalMap", instance.GetTexture("bronze_metal"));
+	IBLTestMat5->AddTextureSRV("Albedo", instance.GetTextureHandle("white_albedo"));
+	IBLTestMat5->AddTextureSRV("NormalMap", instance.GetTextureHandle("scratched_normals"));
+	IBLTestMat5->AddTextureSRV("RoughnessMap", instance.GetTextureHandle("white_matte"));
+	IBLTestMat5->AddTextureSRV("MetalMap", instance.GetTextureHandle("bronze_metal"));
 	materials.push_back(IBLTestMat5);
 	std::shared_ptr<Material> IBLTestMat6 = std::make_shared<Material>(instance.GetPixelShader("PixelShaderPBR"), instance.GetVertexShader("VertexShader"), "Test 6 PBR", XMFLOAT3(1, 1, 1), XMFLOAT2(2, 2));
 	IBLTestMat6->AddSampler("BasicSampler", samplerOptions);
 	IBLTestMat6->AddSampler("ClampSampler", clampSamplerOptions);
-	IBLTestMat6->AddTextureSRV("Albedo", instance.GetTexture("white_albedo"));
-	IBLTestMat6->AddTextureSRV("NormalMap", instance.GetTexture("scratched_normals"));
-	IBLTestMat6->AddTextureSRV("RoughnessMap", instance.GetTexture("white_rough"));
-	IBLTestMat6->AddTextureSRV("MetalMap", instance.GetTexture("bronze_metal"));
+	IBLTestMat6->AddTextureSRV("Albedo", instance.GetTextureHandle("white_albedo"));
+	IBLTestMat6->AddTextureSRV("NormalMap", instance.GetTextureHandle("scratched_normals"));
+	IBLTestMat6->AddTextureSRV("RoughnessMap", instance.GetTextureHandle("white_rough"));
+	IBLTestMat6->AddTextureSRV("MetalMap", instance.GetTextureHandle("bronze_metal"));
 	materials.push_back(IBLTestMat6);
 
 
@@ -352,11 +380,15 @@ void Game::LoadAssetsAndCreateEntities()
 	testEmitter2->SetScale(XMFLOAT2(0.05f, 0.05f), XMFLOAT2(0.1f, 0.1f));
 	testEmitter2->SetVelocityRange(XMFLOAT3(.5f, .5f, 0));
 	testEmitter2->GetTransform()->MoveAbsolute(2.5f, -5, 0);
+	testEmitter2->EnableGPUSimulation(instance.GetComputeShader("ParticleInitDeadListCS"), instance.GetComputeShader("ParticleEmitCS"),
+		instance.GetComputeShader("ParticleUpdateCS"), instance.GetComputeShader("ParticleDrawArgsCS"));
 
 	std::shared_ptr<Emitter> testEmitter3 = std::make_shared<Emitter>(50, 3, 2.5f, context, device, instance.GetTexture("smoke_01"), instance.GetVertexShader("ParticleVS"), instance.GetPixelShader("ParticlePS"));
 	testEmitter3->SetColor(XMFLOAT4(0.0f, 1.0f, 0.0f, 1.0f), XMFLOAT4(0, 0.0f, 0, 1.0f));
 	testEmitter3->SetScale(XMFLOAT2(0.1f, 0.1f), XMFLOAT2(3.0f, 3.0f));
 	testEmitter3->GetTransform()->MoveAbsolute(-2.5f, -5, 0);
+	testEmitter3->SetAlphaBlended(true);
+	testEmitter3->SetSortParticles(true);
 
 	emitter.push_back(testEmitter);
 	emitter.push_back(testEmitter2);
@@ -370,46 +402,14 @@ void Game::LoadAssetsAndCreateEntities()
 // --------------------------------------------------------
 void Game::GenerateLights()
 {
-	// Reset
+	// Reset, then the same setup the benchmarks use, with the
+	// point lights spread around the middle of the scene
 	lights.clear();
+	GenerateSceneLights(lights, (unsigned int)max(lightCount, 3), 10.0f);
 
-	// Setup directional lights
-	Light dir1 = {};
-	dir1.Type = LIGHT_TYPE_DIRECTIONAL;
-	dir1.Direction = XMFLOAT3(1, -1, 1);
-	dir1.Color = XMFLOAT3(0.8f, 0.8f, 0.8f);
-	dir1.Intensity = 1.0f;
-
-	Light dir2 = {};
-	dir2.Type = LIGHT_TYPE_DIRECTIONAL;
-	dir2.Direction = XMFLOAT3(-1, -0.25f, 0);
-	dir2.Color = XMFLOAT3(0.2f, 0.2f, 0.2f);
-	dir2.Intensity = 1.0f;
-
-	Light dir3 = {};
-	dir3.Type = LIGHT_TYPE_DIRECTIONAL;
-	dir3.Direction = XMFLOAT3(0, -1, 1);
-	dir3.Color = XMFLOAT3(0.2f, 0.2f, 0.2f);
-	dir3.Intensity = 1.0f;
-
-	// Add light to the list
-	lights.push_back(dir1);
-	lights.push_back(dir2);
-	lights.push_back(dir3);
-
-	// Create the rest of the lights
-	while (lights.size() < lightCount)
-	{
-		Light point = {};
-		point.Type = LIGHT_TYPE_POINT;
-		point.Position = XMFLOAT3(RandomRange(-10.0f, 10.0f), RandomRange(-5.0f, 5.0f), RandomRange(-10.0f, 10.0f));
-		point.Color = XMFLOAT3(RandomRange(0, 1), RandomRange(0, 1), RandomRange(0, 1));
-		point.Range = RandomRange(5.0f, 10.0f);
-		point.Intensity = RandomRange(0.1f, 3.0f);
-
-		// Add to the list
-		lights.push_back(point);
-	}
+	// The renderer only re-uploads lights it's told have changed
+	if (DXRenderer)
+		DXRenderer->MarkAllLightsDirty();
 
 }
 
@@ -432,14 +432,55 @@ void Game::OnResize()
 		camera->UpdateProjectionMatrix(this->width / (float)this->height);
 }
 
+// --------------------------------------------------------
+// Tells texture streaming how much detail each visible
+// entity's textures need, from its size on screen
+// --------------------------------------------------------
+void Game::RequestTextureDetail()
+{
+	Assets& assets = Assets::GetInstance();
+	XMFLOAT4X4 view = camera->GetView();
+	XMFLOAT4X4 proj = camera->GetProjection();
+	XMMATRIX viewMatrix = XMLoadFloat4x4(&view);
+
+	for (auto& e : entities)
+	{
+		Transform* transform = e->GetTransform();
+		XMFLOAT3 position = transform->GetPosition();
+		XMFLOAT3 scale = transform->GetScale();
+		float radius = e->GetMesh()->GetBoundingRadius() * max(fabsf(scale.x), max(fabsf(scale.y), fabsf(scale.z)));
+
+		// Skip anything entirely behind the camera
+		XMFLOAT3 viewPosition;
+		XMStoreFloat3(&viewPosition, XMVector3TransformCoord(XMLoadFloat3(&position), viewMatrix));
+		if (viewPosition.z + radius < 0)
+			continue;
+
+		// Projected diameter in pixels, clamping the distance so nearby objects don't blow up
+		float distance = max(XMVectorGetX(XMVector3Length(XMLoadFloat3(&viewPosition))), 0.1f);
+		float screenPixels = radius * proj._22 / distance * this->height;
+
+		std::shared_ptr<Material> material = e->GetMaterial();
+		XMFLOAT2 uvScale = material->GetUVScale();
+		for (auto& t : material->GetTextureHandles())
+			assets.RequestTextureDetail(t.second, screenPixels, max(uvScale.x, uvScale.y));
+	}
+}
+
 // --------------------------------------------------------
 // Update your game here - user input, move objects, AI, etc.
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
+	Profiler::BeginFrame();
+	PROFILE_SCOPE("Game::Update");
+
 	// Update the camera
 	camera->Update(deltaTime);
 
+	RequestTextureDetail();
+	Assets::GetInstance().Update(deltaTime);
+
 	entities[0]->GetTransform()->Rotate(0, deltaTime, 0);
 	entities[3]->GetTransform()->Rotate(0, deltaTime, 0);
 	if (entities[1]->GetTransform()->GetPosition().x > 5 && entityDirection == 1)
@@ -483,6 +524,8 @@ void Game::Update(float deltaTime, float totalTime)
 
 	for (auto e : emitter)
 	{
+		PROFILE_SCOPE("Emitter Update");
+		e->UpdateLOD(camera);
 		e->Update(deltaTime);
 	}
 }
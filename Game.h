@@ -56,6 +56,7 @@ private:
 
 	// General helpers for setup and drawing
 	void GenerateLights();
+	void RequestTextureDetail();
 
 	// Initialization helper method
 	void LoadAssetsAndCreateEntities();
@@ -0,0 +1,135 @@
+#include "GpuProfiler.h"
+
+using namespace std;
+
+GpuProfiler::GpuProfiler(Microsoft::WRL::ComPtr<ID3D11Device> Device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> Context)
+	:
+	device(Device),
+	context(Context),
+	frameIndex(0),
+	inFrame(false),
+	lastFrameMs(0)
+{
+	D3D11_QUERY_DESC disjointDesc = {};
+	disjointDesc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+	D3D11_QUERY_DESC timestampDesc = {};
+	timestampDesc.Query = D3D11_QUERY_TIMESTAMP;
+
+	for (auto& frame : frames)
+	{
+		device->CreateQuery(&disjointDesc, frame.Disjoint.GetAddressOf());
+		device->CreateQuery(&timestampDesc, frame.Begin.GetAddressOf());
+		device->CreateQuery(&timestampDesc, frame.End.GetAddressOf());
+		for (auto& pass : frame.Passes)
+		{
+			device->CreateQuery(&timestampDesc, pass.Begin.GetAddressOf());
+			device->CreateQuery(&timestampDesc, pass.End.GetAddressOf());
+		}
+		frame.PassCount = 0;
+		frame.CpuStartNs = 0;
+		frame.Pending = false;
+	}
+}
+
+void GpuProfiler::BeginFrame()
+{
+	Frame& frame = frames[frameIndex];
+
+	//Still not done after every other frame in flight, so it's dropped rather than waited on
+	frame.Pending = false;
+
+	context->Begin(frame.Disjoint.Get());
+	context->End(frame.Begin.Get());
+	frame.CpuStartNs = Profiler::Now();
+	frame.PassCount = 0;
+	openPasses.clear();
+	inFrame = true;
+}
+
+void GpuProfiler::EndFrame()
+{
+	if (!inFrame)
+		return;
+
+	Frame& frame = frames[frameIndex];
+	context->End(frame.End.Get());
+	context->End(frame.Disjoint.Get());
+	frame.Pending = true;
+	inFrame = false;
+	frameIndex = (frameIndex + 1) % FrameLatency;
+
+	//Oldest first, stopping at the first frame the GPU hasn't finished
+	for (unsigned int i = 0; i < FrameLatency; i++)
+	{
+		Frame& older = frames[(frameIndex + i) % FrameLatency];
+		if (older.Pending && !ReadBack(older))
+			break;
+	}
+}
+
+void GpuProfiler::BeginPass(const char* name)
+{
+	Frame& frame = frames[frameIndex];
+	if (!inFrame || frame.PassCount >= MaxPasses)
+	{
+		openPasses.push_back(MaxPasses);
+		return;
+	}
+
+	Pass& pass = frame.Passes[frame.PassCount];
+	pass.Name = name;
+	pass.Depth = (unsigned int)openPasses.size();
+	context->End(pass.Begin.Get());
+	openPasses.push_back(frame.PassCount++);
+}
+
+void GpuProfiler::EndPass()
+{
+	if (openPasses.empty())
+		return;
+
+	unsigned int index = openPasses.back();
+	openPasses.pop_back();
+	if (inFrame && index < MaxPasses)
+		context->End(frames[frameIndex].Passes[index].End.Get());
+}
+
+bool GpuProfiler::ReadBack(Frame& frame)
+{
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+	if (context->GetData(frame.Disjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		return false;
+
+	frame.Pending = false;
+
+	//The clock changed mid frame (power state, etc.), so its timestamps mean nothing
+	if (disjoint.Disjoint || disjoint.Frequency == 0)
+		return true;
+
+	UINT64 frameBegin;
+	UINT64 frameEnd;
+	if (context->GetData(frame.Begin.Get(), &frameBegin, sizeof(frameBegin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+		context->GetData(frame.End.Get(), &frameEnd, sizeof(frameEnd), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		return true;
+
+	auto toNs = [&](UINT64 ticks) { return frame.CpuStartNs + (uint64_t)((double)(ticks - frameBegin) * 1e9 / (double)disjoint.Frequency); };
+	auto toMs = [&](UINT64 ticks) { return (float)((double)ticks * 1000.0 / (double)disjoint.Frequency); };
+
+	Profiler::Record("GPU Frame", toNs(frameBegin), toNs(frameEnd), 0, PROFILE_TRACK_GPU);
+	lastFrameMs = toMs(frameEnd - frameBegin);
+	lastFrameTimes.clear();
+
+	for (unsigned int i = 0; i < frame.PassCount; i++)
+	{
+		Pass& pass = frame.Passes[i];
+		UINT64 passBegin;
+		UINT64 passEnd;
+		if (context->GetData(pass.Begin.Get(), &passBegin, sizeof(passBegin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			context->GetData(pass.End.Get(), &passEnd, sizeof(passEnd), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			continue;
+
+		Profiler::Record(pass.Name, toNs(passBegin), toNs(passEnd), (uint16_t)(pass.Depth + 1), PROFILE_TRACK_GPU);
+		lastFrameTimes.push_back({ pass.Name, toMs(passEnd - passBegin) });
+	}
+	return true;
+}
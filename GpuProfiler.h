@@ -0,0 +1,82 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Profiler.h"
+
+// Times render passes with timestamp queries, inside a disjoint query per frame.
+// Results are read a few frames later without waiting on the GPU, then added to
+// the Profiler's GPU track lined up with the CPU time their frame started.
+class GpuProfiler
+{
+public:
+	GpuProfiler(Microsoft::WRL::ComPtr<ID3D11Device> Device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> Context);
+
+	void BeginFrame();
+	void EndFrame();
+
+	// Passes nest like CPU scopes.  Names must be string literals.
+	void BeginPass(const char* name);
+	void EndPass();
+
+	// Pass times in milliseconds from the most recent frame that finished on the GPU
+	const std::vector<std::pair<const char*, float>>& GetLastFrameTimes() { return lastFrameTimes; }
+	float GetLastFrameMs() { return lastFrameMs; }
+
+	// Frames in flight before results are read back, and passes timed per frame
+	static const unsigned int FrameLatency = 4;
+	static const unsigned int MaxPasses = 32;
+
+private:
+	struct Pass
+	{
+		const char* Name;
+		unsigned int Depth;
+		Microsoft::WRL::ComPtr<ID3D11Query> Begin;
+		Microsoft::WRL::ComPtr<ID3D11Query> End;
+	};
+
+	struct Frame
+	{
+		Microsoft::WRL::ComPtr<ID3D11Query> Disjoint;
+		Microsoft::WRL::ComPtr<ID3D11Query> Begin;
+		Microsoft::WRL::ComPtr<ID3D11Query> End;
+		Pass Passes[MaxPasses];
+		unsigned int PassCount;
+		uint64_t CpuStartNs;
+		bool Pending;
+	};
+
+	// False while the GPU is still working on the frame
+	bool ReadBack(Frame& frame);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Frame frames[FrameLatency];
+	unsigned int frameIndex;
+	bool inFrame;
+	std::vector<unsigned int> openPasses;
+
+	std::vector<std::pair<const char*, float>> lastFrameTimes;
+	float lastFrameMs;
+};
+
+// Times a pass on both the CPU and the GPU
+class GpuProfileScope
+{
+public:
+	GpuProfileScope(GpuProfiler* Profiler, const char* Name) : cpuScope(Name), profiler(Profiler) { profiler->BeginPass(Name); }
+	~GpuProfileScope() { profiler->EndPass(); }
+
+	GpuProfileScope(GpuProfileScope const&) = delete;
+	void operator=(GpuProfileScope const&) = delete;
+
+private:
+	ProfileScope cpuScope;
+	GpuProfiler* profiler;
+};
+
+#define PROFILE_GPU_SCOPE(profiler, name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(profiler, name)
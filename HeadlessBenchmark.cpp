@@ -0,0 +1,255 @@
+#include "HeadlessBenchmark.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace DirectX;
+
+// Same as Camera's defaults
+static const float nearClip = 0.01f;
+static const float farClip = 100.0f;
+static const float fieldOfView = XM_PI / 4.0f;
+
+// sphere.obj is a unit sphere
+static const float entityRadius = 1.0f;
+
+HeadlessBenchmark::HeadlessBenchmark(BenchmarkOptions Options)
+	:
+	options(Options),
+	projectionX(1),
+	projectionY(1),
+	sorter(&jobs),
+	lightClusters(&jobs),
+	shadowCasters(0)
+{
+}
+
+int HeadlessBenchmark::Run()
+{
+	Profiler::SetThreadName("Main");
+	srand(options.Seed);
+
+	if (!options.AssetPath.empty())
+		watcher = make_unique<DirectoryWatcher>(options.AssetPath);
+
+	BuildScene();
+
+	// Out a little past the grid, which is 10 units inside the camera orbit
+	GenerateSceneLights(lights, options.Lights, layout.Radius - 5.0f);
+
+	projectionY = 1.0f / tanf(fieldOfView * 0.5f);
+	projectionX = projectionY * options.Height / (float)options.Width;
+
+	report.AddParameter("entities", options.Entities);
+	report.AddParameter("emitters", options.Emitters);
+	report.AddParameter("lights", (double)lights.size());
+	report.AddParameter("width", options.Width);
+	report.AddParameter("height", options.Height);
+	report.AddParameter("warmup", options.WarmupFrames);
+	report.AddParameter("seed", options.Seed);
+	report.AddParameter("device", BenchmarkOptions::GetDeviceName(BENCHMARK_DEVICE_NONE));
+	report.AddParameter("threads", jobs.GetThreadCount());
+
+	const float deltaTime = 1.0f / 60.0f;
+	float totalTime = 0;
+	vector<ProfileEvent> events;
+	Profiler::BeginFrame();
+	for (unsigned int frame = 0; frame < options.WarmupFrames + options.Frames; frame++)
+	{
+		uint64_t start = Profiler::Now();
+
+		//The game's asset thread looks for changes about once a second
+		if (watcher && frame % 60 == 0)
+			UpdateAssets();
+		Update(deltaTime, totalTime);
+		Render();
+		uint64_t end = Profiler::Now();
+
+		//Closes this frame, so it's the one CollectLastFrame returns
+		Profiler::BeginFrame();
+		if (frame >= options.WarmupFrames)
+		{
+			events.clear();
+			Profiler::CollectLastFrame(events);
+			report.AddFrame(end - start, events);
+		}
+		totalTime += deltaTime;
+	}
+
+	BenchmarkStats stats = report.GetFrameStats();
+	printf("Headless benchmark: %u frames, %u entities, %u emitters, %u lights, %u shadow casters in the last frame\n",
+		report.GetFrameCount(), options.Entities, options.Emitters, (unsigned int)lights.size(), shadowCasters);
+	if (watcher)
+		printf("Assets: %u meshes, %u textures\n", (unsigned int)assetIndex.GetAssetCount(ASSET_MESH), (unsigned int)assetIndex.GetAssetCount(ASSET_TEXTURE));
+	printf("Frame ms: mean %.3f  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n", stats.Mean, stats.P50, stats.P95, stats.P99, stats.Max);
+
+	if (!report.WriteJson(options.Output))
+	{
+		fprintf(stderr, "Headless benchmark: couldn't write %s\n", options.Output.c_str());
+		return 2;
+	}
+
+	if (options.BudgetMs > 0 && stats.P95 > options.BudgetMs)
+	{
+		printf("Over budget: p95 %.3f ms > %.3f ms\n", stats.P95, options.BudgetMs);
+		return 1;
+	}
+	return 0;
+}
+
+void HeadlessBenchmark::BuildScene()
+{
+	LayOutScene(options.Entities, options.Emitters, layout);
+	entityPositions = layout.EntityStarts;
+
+	for (const SceneEmitter& placed : layout.Emitters)
+	{
+		HeadlessEmitter emitter;
+		emitter.Placed = placed;
+		emitter.TimeSinceLastEmit = 0;
+		emitter.EmitSeed = 0;
+
+		ParticleSimulationConstants constants = {};
+		constants.MaxParticles = placed.MaxParticles;
+		constants.Lifetime = placed.Lifetime;
+		emitter.Simulation = make_unique<ParticleSimulationReference>(constants);
+		emitter.Depths.resize(placed.MaxParticles);
+		emitter.SortedIndices.resize(placed.MaxParticles);
+		emitters.push_back(move(emitter));
+	}
+}
+
+// --------------------------------------------------------
+// Game::Update's work, with the camera orbiting instead of
+// following input
+// --------------------------------------------------------
+void HeadlessBenchmark::Update(float deltaTime, float totalTime)
+{
+	PROFILE_SCOPE("Game::Update");
+
+	XMFLOAT3 position;
+	float pitch;
+	float yaw;
+	GetSceneCamera(layout, totalTime, position, pitch, yaw);
+	BuildViewMatrix(position, pitch, yaw, view);
+
+	//Spinning doesn't move the bounds, so only the bobbing ones change
+	for (size_t i = 0; i < entityPositions.size(); i++)
+		entityPositions[i] = GetSceneEntityPosition(layout, i, totalTime);
+
+	for (HeadlessEmitter& e : emitters)
+	{
+		PROFILE_SCOPE("Emitter Update");
+
+		//Emission counted the way Emitter::UpdateGPU does
+		unsigned int emitCount = 0;
+		float emissionInterval = 1.0f / e.Placed.ParticlesPerSecond;
+		e.TimeSinceLastEmit += deltaTime;
+		while (e.TimeSinceLastEmit > emissionInterval)
+		{
+			emitCount++;
+			e.TimeSinceLastEmit -= emissionInterval;
+		}
+		e.EmitSeed++;
+
+		ParticleSimulationConstants constants = {};
+		constants.EmitterPosition = e.Placed.Position;
+		constants.Lifetime = e.Placed.Lifetime;
+		constants.StartingVelocity = e.Placed.StartingVelocity;
+		constants.InvLifetime = 1.0f / e.Placed.Lifetime;
+		constants.VelocityRange = e.Placed.VelocityRange;
+		constants.DeltaTime = deltaTime;
+		constants.EmitCount = emitCount;
+		constants.EmitSeed = e.EmitSeed;
+		constants.MaxParticles = e.Placed.MaxParticles;
+		e.Simulation->Update(constants);
+		e.Simulation->Emit(constants);
+	}
+}
+
+// --------------------------------------------------------
+// The CPU side of Renderer::Render: shadow cascades and
+// caster culling, light clusters and particle sorting
+// --------------------------------------------------------
+void HeadlessBenchmark::Render()
+{
+	PROFILE_SCOPE("Render");
+
+	{
+		PROFILE_SCOPE("Shadow Maps");
+
+		//Only the first directional light casts shadows
+		const Light* shadowLight = 0;
+		for (size_t i = 0; i < lights.size() && !shadowLight; i++)
+		{
+			if (lights[i].Type == LIGHT_TYPE_DIRECTIONAL)
+				shadowLight = &lights[i];
+		}
+
+		shadowCasters = 0;
+		if (shadowLight)
+		{
+			shadowCascades.Fit(view, projectionX, projectionY, nearClip, farClip, shadowLight->Direction);
+			for (unsigned int c = 0; c < shadowCascades.GetCascadeCount(); c++)
+			{
+				for (const XMFLOAT3& position : entityPositions)
+					shadowCasters += shadowCascades.IsVisible(c, position, entityRadius);
+			}
+		}
+	}
+
+	{
+		PROFILE_SCOPE("Light Clusters");
+		lightClusters.Build(lights, view, projectionX, projectionY, nearClip, farClip);
+	}
+
+	//Sorted emitters order their live particles by view depth, with the same motion as ParticleVS
+	for (HeadlessEmitter& e : emitters)
+	{
+		if (!e.Placed.Sorted)
+			continue;
+
+		const vector<Particle>& particles = e.Simulation->GetParticles();
+		const vector<unsigned int>& drawList = e.Simulation->GetDrawList();
+		const XMFLOAT3& a = e.Placed.Acceleration;
+		float nearZ = FLT_MAX;
+		float farZ = -FLT_MAX;
+		for (size_t i = 0; i < drawList.size(); i++)
+		{
+			const Particle& p = particles[drawList[i]];
+			float t = p.Age;
+			float x = a.x * t * t / 2.0f + p.Velocity.x * t + p.Position.x;
+			float y = a.y * t * t / 2.0f + p.Velocity.y * t + p.Position.y;
+			float z = a.z * t * t / 2.0f + p.Velocity.z * t + p.Position.z;
+
+			float depth = x * view._13 + y * view._23 + z * view._33 + view._43;
+			e.Depths[i] = depth;
+			nearZ = min(nearZ, depth);
+			farZ = max(farZ, depth);
+		}
+
+		if (!drawList.empty())
+			sorter.SortBackToFront(e.Depths.data(), (unsigned int)drawList.size(), nearZ, farZ, e.SortedIndices.data());
+	}
+}
+
+// --------------------------------------------------------
+// What the game's asset thread does when it looks for
+// changes: rescan the folder and keep the index current
+// --------------------------------------------------------
+void HeadlessBenchmark::UpdateAssets()
+{
+	PROFILE_SCOPE("Assets::Update");
+
+	for (const FileChange& change : watcher->Poll())
+	{
+		if (change.Type == FileChange::REMOVED)
+			assetIndex.RemoveFile(change.Path);
+		else
+			assetIndex.AddFile(change.Path);
+	}
+}
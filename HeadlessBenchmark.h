@@ -0,0 +1,71 @@
+#pragma once
+#include <DirectXMath.h>
+#include <memory>
+#include <vector>
+
+#include "AssetIndex.h"
+#include "BenchmarkOptions.h"
+#include "BenchmarkReport.h"
+#include "DirectoryWatcher.h"
+#include "JobSystem.h"
+#include "LightClusters.h"
+#include "Lights.h"
+#include "ParticleSimulation.h"
+#include "ParticleSort.h"
+#include "SceneSetup.h"
+#include "ShadowCascades.h"
+
+// The benchmark's scene with no device at all, for machines without Windows or a GPU.
+// Each frame does the CPU side of what the game does: the camera orbits, entities move,
+// emitters simulate (with the reference the compute shaders are checked against), sorted
+// emitters sort on the job system, shadow cascades are fitted and casters culled, and the
+// lights are clustered.  With an asset folder it's also watched and indexed the way the
+// game's is.  Scopes are named like the game's, so its reports compare with the windowed
+// benchmark's on the CPU side.
+class HeadlessBenchmark
+{
+public:
+	HeadlessBenchmark(BenchmarkOptions Options);
+
+	// 0 when the run finished within budget, 1 when it was over, 2 when it couldn't run
+	int Run();
+
+private:
+	// One emitter's particles, simulated the way its GPU or CPU path would be
+	struct HeadlessEmitter
+	{
+		SceneEmitter Placed;
+		std::unique_ptr<ParticleSimulationReference> Simulation;
+		float TimeSinceLastEmit;
+		unsigned int EmitSeed;
+		std::vector<float> Depths;
+		std::vector<unsigned int> SortedIndices;
+	};
+
+	void BuildScene();
+	void Update(float deltaTime, float totalTime);
+	void Render();
+	void UpdateAssets();
+
+	BenchmarkOptions options;
+	BenchmarkReport report;
+	JobSystem jobs;
+
+	SceneLayout layout;
+	std::vector<DirectX::XMFLOAT3> entityPositions;
+	std::vector<HeadlessEmitter> emitters;
+	std::vector<Light> lights;
+
+	// The camera's view (row vectors) and projection scales, like Camera's matrices
+	DirectX::XMFLOAT4X4 view;
+	float projectionX;
+	float projectionY;
+
+	ParticleSorter sorter;
+	ShadowCascades shadowCascades;
+	LightClusters lightClusters;
+	unsigned int shadowCasters;
+
+	std::unique_ptr<DirectoryWatcher> watcher;
+	AssetIndex assetIndex;
+};
@@ -0,0 +1,18 @@
+#include <cstdio>
+#include "HeadlessBenchmark.h"
+
+// Entry point of the portable build's benchmark, which has no device to choose
+int main(int argc, char** argv)
+{
+	BenchmarkOptions options;
+	options.Device = BENCHMARK_DEVICE_NONE;
+	options.Output = "benchmark_headless.json";
+	if (!options.Parse(argc - 1, argv + 1) || options.Device != BENCHMARK_DEVICE_NONE)
+	{
+		fprintf(stderr, "Usage: %s %s", argv[0], BenchmarkOptions::GetUsage());
+		return 2;
+	}
+
+	HeadlessBenchmark benchmark(options);
+	return benchmark.Run();
+}
@@ -0,0 +1,62 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "IBLBaker.h"
+#include "JobSystem.h"
+
+// Entry point of the portable build's IBL baker.  The defaults are the sizes Sky
+// computes its own maps at, which it needs to load the baked ones.
+int main(int argc, char** argv)
+{
+	const char* usage = "<sky cubemap.dds> [--size 256] [--mips 6] [--lut 256] [--samples 4096]\n";
+	unsigned int size = 256;
+	unsigned int mipCount = 6;
+	unsigned int lookUpSize = 256;
+	unsigned int sampleCount = 4096;
+	std::string skyPath;
+
+	for (int i = 1; i < argc; i++)
+	{
+		unsigned int* value = 0;
+		if (strcmp(argv[i], "--size") == 0)
+			value = &size;
+		else if (strcmp(argv[i], "--mips") == 0)
+			value = &mipCount;
+		else if (strcmp(argv[i], "--lut") == 0)
+			value = &lookUpSize;
+		else if (strcmp(argv[i], "--samples") == 0)
+			value = &sampleCount;
+		else if (skyPath.empty() && argv[i][0] != '-')
+		{
+			skyPath = argv[i];
+			continue;
+		}
+
+		if (!value || i + 1 >= argc || atoi(argv[i + 1]) <= 0)
+		{
+			fprintf(stderr, "Usage: %s %s", argv[0], usage);
+			return 2;
+		}
+		*value = (unsigned int)atoi(argv[++i]);
+	}
+	if (skyPath.empty())
+	{
+		fprintf(stderr, "Usage: %s %s", argv[0], usage);
+		return 2;
+	}
+
+	JobSystem jobs;
+	IBLBaker baker(&jobs, sampleCount);
+	auto start = std::chrono::steady_clock::now();
+	if (!baker.BakeSky(skyPath, size, mipCount, lookUpSize))
+	{
+		fprintf(stderr, "Failed to bake %s, which must be an 8 bit RGBA or BC7 cube\n", skyPath.c_str());
+		return 1;
+	}
+
+	printf("Baked %s to %s in %.0f ms\n", skyPath.c_str(), IBLBaker::GetBakedPath(skyPath, "_*").c_str(),
+		std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	return 0;
+}
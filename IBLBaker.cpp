@@ -0,0 +1,405 @@
+#include "IBLBaker.h"
+#include "CubeFaces.h"
+#include "JobSystem.h"
+#include "SphericalHarmonics.h"
+#include "TextureCooker.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <future>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define IBL_BAKER_SSE
+#endif
+
+using namespace std;
+
+static const float pi = 3.14159265f;
+
+// ImportanceSampleGGX's half vector around +Z
+static void SampleGGX(float xiX, float xiY, float roughness, float* h)
+{
+	float a = roughness * roughness;
+	float phi = 2 * pi * xiX;
+	float cosTheta = sqrt((1 - xiY) / (1 + (a * a - 1) * xiY));
+	float sinTheta = sqrt(1 - cosTheta * cosTheta);
+	h[0] = sinTheta * cos(phi);
+	h[1] = sinTheta * sin(phi);
+	h[2] = cosTheta;
+}
+
+// G1_Schlick from IBLBrdfLookUpTablePS
+static float G1Schlick(float roughness, float nDotV)
+{
+	float k = roughness * roughness / 2.0f;
+	return nDotV / (nDotV * (1.0f - k) + k);
+}
+
+// The environment decoded to linear RGB, sampled bilinearly within a face
+struct LinearCube
+{
+	unsigned int Size;
+	vector<float> Texels;
+
+	void Sample(float x, float y, float z, float* color) const
+	{
+		float u, v;
+		unsigned int face = GetCubeFace(x, y, z, u, v);
+
+		//Texel centres, clamped at the face's edges
+		float maxTexel = (float)(Size - 1);
+		float s = min(max((u + 1.0f) * 0.5f * Size - 0.5f, 0.0f), maxTexel);
+		float t = min(max((v + 1.0f) * 0.5f * Size - 0.5f, 0.0f), maxTexel);
+		unsigned int x0 = (unsigned int)s, y0 = (unsigned int)t;
+		unsigned int x1 = min(x0 + 1, Size - 1), y1 = min(y0 + 1, Size - 1);
+		float fx = s - x0, fy = t - y0;
+
+		const float* base = Texels.data() + (size_t)face * Size * Size * 3;
+		const float* c00 = base + (y0 * Size + x0) * 3;
+		const float* c10 = base + (y0 * Size + x1) * 3;
+		const float* c01 = base + (y1 * Size + x0) * 3;
+		const float* c11 = base + (y1 * Size + x1) * 3;
+		for (int c = 0; c < 3; c++)
+		{
+			float top = c00[c] + (c10[c] - c00[c]) * fx;
+			float bottom = c01[c] + (c11[c] - c01[c]) * fx;
+			color[c] = top + (bottom - top) * fy;
+		}
+	}
+};
+
+IBLBaker::IBLBaker(JobSystem* Jobs, unsigned int SampleCount)
+	:
+	jobs(Jobs),
+	sampleCount(max(SampleCount, 1u))
+{
+}
+
+float IBLBaker::RadicalInverse(uint32_t bits)
+{
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return float(bits) * 2.3283064365386963e-10f;
+}
+
+void IBLBaker::ParallelRows(unsigned int count, std::function<void(unsigned int, unsigned int)> bake)
+{
+	unsigned int batchCount = jobs ? min(jobs->GetThreadCount() + 1, count) : 1;
+	vector<future<void>> running;
+	for (unsigned int b = 1; b < batchCount; b++)
+	{
+		unsigned int first = count * b / batchCount;
+		unsigned int end = count * (b + 1) / batchCount;
+		running.push_back(jobs->Submit([=]() { bake(first, end); }));
+	}
+	bake(0, count / max(batchCount, 1u));
+	for (auto& r : running)
+		r.get();
+}
+
+void IBLBaker::BakeBRDFLookUp(unsigned int size, DDSDescription& description, std::vector<uint8_t>& data)
+{
+	description = { 35, size, size, 1, 1, false };	// R16G16_UNORM
+	data.assign(DDSFile::TotalBytes(description), 0);
+	uint16_t* texels = (uint16_t*)data.data();
+
+	ParallelRows(size, [&](unsigned int firstRow, unsigned int endRow)
+	{
+		vector<float> halfX(sampleCount), halfZ(sampleCount);
+		vector<float> a(size), b(size);
+		for (unsigned int row = firstRow; row < endRow; row++)
+		{
+			//Half vectors only depend on roughness, so a row shares them.  With N = +Z the
+			//shader's tangent frame maps local (x, y, z) to (y, -x, z), and V has no y.
+			float roughness = (row + 0.5f) / size;
+			for (unsigned int i = 0; i < sampleCount; i++)
+			{
+				float h[3];
+				SampleGGX(i / (float)sampleCount, RadicalInverse(i), roughness, h);
+				halfX[i] = h[1];
+				halfZ[i] = h[2];
+			}
+
+			unsigned int x = 0;
+#ifdef IBL_BAKER_SSE
+			//Four nDotV texels at a time against each sample
+			__m128 zero = _mm_setzero_ps();
+			__m128 one = _mm_set1_ps(1.0f);
+			__m128 two = _mm_set1_ps(2.0f);
+			__m128 k = _mm_set1_ps(roughness * roughness / 2.0f);
+			__m128 oneMinusK = _mm_sub_ps(one, k);
+			for (; x + 4 <= size; x += 4)
+			{
+				__m128 nDotV = _mm_div_ps(_mm_set_ps(x + 3.5f, x + 2.5f, x + 1.5f, x + 0.5f), _mm_set1_ps((float)size));
+				__m128 vX = _mm_sqrt_ps(_mm_sub_ps(one, _mm_mul_ps(nDotV, nDotV)));
+				__m128 g1V = _mm_div_ps(nDotV, _mm_add_ps(_mm_mul_ps(nDotV, oneMinusK), k));
+				__m128 sumA = zero, sumB = zero;
+
+				for (unsigned int i = 0; i < sampleCount; i++)
+				{
+					__m128 hX = _mm_set1_ps(halfX[i]);
+					__m128 hZ = _mm_set1_ps(halfZ[i]);
+					__m128 vDotHRaw = _mm_add_ps(_mm_mul_ps(vX, hX), _mm_mul_ps(nDotV, hZ));
+					__m128 nDotL = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(two, vDotHRaw), hZ), nDotV);
+					__m128 lit = _mm_cmpgt_ps(nDotL, zero);
+					if (!_mm_movemask_ps(lit))
+						continue;
+
+					__m128 vDotH = _mm_min_ps(_mm_max_ps(vDotHRaw, zero), one);
+					__m128 g1L = _mm_div_ps(nDotL, _mm_add_ps(_mm_mul_ps(nDotL, oneMinusK), k));
+					__m128 gVis = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(g1V, g1L), vDotH), _mm_mul_ps(hZ, nDotV));
+					__m128 f = _mm_sub_ps(one, vDotH);
+					__m128 f2 = _mm_mul_ps(f, f);
+					__m128 fc = _mm_mul_ps(_mm_mul_ps(f2, f2), f);
+					gVis = _mm_and_ps(gVis, lit);
+					sumA = _mm_add_ps(sumA, _mm_mul_ps(_mm_sub_ps(one, fc), gVis));
+					sumB = _mm_add_ps(sumB, _mm_mul_ps(fc, gVis));
+				}
+				_mm_storeu_ps(&a[x], sumA);
+				_mm_storeu_ps(&b[x], sumB);
+			}
+#endif
+
+			//Whatever doesn't fill four lanes, or the whole row without SSE
+			for (; x < size; x++)
+			{
+				float nDotV = (x + 0.5f) / size;
+				float vX = sqrt(1.0f - nDotV * nDotV);
+				a[x] = b[x] = 0;
+				for (unsigned int i = 0; i < sampleCount; i++)
+				{
+					float vDotHRaw = vX * halfX[i] + nDotV * halfZ[i];
+					float nDotL = 2 * vDotHRaw * halfZ[i] - nDotV;
+					if (nDotL <= 0)
+						continue;
+
+					float vDotH = min(max(vDotHRaw, 0.0f), 1.0f);
+					float gVis = G1Schlick(roughness, nDotV) * G1Schlick(roughness, nDotL) * vDotH / (halfZ[i] * nDotV);
+					float fc = pow(1 - vDotH, 5.0f);
+					a[x] += (1 - fc) * gVis;
+					b[x] += fc * gVis;
+				}
+			}
+
+			for (x = 0; x < size; x++)
+			{
+				uint16_t* texel = texels + ((size_t)row * size + x) * 2;
+				texel[0] = (uint16_t)(min(max(a[x] / sampleCount, 0.0f), 1.0f) * 65535.0f + 0.5f);
+				texel[1] = (uint16_t)(min(max(b[x] / sampleCount, 0.0f), 1.0f) * 65535.0f + 0.5f);
+			}
+		}
+	});
+}
+
+void IBLBaker::BakeSpecular(const uint8_t* faces, unsigned int faceSize, bool bgra, unsigned int size, unsigned int mipCount, DDSDescription& description, std::vector<uint8_t>& data)
+{
+	mipCount = max(mipCount, 1u);
+	description = { 28, size, size, mipCount, 6, true };	// R8G8B8A8_UNORM
+	data.assign(DDSFile::TotalBytes(description), 0);
+
+	//Decoded once, so filtering happens on linear values
+	LinearCube environment;
+	environment.Size = faceSize;
+	environment.Texels.resize((size_t)6 * faceSize * faceSize * 3);
+	float gamma[256];
+	for (int i = 0; i < 256; i++)
+		gamma[i] = pow(i / 255.0f, 2.2f);
+	int red = bgra ? 2 : 0;
+	int blue = bgra ? 0 : 2;
+	for (size_t i = 0; i < (size_t)6 * faceSize * faceSize; i++)
+	{
+		environment.Texels[i * 3 + 0] = gamma[faces[i * 4 + red]];
+		environment.Texels[i * 3 + 1] = gamma[faces[i * 4 + 1]];
+		environment.Texels[i * 3 + 2] = gamma[faces[i * 4 + blue]];
+	}
+
+	//Where each face's mip chain starts
+	size_t faceBytes = DDSFile::TotalBytes({ description.Format, size, size, mipCount, 1, false });
+
+	for (unsigned int mip = 0; mip < mipCount; mip++)
+	{
+		unsigned int mipSize = max(size >> mip, 1u);
+		size_t mipOffset = 0;
+		for (unsigned int m = 0; m < mip; m++)
+			mipOffset += DDSFile::MipBytes(description.Format, size, size, m);
+
+		//With N = V = +Z, L = 2 (N.H) H - N is the same for every texel, so the lit samples
+		//are worked out once in the tangent frame, padded to whole groups of four with no
+		//weight.  A smooth mip would sample one direction sampleCount times, so it only
+		//gets one sample.
+		float roughness = mipCount > 1 ? mip / (float)(mipCount - 1) : 0.0f;
+		unsigned int mipSamples = roughness > 0 ? sampleCount : 1;
+		vector<float> localX, localY, localZ, weights;
+		for (unsigned int i = 0; i < mipSamples; i++)
+		{
+			float h[3];
+			SampleGGX(i / (float)mipSamples, RadicalInverse(i), roughness, h);
+			float l[3] = { 2 * h[2] * h[0], 2 * h[2] * h[1], 2 * h[2] * h[2] - 1 };
+			if (l[2] <= 0)
+				continue;
+			localX.push_back(l[0]);
+			localY.push_back(l[1]);
+			localZ.push_back(l[2]);
+			weights.push_back(l[2]);
+		}
+		while (localX.size() % 4)
+		{
+			localX.push_back(0);
+			localY.push_back(0);
+			localZ.push_back(1);
+			weights.push_back(0);
+		}
+		float totalWeight = 0;
+		for (float w : weights)
+			totalWeight += w;
+
+		ParallelRows(mipSize * 6, [&](unsigned int firstRow, unsigned int endRow)
+		{
+			float dirX[4], dirY[4], dirZ[4];
+			for (unsigned int row = firstRow; row < endRow; row++)
+			{
+				unsigned int face = row / mipSize;
+				unsigned int y = row % mipSize;
+				uint8_t* out = data.data() + face * faceBytes + mipOffset + (size_t)y * mipSize * 4;
+
+				for (unsigned int x = 0; x < mipSize; x++)
+				{
+					float n[3];
+					GetCubeTexelDirection(face, x, y, mipSize, n);
+
+					//ImportanceSampleGGX's tangent frame around this texel's direction
+					float up[3] = { 0, 0, 1 };
+					if (fabs(n[2]) >= 0.999f)
+					{
+						up[0] = 1;
+						up[2] = 0;
+					}
+					float tx[3] = { up[1] * n[2] - up[2] * n[1], up[2] * n[0] - up[0] * n[2], up[0] * n[1] - up[1] * n[0] };
+					float txLength = sqrt(tx[0] * tx[0] + tx[1] * tx[1] + tx[2] * tx[2]);
+					for (int a = 0; a < 3; a++)
+						tx[a] /= txLength;
+					float ty[3] = { n[1] * tx[2] - n[2] * tx[1], n[2] * tx[0] - n[0] * tx[2], n[0] * tx[1] - n[1] * tx[0] };
+
+					float color[3] = {};
+					for (size_t i = 0; i < localX.size(); i += 4)
+					{
+#ifdef IBL_BAKER_SSE
+						//Four samples into world space at once, then fetched one by one
+						__m128 lx = _mm_loadu_ps(&localX[i]);
+						__m128 ly = _mm_loadu_ps(&localY[i]);
+						__m128 lz = _mm_loadu_ps(&localZ[i]);
+						_mm_storeu_ps(dirX, _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, _mm_set1_ps(tx[0])), _mm_mul_ps(ly, _mm_set1_ps(ty[0]))), _mm_mul_ps(lz, _mm_set1_ps(n[0]))));
+						_mm_storeu_ps(dirY, _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, _mm_set1_ps(tx[1])), _mm_mul_ps(ly, _mm_set1_ps(ty[1]))), _mm_mul_ps(lz, _mm_set1_ps(n[1]))));
+						_mm_storeu_ps(dirZ, _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, _mm_set1_ps(tx[2])), _mm_mul_ps(ly, _mm_set1_ps(ty[2]))), _mm_mul_ps(lz, _mm_set1_ps(n[2]))));
+#else
+						for (int s = 0; s < 4; s++)
+						{
+							dirX[s] = localX[i + s] * tx[0] + localY[i + s] * ty[0] + localZ[i + s] * n[0];
+							dirY[s] = localX[i + s] * tx[1] + localY[i + s] * ty[1] + localZ[i + s] * n[1];
+							dirZ[s] = localX[i + s] * tx[2] + localY[i + s] * ty[2] + localZ[i + s] * n[2];
+						}
+#endif
+						for (int s = 0; s < 4; s++)
+						{
+							float weight = weights[i + s];
+							if (weight <= 0)
+								continue;
+							float sample[3];
+							environment.Sample(dirX[s], dirY[s], dirZ[s], sample);
+							color[0] += sample[0] * weight;
+							color[1] += sample[1] * weight;
+							color[2] += sample[2] * weight;
+						}
+					}
+
+					//Gamma encoded like the shader's output
+					for (int c = 0; c < 3; c++)
+						out[x * 4 + c] = (uint8_t)(min(max(pow(color[c] / totalWeight, 1.0f / 2.2f), 0.0f), 1.0f) * 255.0f + 0.5f);
+					out[x * 4 + 3] = 255;
+				}
+			}
+		});
+	}
+}
+
+bool IBLBaker::BakeSky(const std::string& skyPath, unsigned int size, unsigned int mipCount, unsigned int lookUpSize)
+{
+	auto start = chrono::steady_clock::now();
+	vector<uint8_t> faces;
+	unsigned int faceSize = 0;
+	if (!ReadEnvironment(skyPath, size, faces, faceSize))
+		return false;
+
+	DDSDescription description;
+	vector<uint8_t> data;
+	BakeSpecular(faces.data(), faceSize, false, size, mipCount, description, data);
+	if (!DDSFile::Write(GetBakedPath(skyPath, "_specular.dds"), description, data.data(), data.size()))
+		return false;
+
+	BakeBRDFLookUp(lookUpSize, description, data);
+	if (!DDSFile::Write(GetBakedPath(skyPath, "_brdf.dds"), description, data.data(), data.size()))
+		return false;
+
+	SHIrradiance sh = SphericalHarmonics::ProjectIrradiance(faces.data(), faceSize, false, jobs);
+
+	//Written last, so its file only exists once the maps are complete
+	ofstream summary(GetBakedPath(skyPath, "_ibl.txt"));
+	summary.precision(9);
+	summary << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	for (int i = 0; i < 9; i++)
+		summary << " " << sh.Coefficients[i].x << " " << sh.Coefficients[i].y << " " << sh.Coefficients[i].z;
+	return (bool)summary;
+}
+
+std::string IBLBaker::GetBakedPath(const std::string& skyPath, const char* suffix)
+{
+	size_t slash = skyPath.find_last_of("/\\");
+	size_t dot = skyPath.find_last_of('.');
+	bool hasExtension = dot != string::npos && (slash == string::npos || dot > slash);
+	return (hasExtension ? skyPath.substr(0, dot) : skyPath) + suffix;
+}
+
+bool IBLBaker::ReadEnvironment(const std::string& path, unsigned int maxSize, std::vector<uint8_t>& faces, unsigned int& faceSize)
+{
+	DDSDescription description;
+	vector<uint8_t> data;
+	if (!DDSFile::Read(path, description, data))
+		return false;
+
+	bool rgba = description.Format == 28 || description.Format == 29;	// R8G8B8A8_UNORM, _SRGB
+	bool bc7 = description.Format == 98 || description.Format == 99;	// BC7_UNORM, _SRGB
+	if ((!rgba && !bc7) || description.ArraySize != 6 || description.Width != description.Height)
+		return false;
+
+	unsigned int mip = 0;
+	while (mip + 1 < description.MipCount && (description.Width >> mip) > maxSize)
+		mip++;
+	faceSize = max(description.Width >> mip, 1u);
+
+	DDSDescription face = description;
+	face.ArraySize = 1;
+	size_t faceBytes = DDSFile::TotalBytes(face);
+	size_t mipOffset = 0;
+	for (unsigned int m = 0; m < mip; m++)
+		mipOffset += DDSFile::MipBytes(description.Format, description.Width, description.Height, m);
+
+	faces.clear();
+	vector<uint8_t> decoded;
+	for (int i = 0; i < 6; i++)
+	{
+		const uint8_t* source = data.data() + i * faceBytes + mipOffset;
+		if (bc7)
+		{
+			TextureCooker::DecodeBlocks(source, COOKED_BC7, faceSize, faceSize, decoded);
+			faces.insert(faces.end(), decoded.begin(), decoded.end());
+		}
+		else
+			faces.insert(faces.end(), source, source + (size_t)faceSize * faceSize * 4);
+	}
+	return true;
+}
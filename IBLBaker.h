@@ -0,0 +1,56 @@
+#pragma once
+#include "DDSFile.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// Bakes the split sum IBL maps Sky renders with IBLBrdfLookUpTablePS and
+// IBLSpecularConvolutionPS, on the CPU, so they can be prebaked without a GPU and
+// checked.  Same Hammersley points, GGX importance sampling and sample count as the
+// shaders.  Results come back in the layout DDSFile writes.
+//
+// Environments are 8 bit RGBA (or BGRA) cubes like SphericalHarmonics takes: square,
+// tightly packed faces in D3D's order, gamma decoded with 2.2.
+//
+// Everything is plain math, so nothing here needs D3D.
+class IBLBaker
+{
+public:
+	// Rows are spread across the job system's workers when one is given
+	IBLBaker(JobSystem* Jobs = 0, unsigned int SampleCount = 4096);
+
+	// R16G16_UNORM scale and bias for F0, nDotV across and roughness down
+	void BakeBRDFLookUp(unsigned int size, DDSDescription& description, std::vector<uint8_t>& data);
+
+	// Gamma encoded R8G8B8A8_UNORM cube of size texels with mipCount mips, mip i
+	// convolved for roughness i / (mipCount - 1)
+	void BakeSpecular(const uint8_t* faces, unsigned int faceSize, bool bgra, unsigned int size, unsigned int mipCount, DDSDescription& description, std::vector<uint8_t>& data);
+
+	// Bakes a cube DDS sky's maps and its SH and writes them next to it, where Sky looks
+	// for them before computing its own (see GetBakedPath)
+	bool BakeSky(const std::string& skyPath, unsigned int size, unsigned int mipCount, unsigned int lookUpSize);
+
+	// Where BakeSky puts a sky's files: Skies/Clouds/cubemap.dds gives
+	// Skies/Clouds/cubemap_specular.dds, _brdf.dds and _ibl.txt.  The text file holds the
+	// bake's time in ms and then the nine SH coefficients' RGB, like the IBL cache's.
+	static std::string GetBakedPath(const std::string& skyPath, const char* suffix);
+
+	// The first mip no bigger than maxSize of each face of an 8 bit RGBA or BC7 cube DDS,
+	// decoded and packed the way BakeSpecular and SphericalHarmonics take them
+	static bool ReadEnvironment(const std::string& path, unsigned int maxSize, std::vector<uint8_t>& faces, unsigned int& faceSize);
+
+	// Van der Corput radical inverse of i, the second Hammersley coordinate
+	static float RadicalInverse(uint32_t bits);
+
+	unsigned int GetSampleCount() { return sampleCount; }
+
+private:
+	// Splits count rows into one run per worker plus the calling thread
+	void ParallelRows(unsigned int count, std::function<void(unsigned int, unsigned int)> bake);
+
+	JobSystem* jobs;
+	unsigned int sampleCount;
+};
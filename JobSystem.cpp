@@ -0,0 +1,75 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+
+using namespace std;
+
+static thread_local int currentWorkerIndex = -1;
+
+JobSystem::JobSystem(unsigned int threadCount)
+	:
+	stopping(false)
+{
+	if (threadCount == 0)
+	{
+		unsigned int hardwareThreads = thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	for (unsigned int i = 0; i < threadCount; i++)
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		lock_guard<mutex> lock(jobsMutex);
+		stopping = true;
+	}
+	jobsAvailable.notify_all();
+
+	for (auto& worker : workers)
+		worker.join();
+}
+
+std::future<void> JobSystem::Submit(std::function<void()> job)
+{
+	packaged_task<void()> task(move(job));
+	future<void> result = task.get_future();
+
+	{
+		lock_guard<mutex> lock(jobsMutex);
+		jobs.push(move(task));
+	}
+	jobsAvailable.notify_one();
+
+	return result;
+}
+
+int JobSystem::GetCurrentWorkerIndex()
+{
+	return currentWorkerIndex;
+}
+
+void JobSystem::WorkerLoop(unsigned int workerIndex)
+{
+	currentWorkerIndex = (int)workerIndex;
+	Profiler::SetThreadName(("Worker " + to_string(workerIndex)).c_str());
+
+	while (true)
+	{
+		packaged_task<void()> task;
+		{
+			unique_lock<mutex> lock(jobsMutex);
+			jobsAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+			//Finish what was queued before shutting down
+			if (jobs.empty())
+				return;
+
+			task = move(jobs.front());
+			jobs.pop();
+		}
+
+		task();
+	}
+}
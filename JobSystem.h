@@ -0,0 +1,37 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// A small pool of worker threads that runs jobs in the order they were submitted.
+// Nothing here touches D3D, so jobs must leave device work to whoever waits on them.
+class JobSystem
+{
+public:
+	// Zero threads means one per hardware thread, leaving the main thread free
+	JobSystem(unsigned int threadCount = 0);
+	~JobSystem();
+
+	JobSystem(JobSystem const&) = delete;
+	void operator=(JobSystem const&) = delete;
+
+	std::future<void> Submit(std::function<void()> job);
+
+	unsigned int GetThreadCount() { return (unsigned int)workers.size(); }
+
+	// Index of the worker running the calling job, or -1 off the pool
+	static int GetCurrentWorkerIndex();
+
+private:
+	void WorkerLoop(unsigned int workerIndex);
+
+	std::vector<std::thread> workers;
+	std::queue<std::packaged_task<void()>> jobs;
+	std::mutex jobsMutex;
+	std::condition_variable jobsAvailable;
+	bool stopping;
+};
@@ -0,0 +1,288 @@
+#include "LightClusters.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <future>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define LIGHT_CLUSTERS_SSE
+#endif
+
+using namespace std;
+
+// Past this a box can't be reached by any light, for padding rows out to four tiles
+static const float unreachable = 1e30f;
+
+// Fewer lights than this aren't worth handing out to the workers
+static const size_t minLightsToSplit = 32;
+
+// Distance along one axis from a point to an interval, zero inside it.  Build and
+// BuildReference both go through this, so they round the same way.
+static inline float AxisDistance(float point, float minimum, float maximum)
+{
+	return max(0.0f, max(minimum - point, point - maximum));
+}
+
+LightClusters::LightClusters(JobSystem* Jobs)
+	:
+	jobs(Jobs),
+	globalLightCount(0)
+{
+	SetGrid(DefaultTilesX, DefaultTilesY, DefaultSlices);
+}
+
+void LightClusters::SetGrid(uint32_t tilesX, uint32_t tilesY, uint32_t slices, float clusterNear)
+{
+	this->tilesX = max(tilesX, 1u);
+	this->tilesY = max(tilesY, 1u);
+	this->slices = max(slices, 1u);
+	this->clusterNear = clusterNear;
+	paddedTilesX = (this->tilesX + 3) & ~3u;
+}
+
+void LightClusters::Prepare(const std::vector<Light>& lights, const DirectX::XMFLOAT4X4& view, float projectionX, float projectionY, float nearClip, float farClip)
+{
+	//Slice 0 is everything up to clusterNear, the rest split the remaining depth exponentially
+	float sliceStart = min(max(clusterNear, nearClip), farClip);
+	if (slices > 1 && farClip > sliceStart)
+	{
+		depthScale = (slices - 1) / log(farClip / sliceStart);
+		depthBias = 1.0f - log(sliceStart) * depthScale;
+	}
+	else
+	{
+		depthScale = 0;
+		depthBias = 0;
+	}
+
+	sliceMinZ.resize(slices);
+	sliceMaxZ.resize(slices);
+	for (uint32_t k = 0; k < slices; k++)
+	{
+		sliceMinZ[k] = k == 0 ? nearClip : sliceStart * pow(farClip / sliceStart, (k - 1) / (float)(slices - 1));
+		sliceMaxZ[k] = k + 1 == slices ? farClip : sliceStart * pow(farClip / sliceStart, k / (float)(slices - 1));
+	}
+
+	//A tile's sides are planes through the eye, so its widest point in a slice is at one
+	//end or the other depending on which side of the centre it's on
+	tileMinX.assign(slices * paddedTilesX, unreachable);
+	tileMaxX.assign(slices * paddedTilesX, -unreachable);
+	tileMinY.resize(slices * tilesY);
+	tileMaxY.resize(slices * tilesY);
+	for (uint32_t k = 0; k < slices; k++)
+	{
+		float z0 = sliceMinZ[k];
+		float z1 = sliceMaxZ[k];
+		for (uint32_t i = 0; i < tilesX; i++)
+		{
+			float left = -1.0f + 2.0f * i / tilesX;
+			float right = -1.0f + 2.0f * (i + 1) / tilesX;
+			tileMinX[k * paddedTilesX + i] = min(left * z0, left * z1) / projectionX;
+			tileMaxX[k * paddedTilesX + i] = max(right * z0, right * z1) / projectionX;
+		}
+		//Rows count down from the top of the screen
+		for (uint32_t j = 0; j < tilesY; j++)
+		{
+			float top = 1.0f - 2.0f * j / tilesY;
+			float bottom = 1.0f - 2.0f * (j + 1) / tilesY;
+			tileMinY[k * tilesY + j] = min(bottom * z0, bottom * z1) / projectionY;
+			tileMaxY[k * tilesY + j] = max(top * z0, top * z1) / projectionY;
+		}
+	}
+
+	indices.clear();
+	binned.clear();
+	for (uint32_t i = 0; i < (uint32_t)lights.size(); i++)
+	{
+		const Light& light = lights[i];
+		if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+		{
+			indices.push_back(i);
+			continue;
+		}
+		if (light.Range <= 0)
+			continue;
+
+		const DirectX::XMFLOAT3& p = light.Position;
+		BinnedLight b;
+		b.X = p.x * view.m[0][0] + p.y * view.m[1][0] + p.z * view.m[2][0] + view.m[3][0];
+		b.Y = p.x * view.m[0][1] + p.y * view.m[1][1] + p.z * view.m[2][1] + view.m[3][1];
+		b.Z = p.x * view.m[0][2] + p.y * view.m[1][2] + p.z * view.m[2][2] + view.m[3][2];
+		b.Radius = light.Range;
+		b.Index = i;
+
+		//Entirely in front of the near plane or past the far one
+		if (b.Z + b.Radius < nearClip || b.Z - b.Radius > farClip)
+			continue;
+		binned.push_back(b);
+	}
+	globalLightCount = (uint32_t)indices.size();
+}
+
+void LightClusters::Build(const std::vector<Light>& lights, const DirectX::XMFLOAT4X4& view, float projectionX, float projectionY, float nearClip, float farClip)
+{
+	Prepare(lights, view, projectionX, projectionY, nearClip, farClip);
+
+	//Workers take a run of slices each, so no two write the same cluster
+	uint32_t batchCount = 1;
+	if (jobs && binned.size() >= minLightsToSplit)
+		batchCount = min(jobs->GetThreadCount() + 1, slices);
+
+	batches.resize(batchCount);
+	for (uint32_t b = 0; b < batchCount; b++)
+	{
+		batches[b].FirstSlice = slices * b / batchCount;
+		batches[b].EndSlice = slices * (b + 1) / batchCount;
+	}
+
+	vector<future<void>> running;
+	for (uint32_t b = 1; b < batchCount; b++)
+	{
+		SliceBatch* batch = &batches[b];
+		running.push_back(jobs->Submit([this, batch]() { BinSlices(*batch); }));
+	}
+	BinSlices(batches[0]);
+	for (auto& r : running)
+		r.get();
+
+	Finish();
+}
+
+void LightClusters::BinSlices(SliceBatch& batch)
+{
+	uint32_t clustersPerSlice = tilesX * tilesY;
+	batch.Counts.assign((batch.EndSlice - batch.FirstSlice) * clustersPerSlice, 0);
+	batch.Pairs.clear();
+	batch.DistanceX.resize(paddedTilesX);
+	float* distanceX = batch.DistanceX.data();
+
+	for (const BinnedLight& light : binned)
+	{
+		float radiusSq = light.Radius * light.Radius;
+		for (uint32_t k = batch.FirstSlice; k < batch.EndSlice; k++)
+		{
+			float dz = AxisDistance(light.Z, sliceMinZ[k], sliceMaxZ[k]);
+			float dzSq = dz * dz;
+			if (dzSq > radiusSq)
+				continue;
+
+			//The distance across each tile in the slice is the same for every row
+			const float* minX = &tileMinX[k * paddedTilesX];
+			const float* maxX = &tileMaxX[k * paddedTilesX];
+#ifdef LIGHT_CLUSTERS_SSE
+			__m128 zero = _mm_setzero_ps();
+			__m128 x = _mm_set1_ps(light.X);
+			for (uint32_t i = 0; i < paddedTilesX; i += 4)
+			{
+				__m128 dx = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minX + i), x), _mm_sub_ps(x, _mm_loadu_ps(maxX + i))));
+				_mm_storeu_ps(distanceX + i, _mm_mul_ps(dx, dx));
+			}
+#else
+			for (uint32_t i = 0; i < paddedTilesX; i++)
+			{
+				float dx = AxisDistance(light.X, minX[i], maxX[i]);
+				distanceX[i] = dx * dx;
+			}
+#endif
+
+			for (uint32_t j = 0; j < tilesY; j++)
+			{
+				float dy = AxisDistance(light.Y, tileMinY[k * tilesY + j], tileMaxY[k * tilesY + j]);
+				float dyzSq = dy * dy + dzSq;
+				if (dyzSq > radiusSq)
+					continue;
+
+				uint32_t rowStart = ((k - batch.FirstSlice) * tilesY + j) * tilesX;
+#ifdef LIGHT_CLUSTERS_SSE
+				__m128 yz = _mm_set1_ps(dyzSq);
+				__m128 radius = _mm_set1_ps(radiusSq);
+				for (uint32_t i = 0; i < paddedTilesX; i += 4)
+				{
+					int hits = _mm_movemask_ps(_mm_cmple_ps(_mm_add_ps(_mm_loadu_ps(distanceX + i), yz), radius));
+					for (; hits; hits &= hits - 1)
+					{
+						uint32_t tile = i;
+						for (int bit = hits; !(bit & 1); bit >>= 1)
+							tile++;
+						batch.Counts[rowStart + tile]++;
+						batch.Pairs.push_back(rowStart + tile);
+						batch.Pairs.push_back(light.Index);
+					}
+				}
+#else
+				for (uint32_t i = 0; i < tilesX; i++)
+				{
+					if (distanceX[i] + dyzSq > radiusSq)
+						continue;
+					batch.Counts[rowStart + i]++;
+					batch.Pairs.push_back(rowStart + i);
+					batch.Pairs.push_back(light.Index);
+				}
+#endif
+			}
+		}
+	}
+
+	//Counting sort by cluster, which keeps each cluster's lights in light order
+	batch.Offsets.resize(batch.Counts.size());
+	uint32_t offset = 0;
+	for (size_t c = 0; c < batch.Counts.size(); c++)
+	{
+		batch.Offsets[c] = offset;
+		offset += batch.Counts[c];
+	}
+
+	batch.Indices.resize(offset);
+	vector<uint32_t>& cursor = batch.Counts;
+	for (size_t c = 0; c < cursor.size(); c++)
+		cursor[c] = batch.Offsets[c];
+	for (size_t p = 0; p < batch.Pairs.size(); p += 2)
+		batch.Indices[cursor[batch.Pairs[p]]++] = batch.Pairs[p + 1];
+}
+
+void LightClusters::Finish()
+{
+	ranges.resize(GetClusterCount());
+	uint32_t clustersPerSlice = tilesX * tilesY;
+	for (SliceBatch& batch : batches)
+	{
+		uint32_t base = (uint32_t)indices.size();
+		uint32_t firstCluster = batch.FirstSlice * clustersPerSlice;
+		for (size_t c = 0; c < batch.Offsets.size(); c++)
+		{
+			//The cursors from the sort ended at each cluster's end
+			uint32_t end = batch.Counts[c];
+			ranges[firstCluster + c].Offset = base + batch.Offsets[c];
+			ranges[firstCluster + c].Count = end - batch.Offsets[c];
+		}
+		indices.insert(indices.end(), batch.Indices.begin(), batch.Indices.end());
+	}
+}
+
+void LightClusters::BuildReference(const std::vector<Light>& lights, const DirectX::XMFLOAT4X4& view, float projectionX, float projectionY, float nearClip, float farClip)
+{
+	Prepare(lights, view, projectionX, projectionY, nearClip, farClip);
+
+	ranges.resize(GetClusterCount());
+	for (uint32_t k = 0; k < slices; k++)
+	{
+		for (uint32_t j = 0; j < tilesY; j++)
+		{
+			for (uint32_t i = 0; i < tilesX; i++)
+			{
+				LightClusterRange& range = ranges[GetClusterIndex(i, j, k)];
+				range.Offset = (uint32_t)indices.size();
+				for (const BinnedLight& light : binned)
+				{
+					float dx = AxisDistance(light.X, tileMinX[k * paddedTilesX + i], tileMaxX[k * paddedTilesX + i]);
+					float dy = AxisDistance(light.Y, tileMinY[k * tilesY + j], tileMaxY[k * tilesY + j]);
+					float dz = AxisDistance(light.Z, sliceMinZ[k], sliceMaxZ[k]);
+					if (dx * dx + (dy * dy + dz * dz) <= light.Radius * light.Radius)
+						indices.push_back(light.Index);
+				}
+				range.Count = (uint32_t)indices.size() - range.Offset;
+			}
+		}
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+#include "Lights.h"
+
+class JobSystem;
+
+// Where one cluster's lights sit in the index list.  Must match LightClusterRanges in PixelShaderPBR.hlsl.
+struct LightClusterRange
+{
+	uint32_t Offset;
+	uint32_t Count;
+};
+
+// Bins point and spot lights into a grid of view space clusters (froxels), so each pixel
+// only walks the lights whose range reaches its cluster.  The grid is screen tiles across
+// and depth slices deep: slice 0 runs from the near plane to ClusterNear, and the rest are
+// spaced exponentially out to the far plane, so clusters stay roughly cube shaped.
+//
+// A light is in a cluster when its range sphere touches the cluster's view space bounding
+// box.  Directional lights reach everything, so they're listed once at the start of the
+// index list instead.  Clusters list their lights in ascending order, whichever way the
+// work was split.
+//
+// Slices are shared out between the job system's workers, and each tests a light against
+// a row of tiles four at a time with SSE.  BuildReference tests every light against every
+// cluster the plain way, for checking Build against.  Nothing here needs D3D.
+class LightClusters
+{
+public:
+	LightClusters(JobSystem* Jobs = 0);
+
+	void SetGrid(uint32_t tilesX, uint32_t tilesY, uint32_t slices, float clusterNear = 1.0f);
+
+	// The view matrix as the Camera stores it (row vectors), the projection's x and y scale
+	// (_11 and _22) and its clip planes
+	void Build(const std::vector<Light>& lights, const DirectX::XMFLOAT4X4& view, float projectionX, float projectionY, float nearClip, float farClip);
+	void BuildReference(const std::vector<Light>& lights, const DirectX::XMFLOAT4X4& view, float projectionX, float projectionY, float nearClip, float farClip);
+
+	const std::vector<LightClusterRange>& GetRanges() { return ranges; }
+	const std::vector<uint32_t>& GetIndices() { return indices; }
+	// Directional lights, at the start of the index list
+	uint32_t GetGlobalLightCount() { return globalLightCount; }
+
+	uint32_t GetTilesX() { return tilesX; }
+	uint32_t GetTilesY() { return tilesY; }
+	uint32_t GetSlices() { return slices; }
+	uint32_t GetClusterCount() { return tilesX * tilesY * slices; }
+	uint32_t GetClusterIndex(uint32_t x, uint32_t y, uint32_t slice) { return (slice * tilesY + y) * tilesX + x; }
+
+	// The shader finds a pixel's slice as log(viewDepth) * scale + bias, clamped to the grid
+	float GetDepthScale() { return depthScale; }
+	float GetDepthBias() { return depthBias; }
+
+	static const uint32_t DefaultTilesX = 16;
+	static const uint32_t DefaultTilesY = 9;
+	static const uint32_t DefaultSlices = 24;
+
+private:
+	// A light that can be binned, in view space
+	struct BinnedLight
+	{
+		float X, Y, Z;
+		float Radius;
+		uint32_t Index;
+	};
+
+	// Per worker, its slices' lists before they're stitched together
+	struct SliceBatch
+	{
+		uint32_t FirstSlice;
+		uint32_t EndSlice;
+		std::vector<uint32_t> Counts;
+		std::vector<uint32_t> Offsets;
+		std::vector<uint32_t> Pairs;	// Cluster then light, in light order
+		std::vector<uint32_t> Indices;
+		std::vector<float> DistanceX;	// Squared, from the light to each tile in a row
+	};
+
+	void Prepare(const std::vector<Light>& lights, const DirectX::XMFLOAT4X4& view, float projectionX, float projectionY, float nearClip, float farClip);
+	void BinSlices(SliceBatch& batch);
+	void Finish();
+
+	JobSystem* jobs;
+	uint32_t tilesX;
+	uint32_t tilesY;
+	uint32_t slices;
+	float clusterNear;
+	float depthScale;
+	float depthBias;
+
+	// Cluster bounds, as boxes in view space.  Tile bounds are per slice, padded to a
+	// multiple of four with boxes nothing can touch.
+	std::vector<float> sliceMinZ;
+	std::vector<float> sliceMaxZ;
+	std::vector<float> tileMinX;
+	std::vector<float> tileMaxX;
+	std::vector<float> tileMinY;
+	std::vector<float> tileMaxY;
+	uint32_t paddedTilesX;
+
+	std::vector<BinnedLight> binned;
+	std::vector<SliceBatch> batches;
+
+	std::vector<LightClusterRange> ranges;
+	std::vector<uint32_t> indices;
+	uint32_t globalLightCount;
+};
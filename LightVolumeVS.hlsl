@@ -0,0 +1,39 @@
+cbuffer externalData : register(b0)
+{
+	matrix view;
+	matrix projection;
+};
+
+// One vertex of the sphere mesh, and the light it's drawn for
+struct VertexShaderInput
+{
+	float3 position		: POSITION;
+	float4 world0		: WORLD_PER_INSTANCE0;
+	float4 world1		: WORLD_PER_INSTANCE1;
+	float4 world2		: WORLD_PER_INSTANCE2;
+	float4 world3		: WORLD_PER_INSTANCE3;
+	float3 color		: COLOR_PER_INSTANCE;
+};
+
+struct VertexToPixel
+{
+	float4 screenPosition	: SV_POSITION;
+	float3 color			: COLOR;
+};
+
+// --------------------------------------------------------
+// Draws every point light's sphere in one instanced call.
+// The world matrix rows come straight from XMFLOAT4X4, so
+// it's applied to a row vector.
+// --------------------------------------------------------
+VertexToPixel main(VertexShaderInput input)
+{
+	VertexToPixel output;
+
+	float4x4 world = float4x4(input.world0, input.world1, input.world2, input.world3);
+	float4 worldPos = mul(float4(input.position, 1.0f), world);
+	output.screenPosition = mul(projection, mul(view, worldPos));
+	output.color = input.color;
+
+	return output;
+}
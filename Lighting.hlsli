@@ -23,10 +23,11 @@ struct Light
 
 // === UTILITY FUNCTIONS ============================================
 
-// Basic sample and unpack
+// Sample and unpack, rebuilding Z so two channel (BC5) normal maps work too
 float3 SampleAndUnpackNormalMap(Texture2D map, SamplerState samp, float2 uv)
 {
-	return map.Sample(samp, uv).rgb * 2.0f - 1.0f;
+	float2 xy = map.Sample(samp, uv).rg * 2.0f - 1.0f;
+	return float3(xy, sqrt(saturate(1.0f - dot(xy, xy))));
 }
 
 // Handle converting tangent-space normal map to world space normal
@@ -314,44 +315,34 @@ static const float PI_OVER_2 = PI / 2.0f;
 
 #define MAX_IBL_SAMPLES 4096 // Or fewer as necessary for performance
 
-#define IRRADIANCE_SAMPLE_STEP_PHI 0.025f // Or larger for performance
-
-#define IRRADIANCE_SAMPLE_STEP_THETA 0.025f // Or larger for performance
-
 
 // === INDIRECT PBR (IBL) ===========================================
 
 
 // Indirect diffuse irradiance for the scene
-
 //
-
-// Uses an irradiance map for indirect diffuse lighting
-
+// Evaluates the sky's irradiance as L2 spherical harmonics (see SphericalHarmonics),
+// already convolved with the cosine lobe and divided by pi on the CPU, so this is
+// linear and needs no gamma correction
 //
-
-// irrMap - The irradiance cube map
-
-// samp - Sampler to use
-
-// direction - Direction for sampling cube map
-
+// sh - Nine RGB coefficients, in the w-padded layout of SHIrradiance
+// normal - Unit direction to evaluate in
 //
-
-float3 IndirectDiffuse(TextureCube irrMap, SamplerState samp, float3 direction)
-
+float3 IndirectDiffuse(float4 sh[9], float3 normal)
 {
-
-	// Sample in the specified direction - the irradiance map
-
-	// is a pre-computed cube map which represents light
-
-	// coming into this pixel from a particular hemisphere
-
-	float3 diff = irrMap.SampleLevel(samp, direction, 0).rgb;
-
-	return pow(abs(diff), 2.2);
-
+	float3 result =
+		sh[0].rgb * 0.282095f +
+		sh[1].rgb * 0.488603f * normal.y +
+		sh[2].rgb * 0.488603f * normal.z +
+		sh[3].rgb * 0.488603f * normal.x +
+		sh[4].rgb * 1.092548f * normal.x * normal.y +
+		sh[5].rgb * 1.092548f * normal.y * normal.z +
+		sh[6].rgb * 0.315392f * (3.0f * normal.z * normal.z - 1.0f) +
+		sh[7].rgb * 1.092548f * normal.x * normal.z +
+		sh[8].rgb * 0.546274f * (normal.x * normal.x - normal.y * normal.y);
+
+	// Ringing can dip below zero opposite a bright light
+	return max(result, 0.0f);
 }
 
 
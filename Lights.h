@@ -2,16 +2,14 @@
 
 #include <DirectXMath.h>
 
-// This define should match your
-// MAX_LIGHTS definition in your shader(s)
-#define MAX_LIGHTS 128
-
 // Light types
 // Must match definitions in shader
 #define LIGHT_TYPE_DIRECTIONAL	0
 #define LIGHT_TYPE_POINT		1
 #define LIGHT_TYPE_SPOT			2
 
+// Matches Light in Lighting.hlsli.  There's no limit on how many there are, since the
+// PBR shader reads them from a structured buffer through LightClusters.
 struct Light
 {
 	int					Type;
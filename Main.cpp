@@ -3,7 +3,11 @@
 #define SIMPLE_SHADER_REPORT_WARNINGS
 
 #include <Windows.h>
+#include <cstdio>
+#include <cstring>
 #include "Game.h"
+#include "Benchmark.h"
+#include "HeadlessBenchmark.h"
 
 // --------------------------------------------------------
 // Entry point for a graphical (non-console) Windows application
@@ -21,6 +25,35 @@ int WINAPI WinMain(
 	_CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
 #endif
 
+	// "--benchmark" runs the benchmark instead of the game, printing to the
+	// console it was started from (see BenchmarkOptions for the rest).  With
+	// "--device none" there's no device at all, like the Linux build's.
+	if (__argc > 1 && strcmp(__argv[1], "--benchmark") == 0)
+	{
+		FILE* console = 0;
+		if (AttachConsole(ATTACH_PARENT_PROCESS))
+		{
+			freopen_s(&console, "CONOUT$", "w", stdout);
+			freopen_s(&console, "CONOUT$", "w", stderr);
+		}
+
+		BenchmarkOptions options;
+		if (!options.Parse(__argc - 2, __argv + 2))
+		{
+			fprintf(stderr, "Usage: %s --benchmark %s", __argv[0], BenchmarkOptions::GetUsage());
+			return 2;
+		}
+
+		if (options.Device == BENCHMARK_DEVICE_NONE)
+		{
+			HeadlessBenchmark headless(options);
+			return headless.Run();
+		}
+
+		Benchmark benchmark(options);
+		return benchmark.Run();
+	}
+
 	// Create the Game object using
 	// the app handle we got from WinMain
 	Game dxGame(hInstance);
@@ -1,4 +1,5 @@
 #include "Material.h"
+#include "Assets.h"
 
 Material::Material(
 	std::shared_ptr<SimplePixelShader> ps,
@@ -43,6 +44,11 @@ DirectX::XMFLOAT3 Material::GetColorTint() { return colorTint; }
 
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Material::GetTextureSRV(std::string name)
 {
+	// Handles are resolved each time, so hot reloaded textures show up
+	auto handle = textureHandles.find(name);
+	if (handle != textureHandles.end())
+		return Assets::GetInstance().GetTexture(handle->second);
+
 	// Search for the key
 	auto it = textureSRVs.find(name);
 
@@ -90,6 +96,11 @@ void Material::AddTextureSRV(std::string name, Microsoft::WRL::ComPtr<ID3D11Shad
 	textureSRVs.insert({ name, srv });
 }
 
+void Material::AddTextureSRV(std::string name, TextureHandle texture)
+{
+	textureHandles.insert({ name, texture });
+}
+
 void Material::AddSampler(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler)
 {
 	samplers.insert({ name, sampler });
@@ -98,6 +109,7 @@ void Material::AddSampler(std::string name, Microsoft::WRL::ComPtr<ID3D11Sampler
 void Material::RemoveTextureSRV(std::string name)
 {
 	textureSRVs.erase(name);
+	textureHandles.erase(name);
 }
 
 void Material::RemoveSampler(std::string name)
@@ -135,5 +147,6 @@ void Material::PrepareMaterial(Transform* transform, std::shared_ptr<Camera> cam
 
 	// Loop and set any other resources
 	for (auto& t : textureSRVs) { ps->SetShaderResourceView(t.first.c_str(), t.second.Get()); }
+	for (auto& t : textureHandles) { ps->SetShaderResourceView(t.first.c_str(), Assets::GetInstance().GetTexture(t.second).Get()); }
 	for (auto& s : samplers) { ps->SetSamplerState(s.first.c_str(), s.second.Get()); }
 }
@@ -9,6 +9,7 @@
 #include "SimpleShader.h"
 #include "Camera.h"
 #include "Transform.h"
+#include "AssetHandles.h"
 
 class Material
 {
@@ -36,6 +37,7 @@ public:
 	DirectX::XMFLOAT2 GetUVOffset();
 	DirectX::XMFLOAT3 GetColorTint();
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetTextureSRV(std::string name);
+	const std::unordered_map<std::string, TextureHandle>& GetTextureHandles() { return textureHandles; }
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> GetSampler(std::string name);
 	bool GetRefractive();
 
@@ -47,6 +49,7 @@ public:
 	const char* GetName();
 
 	void AddTextureSRV(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	void AddTextureSRV(std::string name, TextureHandle texture);
 	void AddSampler(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler);
 
 	void RemoveTextureSRV(std::string name);
@@ -67,6 +70,7 @@ private:
 	DirectX::XMFLOAT2 uvOffset;
 	DirectX::XMFLOAT2 uvScale;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs;
+	std::unordered_map<std::string, TextureHandle> textureHandles;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> samplers;
 
 	const char* name;
@@ -2,30 +2,42 @@
 
 #include <d3d11.h>
 #include <wrl/client.h>
+#include <vector>
 
 #include "Vertex.h"
-
+#include "MeshData.h"
 
 class Mesh
 {
 public:
 	Mesh(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
 	Mesh(const char* objFile, Microsoft::WRL::ComPtr<ID3D11Device> device);
+	// Tangents must already be calculated, as LoadOBJ does
+	Mesh(const MeshData& data, Microsoft::WRL::ComPtr<ID3D11Device> device);
 	~Mesh(void);
 
+	// Swaps in new geometry, so everything holding this mesh picks it up
+	void Reload(const MeshData& data, Microsoft::WRL::ComPtr<ID3D11Device> device);
+
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer() { return vb; }
+	// Positions alone, for depth only passes that don't need the rest of the vertex
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetPositionBuffer() { return positionVB; }
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer() { return ib; }
 	int GetIndexCount() { return numIndices; }
+	float GetBoundingRadius() { return boundingRadius; }
 
 	void SetBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void SetPositionBuffersAndDraw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
 
 private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vb;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> positionVB;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ib;
 	int numIndices;
+	float boundingRadius;
 
 	void CreateBuffers(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
-	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+	void UploadBuffers(const Vertex* vertArray, int numVerts, const unsigned int* indexArray, int numIndices, Microsoft::WRL::ComPtr<ID3D11Device> device);
 
 };
 
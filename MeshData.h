@@ -0,0 +1,19 @@
+#pragma once
+#include <vector>
+
+#include "Vertex.h"
+
+// CPU side mesh data, ready to be turned into buffers.  Produced off the
+// device thread when assets are loaded asynchronously.
+struct MeshData
+{
+	std::vector<Vertex> Vertices;
+	std::vector<unsigned int> Indices;
+};
+
+// Parses an OBJ and generates tangents without touching the device, so it is safe on any
+// thread and builds without D3D
+bool LoadOBJ(const char* objFile, MeshData& data);
+
+// Calculates the tangents of the vertices in a mesh, orthogonal to their normals
+void CalculateTangents(Vertex* verts, int numVerts, const unsigned int* indices, int numIndices);
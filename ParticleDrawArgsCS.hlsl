@@ -0,0 +1,15 @@
+
+// Holds the draw list's hidden counter, copied in with CopyStructureCount
+StructuredBuffer<uint> DrawListCounter		: register(t0);
+
+// Arguments for DrawInstancedIndirect
+RWBuffer<uint> DrawArgs						: register(u0);
+
+[numthreads(1, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	DrawArgs[0] = DrawListCounter[0] * 6;	// VertexCountPerInstance - 6 vertices per quad
+	DrawArgs[1] = 1;						// InstanceCount
+	DrawArgs[2] = 0;						// StartVertexLocation
+	DrawArgs[3] = 0;						// StartInstanceLocation
+}
@@ -0,0 +1,22 @@
+
+#include "ParticleSimulation.hlsli"
+
+RWStructuredBuffer<Particle> Particles		: register(u0);
+ConsumeStructuredBuffer<uint> DeadList		: register(u1);
+AppendStructuredBuffer<uint> DrawList		: register(u2);
+
+// Holds the dead list's hidden counter, copied in with CopyStructureCount
+StructuredBuffer<uint> DeadListCounter		: register(t0);
+
+[numthreads(PARTICLE_THREADS, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	// Consuming from an empty list is undefined, so never
+	// take more particles than are actually dead
+	if (DTid.x >= emitCount || DTid.x >= DeadListCounter[0])
+		return;
+
+	uint index = DeadList.Consume();
+	Particles[index] = ParticleSpawn(DTid.x);
+	DrawList.Append(index);
+}
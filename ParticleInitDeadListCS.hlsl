@@ -0,0 +1,16 @@
+
+#include "ParticleSimulation.hlsli"
+
+RWStructuredBuffer<Particle> Particles		: register(u0);
+AppendStructuredBuffer<uint> DeadList		: register(u1);
+
+// Marks every particle as dead and puts it in the dead list
+[numthreads(PARTICLE_THREADS, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	if (DTid.x >= maxParticles)
+		return;
+
+	Particles[DTid.x] = ParticleDead();
+	DeadList.Append(DTid.x);
+}
@@ -0,0 +1,115 @@
+#include "ParticleSimulation.h"
+
+using namespace DirectX;
+
+// PCG hash - see ParticleHash() in ParticleSimulation.hlsli
+unsigned int ParticleHash(unsigned int x)
+{
+	unsigned int state = x * 747796405u + 2891336453u;
+	unsigned int word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+float ParticleRandomSigned(unsigned int hash)
+{
+	float r = (float)(hash >> 8) * (2.0f / 16777216.0f);
+	return r - 1.0f;
+}
+
+bool ParticleIsDead(const Particle& p, const ParticleSimulationConstants& c)
+{
+	return p.Time >= c.Lifetime;
+}
+
+Particle ParticleDead(const ParticleSimulationConstants& c)
+{
+	Particle p;
+	p.Age = 1.0f;
+	p.Position = XMFLOAT3(0, 0, 0);
+	p.Time = c.Lifetime;
+	p.Velocity = XMFLOAT3(0, 0, 0);
+	return p;
+}
+
+Particle ParticleSpawn(unsigned int threadID, const ParticleSimulationConstants& c)
+{
+	unsigned int seed = ParticleHash(c.EmitSeed ^ (threadID * 2654435769u));
+	float rx = ParticleRandomSigned(seed);
+	seed = ParticleHash(seed);
+	float ry = ParticleRandomSigned(seed);
+	seed = ParticleHash(seed);
+	float rz = ParticleRandomSigned(seed);
+
+	// Written out per component (rather than with XMVECTOR math) so
+	// that the rounding is exactly the same as the shader's
+	Particle p;
+	p.Age = 0.0f;
+	p.Position = c.EmitterPosition;
+	p.Time = 0.0f;
+
+	float vx = c.VelocityRange.x * rx;
+	float vy = c.VelocityRange.y * ry;
+	float vz = c.VelocityRange.z * rz;
+	p.Velocity.x = c.StartingVelocity.x + vx;
+	p.Velocity.y = c.StartingVelocity.y + vy;
+	p.Velocity.z = c.StartingVelocity.z + vz;
+	return p;
+}
+
+bool ParticleUpdate(Particle& p, const ParticleSimulationConstants& c)
+{
+	float time = p.Time + c.DeltaTime;
+	float age = time * c.InvLifetime;
+	p.Time = time;
+	p.Age = age;
+	return ParticleIsDead(p, c);
+}
+
+ParticleSimulationReference::ParticleSimulationReference(const ParticleSimulationConstants& constants)
+{
+	// Mirrors ParticleInitDeadListCS
+	particles.resize(constants.MaxParticles);
+	for (unsigned int i = 0; i < constants.MaxParticles; i++)
+	{
+		particles[i] = ParticleDead(constants);
+		deadList.push_back(i);
+	}
+}
+
+void ParticleSimulationReference::Update(const ParticleSimulationConstants& constants)
+{
+	// The draw list is rebuilt from scratch each frame, just
+	// like the GPU resetting its hidden counter to zero
+	drawList.clear();
+
+	// Mirrors ParticleUpdateCS
+	for (unsigned int i = 0; i < constants.MaxParticles; i++)
+	{
+		Particle p = particles[i];
+		if (ParticleIsDead(p, constants))
+			continue;
+
+		if (ParticleUpdate(p, constants))
+			deadList.push_back(i);
+		else
+			drawList.push_back(i);
+
+		particles[i] = p;
+	}
+}
+
+void ParticleSimulationReference::Emit(const ParticleSimulationConstants& constants)
+{
+	// Mirrors ParticleEmitCS
+	unsigned int deadCount = (unsigned int)deadList.size();
+	for (unsigned int i = 0; i < constants.EmitCount; i++)
+	{
+		if (i >= deadCount)
+			break;
+
+		unsigned int index = deadList.back();
+		deadList.pop_back();
+		particles[index] = ParticleSpawn(i, constants);
+		drawList.push_back(index);
+	}
+}
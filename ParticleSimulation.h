@@ -0,0 +1,69 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+
+// CPU reference of the particle compute shaders.  Every function here
+// mirrors one in ParticleSimulation.hlsli, operation for operation, so
+// the results match the GPU bit for bit (as long as the compiler isn't
+// allowed to contract multiplies and adds, i.e. no /fp:fast or /fp:contract).
+// This lets the simulation logic be checked on a machine without a GPU.
+
+// Shared by the CPU emitter, the compute shaders and ParticleVS.hlsl
+struct Particle
+{
+	float				Age;		// Normalized age (0 - 1)
+	DirectX::XMFLOAT3	Position;	// 16 bytes
+
+	float				Time;		// Seconds alive
+	DirectX::XMFLOAT3   Velocity;	// 32 bytes
+};
+
+// Must match the simulationData cbuffer in ParticleSimulation.hlsli
+struct ParticleSimulationConstants
+{
+	DirectX::XMFLOAT3	EmitterPosition;
+	float				Lifetime;
+
+	DirectX::XMFLOAT3	StartingVelocity;
+	float				InvLifetime;
+
+	DirectX::XMFLOAT3	VelocityRange;
+	float				DeltaTime;
+
+	unsigned int		EmitCount;
+	unsigned int		EmitSeed;
+	unsigned int		MaxParticles;
+};
+
+// Matches PARTICLE_THREADS in ParticleSimulation.hlsli
+#define PARTICLE_THREADS 64
+
+unsigned int ParticleHash(unsigned int x);
+float ParticleRandomSigned(unsigned int hash);
+bool ParticleIsDead(const Particle& p, const ParticleSimulationConstants& c);
+Particle ParticleDead(const ParticleSimulationConstants& c);
+Particle ParticleSpawn(unsigned int threadID, const ParticleSimulationConstants& c);
+bool ParticleUpdate(Particle& p, const ParticleSimulationConstants& c);
+
+// Runs the same kernels as the GPU path, one "thread" at a time, with
+// vectors standing in for the append/consume buffers.  The order of the
+// indices in the lists is not defined on the GPU, but the state of each
+// particle is.
+class ParticleSimulationReference
+{
+public:
+	ParticleSimulationReference(const ParticleSimulationConstants& constants);
+
+	// Same order the Emitter dispatches them in
+	void Update(const ParticleSimulationConstants& constants);
+	void Emit(const ParticleSimulationConstants& constants);
+
+	const std::vector<Particle>& GetParticles() { return particles; }
+	const std::vector<unsigned int>& GetDrawList() { return drawList; }
+	unsigned int GetDeadCount() { return (unsigned int)deadList.size(); }
+
+private:
+	std::vector<Particle> particles;
+	std::vector<unsigned int> deadList;
+	std::vector<unsigned int> drawList;
+};
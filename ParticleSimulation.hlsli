@@ -0,0 +1,99 @@
+// Include guard
+#ifndef _PARTICLE_SIMULATION_HLSL
+#define _PARTICLE_SIMULATION_HLSL
+
+// Everything in this file is mirrored by ParticleSimulation.h/.cpp on the CPU.
+// Any change here MUST be made there as well, or the CPU reference
+// will stop matching the GPU bit for bit.  All arithmetic is marked
+// precise so the compiler can't fuse multiplies and adds.
+
+#define PARTICLE_THREADS 64
+
+// Must match the Particle struct in ParticleSimulation.h and ParticleVS.hlsl
+struct Particle
+{
+	float	Age;		// Normalized age (0 - 1)
+	float3	Position;	// 16 bytes
+
+	float	Time;		// Seconds alive
+	float3	Velocity;	// 32 bytes
+};
+
+// Must match ParticleSimulationConstants in ParticleSimulation.h
+cbuffer simulationData : register(b0)
+{
+	float3 emitterPosition;
+	float lifetime;
+
+	float3 startingVelocity;
+	float invLifetime;
+
+	float3 velocityRange;
+	float deltaTime;
+
+	uint emitCount;
+	uint emitSeed;
+	uint maxParticles;
+}
+
+// PCG hash - integer only, so it matches the CPU exactly
+uint ParticleHash(uint x)
+{
+	uint state = x * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+// Maps the top 24 bits of a hash to [-1, 1) without any rounding
+float ParticleRandomSigned(uint hash)
+{
+	precise float r = (float)(hash >> 8) * (2.0f / 16777216.0f);
+	return r - 1.0f;
+}
+
+// A particle is dead once it has lived its whole lifetime
+bool ParticleIsDead(Particle p)
+{
+	return p.Time >= lifetime;
+}
+
+Particle ParticleDead()
+{
+	Particle p;
+	p.Age = 1.0f;
+	p.Position = float3(0, 0, 0);
+	p.Time = lifetime;
+	p.Velocity = float3(0, 0, 0);
+	return p;
+}
+
+Particle ParticleSpawn(uint threadID)
+{
+	uint seed = ParticleHash(emitSeed ^ (threadID * 2654435769u));
+	float rx = ParticleRandomSigned(seed);
+	seed = ParticleHash(seed);
+	float ry = ParticleRandomSigned(seed);
+	seed = ParticleHash(seed);
+	float rz = ParticleRandomSigned(seed);
+
+	Particle p;
+	p.Age = 0.0f;
+	p.Position = emitterPosition;
+	p.Time = 0.0f;
+
+	precise float3 velocity = startingVelocity + velocityRange * float3(rx, ry, rz);
+	p.Velocity = velocity;
+	return p;
+}
+
+// Returns true if the particle died during this update
+bool ParticleUpdate(inout Particle p)
+{
+	precise float time = p.Time + deltaTime;
+	precise float age = time * invLifetime;
+	p.Time = time;
+	p.Age = age;
+	return ParticleIsDead(p);
+}
+
+#endif
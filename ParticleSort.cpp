@@ -0,0 +1,103 @@
+#include "ParticleSort.h"
+#include "JobSystem.h"
+#include <algorithm>
+
+// Below this many particles threading costs more than it saves
+#define PARTICLE_SORT_MIN_PER_THREAD 16384
+#define RADIX_BUCKETS 256
+
+ParticleSorter::ParticleSorter(JobSystem* Jobs)
+	:
+	jobs(Jobs)
+{
+}
+
+void ParticleSorter::SortBackToFront(const float* depths, unsigned int count, float nearZ, float farZ, unsigned int* outIndices)
+{
+	if (count == 0)
+		return;
+
+	if (keys.size() < count)
+	{
+		keys.resize(count);
+		keysTemp.resize(count);
+		valuesTemp.resize(count);
+	}
+
+	// Farther particles get smaller keys, so an ascending sort is back to front
+	float range = farZ - nearZ;
+	float scale = range > 0.0f ? 65535.0f / range : 0.0f;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float d = std::min(std::max(depths[i], nearZ), farZ);
+		keys[i] = (unsigned short)((farZ - d) * scale);
+		outIndices[i] = i;
+	}
+
+	// Low byte into the scratch buffers, high byte back into the outputs
+	RadixPass(keys.data(), outIndices, keysTemp.data(), valuesTemp.data(), count, 0);
+	RadixPass(keysTemp.data(), valuesTemp.data(), keys.data(), outIndices, count, 8);
+}
+
+void ParticleSorter::RadixPass(const unsigned short* keysIn, const unsigned int* valuesIn, unsigned short* keysOut, unsigned int* valuesOut, unsigned int count, unsigned int shift)
+{
+	//The calling thread takes a chunk too, so the workers are never all that's left
+	unsigned int threadCount = jobs ? jobs->GetThreadCount() + 1 : 1;
+	unsigned int threads = std::min(threadCount, std::max(count / PARTICLE_SORT_MIN_PER_THREAD, 1u));
+	unsigned int chunkSize = (count + threads - 1) / threads;
+
+	histograms.assign(threads * RADIX_BUCKETS, 0);
+
+	auto histogram = [&](unsigned int t)
+	{
+		unsigned int* h = &histograms[t * RADIX_BUCKETS];
+		unsigned int end = std::min(count, (t + 1) * chunkSize);
+		for (unsigned int i = t * chunkSize; i < end; i++)
+			h[(keysIn[i] >> shift) & 0xFF]++;
+	};
+
+	auto scatter = [&](unsigned int t)
+	{
+		unsigned int* h = &histograms[t * RADIX_BUCKETS];
+		unsigned int end = std::min(count, (t + 1) * chunkSize);
+		for (unsigned int i = t * chunkSize; i < end; i++)
+		{
+			unsigned int dest = h[(keysIn[i] >> shift) & 0xFF]++;
+			keysOut[dest] = keysIn[i];
+			valuesOut[dest] = valuesIn[i];
+		}
+	};
+
+	auto runAll = [&](auto job)
+	{
+		if (threads == 1)
+		{
+			job(0);
+			return;
+		}
+
+		std::vector<std::future<void>> running;
+		for (unsigned int t = 1; t < threads; t++)
+			running.push_back(jobs->Submit([&job, t]() { job(t); }));
+		job(0);
+		for (auto& r : running)
+			r.get();
+	};
+
+	runAll(histogram);
+
+	// Turn the counts into starting offsets.  Walking each bucket across
+	// the threads in order keeps the sort stable.
+	unsigned int offset = 0;
+	for (unsigned int b = 0; b < RADIX_BUCKETS; b++)
+	{
+		for (unsigned int t = 0; t < threads; t++)
+		{
+			unsigned int c = histograms[t * RADIX_BUCKETS + b];
+			histograms[t * RADIX_BUCKETS + b] = offset;
+			offset += c;
+		}
+	}
+
+	runAll(scatter);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+
+class JobSystem;
+
+// Back-to-front sorting of particles for alpha blending.
+// View depths are quantized to 16 bit keys and sorted with a stable
+// LSD radix sort (two 8 bit passes).  Large inputs split each pass's
+// histogram and scatter across the job system's workers.
+class ParticleSorter
+{
+public:
+	// Without a job system everything runs on the calling thread
+	ParticleSorter(JobSystem* Jobs = 0);
+
+	// depths      - view space depth of each particle
+	// count       - number of particles
+	// nearZ/farZ  - depth range used for quantizing, anything outside is clamped
+	// outIndices  - receives the particle indices, farthest first
+	void SortBackToFront(const float* depths, unsigned int count, float nearZ, float farZ, unsigned int* outIndices);
+
+private:
+	void RadixPass(const unsigned short* keysIn, const unsigned int* valuesIn, unsigned short* keysOut, unsigned int* valuesOut, unsigned int count, unsigned int shift);
+
+	JobSystem* jobs;
+
+	// Scratch space, kept around so sorting every frame doesn't allocate
+	std::vector<unsigned short> keys;
+	std::vector<unsigned short> keysTemp;
+	std::vector<unsigned int> valuesTemp;
+	std::vector<unsigned int> histograms;
+};
@@ -0,0 +1,26 @@
+
+#include "ParticleSimulation.hlsli"
+
+RWStructuredBuffer<Particle> Particles		: register(u0);
+AppendStructuredBuffer<uint> DeadList		: register(u1);
+AppendStructuredBuffer<uint> DrawList		: register(u2);
+
+[numthreads(PARTICLE_THREADS, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	if (DTid.x >= maxParticles)
+		return;
+
+	Particle p = Particles[DTid.x];
+
+	// Already in the dead list
+	if (ParticleIsDead(p))
+		return;
+
+	if (ParticleUpdate(p))
+		DeadList.Append(DTid.x);
+	else
+		DrawList.Append(DTid.x);
+
+	Particles[DTid.x] = p;
+}
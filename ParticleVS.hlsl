@@ -7,6 +7,8 @@ cbuffer externalData	: register(b0)
 	float4 startColor;
 	float4 endColor;
 	float3 acceleration;
+	int useDrawList;
+	float ageOffset;
 }
 
 struct Particle
@@ -30,17 +32,31 @@ struct VertexToPixel
 };
 
 StructuredBuffer<Particle> ParticleData	: register(t0);
+// Indices of the live particles, used when the particles aren't tightly packed (GPU simulation)
+StructuredBuffer<uint> DrawList			: register(t1);
 
 VertexToPixel main(uint id : SV_VertexID)
 {
 	VertexToPixel output;
 
-	uint particleID = id / 4;
-	uint cornerID = id % 4;
+	// Two triangles per particle, no index buffer needed
+	static const uint quadCorners[6] = { 0, 1, 2, 0, 2, 3 };
+	uint particleID = id / 6;
+	uint cornerID = quadCorners[id % 6];
+
+	if (useDrawList)
+		particleID = DrawList.Load(particleID);
 
 	Particle part = ParticleData.Load(particleID);
-	float age = part.EmitTime;
-	float3 pos = acceleration * part.EmitTime * part.EmitTime /2.0f + part.Velocity * part.EmitTime + part.StartPos;
+	// Emitters at a lower LOD aren't ticked every frame, so the age is extrapolated in closed form
+	float age = part.EmitTime + ageOffset;
+	if (age >= 1.0f)
+	{
+		// Died between ticks, collapse the quad so it gets culled
+		output = (VertexToPixel)0;
+		return output;
+	}
+	float3 pos = acceleration * age * age /2.0f + part.Velocity * age + part.StartPos;
 
 	float xScale = lerp(startScale.x, endScale.x, age);
 	float yScale = lerp(startScale.y, endScale.y, age);;
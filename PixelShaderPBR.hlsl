@@ -1,7 +1,19 @@
 
+// Permutations (see ShaderPermutations) define PERMUTATION along with the features
+// they use.  Built on its own, as PixelShaderPBR.cso, the usual features are on.
+#ifndef PERMUTATION
+#define NORMAL_MAP
+#define IBL
+#define MOTION_VECTORS
+#define SHADOWS
+#endif
+
 #include "Lighting.hlsli"
-// How many lights could we handle?
-#define MAX_LIGHTS 128
+// Permutations can cap how many lights a pixel shades with MAX_LIGHTS; otherwise every
+// light reaching its cluster is shaded
+
+// Must match MAX_SHADOW_CASCADES in ShadowCascades.h
+#define MAX_SHADOW_CASCADES 4
 
 // Data that can change per material
 cbuffer perMaterial : register(b0)
@@ -17,19 +29,37 @@ cbuffer perMaterial : register(b0)
 // Data that only changes once per frame
 cbuffer perFrame : register(b1)
 {
-	// An array of light data
-	Light lights[MAX_LIGHTS];
-
-	// The amount of lights THIS FRAME
-	int lightCount;
+	// Directional lights, listed first in LightIndices
+	uint globalLightCount;
 
 	// Needed for specular (reflection) calculation
 	float3 cameraPosition;
 
+	// Light cluster grid (see LightClusters): tiles across, down and slices deep, and
+	// how to turn view depth into a slice
+	uint3 clusterCounts;
+	float clusterDepthScale;
+	float3 cameraForward;
+	float clusterDepthBias;
+
 	int specIBLTotalMipLevels;
 
 	float2 screenSize;
 	float MotionBlurMax;
+
+	// Cascaded shadows for one directional light (see ShadowCascades), with SHADOWS.
+	// None when the index is negative, and then the count is zero too so the lookup
+	// returns straight away.  Splits are where each cascade ends in view depth, and
+	// texel sizes are in world units.
+	int shadowLightIndex;
+	matrix shadowViewProjections[MAX_SHADOW_CASCADES];
+	float4 cascadeSplits;
+	float4 cascadeTexelSizes;
+	int cascadeCount;
+	float shadowMapTexelSize;
+
+	// Sky irradiance as L2 spherical harmonics, see SphericalHarmonics
+	float4 irradianceSH[9];
 };
 
 struct PS_Output
@@ -57,17 +87,68 @@ struct VertexToPixel
 
 // Texture-related variables
 Texture2D Albedo			: register(t0);
+#ifdef NORMAL_MAP
 Texture2D NormalMap			: register(t1);
+#endif
+#ifdef PACKED_RMA
+// Roughness, metal and AO in red, green and blue
+Texture2D RoughMetalAOMap	: register(t2);
+#else
 Texture2D RoughnessMap		: register(t2);
 Texture2D MetalMap			: register(t3);
+#endif
 SamplerState BasicSampler	: register(s0);
 SamplerState ClampSampler	: register(s1);
 
 
+// One slice per cascade
+Texture2DArray ShadowMap					: register(t10);
+SamplerComparisonState ShadowSampler		: register(s2);
+
+
+// Every light, then each cluster's range of indices into them
+StructuredBuffer<Light> Lights				: register(t7);
+StructuredBuffer<uint2> LightClusterRanges	: register(t8);
+StructuredBuffer<uint> LightIndices			: register(t9);
+
+
 //IBL
+#ifdef IBL
 Texture2D BrdfLookUpMap		: register(t4);
-TextureCube IrradianceIBLMap	: register(t5);
 TextureCube SpecularIBLMap	: register(t6);
+#endif
+
+
+// How much of the shadowing directional light reaches a point, 0 to 1
+float CascadedShadow(float3 worldPos, float3 normal, float viewDepth)
+{
+	// The first cascade reaching this far, with nothing past the last one (or
+	// nothing at all without cascades)
+	if (cascadeCount <= 0 || viewDepth > cascadeSplits[min(cascadeCount, MAX_SHADOW_CASCADES) - 1])
+		return 1.0f;
+	uint cascade = 0;
+	while (viewDepth > cascadeSplits[cascade])
+		cascade++;
+
+	// Pushed out along the normal by about a texel, against acne on sloped surfaces
+	float3 offsetPos = worldPos + normal * cascadeTexelSizes[cascade] * 1.5f;
+	float4 shadowPos = mul(shadowViewProjections[cascade], float4(offsetPos, 1.0f));
+	float2 uv = shadowPos.xy * float2(0.5f, -0.5f) + 0.5f;
+
+	// 3x3 PCF, each tap already filtered between texels by the comparison sampler
+	float lit = 0;
+	[unroll]
+	for (int y = -1; y <= 1; y++)
+	{
+		[unroll]
+		for (int x = -1; x <= 1; x++)
+		{
+			float2 tapUV = uv + float2(x, y) * shadowMapTexelSize;
+			lit += ShadowMap.SampleCmpLevelZero(ShadowSampler, float3(tapUV, cascade), shadowPos.z);
+		}
+	}
+	return lit / 9.0f;
+}
 
 
 // Entry point for this pixel shader
@@ -83,9 +164,19 @@ PS_Output main(VertexToPixel input)
 	input.uv = input.uv * uvScale + uvOffset;
 
 	// Sample various textures
+#ifdef NORMAL_MAP
 	input.normal = NormalMapping(NormalMap, BasicSampler, input.uv, input.normal, input.tangent);
+#endif
+#ifdef PACKED_RMA
+	float3 roughMetalAO = RoughMetalAOMap.Sample(BasicSampler, input.uv).rgb;
+	float roughness = roughMetalAO.r;
+	float metal = roughMetalAO.g;
+	float ao = roughMetalAO.b;
+#else
 	float roughness = RoughnessMap.Sample(BasicSampler, input.uv).r;
 	float metal = MetalMap.Sample(BasicSampler, input.uv).r;
+	float ao = 1;
+#endif
 
 	// Gamma correct the texture back to linear space and apply the color tint
 	float4 surfaceColor = Albedo.Sample(BasicSampler, input.uv);
@@ -99,26 +190,49 @@ PS_Output main(VertexToPixel input)
 	// Total color for this pixel
 	float3 totalColor = float3(0,0,0);
 
-	// Loop through all lights this frame
-	for(int i = 0; i < lightCount; i++)
+	// Find this pixel's cluster
+	float viewDepth = dot(input.worldPos - cameraPosition, cameraForward);
+#ifdef SHADOWS
+	float shadow = CascadedShadow(input.worldPos, input.normal, viewDepth);
+#endif
+	uint3 cluster;
+	cluster.xy = min((uint2)(input.screenPosition.xy / screenSize * clusterCounts.xy), clusterCounts.xy - 1);
+	cluster.z = (uint)clamp(log(viewDepth) * clusterDepthScale + clusterDepthBias, 0, clusterCounts.z - 1);
+	uint2 clusterRange = LightClusterRanges[(cluster.z * clusterCounts.y + cluster.y) * clusterCounts.x + cluster.x];
+
+	// Directional lights, then the ones reaching this cluster
+	uint lightCount = globalLightCount + clusterRange.y;
+#ifdef MAX_LIGHTS
+	lightCount = min(lightCount, MAX_LIGHTS);
+#endif
+	for(uint i = 0; i < lightCount; i++)
 	{
+		uint lightIndex = LightIndices[i < globalLightCount ? i : clusterRange.x + i - globalLightCount];
+		Light light = Lights[lightIndex];
+
 		// Which kind of light?
-		switch (lights[i].Type)
+		switch (light.Type)
 		{
 		case LIGHT_TYPE_DIRECTIONAL:
-			totalColor += DirLightPBR(lights[i], input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor);
+#ifdef SHADOWS
+			totalColor += DirLightPBR(light, input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor) *
+				(lightIndex == (uint)shadowLightIndex ? shadow : 1.0f);
+#else
+			totalColor += DirLightPBR(light, input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor);
+#endif
 			break;
 
 		case LIGHT_TYPE_POINT:
-			totalColor += PointLightPBR(lights[i], input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor);
+			totalColor += PointLightPBR(light, input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor);
 			break;
 
 		case LIGHT_TYPE_SPOT:
-			totalColor += SpotLightPBR(lights[i], input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor);
+			totalColor += SpotLightPBR(light, input.normal, input.worldPos, cameraPosition, roughness, metal, surfaceColor.rgb, specColor);
 			break;
 		}
 	}
 
+#ifdef IBL
 	// Calculate requisite reflection vectors
 
 	float3 viewToCam = normalize(cameraPosition - input.worldPos);
@@ -130,7 +244,7 @@ PS_Output main(VertexToPixel input)
 
 	// Indirect lighting
 
-	float3 indirectDiffuse = IndirectDiffuse(IrradianceIBLMap, BasicSampler, input.normal);
+	float3 indirectDiffuse = IndirectDiffuse(irradianceSH, input.normal);
 
 	float3 indirectSpecular = IndirectSpecular(
 
@@ -149,7 +263,12 @@ PS_Output main(VertexToPixel input)
 
 	float3 fullIndirect = indirectSpecular + balancedDiff * surfaceColor.rgb;
 
+	// Add the indirect to the direct
+
+	totalColor += fullIndirect * ao;
+#endif
 
+#ifdef MOTION_VECTORS
 	float2 prevPos = input.prevScreenPos.xy / input.prevScreenPos.w;
 	float2 currentPos = input.currentScreenPos.xy / input.currentScreenPos.w;
 	float2 velocity = currentPos - prevPos;
@@ -160,10 +279,10 @@ PS_Output main(VertexToPixel input)
 	{
 		velocity = normalize(velocity) * MotionBlurMax;
 	}
-
-	// Add the indirect to the direct
-
-	totalColor += fullIndirect;
+#else
+	// Still written, so whatever was drawn behind doesn't leave its motion here
+	float2 velocity = float2(0, 0);
+#endif
 
 
 	// Gamma correction
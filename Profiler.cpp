@@ -0,0 +1,189 @@
+#include "Profiler.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+
+using namespace std;
+
+thread_local Profiler::Ring* Profiler::threadRing = 0;
+thread_local uint16_t Profiler::threadDepth = 0;
+std::atomic<bool> Profiler::enabled(true);
+std::vector<std::unique_ptr<Profiler::Ring>>* Profiler::rings = new vector<unique_ptr<Profiler::Ring>>();
+std::mutex Profiler::ringsMutex;
+
+static const chrono::steady_clock::time_point clockStart = chrono::steady_clock::now();
+
+uint64_t Profiler::Now()
+{
+	return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - clockStart).count();
+}
+
+Profiler::Ring& Profiler::GetThreadRing()
+{
+	if (threadRing)
+		return *threadRing;
+
+	unique_ptr<Ring> ring(new Ring());
+	ring->Reserved.store(0, memory_order_relaxed);
+	ring->Head.store(0, memory_order_relaxed);
+	ring->FrameStart[0] = 0;
+	ring->FrameStart[1] = 0;
+
+	lock_guard<mutex> lock(ringsMutex);
+	ring->Thread = (uint32_t)rings->size();
+	ring->Name = "Thread " + to_string(ring->Thread);
+	threadRing = ring.get();
+	rings->push_back(move(ring));
+	return *threadRing;
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	Ring& ring = GetThreadRing();
+	lock_guard<mutex> lock(ringsMutex);
+	ring.Name = name;
+}
+
+void Profiler::BeginFrame()
+{
+	Ring& ring = GetThreadRing();
+	ring.FrameStart[1] = ring.FrameStart[0];
+	ring.FrameStart[0] = Now();
+}
+
+void Profiler::Record(const char* name, uint64_t startNs, uint64_t endNs, uint16_t depth, ProfileTrack track)
+{
+	Ring& ring = GetThreadRing();
+	uint64_t head = ring.Head.load(memory_order_relaxed);
+
+	//Claims the slot before touching it, so a reader that sees any of the new values also sees the claim
+	ring.Reserved.store(head + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	Slot& slot = ring.Events[head % RingSize];
+	slot.Name.store(name, memory_order_relaxed);
+	slot.StartNs.store(startNs, memory_order_relaxed);
+	slot.EndNs.store(endNs, memory_order_relaxed);
+	slot.DepthAndTrack.store(depth | ((uint32_t)track << 16), memory_order_relaxed);
+
+	//Publishes the event to readers
+	ring.Head.store(head + 1, memory_order_release);
+}
+
+void Profiler::CopyRing(Ring& ring, std::vector<ProfileEvent>& events)
+{
+	uint64_t head = ring.Head.load(memory_order_acquire);
+	uint64_t first = head > RingSize ? head - RingSize : 0;
+
+	size_t copyStart = events.size();
+	for (uint64_t i = first; i < head; i++)
+	{
+		Slot& slot = ring.Events[i % RingSize];
+		uint32_t depthAndTrack = slot.DepthAndTrack.load(memory_order_relaxed);
+		events.push_back({
+			slot.Name.load(memory_order_relaxed),
+			slot.StartNs.load(memory_order_relaxed),
+			slot.EndNs.load(memory_order_relaxed),
+			ring.Thread,
+			(uint16_t)(depthAndTrack & 0xFFFF),
+			(uint16_t)(depthAndTrack >> 16) });
+	}
+
+	//Anything the owner claimed to wrap around onto while we copied may be torn
+	atomic_thread_fence(memory_order_acquire);
+	uint64_t reserved = ring.Reserved.load(memory_order_relaxed);
+	uint64_t firstIntact = reserved > RingSize ? reserved - RingSize : 0;
+	if (firstIntact > first)
+	{
+		size_t torn = (size_t)min(firstIntact - first, head - first);
+		events.erase(events.begin() + copyStart, events.begin() + copyStart + torn);
+	}
+}
+
+void Profiler::Collect(std::vector<ProfileEvent>& events)
+{
+	lock_guard<mutex> lock(ringsMutex);
+	for (auto& ring : *rings)
+		CopyRing(*ring, events);
+}
+
+void Profiler::CollectLastFrame(std::vector<ProfileEvent>& events)
+{
+	Ring& ring = GetThreadRing();
+	vector<ProfileEvent> all;
+	CopyRing(ring, all);
+
+	for (auto& e : all)
+	{
+		if (e.Track == PROFILE_TRACK_CPU && e.StartNs >= ring.FrameStart[1] && e.EndNs <= ring.FrameStart[0])
+			events.push_back(e);
+	}
+}
+
+// Names are code literals, but a stray quote or backslash would still break the JSON
+static void AppendEscaped(string& json, const char* text)
+{
+	for (const char* c = text; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			json += '\\';
+		if ((unsigned char)*c >= 0x20)
+			json += *c;
+	}
+}
+
+std::string Profiler::ExportChromeTrace()
+{
+	vector<ProfileEvent> events;
+	vector<pair<uint32_t, string>> threadNames;
+	{
+		lock_guard<mutex> lock(ringsMutex);
+		for (auto& ring : *rings)
+		{
+			CopyRing(*ring, events);
+			threadNames.push_back({ ring->Thread, ring->Name });
+		}
+	}
+
+	//The GPU gets a timeline of its own after every thread's
+	uint32_t gpuThread = (uint32_t)threadNames.size();
+	threadNames.push_back({ gpuThread, "GPU" });
+
+	string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	char number[96];
+	bool first = true;
+	for (auto& thread : threadNames)
+	{
+		json += first ? "" : ",\n";
+		first = false;
+		snprintf(number, sizeof(number), "{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":\"", thread.first);
+		json += number;
+		AppendEscaped(json, thread.second.c_str());
+		json += "\"}}";
+	}
+
+	for (auto& e : events)
+	{
+		uint32_t thread = e.Track == PROFILE_TRACK_GPU ? gpuThread : e.Thread;
+		json += ",\n{\"ph\":\"X\",\"pid\":1,\"cat\":\"";
+		json += e.Track == PROFILE_TRACK_GPU ? "gpu" : "cpu";
+		json += "\",\"name\":\"";
+		AppendEscaped(json, e.Name);
+		snprintf(number, sizeof(number), "\",\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", thread, e.StartNs / 1000.0, (e.EndNs - e.StartNs) / 1000.0);
+		json += number;
+	}
+
+	json += "\n]}\n";
+	return json;
+}
+
+bool Profiler::WriteChromeTrace(const std::string& path)
+{
+	ofstream file(path, ios::binary);
+	if (!file.is_open())
+		return false;
+
+	file << ExportChromeTrace();
+	return file.good();
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Which timeline an event is drawn on
+enum ProfileTrack
+{
+	PROFILE_TRACK_CPU,
+	PROFILE_TRACK_GPU
+};
+
+// One finished scope.  Names must outlive the profiler, so string literals.
+struct ProfileEvent
+{
+	const char* Name;
+	uint64_t StartNs;
+	uint64_t EndNs;
+	uint32_t Thread;
+	uint16_t Depth;
+	uint16_t Track;
+};
+
+// Hierarchical CPU profiler.  Scopes are recorded into a ring per thread which only
+// that thread writes, so recording takes no locks; a thread's first event registers
+// its ring once.  Readers copy the rings out seqlock style, dropping anything the
+// owner overwrote while they were copying.  Plain C++ with no Windows or D3D, so it builds and runs anywhere.
+//
+// GPU timings (see GpuProfiler) are added as events on their own track, already
+// converted to this clock.
+class Profiler
+{
+public:
+	// Nanoseconds since the profiler's clock started
+	static uint64_t Now();
+
+	static void SetEnabled(bool enabled) { Profiler::enabled.store(enabled, std::memory_order_relaxed); }
+	static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+	// Shown as the thread's name in traces
+	static void SetThreadName(const char* name);
+
+	// Marks the start of a frame on the calling thread, so its last full frame can be
+	// picked out of the ring
+	static void BeginFrame();
+
+	static void Record(const char* name, uint64_t startNs, uint64_t endNs, uint16_t depth, ProfileTrack track = PROFILE_TRACK_CPU);
+
+	// Copies out every event still in the rings, oldest first on each thread
+	static void Collect(std::vector<ProfileEvent>& events);
+	// The calling thread's events from its last finished frame
+	static void CollectLastFrame(std::vector<ProfileEvent>& events);
+
+	// Chrome's trace event format, viewable in chrome://tracing or Perfetto
+	static std::string ExportChromeTrace();
+	static bool WriteChromeTrace(const std::string& path);
+
+	// Events each thread keeps before the oldest are overwritten
+	static const uint32_t RingSize = 16384;
+
+private:
+	friend class ProfileScope;
+
+	// An event as stored, in atomics so a reader racing the owner is well defined
+	struct Slot
+	{
+		std::atomic<const char*> Name;
+		std::atomic<uint64_t> StartNs;
+		std::atomic<uint64_t> EndNs;
+		std::atomic<uint32_t> DepthAndTrack;
+	};
+
+	struct Ring
+	{
+		Slot Events[RingSize];
+		// Events started and finished writing.  Readers use the first to spot slots
+		// that were being overwritten while they copied.
+		std::atomic<uint64_t> Reserved;
+		std::atomic<uint64_t> Head;
+		uint32_t Thread;
+		std::string Name;
+		// Start of the current and previous frames, for CollectLastFrame
+		uint64_t FrameStart[2];
+	};
+
+	static void CopyRing(Ring& ring, std::vector<ProfileEvent>& events);
+
+	static Ring& GetThreadRing();
+	static thread_local Ring* threadRing;
+	static thread_local uint16_t threadDepth;
+	static std::atomic<bool> enabled;
+
+	// Every ring ever registered.  Rings outlive their threads, so a trace still shows
+	// work from workers that have since exited.
+	static std::vector<std::unique_ptr<Ring>>* rings;
+	static std::mutex ringsMutex;
+};
+
+// Records the time between its construction and destruction, nested under whatever
+// scope is open on the same thread
+class ProfileScope
+{
+public:
+	ProfileScope(const char* Name)
+	{
+		name = Profiler::IsEnabled() ? Name : 0;
+		if (!name)
+			return;
+		depth = Profiler::threadDepth++;
+		start = Profiler::Now();
+	}
+
+	~ProfileScope()
+	{
+		if (!name)
+			return;
+		Profiler::Record(name, start, Profiler::Now(), depth);
+		Profiler::threadDepth--;
+	}
+
+	ProfileScope(ProfileScope const&) = delete;
+	void operator=(ProfileScope const&) = delete;
+
+private:
+	const char* name;
+	uint64_t start;
+	uint16_t depth;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
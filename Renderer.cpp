@@ -1,6 +1,7 @@
 #include "Renderer.h"
 #include "Assets.h"
 #include <DirectXMath.h>
+#include <algorithm>
 
 #include "ImGui/imgui.h"
 #include "ImGui/imgui_impl_dx11.h"
@@ -8,13 +9,37 @@
 
 using namespace std;
 using namespace DirectX;
+
+// Names used every frame, hashed at compile time
+static constexpr AssetName fullscreenVSName("FullscreenVS");
+static constexpr AssetName motionBlurNeighborhoodPSName("MotionBlurNeighborhoodPS");
+static constexpr AssetName motionBlurPSName("MotionBlurPS");
+static constexpr AssetName lightVSName("LightVolumeVS");
+static constexpr AssetName lightPSName("LightVolumePS");
+static constexpr AssetName lightMeshName("sphere");
+static constexpr AssetName shadowVSName("ShadowVS");
+static constexpr AssetName depthPrepassVSName("DepthPrepassVS");
 Renderer::Renderer(Microsoft::WRL::ComPtr<ID3D11Device> Device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> Context, Microsoft::WRL::ComPtr<IDXGISwapChain> SwapChain, Microsoft::WRL::ComPtr<ID3D11RenderTargetView> BackBufferRTV,
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DepthBufferDSV, unsigned int WindowWidth, unsigned int WindowHeight, std::shared_ptr<Sky> SkyPTR, std::vector<std::shared_ptr<GameEntity>>& Entities, std::vector<std::shared_ptr<Emitter>>& Emitters,
 	std::vector<Light>& Lights, HWND hWnd)
 	:
 		lights(Lights),
 		entities(Entities),
-		emitters(Emitters)
+		emitters(Emitters),
+		lightClusters(Assets::GetInstance().GetJobSystem()),
+		lightCapacity(0),
+		uploadedBytes(0),
+		uploadedLightBytes(0),
+		depthPrepass(true),
+		countOverdraw(false),
+		iblBudgetMicroseconds(2000),
+		overdrawPending(),
+		overdrawFrame(0),
+		shadedPerPixel(0),
+		shadowsEnabled(true),
+		shadowLightIndex(-1),
+		shadowCasterCounts(),
+		lightInstanceCapacity(0)
 {
 	device = Device;
 	context = Context;
@@ -28,12 +53,17 @@ Renderer::Renderer(Microsoft::WRL::ComPtr<ID3D11Device> Device, Microsoft::WRL::
 	motionBlurNeighborhoodSamples = 16;
 	motionBlurMax = 16;
 
-	ImGui::CreateContext();
+	//Without a window (the benchmark) there's no UI to draw and nothing to present to
+	drawUI = hWnd != 0;
+	if (drawUI)
+	{
+		ImGui::CreateContext();
 
-	ImGui::StyleColorsDark();
+		ImGui::StyleColorsDark();
 
-	ImGui_ImplWin32_Init(hWnd);
-	ImGui_ImplDX11_Init(device.Get(), context.Get());
+		ImGui_ImplWin32_Init(hWnd);
+		ImGui_ImplDX11_Init(device.Get(), context.Get());
+	}
 
 	renderTargetsRTV = new Microsoft::WRL::ComPtr<ID3D11RenderTargetView>[RENDER_TARGETS_COUNT];
 	renderTargetsSRV = new Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>[RENDER_TARGETS_COUNT];
@@ -54,6 +84,18 @@ Renderer::Renderer(Microsoft::WRL::ComPtr<ID3D11Device> Device, Microsoft::WRL::
 	particleDepthDesc.DepthFunc = D3D11_COMPARISON_LESS;
 	device->CreateDepthStencilState(&particleDepthDesc, particleDSS.GetAddressOf());
 
+	//After the prepass the depth buffer already holds the nearest surfaces
+	D3D11_DEPTH_STENCIL_DESC equalDepthDesc = {};
+	equalDepthDesc.DepthEnable = true;
+	equalDepthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+	equalDepthDesc.DepthFunc = D3D11_COMPARISON_EQUAL;
+	device->CreateDepthStencilState(&equalDepthDesc, equalDepthDSS.GetAddressOf());
+
+	D3D11_QUERY_DESC statsDesc = {};
+	statsDesc.Query = D3D11_QUERY_PIPELINE_STATISTICS;
+	for (auto& query : overdrawQueries)
+		device->CreateQuery(&statsDesc, query.GetAddressOf());
+
 	D3D11_BLEND_DESC additiveBlendDesc = {};
 	additiveBlendDesc.RenderTarget[0].BlendEnable = true;
 	additiveBlendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
@@ -64,6 +106,21 @@ Renderer::Renderer(Microsoft::WRL::ComPtr<ID3D11Device> Device, Microsoft::WRL::
 	additiveBlendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ONE;
 	additiveBlendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
 	device->CreateBlendState(&additiveBlendDesc, particleBS.GetAddressOf());
+
+	D3D11_BLEND_DESC alphaBlendDesc = {};
+	alphaBlendDesc.RenderTarget[0].BlendEnable = true;
+	alphaBlendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+	alphaBlendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+	alphaBlendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+	alphaBlendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	alphaBlendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+	alphaBlendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+	alphaBlendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+	device->CreateBlendState(&alphaBlendDesc, particleAlphaBS.GetAddressOf());
+
+	CreateShadowResources();
+
+	gpuProfiler = make_unique<GpuProfiler>(device, context);
 }
 
 Renderer::~Renderer()
@@ -96,6 +153,21 @@ void Renderer::PostResize(unsigned int windowWidth, unsigned int windowHeight, M
 
 void Renderer::Render(shared_ptr<Camera> camera, vector<shared_ptr<Material>> materials, float deltaTime)
 {
+	PROFILE_SCOPE("Render");
+
+	//Before the frame's passes, since it sets its own targets and waits on the GPU
+	{
+		PROFILE_SCOPE("Sky IBL Update");
+		sky->UpdateIBL(iblBudgetMicroseconds);
+	}
+
+	gpuProfiler->BeginFrame();
+
+	{
+		PROFILE_GPU_SCOPE(gpuProfiler.get(), "Shadow Maps");
+		RenderShadowMaps(camera);
+	}
+
 	// Background color for clearing
 	const float color[4] = { 0, 0, 0, 1 };
 
@@ -113,6 +185,13 @@ void Renderer::Render(shared_ptr<Camera> camera, vector<shared_ptr<Material>> ma
 		context->ClearRenderTargetView(renderTargetsRTV[i].Get(), color);
 	}
 
+	SortOpaqueDraws(camera);
+	if (depthPrepass)
+	{
+		PROFILE_GPU_SCOPE(gpuProfiler.get(), "Depth Prepass");
+		DrawDepthPrepass(camera);
+	}
+
 
 	ID3D11RenderTargetView* renderTargets[RENDER_TARGETS_COUNT] = {};
 	for (int i = 0; i < RENDER_TARGETS_COUNT; i++)
@@ -122,11 +201,38 @@ void Renderer::Render(shared_ptr<Camera> camera, vector<shared_ptr<Material>> ma
 
 	context->OMSetRenderTargets(RENDER_TARGETS_COUNT, renderTargets, depthBufferDSV.Get());
 
+	UpdateLightClusters(camera);
+	XMFLOAT4X4 view = camera->GetView();
+	XMFLOAT3 cameraForward(view._13, view._23, view._33);
+	unsigned int clusterCounts[3] = { lightClusters.GetTilesX(), lightClusters.GetTilesY(), lightClusters.GetSlices() };
+
+	XMFLOAT4X4 shadowViewProjections[MAX_SHADOW_CASCADES] = {};
+	float cascadeSplits[4] = {};
+	float cascadeTexelSizes[4] = {};
+	for (unsigned int c = 0; c < shadowCascades.GetCascadeCount(); c++)
+	{
+		const ShadowCascade& cascade = shadowCascades.GetCascade(c);
+		shadowViewProjections[c] = cascade.ViewProjection;
+		cascadeSplits[c] = cascade.SplitFar;
+		cascadeTexelSizes[c] = cascade.TexelSize;
+	}
+
 	// Draw all of the entities
-	for (auto& ge : entities)
+	gpuProfiler->BeginPass("Opaque");
+	if (depthPrepass)
+		context->OMSetDepthStencilState(equalDepthDSS.Get(), 0);
+	//A query still waiting on the GPU can't be begun again, so frames go uncounted until it's read
+	bool queryOverdraw = false;
+	if (countOverdraw)
 	{
-		if (ge->GetMaterial()->GetRefractive())
-			continue;
+		ReadOverdraw();
+		queryOverdraw = !overdrawPending[overdrawFrame];
+		if (queryOverdraw)
+			context->Begin(overdrawQueries[overdrawFrame].Get());
+	}
+	for (auto& draw : opaqueDraws)
+	{
+		GameEntity* ge = draw.second;
 		// Set the "per frame" data
 		// Note that this should literally be set once PER FRAME, before
 		// the draw loop, but we're currently setting it per entity since 
@@ -138,12 +244,26 @@ void Renderer::Render(shared_ptr<Camera> camera, vector<shared_ptr<Material>> ma
 		vs->SetMatrix4x4("prevWorld", ge->GetTransform()->GetPreviousWorldMatrix());
 		vs->CopyAllBufferData();
 		std::shared_ptr<SimplePixelShader> ps = ge->GetMaterial()->GetPixelShader();
-		ps->SetData("lights", (void*)(&lights[0]), sizeof(Light) * (int)lights.size());
-		ps->SetInt("lightCount", lights.size());
+		ps->SetInt("globalLightCount", lightClusters.GetGlobalLightCount());
+		ps->SetData("clusterCounts", clusterCounts, sizeof(clusterCounts));
+		ps->SetFloat("clusterDepthScale", lightClusters.GetDepthScale());
+		ps->SetFloat("clusterDepthBias", lightClusters.GetDepthBias());
+		ps->SetFloat3("cameraForward", cameraForward);
+		ps->SetShaderResourceView("Lights", lightSRV);
+		ps->SetShaderResourceView("LightClusterRanges", clusterRangeBuffer.SRV);
+		ps->SetShaderResourceView("LightIndices", lightIndexBuffer.SRV);
+		ps->SetInt("shadowLightIndex", shadowLightIndex);
+		ps->SetData("shadowViewProjections", shadowViewProjections, sizeof(shadowViewProjections));
+		ps->SetFloat4("cascadeSplits", cascadeSplits);
+		ps->SetFloat4("cascadeTexelSizes", cascadeTexelSizes);
+		ps->SetInt("cascadeCount", shadowLightIndex >= 0 ? shadowCascades.GetCascadeCount() : 0);
+		ps->SetFloat("shadowMapTexelSize", 1.0f / shadowCascades.GetResolution());
+		ps->SetShaderResourceView("ShadowMap", shadowSRV);
+		ps->SetSamplerState("ShadowSampler", shadowSampler);
 		ps->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
 		ps->SetInt("specIBLTotalMipLevels", sky->GetNumOfMipLevels());
 		ps->SetShaderResourceView("BrdfLookUpMap", sky->GetBrdfLookUp());
-		ps->SetShaderResourceView("IrradianceIBLMap", sky->GetIrradianceMap());
+		ps->SetData("irradianceSH", sky->GetIrradianceSH().Coefficients, sizeof(SHIrradiance));
 		ps->SetShaderResourceView("SpecularIBLMap", sky->getConvolvedSpecularMap());
 		ps->SetFloat2("screenSize", XMFLOAT2(windowWidth, windowHeight));
 		ps->SetFloat("MotionBlurMax", motionBlurMax);
@@ -152,12 +272,26 @@ void Renderer::Render(shared_ptr<Camera> camera, vector<shared_ptr<Material>> ma
 		// Draw the entity
 		ge->Draw(context, camera);
 	}
+	if (queryOverdraw)
+	{
+		context->End(overdrawQueries[overdrawFrame].Get());
+		overdrawPending[overdrawFrame] = true;
+		overdrawFrame = (overdrawFrame + 1) % GpuProfiler::FrameLatency;
+	}
+	context->OMSetDepthStencilState(0, 0);
+	gpuProfiler->EndPass();
 
 	// Draw the light sources
-	DrawPointLights(camera);
+	{
+		PROFILE_GPU_SCOPE(gpuProfiler.get(), "Point Lights");
+		DrawPointLights(camera);
+	}
 
 	// Draw the sky
-	sky->Draw(camera);
+	{
+		PROFILE_GPU_SCOPE(gpuProfiler.get(), "Sky");
+		sky->Draw(camera);
+	}
 
 
 
@@ -175,11 +309,12 @@ void Renderer::Render(shared_ptr<Camera> camera, vector<shared_ptr<Material>> ma
 	context->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
 	context->IASetVertexBuffers(0, 1, &nothing, &stride, &offset);
 
-	Assets::GetInstance().GetVertexShader("FullscreenVS")->SetShader();
+	Assets::GetInstance().GetVertexShader(fullscreenVSName)->SetShader();
 	context->OMSetRenderTargets(1, renderTargetsRTV[NEIGHBORHOOD_MAX].GetAddressOf(), 0);
 	//Doing the motion blur B)
 	{
-		std::shared_ptr<SimplePixelShader> ps = Assets::GetInstance().GetPixelShader("MotionBlurNeighborhoodPS");
+		PROFILE_GPU_SCOPE(gpuProfiler.get(), "Motion Blur Neighborhood");
+		std::shared_ptr<SimplePixelShader> ps = Assets::GetInstance().GetPixelShader(motionBlurNeighborhoodPSName);
 		ps->SetShader();
 		ps->SetInt("numOfSamples", motionBlurNeighborhoodSamples);
 		ps->SetShaderResourceView("Velocities", renderTargetsSRV[VELOCITY].Get());
@@ -191,7 +326,8 @@ void Renderer::Render(shared_ptr<Camera> camera, vector<shared_ptr<Material>> ma
 
 	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), 0);
 	{
-		std::shared_ptr<SimplePixelShader> ps = Assets::GetInstance().GetPixelShader("MotionBlurPS");
+		PROFILE_GPU_SCOPE(gpuProfiler.get(), "Motion Blur");
+		std::shared_ptr<SimplePixelShader> ps = Assets::GetInstance().GetPixelShader(motionBlurPSName);
 		ps->SetShader();
 		ps->SetInt("numOfSamples", 16);
 		ps->SetShaderResourceView("OriginalColors", renderTargetsSRV[ALBEDO].Get());
@@ -205,6 +341,7 @@ void Renderer::Render(shared_ptr<Camera> camera, vector<shared_ptr<Material>> ma
 
 	//Refractive objects rendering
 	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthBufferDSV.Get());
+	gpuProfiler->BeginPass("Refraction");
 	for (auto& ge : entities)
 	{
 		ge->GetTransform()->SetPreviousWorldMatrix(ge->GetTransform()->GetWorldMatrix());
@@ -219,20 +356,23 @@ void Renderer::Render(shared_ptr<Camera> camera, vector<shared_ptr<Material>> ma
 		ge->Draw(context, camera);
 	}
 
+	gpuProfiler->EndPass();
+
 	//Particle drawing
 	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthBufferDSV.Get());
-	context->OMSetDepthStencilState(particleDSS.Get(), 0);
-
-	for (auto& e : emitters)
 	{
-		context->OMSetBlendState(particleBS.Get(), 0, 0xFFFFFFFF);
-		e->Draw(camera);
+		PROFILE_GPU_SCOPE(gpuProfiler.get(), "Particles");
+		DrawEmitters(camera);
 	}
 
 	context->OMSetBlendState(0, 0, 0xFFFFFFFF);
 	context->OMSetDepthStencilState(0, 0);
 	// Draw some UI
-	DrawUI(materials, deltaTime);
+	if (drawUI)
+	{
+		PROFILE_GPU_SCOPE(gpuProfiler.get(), "UI");
+		DrawUI(materials, deltaTime);
+	}
 	// Present the back buffer to the user
 	//  - Puts the final frame we're drawing into the window so the user can see it
 	//  - Do this exactly ONCE PER FRAME (always at the very end of the frame)
@@ -240,7 +380,12 @@ void Renderer::Render(shared_ptr<Camera> camera, vector<shared_ptr<Material>> ma
 	ID3D11ShaderResourceView* nullSRVs[16] = {};
 	context->PSSetShaderResources(0, 16, nullSRVs);
 
-	swapChain->Present(0, 0);
+	gpuProfiler->EndFrame();
+	if (swapChain)
+	{
+		PROFILE_SCOPE("Present");
+		swapChain->Present(0, 0);
+	}
 
 	// Due to the usage of a more sophisticated swap chain,
 	// the render target must be re-bound after every call to Present()
@@ -264,6 +409,40 @@ void Renderer::DrawUI(vector<shared_ptr<Material>> materials, float deltaTime)
 	ImGui::Text("Aspect ratio = %f", (float)windowWidth / (float)windowHeight);
 	ImGui::Text("Number of Entities = %i", entities.size());
 	ImGui::Text("Number of Lights = %i", lights.size());
+	ImGui::Text("Light Clusters = %u x %u x %u, %u indices", lightClusters.GetTilesX(), lightClusters.GetTilesY(), lightClusters.GetSlices(), (unsigned int)lightClusters.GetIndices().size());
+	ImGui::Text("Uploaded = %u bytes (lights %u)", uploadedBytes, uploadedLightBytes);
+
+	if (ImGui::CollapsingHeader("Opaque Pass"))
+	{
+		ImGui::Checkbox("Depth Prepass", &depthPrepass);
+		ImGui::Checkbox("Count Overdraw", &countOverdraw);
+		if (countOverdraw)
+			ImGui::Text("Pixels shaded per screen pixel = %.2f", shadedPerPixel);
+	}
+
+	if (ImGui::CollapsingHeader("Sky Lighting"))
+	{
+		ImGui::Text("Sky texture loaded in %.0f ms, IBL maps %s in %.0f ms", sky->GetLoadMs(), sky->GetIBLFromCache() ? "loaded" : "computed", sky->GetIBLMs());
+		ImGui::SliderInt("Budget (us)", &iblBudgetMicroseconds, 0, 8000);
+		if (ImGui::Button("Re-convolve IBL"))
+			sky->BeginIBLUpdate();
+
+		TimeSlicer& slicer = sky->GetIBLSlicer();
+		if (sky->IsIBLUpdating())
+			ImGui::Text("Updating: %u of %u pieces", slicer.GetNextItem(), slicer.GetItemCount());
+		else if (slicer.GetLastPassSlices())
+			ImGui::Text("Last update took %u frames", slicer.GetLastPassSlices());
+	}
+
+	if (ImGui::CollapsingHeader("Shadows"))
+	{
+		ImGui::Checkbox("Cast Shadows", &shadowsEnabled);
+		for (unsigned int c = 0; shadowLightIndex >= 0 && c < shadowCascades.GetCascadeCount(); c++)
+		{
+			const ShadowCascade& cascade = shadowCascades.GetCascade(c);
+			ImGui::BulletText("Cascade %u: %.2f to %.2f, %u casters", c, cascade.SplitNear, cascade.SplitFar, shadowCasterCounts[c]);
+		}
+	}
 
 	if (ImGui::CollapsingHeader("Lights")) {
 		for (int i = 0; i < lights.size(); i++)
@@ -272,8 +451,10 @@ void Renderer::DrawUI(vector<shared_ptr<Material>> materials, float deltaTime)
 			std::string label = "Light " + std::to_string(i + 1);
 			if (ImGui::TreeNode(label.c_str()))
 			{
-				ImGui::ColorEdit3("Light Color", &lights[i].Color.x);
-				ImGui::DragFloat3("Light Direction", &lights[i].Direction.x);
+				if (ImGui::ColorEdit3("Light Color", &lights[i].Color.x))
+					MarkLightDirty(i);
+				if (ImGui::DragFloat3("Light Direction", &lights[i].Direction.x))
+					MarkLightDirty(i);
 				ImGui::TreePop();
 			}
 			ImGui::PopID();
@@ -357,12 +538,85 @@ void Renderer::DrawUI(vector<shared_ptr<Material>> materials, float deltaTime)
 			ImGui::Image((void*)renderTargetsSRV[i].Get(), ImVec2(256, 256));
 	}
 
+	if (ImGui::CollapsingHeader("Particles"))
+	{
+		const char* lodNames[EMITTER_LOD_COUNT] = { "Near", "Far", "Culled" };
+		for (int l = 0; l < EMITTER_LOD_COUNT; l++)
+		{
+			int current = 0;
+			unsigned int updates = 0;
+			for (auto& e : emitters)
+			{
+				current += e->GetLOD() == l;
+				updates += e->GetLODUpdateCount((EmitterLOD)l);
+			}
+			ImGui::Text("LOD %s: %d emitters, %u updates", lodNames[l], current, updates);
+		}
+
+		for (int i = 0; i < emitters.size(); i++)
+		{
+			ImGui::PushID(i);
+			std::string label = "Emitter " + std::to_string(i + 1);
+			if (ImGui::TreeNode(label.c_str()))
+			{
+				ImGui::Text("LOD: %s", lodNames[emitters[i]->GetLOD()]);
+				float farDistance = emitters[i]->GetLODFarDistance();
+				if (ImGui::DragFloat("Far LOD Distance", &farDistance, 0.5f, 0.0f, 100.0f))
+					emitters[i]->SetLODFarDistance(farDistance);
+
+				bool alpha = emitters[i]->GetAlphaBlended();
+				if (ImGui::Checkbox("Alpha Blended", &alpha))
+					emitters[i]->SetAlphaBlended(alpha);
+
+				bool sort = emitters[i]->GetSortParticles();
+				if (ImGui::Checkbox("Sort Back To Front", &sort))
+					emitters[i]->SetSortParticles(sort);
+				ImGui::TreePop();
+			}
+			ImGui::PopID();
+		}
+	}
+
+	TextureResidency* residency = Assets::GetInstance().GetTextureResidency();
+	if (residency && ImGui::CollapsingHeader("Texture Streaming"))
+	{
+		const float megabyte = 1024.0f * 1024.0f;
+		ImGui::Text("Streamed Textures: %u", (unsigned int)residency->GetTextureCount());
+		ImGui::Text("Resident: %.1f MB of %.1f MB", residency->GetResidentBytes() / megabyte, residency->GetBudget() / megabyte);
+		ImGui::Text("Uploads In Flight: %u", Assets::GetInstance().GetPendingMipUploadCount());
+
+		int budget = (int)(residency->GetBudget() / (1024 * 1024));
+		if (ImGui::DragInt("Budget (MB)", &budget, 1, 1, 2048))
+			residency->SetBudget((uint64_t)budget * 1024 * 1024);
+	}
+
 	if (ImGui::CollapsingHeader("Motion Blur"))
 	{
 		ImGui::DragInt("Motion Blur Samples", &motionBlurNeighborhoodSamples, 1, 0, 64);
 		ImGui::DragInt("Max Motion Blur", &motionBlurMax, 1, 0, 64);
 		
 	}
+
+	if (ImGui::CollapsingHeader("Profiler"))
+	{
+		bool enabled = Profiler::IsEnabled();
+		if (ImGui::Checkbox("Enabled", &enabled))
+			Profiler::SetEnabled(enabled);
+		if (ImGui::Button("Write Chrome Trace"))
+			Profiler::WriteChromeTrace("trace.json");
+
+		ImGui::Text("GPU Frame: %.3f ms", gpuProfiler->GetLastFrameMs());
+		for (auto& pass : gpuProfiler->GetLastFrameTimes())
+			ImGui::BulletText("%s: %.3f ms", pass.first, pass.second);
+
+		//The main thread's scopes from its last full frame, nested by depth
+		vector<ProfileEvent> events;
+		Profiler::CollectLastFrame(events);
+		sort(events.begin(), events.end(), [](const ProfileEvent& a, const ProfileEvent& b) { return a.StartNs < b.StartNs; });
+		ImGui::Text("CPU:");
+		for (auto& e : events)
+			ImGui::Text("%*s%s: %.3f ms", (int)(e.Depth + 1) * 2, "", e.Name, (e.EndNs - e.StartNs) / 1000000.0);
+	}
 	ImGui::End();
 	ImGui::Render();
 	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
@@ -402,58 +656,400 @@ void Renderer::CreatePostProcessResources()
 
 }
 
+// --------------------------------------------------------
+// Orders the opaque entities nearest first, so the depth
+// test rejects as much as it can
+// --------------------------------------------------------
+void Renderer::SortOpaqueDraws(std::shared_ptr<Camera> camera)
+{
+	XMFLOAT4X4 view = camera->GetView();
+	XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+
+	opaqueDraws.clear();
+	for (auto& ge : entities)
+	{
+		if (ge->GetMaterial()->GetRefractive())
+			continue;
+		XMFLOAT3 position = ge->GetTransform()->GetPosition();
+		float depth =
+			(position.x - cameraPosition.x) * view._13 +
+			(position.y - cameraPosition.y) * view._23 +
+			(position.z - cameraPosition.z) * view._33;
+		opaqueDraws.push_back({ depth, ge.get() });
+	}
+
+	sort(opaqueDraws.begin(), opaqueDraws.end(),
+		[](const pair<float, GameEntity*>& a, const pair<float, GameEntity*>& b) { return a.first < b.first; });
+}
+
+// --------------------------------------------------------
+// Lays down the opaque entities' depth with no pixel
+// shader, from their position only vertex streams
+// --------------------------------------------------------
+void Renderer::DrawDepthPrepass(std::shared_ptr<Camera> camera)
+{
+	shared_ptr<SimpleVertexShader> vs = Assets::GetInstance().GetVertexShader(depthPrepassVSName);
+	vs->SetShader();
+	context->PSSetShader(0, 0, 0);
+	context->OMSetRenderTargets(0, 0, depthBufferDSV.Get());
+
+	vs->SetMatrix4x4("view", camera->GetView());
+	vs->SetMatrix4x4("projection", camera->GetProjection());
+	for (auto& draw : opaqueDraws)
+	{
+		vs->SetMatrix4x4("world", draw.second->GetTransform()->GetWorldMatrix());
+		vs->CopyAllBufferData();
+		draw.second->GetMesh()->SetPositionBuffersAndDraw(context);
+	}
+}
+
+// --------------------------------------------------------
+// Picks up the oldest overdraw count if the GPU is done
+// with it, without waiting
+// --------------------------------------------------------
+void Renderer::ReadOverdraw()
+{
+	if (!overdrawPending[overdrawFrame])
+		return;
+
+	D3D11_QUERY_DATA_PIPELINE_STATISTICS stats;
+	if (context->GetData(overdrawQueries[overdrawFrame].Get(), &stats, sizeof(stats), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		return;
+
+	overdrawPending[overdrawFrame] = false;
+	shadedPerPixel = (float)((double)stats.PSInvocations / ((double)windowWidth * windowHeight));
+}
+
+// --------------------------------------------------------
+// One depth slice per cascade, and the states to draw and
+// sample them with
+// --------------------------------------------------------
+void Renderer::CreateShadowResources()
+{
+	unsigned int resolution = shadowCascades.GetResolution();
+	unsigned int cascadeCount = shadowCascades.GetCascadeCount();
+
+	D3D11_TEXTURE2D_DESC texDesc = {};
+	texDesc.Width = resolution;
+	texDesc.Height = resolution;
+	texDesc.MipLevels = 1;
+	texDesc.ArraySize = cascadeCount;
+	texDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	texDesc.SampleDesc.Count = 1;
+	texDesc.Usage = D3D11_USAGE_DEFAULT;
+	texDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
+	device->CreateTexture2D(&texDesc, 0, shadowTexture.GetAddressOf());
+
+	for (unsigned int c = 0; c < cascadeCount; c++)
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+		dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+		dsvDesc.Texture2DArray.FirstArraySlice = c;
+		dsvDesc.Texture2DArray.ArraySize = 1;
+		device->CreateDepthStencilView(shadowTexture.Get(), &dsvDesc, shadowDSVs[c].GetAddressOf());
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MipLevels = 1;
+	srvDesc.Texture2DArray.ArraySize = cascadeCount;
+	device->CreateShaderResourceView(shadowTexture.Get(), &srvDesc, shadowSRV.GetAddressOf());
+
+	//Depth clipping is off so casters between the light and a cascade are flattened
+	//onto its near plane instead of being cut off
+	D3D11_RASTERIZER_DESC rastDesc = {};
+	rastDesc.FillMode = D3D11_FILL_SOLID;
+	rastDesc.CullMode = D3D11_CULL_BACK;
+	rastDesc.DepthBias = 1000;
+	rastDesc.SlopeScaledDepthBias = 1.0f;
+	rastDesc.DepthClipEnable = false;
+	device->CreateRasterizerState(&rastDesc, shadowRasterizer.GetAddressOf());
+
+	//Past the edge of a cascade counts as lit
+	D3D11_SAMPLER_DESC sampDesc = {};
+	sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
+	sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
+	sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
+	sampDesc.BorderColor[0] = 1.0f;
+	sampDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+	sampDesc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
+	sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	device->CreateSamplerState(&sampDesc, shadowSampler.GetAddressOf());
+}
+
+// --------------------------------------------------------
+// Fits the cascades to the camera and draws the depth of
+// whatever can cast into each of them
+// --------------------------------------------------------
+void Renderer::RenderShadowMaps(std::shared_ptr<Camera> camera)
+{
+	PROFILE_SCOPE("Shadow Maps");
+
+	//Only the first directional light casts shadows, and only into cascades
+	shadowLightIndex = -1;
+	bool castShadows = shadowsEnabled && shadowCascades.GetCascadeCount() > 0;
+	for (unsigned int i = 0; castShadows && i < lights.size() && shadowLightIndex < 0; i++)
+	{
+		if (lights[i].Type == LIGHT_TYPE_DIRECTIONAL)
+			shadowLightIndex = i;
+	}
+	if (shadowLightIndex < 0)
+		return;
+
+	XMFLOAT4X4 proj = camera->GetProjection();
+	shadowCascades.Fit(camera->GetView(), proj._11, proj._22, camera->GetNearClip(), camera->GetFarClip(), lights[shadowLightIndex].Direction);
+
+	D3D11_VIEWPORT oldViewport;
+	UINT viewportCount = 1;
+	context->RSGetViewports(&viewportCount, &oldViewport);
+
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (float)shadowCascades.GetResolution();
+	viewport.Height = (float)shadowCascades.GetResolution();
+	viewport.MaxDepth = 1.0f;
+	context->RSSetViewports(1, &viewport);
+	context->RSSetState(shadowRasterizer.Get());
+
+	//Depth only, so no pixel shader at all
+	shared_ptr<SimpleVertexShader> vs = Assets::GetInstance().GetVertexShader(shadowVSName);
+	vs->SetShader();
+	context->PSSetShader(0, 0, 0);
+
+	for (unsigned int c = 0; c < shadowCascades.GetCascadeCount(); c++)
+	{
+		context->OMSetRenderTargets(0, 0, shadowDSVs[c].Get());
+		context->ClearDepthStencilView(shadowDSVs[c].Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+		vs->SetMatrix4x4("viewProjection", shadowCascades.GetCascade(c).ViewProjection);
+
+		shadowCasterCounts[c] = 0;
+		for (auto& ge : entities)
+		{
+			Transform* transform = ge->GetTransform();
+			XMFLOAT3 scale = transform->GetScale();
+			float radius = ge->GetMesh()->GetBoundingRadius() * max(fabsf(scale.x), max(fabsf(scale.y), fabsf(scale.z)));
+			if (!shadowCascades.IsVisible(c, transform->GetPosition(), radius))
+				continue;
+
+			vs->SetMatrix4x4("world", transform->GetWorldMatrix());
+			vs->CopyAllBufferData();
+			ge->GetMesh()->SetPositionBuffersAndDraw(context);
+			shadowCasterCounts[c]++;
+		}
+	}
+
+	context->RSSetState(0);
+	context->RSSetViewports(1, &oldViewport);
+}
+
+// --------------------------------------------------------
+// Bins the lights into clusters for this camera and uploads
+// the lights and the cluster lists for the PBR shader
+// --------------------------------------------------------
+void Renderer::UpdateLightClusters(std::shared_ptr<Camera> camera)
+{
+	PROFILE_SCOPE("Light Clusters");
+
+	XMFLOAT4X4 proj = camera->GetProjection();
+	lightClusters.Build(lights, camera->GetView(), proj._11, proj._22, camera->GetNearClip(), camera->GetFarClip());
+
+	const vector<LightClusterRange>& ranges = lightClusters.GetRanges();
+	const vector<uint32_t>& indices = lightClusters.GetIndices();
+	uploadedBytes = 0;
+	UploadLights();
+	UploadStructuredBuffer(clusterRangeBuffer, ranges.data(), sizeof(LightClusterRange), (unsigned int)ranges.size());
+	UploadStructuredBuffer(lightIndexBuffer, indices.data(), sizeof(uint32_t), (unsigned int)indices.size());
+}
+
+void Renderer::UploadStructuredBuffer(DynamicStructuredBuffer& buffer, const void* data, unsigned int stride, unsigned int count)
+{
+	//Doubling keeps a growing light count from recreating it every frame
+	if (!buffer.Buffer || count > buffer.Capacity)
+	{
+		buffer.Capacity = max(max(count, buffer.Buffer ? buffer.Capacity * 2 : 0u), 1u);
+		buffer.Buffer.Reset();
+		buffer.SRV.Reset();
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.ByteWidth = stride * buffer.Capacity;
+		desc.StructureByteStride = stride;
+		device->CreateBuffer(&desc, 0, buffer.Buffer.GetAddressOf());
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = buffer.Capacity;
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		device->CreateShaderResourceView(buffer.Buffer.Get(), &srvDesc, buffer.SRV.GetAddressOf());
+	}
+
+	if (count == 0)
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(buffer.Buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+	memcpy(mapped.pData, data, stride * count);
+	context->Unmap(buffer.Buffer.Get(), 0);
+	uploadedBytes += stride * count;
+}
+
+// --------------------------------------------------------
+// Copies only the lights that changed since last frame,
+// or all of them when the buffer has to grow
+// --------------------------------------------------------
+void Renderer::UploadLights()
+{
+	unsigned int count = (unsigned int)lights.size();
+	dirtyLights.Resize(count);
+
+	if (!lightBuffer || count > lightCapacity)
+	{
+		lightCapacity = max(max(count, lightBuffer ? lightCapacity * 2 : 0u), 1u);
+		lightBuffer.Reset();
+		lightSRV.Reset();
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.ByteWidth = sizeof(Light) * lightCapacity;
+		desc.StructureByteStride = sizeof(Light);
+		device->CreateBuffer(&desc, 0, lightBuffer.GetAddressOf());
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = lightCapacity;
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		device->CreateShaderResourceView(lightBuffer.Get(), &srvDesc, lightSRV.GetAddressOf());
+
+		//A new buffer starts out empty
+		dirtyLights.MarkAll();
+	}
+
+	uploadedLightBytes = 0;
+	for (const DirtyRange& range : dirtyLights.GetRanges())
+	{
+		//Buffer boxes are in bytes
+		D3D11_BOX box = {};
+		box.left = range.First * sizeof(Light);
+		box.right = (range.First + range.Count) * sizeof(Light);
+		box.bottom = 1;
+		box.back = 1;
+		context->UpdateSubresource(lightBuffer.Get(), 0, &box, &lights[range.First], 0, 0);
+		uploadedLightBytes += range.Count * sizeof(Light);
+	}
+	dirtyLights.Clear();
+	uploadedBytes += uploadedLightBytes;
+}
+
 void Renderer::DrawPointLights(std::shared_ptr<Camera> camera)
 {
 	Assets* instance = &Assets::GetInstance();
-	shared_ptr<SimpleVertexShader> lightVS = instance->GetVertexShader("VertexShader");
-	shared_ptr<SimplePixelShader> lightPS = instance->GetPixelShader("SolidColorPS");
-	shared_ptr<Mesh> lightMesh = instance->GetMesh("Sphere");
+	shared_ptr<SimpleVertexShader> lightVS = instance->GetVertexShader(lightVSName);
+	shared_ptr<SimplePixelShader> lightPS = instance->GetPixelShader(lightPSName);
+	shared_ptr<Mesh> lightMesh = instance->GetMesh(lightMeshName);
 	// Turn on these shaders
 	lightVS->SetShader();
 	lightPS->SetShader();
 
 	// Set up vertex shader
 	lightVS->SetMatrix4x4("view", camera->GetView());
-	lightPS->SetMatrix4x4("projection", camera->GetProjection());
-
-	for (int i = 0; i < lights.size(); i++)
+	lightVS->SetMatrix4x4("projection", camera->GetProjection());
+	lightVS->CopyAllBufferData();
+
+	//Each sphere is only scaled and moved, so its rows are the identity's
+	//scaled with the position in the last one.  The spheres are drawn in a
+	//solid color, so nothing needs the inverse transpose for normals.
+	lightInstances.clear();
+	for (const Light& light : lights)
 	{
-		Light light = lights[i];
-
 		// Only drawing points, so skip others
 		if (light.Type != LIGHT_TYPE_POINT)
 			continue;
 
 		// Calc quick scale based on range
-		float scale = light.Range / 20.0f;
+		XMVECTOR scale = XMVectorReplicate(light.Range / 20.0f);
+		XMMATRIX world;
+		world.r[0] = XMVectorMultiply(g_XMIdentityR0, scale);
+		world.r[1] = XMVectorMultiply(g_XMIdentityR1, scale);
+		world.r[2] = XMVectorMultiply(g_XMIdentityR2, scale);
+		world.r[3] = XMVectorSelect(g_XMIdentityR3, XMLoadFloat3(&light.Position), g_XMSelect1110);
+
+		LightVolumeInstance instance;
+		XMStoreFloat4x4(&instance.World, world);
+		XMStoreFloat3(&instance.Color, XMVectorScale(XMLoadFloat3(&light.Color), light.Intensity));
+		lightInstances.push_back(instance);
+	}
 
-		// Make the transform for this light
-		XMMATRIX rotMat = XMMatrixIdentity();
-		XMMATRIX scaleMat = XMMatrixScaling(scale, scale, scale);
-		XMMATRIX transMat = XMMatrixTranslation(light.Position.x, light.Position.y, light.Position.z);
-		XMMATRIX worldMat = scaleMat * rotMat * transMat;
+	unsigned int count = (unsigned int)lightInstances.size();
+	if (count == 0)
+		return;
 
-		XMFLOAT4X4 world;
-		XMFLOAT4X4 worldInvTrans;
-		XMStoreFloat4x4(&world, worldMat);
-		XMStoreFloat4x4(&worldInvTrans, XMMatrixInverse(0, XMMatrixTranspose(worldMat)));
+	if (!lightInstanceBuffer || count > lightInstanceCapacity)
+	{
+		lightInstanceCapacity = max(count, lightInstanceCapacity * 2);
+		lightInstanceBuffer.Reset();
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.ByteWidth = sizeof(LightVolumeInstance) * lightInstanceCapacity;
+		device->CreateBuffer(&desc, 0, lightInstanceBuffer.GetAddressOf());
+	}
 
-		// Set up the world matrix for this light
-		lightVS->SetMatrix4x4("world", world);
-		lightVS->SetMatrix4x4("worldInverseTranspose", worldInvTrans);
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(lightInstanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+	memcpy(mapped.pData, lightInstances.data(), sizeof(LightVolumeInstance) * count);
+	context->Unmap(lightInstanceBuffer.Get(), 0);
+	uploadedBytes += sizeof(LightVolumeInstance) * count;
+
+	//The sphere in slot 0, one instance per light in slot 1
+	ID3D11Buffer* vertexBuffers[2] = { lightMesh->GetVertexBuffer().Get(), lightInstanceBuffer.Get() };
+	UINT strides[2] = { sizeof(Vertex), sizeof(LightVolumeInstance) };
+	UINT offsets[2] = { 0, 0 };
+	context->IASetVertexBuffers(0, 2, vertexBuffers, strides, offsets);
+	context->IASetIndexBuffer(lightMesh->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
+	context->DrawIndexedInstanced(lightMesh->GetIndexCount(), count, 0, 0, 0);
+}
 
-		// Set up the pixel shader data
-		XMFLOAT3 finalColor = light.Color;
-		finalColor.x *= light.Intensity;
-		finalColor.y *= light.Intensity;
-		finalColor.z *= light.Intensity;
-		lightPS->SetFloat3("Color", finalColor);
+void Renderer::DrawEmitters(std::shared_ptr<Camera> camera)
+{
+	context->OMSetDepthStencilState(particleDSS.Get(), 0);
 
-		// Copy data
-		lightVS->CopyAllBufferData();
-		lightPS->CopyAllBufferData();
+	// Additive emitters don't care about order, so they go first
+	context->OMSetBlendState(particleBS.Get(), 0, 0xFFFFFFFF);
+	vector<pair<float, Emitter*>> alphaEmitters;
+	XMFLOAT3 camPos = camera->GetTransform()->GetPosition();
+	for (auto& e : emitters)
+	{
+		if (!e->GetAlphaBlended())
+		{
+			e->Draw(camera);
+			continue;
+		}
 
-		// Draw
-		lightMesh->SetBuffersAndDraw(context);
+		XMFLOAT3 pos = e->GetTransform()->GetPosition();
+		float dx = pos.x - camPos.x;
+		float dy = pos.y - camPos.y;
+		float dz = pos.z - camPos.z;
+		alphaEmitters.push_back({ dx * dx + dy * dy + dz * dz, e.get() });
 	}
+
+	// Alpha blended emitters are drawn farthest first
+	sort(alphaEmitters.begin(), alphaEmitters.end(),
+		[](const pair<float, Emitter*>& a, const pair<float, Emitter*>& b) { return a.first > b.first; });
+
+	context->OMSetBlendState(particleAlphaBS.Get(), 0, 0xFFFFFFFF);
+	for (auto& e : alphaEmitters)
+		e.second->Draw(camera);
 }
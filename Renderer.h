@@ -11,6 +11,10 @@
 #include "Lights.h"
 #include "Emitter.h"
 #include "Sky.h"
+#include "GpuProfiler.h"
+#include "LightClusters.h"
+#include "DirtyRanges.h"
+#include "ShadowCascades.h"
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 #include <memory>
 
@@ -27,6 +31,7 @@ enum RenderTargetType
 class Renderer
 {
 public:
+	// A null swap chain and window render offscreen, with no UI and no present
 	Renderer(Microsoft::WRL::ComPtr<ID3D11Device> Device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> Context, Microsoft::WRL::ComPtr<IDXGISwapChain> SwapChain, Microsoft::WRL::ComPtr<ID3D11RenderTargetView> BackBufferRTV,
 		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DepthBufferDSV, unsigned int WindowWidth, unsigned int WindowHeight, std::shared_ptr<Sky> SkyPTR, std::vector<std::shared_ptr<GameEntity>>& Entities, std::vector<std::shared_ptr<Emitter>>& Emitters,
 		std::vector<Light>& Lights, HWND hWnd);
@@ -37,9 +42,44 @@ public:
 		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> backBufferRTV, Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthBufferDSV);
 
 	void Render(std::shared_ptr<Camera> camera, std::vector<std::shared_ptr<Material>> materials, float deltaTime);
+
+	// Lights are only re-uploaded when marked as changed, apart from ones added since
+	// the last frame, so anything editing them in place has to say so
+	void MarkLightDirty(unsigned int index) { dirtyLights.Mark(index); }
+	void MarkAllLightsDirty() { dirtyLights.MarkAll(); }
+
+	// Bytes copied into GPU buffers by the last frame, in total and for lights alone
+	unsigned int GetUploadedBytes() { return uploadedBytes; }
+	unsigned int GetUploadedLightBytes() { return uploadedLightBytes; }
 private:
+	// A structured buffer the CPU rewrites, grown when it runs out of room
+	struct DynamicStructuredBuffer
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> Buffer;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
+		unsigned int Capacity;
+	};
+
+	// One point light's sphere.  Must match LightVolumeVS.hlsl.
+	struct LightVolumeInstance
+	{
+		DirectX::XMFLOAT4X4 World;
+		DirectX::XMFLOAT3 Color;
+	};
+
+	void CreateShadowResources();
+	void RenderShadowMaps(std::shared_ptr<Camera> camera);
+
+	void SortOpaqueDraws(std::shared_ptr<Camera> camera);
+	void DrawDepthPrepass(std::shared_ptr<Camera> camera);
+	void ReadOverdraw();
+
+	void UpdateLightClusters(std::shared_ptr<Camera> camera);
+	void UploadStructuredBuffer(DynamicStructuredBuffer& buffer, const void* data, unsigned int stride, unsigned int count);
+	void UploadLights();
 
 	void DrawPointLights(std::shared_ptr<Camera> camera);
+	void DrawEmitters(std::shared_ptr<Camera> camera);
 
 	void DrawUI(std::vector<std::shared_ptr<Material>> materials, float deltaTime);
 
@@ -52,12 +92,14 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthBufferDSV;
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> particleDSS;
 	Microsoft::WRL::ComPtr<ID3D11BlendState> particleBS;
+	Microsoft::WRL::ComPtr<ID3D11BlendState> particleAlphaBS;
 	std::shared_ptr<DirectX::SpriteFont> arial;
 	std::shared_ptr<DirectX::SpriteBatch> spriteBatch;
 	unsigned int windowWidth;
 	unsigned int windowHeight;
 	int motionBlurNeighborhoodSamples;
 	int motionBlurMax;
+	bool drawUI;
 	std::shared_ptr<Sky> sky;
 	std::vector<std::shared_ptr<GameEntity>>& entities;
 	std::vector<std::shared_ptr<Emitter>>& emitters;
@@ -68,6 +110,51 @@ private:
 
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> ppSampler;
 
+	std::unique_ptr<GpuProfiler> gpuProfiler;
+
+	LightClusters lightClusters;
+	DynamicStructuredBuffer clusterRangeBuffer;
+	DynamicStructuredBuffer lightIndexBuffer;
+
+	// Lights live in a default usage buffer that's patched where they've changed
+	Microsoft::WRL::ComPtr<ID3D11Buffer> lightBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> lightSRV;
+	unsigned int lightCapacity;
+	DirtyRanges dirtyLights;
+	unsigned int uploadedBytes;
+	unsigned int uploadedLightBytes;
+
+	// Opaque entities nearest first, by view depth
+	std::vector<std::pair<float, GameEntity*>> opaqueDraws;
+
+	// With the depth prepass on, the opaque pass only shades the nearest surface
+	bool depthPrepass;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> equalDepthDSS;
+
+	// Pixel shader invocations in the opaque pass, read a few frames late
+	bool countOverdraw;
+	Microsoft::WRL::ComPtr<ID3D11Query> overdrawQueries[GpuProfiler::FrameLatency];
+	bool overdrawPending[GpuProfiler::FrameLatency];
+	unsigned int overdrawFrame;
+	float shadedPerPixel;
+
+	// Time each frame may spend re-convolving the sky's IBL maps, see Sky::UpdateIBL
+	int iblBudgetMicroseconds;
+
+	// Cascaded shadows for the first directional light
+	ShadowCascades shadowCascades;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSVs[MAX_SHADOW_CASCADES];
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizer;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler;
+	bool shadowsEnabled;
+	int shadowLightIndex;
+	unsigned int shadowCasterCounts[MAX_SHADOW_CASCADES];
+
+	std::vector<LightVolumeInstance> lightInstances;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> lightInstanceBuffer;
+	unsigned int lightInstanceCapacity;
+
 	DirectX::XMFLOAT4X4 prevView;
 	DirectX::XMFLOAT4X4 prevProj;
 };
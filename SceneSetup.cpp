@@ -0,0 +1,132 @@
+#include "SceneSetup.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+using namespace DirectX;
+
+// Helper macro for getting a float between min and max
+#define RandomRange(min, max) (float)rand() / RAND_MAX * (max - min) + min
+
+void GenerateSceneLights(std::vector<Light>& lights, unsigned int lightCount, float extent)
+{
+	Light dir1 = {};
+	dir1.Type = LIGHT_TYPE_DIRECTIONAL;
+	dir1.Direction = XMFLOAT3(1, -1, 1);
+	dir1.Color = XMFLOAT3(0.8f, 0.8f, 0.8f);
+	dir1.Intensity = 1.0f;
+
+	Light dir2 = {};
+	dir2.Type = LIGHT_TYPE_DIRECTIONAL;
+	dir2.Direction = XMFLOAT3(-1, -0.25f, 0);
+	dir2.Color = XMFLOAT3(0.2f, 0.2f, 0.2f);
+	dir2.Intensity = 1.0f;
+
+	Light dir3 = {};
+	dir3.Type = LIGHT_TYPE_DIRECTIONAL;
+	dir3.Direction = XMFLOAT3(0, -1, 1);
+	dir3.Color = XMFLOAT3(0.2f, 0.2f, 0.2f);
+	dir3.Intensity = 1.0f;
+
+	Light directional[] = { dir1, dir2, dir3 };
+	for (unsigned int i = 0; i < 3 && i < lightCount; i++)
+		lights.push_back(directional[i]);
+
+	while (lights.size() < lightCount)
+	{
+		Light point = {};
+		point.Type = LIGHT_TYPE_POINT;
+		point.Position = XMFLOAT3(RandomRange(-extent, extent), RandomRange(-5.0f, 5.0f), RandomRange(-extent, extent));
+		point.Color = XMFLOAT3(RandomRange(0, 1), RandomRange(0, 1), RandomRange(0, 1));
+		point.Range = RandomRange(5.0f, 10.0f);
+		point.Intensity = RandomRange(0.1f, 3.0f);
+		lights.push_back(point);
+	}
+}
+
+void LayOutScene(unsigned int entityCount, unsigned int emitterCount, SceneLayout& layout)
+{
+	const float spacing = 2.5f;
+	unsigned int columns = max((unsigned int)ceil(sqrt((float)entityCount)), 1u);
+	float halfWidth = (columns - 1) * spacing * 0.5f;
+	layout.Radius = halfWidth * 1.5f + 10.0f;
+
+	layout.EntityStarts.clear();
+	for (unsigned int i = 0; i < entityCount; i++)
+		layout.EntityStarts.push_back(XMFLOAT3((i % columns) * spacing - halfWidth, 0, (i / columns) * spacing - halfWidth));
+
+	layout.Emitters.clear();
+	for (unsigned int i = 0; i < emitterCount; i++)
+	{
+		SceneEmitter emitter = {};
+		switch (i % 3)
+		{
+		case 0:
+			emitter.MaxParticles = 50;
+			emitter.ParticlesPerSecond = 2;
+			emitter.Lifetime = 2.5f;
+			break;
+		case 1:
+			emitter.MaxParticles = 400;
+			emitter.ParticlesPerSecond = 75;
+			emitter.Lifetime = 4;
+			emitter.StartingVelocity = XMFLOAT3(2.0f, 4.0f, 0.0f);
+			emitter.VelocityRange = XMFLOAT3(.5f, .5f, 0);
+			emitter.Acceleration = XMFLOAT3(0.0f, -3.0f, 0.0f);
+			emitter.GPUSimulated = true;
+			break;
+		default:
+			emitter.MaxParticles = 50;
+			emitter.ParticlesPerSecond = 3;
+			emitter.Lifetime = 2.5f;
+			emitter.Sorted = true;
+			break;
+		}
+
+		float angle = XM_2PI * i / emitterCount;
+		emitter.Position = XMFLOAT3(cos(angle) * (halfWidth + 3.0f), -3.0f, sin(angle) * (halfWidth + 3.0f));
+		layout.Emitters.push_back(emitter);
+	}
+}
+
+DirectX::XMFLOAT3 GetSceneEntityPosition(const SceneLayout& layout, size_t entity, float totalTime)
+{
+	XMFLOAT3 start = layout.EntityStarts[entity];
+	if (!IsSceneEntitySpinning(entity))
+		start.y += sin(totalTime * 2.0f + entity) * 0.5f;
+	return start;
+}
+
+bool IsSceneEntitySpinning(size_t entity)
+{
+	return entity % 3 == 0;
+}
+
+void GetSceneCamera(const SceneLayout& layout, float totalTime, DirectX::XMFLOAT3& position, float& pitch, float& yaw)
+{
+	float angle = totalTime * 0.25f;
+	position = XMFLOAT3(sin(angle) * layout.Radius, 3.0f, -cos(angle) * layout.Radius);
+	pitch = 0.15f;
+	yaw = -angle;
+}
+
+void BuildViewMatrix(const DirectX::XMFLOAT3& position, float pitch, float yaw, DirectX::XMFLOAT4X4& view)
+{
+	XMFLOAT3 z(sinf(yaw) * cosf(pitch), -sinf(pitch), cosf(yaw) * cosf(pitch));
+
+	//x = normalize(cross(up, z)), and y = cross(z, x) is already unit length
+	XMFLOAT3 x(z.z, 0, -z.x);
+	float length = sqrtf(x.x * x.x + x.z * x.z);
+	x.x /= length;
+	x.z /= length;
+	XMFLOAT3 y(z.y * x.z - z.z * x.y, z.z * x.x - z.x * x.z, z.x * x.y - z.y * x.x);
+
+	view = XMFLOAT4X4(
+		x.x, y.x, z.x, 0,
+		x.y, y.y, z.y, 0,
+		x.z, y.z, z.z, 0,
+		-(x.x * position.x + x.y * position.y + x.z * position.z),
+		-(y.x * position.x + y.y * position.y + y.z * position.z),
+		-(z.x * position.x + z.y * position.y + z.z * position.z), 1);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cstddef>
+#include <vector>
+
+#include "Lights.h"
+
+// One of the game's emitters as a benchmark scene places it.  The game has three kinds:
+// CPU simulated, GPU simulated, and sorted alpha blended.
+struct SceneEmitter
+{
+	int MaxParticles;
+	int ParticlesPerSecond;
+	float Lifetime;
+	DirectX::XMFLOAT3 Position;
+	DirectX::XMFLOAT3 StartingVelocity;
+	DirectX::XMFLOAT3 VelocityRange;
+	DirectX::XMFLOAT3 Acceleration;
+	bool GPUSimulated;
+	bool Sorted;
+};
+
+// Where everything in a benchmark scene goes, for a number of entities and emitters
+struct SceneLayout
+{
+	std::vector<DirectX::XMFLOAT3> EntityStarts;
+	std::vector<SceneEmitter> Emitters;
+	// The camera orbits at this distance, outside the grid
+	float Radius;
+};
+
+// The scene the game and both benchmarks build, so the windowed benchmark, the headless
+// one and the game itself all light and lay out the same things.  Plain C++ with no D3D.
+
+// The game's three directional lights (as many as lightCount allows), then point lights
+// from rand() until there are lightCount, spread extent out from the origin across and
+// 5 units up and down
+void GenerateSceneLights(std::vector<Light>& lights, unsigned int lightCount, float extent);
+
+// Spheres on a square grid, and the emitters in a ring around it cycling through the three kinds
+void LayOutScene(unsigned int entityCount, unsigned int emitterCount, SceneLayout& layout);
+
+// Every third entity spins in place, the rest bob up and down
+DirectX::XMFLOAT3 GetSceneEntityPosition(const SceneLayout& layout, size_t entity, float totalTime);
+bool IsSceneEntitySpinning(size_t entity);
+
+// The camera orbiting the grid and looking slightly down, as a Transform's position,
+// pitch and yaw
+void GetSceneCamera(const SceneLayout& layout, float totalTime, DirectX::XMFLOAT3& position, float& pitch, float& yaw);
+
+// What Camera::UpdateViewMatrix builds from a Transform with this position, pitch and
+// yaw (XMMatrixLookToLH), written out since the portable build has no XMMATRIX
+void BuildViewMatrix(const DirectX::XMFLOAT3& position, float pitch, float yaw, DirectX::XMFLOAT4X4& view);
@@ -0,0 +1,163 @@
+#include "ShaderPermutations.h"
+#include "Lights.h"
+#include <d3dcompiler.h>
+#include <experimental/filesystem>
+#include <cstdio>
+
+using namespace std;
+
+ShaderPermutations::ShaderPermutations()
+{
+	compileCount = 0;
+}
+
+void ShaderPermutations::Initialize(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::wstring compiledDirectory)
+{
+	this->device = device;
+	this->context = context;
+	this->compiledDirectory = compiledDirectory;
+	pixelShaders.clear();
+}
+
+std::shared_ptr<SimplePixelShader> ShaderPermutations::GetPixelShader(const std::string& name, ShaderFeatures features)
+{
+	auto& loaded = pixelShaders[name];
+	auto existing = loaded.find(features);
+	if (existing != loaded.end())
+		return existing->second;
+
+	Microsoft::WRL::ComPtr<ID3DBlob> blob;
+	if (!LoadBlob(name, features, true, blob))
+		return 0;
+
+	shared_ptr<SimplePixelShader> ps = make_shared<SimplePixelShader>(device, context, blob);
+	if (!ps->IsShaderValid())
+		return 0;
+
+	loaded[features] = ps;
+	return ps;
+}
+
+void ShaderPermutations::Reload(const std::string& name)
+{
+	auto loaded = pixelShaders.find(name);
+	if (loaded == pixelShaders.end())
+		return;
+
+	//Rebuilt in place like the shader itself, keeping the old code if the source doesn't compile
+	for (auto& permutation : loaded->second)
+	{
+		Microsoft::WRL::ComPtr<ID3DBlob> blob;
+		if (LoadBlob(name, permutation.first, false, blob))
+			permutation.second->LoadShaderBlob(blob);
+	}
+}
+
+size_t ShaderPermutations::GetPermutationCount()
+{
+	size_t count = 0;
+	for (auto& shader : pixelShaders)
+		count += shader.second.size();
+	return count;
+}
+
+unsigned int ShaderPermutations::GetLightCapacity(ShaderFeatures features)
+{
+	switch (features & SHADER_LIGHTS_MASK)
+	{
+	case SHADER_LIGHTS_8: return 8;
+	case SHADER_LIGHTS_32: return 32;
+	default: return 0;
+	}
+}
+
+std::vector<std::pair<std::string, std::string>> ShaderPermutations::GetDefines(ShaderFeatures features)
+{
+	vector<pair<string, string>> defines = { { "PERMUTATION", "1" } };
+	if (features & SHADER_NORMAL_MAP)
+		defines.push_back({ "NORMAL_MAP", "1" });
+	if (features & SHADER_IBL)
+		defines.push_back({ "IBL", "1" });
+	if (features & SHADER_MOTION_VECTORS)
+		defines.push_back({ "MOTION_VECTORS", "1" });
+	if (features & SHADER_PACKED_RMA)
+		defines.push_back({ "PACKED_RMA", "1" });
+	if (features & SHADER_SHADOWS)
+		defines.push_back({ "SHADOWS", "1" });
+	if (features & SHADER_LIGHTS_MASK)
+		defines.push_back({ "MAX_LIGHTS", to_string(GetLightCapacity(features)) });
+	return defines;
+}
+
+bool ShaderPermutations::LoadBlob(const std::string& name, ShaderFeatures features, bool allowSaved, Microsoft::WRL::ComPtr<ID3DBlob>& blob)
+{
+	wstring wideName(name.begin(), name.end());
+	wstring savedPath = GetSavedPath(name, features);
+	wstring sourcePath = sourceDirectory + L"\\" + wideName + L".hlsl";
+	bool haveSource = !sourceDirectory.empty() && experimental::filesystem::exists(sourcePath);
+
+	if (allowSaved && experimental::filesystem::exists(savedPath))
+	{
+		//Only stale if there is a source to compile it again from
+		error_code savedError;
+		error_code shaderError;
+		auto savedTime = experimental::filesystem::last_write_time(savedPath, savedError);
+		auto shaderTime = experimental::filesystem::last_write_time(compiledDirectory + L"\\" + wideName + L".cso", shaderError);
+		bool stale = haveSource && !savedError && !shaderError && savedTime < shaderTime;
+
+		if (!stale && D3DReadFileToBlob(savedPath.c_str(), blob.ReleaseAndGetAddressOf()) == S_OK)
+			return true;
+	}
+
+	if (!haveSource || !Compile(name, features, blob))
+		return false;
+
+	D3DWriteBlobToFile(blob.Get(), savedPath.c_str(), TRUE);
+	return true;
+}
+
+bool ShaderPermutations::Compile(const std::string& name, ShaderFeatures features, Microsoft::WRL::ComPtr<ID3DBlob>& blob)
+{
+	vector<pair<string, string>> defines = GetDefines(features);
+	vector<D3D_SHADER_MACRO> macros;
+	for (auto& define : defines)
+		macros.push_back({ define.first.c_str(), define.second.c_str() });
+	macros.push_back({ 0, 0 });
+
+	//Same settings the project builds its .cso files with
+	UINT flags = 0;
+#if defined(DEBUG) || defined(_DEBUG)
+	flags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+
+	wstring sourcePath = sourceDirectory + L"\\" + wstring(name.begin(), name.end()) + L".hlsl";
+	Microsoft::WRL::ComPtr<ID3DBlob> errors;
+	HRESULT hr = D3DCompileFromFile(
+		sourcePath.c_str(),
+		macros.data(),
+		D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		"main",
+		"ps_5_0",
+		flags,
+		0,
+		blob.ReleaseAndGetAddressOf(),
+		errors.GetAddressOf());
+
+	if (FAILED(hr))
+	{
+		printf("Failed to compile %s permutation %02x\n", name.c_str(), features);
+		if (errors)
+			printf("%s\n", (const char*)errors->GetBufferPointer());
+		return false;
+	}
+
+	compileCount++;
+	return true;
+}
+
+std::wstring ShaderPermutations::GetSavedPath(const std::string& name, ShaderFeatures features)
+{
+	wchar_t key[16];
+	swprintf_s(key, L"_%02x", features);
+	return compiledDirectory + L"\\" + wstring(name.begin(), name.end()) + key + L".permutation";
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "SimpleShader.h"
+
+// Optional parts of a shader, each compiled in with a #define.  The shader's own .cso
+// is built without PERMUTATION and has SHADER_DEFAULT_FEATURES.
+enum ShaderFeature
+{
+	SHADER_NORMAL_MAP		= 1 << 0,
+	SHADER_IBL				= 1 << 1,
+	SHADER_MOTION_VECTORS	= 1 << 2,
+	SHADER_PACKED_RMA		= 1 << 3,
+
+	// Most lights shaded per pixel, every light in the pixel's cluster when neither is set
+	SHADER_LIGHTS_8			= 1 << 4,
+	SHADER_LIGHTS_32		= 2 << 4,
+	SHADER_LIGHTS_MASK		= 3 << 4,
+
+	// The shadowing directional light's cascades are sampled
+	SHADER_SHADOWS			= 1 << 6,
+
+	SHADER_DEFAULT_FEATURES = SHADER_NORMAL_MAP | SHADER_IBL | SHADER_MOTION_VECTORS | SHADER_SHADOWS
+};
+typedef uint32_t ShaderFeatures;
+
+// Variations of one shader source, looked up by a bitmask of features so each
+// material only pays for what it uses.  A permutation is compiled from the .hlsl
+// the first time it's asked for and saved next to the .cso files as
+// <name>_<features>.permutation, so later runs (or builds shipped without the
+// sources) load it instead.  Saved ones older than the shader's .cso, which the
+// build remakes whenever the source or its includes change, are compiled again.
+class ShaderPermutations
+{
+public:
+	ShaderPermutations();
+
+	void Initialize(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::wstring compiledDirectory);
+	void SetSourceDirectory(std::wstring directory) { sourceDirectory = directory; }
+
+	// The named pixel shader (as with Assets, its file name without .cso) built with
+	// the given features, or null when it can't be loaded or compiled
+	std::shared_ptr<SimplePixelShader> GetPixelShader(const std::string& name, ShaderFeatures features);
+
+	// Recompiles the loaded permutations of a shader in place, for hot reload
+	void Reload(const std::string& name);
+
+	size_t GetPermutationCount();
+	unsigned int GetCompileCount() { return compileCount; }
+
+	// How many lights a permutation shades per pixel, zero for no limit
+	static unsigned int GetLightCapacity(ShaderFeatures features);
+	static std::vector<std::pair<std::string, std::string>> GetDefines(ShaderFeatures features);
+
+private:
+	bool LoadBlob(const std::string& name, ShaderFeatures features, bool allowSaved, Microsoft::WRL::ComPtr<ID3DBlob>& blob);
+	bool Compile(const std::string& name, ShaderFeatures features, Microsoft::WRL::ComPtr<ID3DBlob>& blob);
+	std::wstring GetSavedPath(const std::string& name, ShaderFeatures features);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	std::wstring compiledDirectory;
+	std::wstring sourceDirectory;
+	unsigned int compileCount;
+
+	// Shader name to its loaded permutations
+	std::unordered_map<std::string, std::unordered_map<ShaderFeatures, std::shared_ptr<SimplePixelShader>>> pixelShaders;
+};
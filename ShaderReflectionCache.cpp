@@ -0,0 +1,266 @@
+#include "ShaderReflectionCache.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace std;
+
+static const uint32_t cacheMagic = 0x43525353;	// "SSRC"
+static const uint32_t cacheVersion = 1;
+
+// Appends little endian fields, which is what every target here is
+struct ByteWriter
+{
+	vector<uint8_t>& Bytes;
+
+	void Write(uint32_t value) { WriteRaw(&value, sizeof(value)); }
+	void Write64(uint64_t value) { WriteRaw(&value, sizeof(value)); }
+	void Write(const string& text)
+	{
+		Write((uint32_t)text.size());
+		WriteRaw(text.data(), text.size());
+	}
+	void WriteRaw(const void* data, size_t size)
+	{
+		const uint8_t* start = (const uint8_t*)data;
+		Bytes.insert(Bytes.end(), start, start + size);
+	}
+};
+
+// Reads fields back, failing (and staying failed) on anything past the end
+struct ByteReader
+{
+	const uint8_t* Bytes;
+	size_t Size;
+	size_t Position;
+	bool Failed;
+
+	uint32_t Read()
+	{
+		uint32_t value = 0;
+		ReadRaw(&value, sizeof(value));
+		return value;
+	}
+	uint64_t Read64()
+	{
+		uint64_t value = 0;
+		ReadRaw(&value, sizeof(value));
+		return value;
+	}
+	string ReadString()
+	{
+		uint32_t length = Read();
+		if (Failed || length > Size - Position)
+		{
+			Failed = true;
+			return "";
+		}
+		string text((const char*)Bytes + Position, length);
+		Position += length;
+		return text;
+	}
+	// Counts are checked against what's left, so a damaged count can't ask for gigabytes
+	uint32_t ReadCount(size_t minimumItemSize)
+	{
+		uint32_t count = Read();
+		if (Failed || count > (Size - Position) / minimumItemSize)
+		{
+			Failed = true;
+			return 0;
+		}
+		return count;
+	}
+	void ReadRaw(void* data, size_t size)
+	{
+		if (Failed || size > Size - Position)
+		{
+			Failed = true;
+			return;
+		}
+		memcpy(data, Bytes + Position, size);
+		Position += size;
+	}
+};
+
+uint64_t ShaderReflectionCache::HashBlob(const void* data, size_t size)
+{
+	//FNV-1a, with the size mixed in so a truncated blob can't collide with its prefix
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash ^ ((uint64_t)size * 1099511628211ull);
+}
+
+bool ShaderReflectionCache::Find(uint64_t hash, ShaderReflection& reflection)
+{
+	lock_guard<mutex> lock(entryMutex);
+	auto entry = entries.find(hash);
+	if (entry == entries.end())
+		return false;
+
+	reflection = entry->second;
+	return true;
+}
+
+void ShaderReflectionCache::Store(uint64_t hash, const ShaderReflection& reflection)
+{
+	lock_guard<mutex> lock(entryMutex);
+	entries[hash] = reflection;
+	dirty = true;
+}
+
+size_t ShaderReflectionCache::GetEntryCount()
+{
+	lock_guard<mutex> lock(entryMutex);
+	return entries.size();
+}
+
+bool ShaderReflectionCache::Load(const std::string& path)
+{
+	ifstream file(path, ios::binary);
+	if (!file.is_open())
+		return false;
+
+	vector<uint8_t> bytes((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+	return Deserialize(bytes.data(), bytes.size());
+}
+
+bool ShaderReflectionCache::Save(const std::string& path)
+{
+	vector<uint8_t> bytes;
+	Serialize(bytes);
+
+	ofstream file(path, ios::binary);
+	if (!file.is_open())
+		return false;
+
+	file.write((const char*)bytes.data(), bytes.size());
+	if (!file.good())
+		return false;
+
+	dirty = false;
+	return true;
+}
+
+void ShaderReflectionCache::Serialize(std::vector<uint8_t>& bytes)
+{
+	lock_guard<mutex> lock(entryMutex);
+
+	bytes.clear();
+	ByteWriter writer = { bytes };
+	writer.Write(cacheMagic);
+	writer.Write(cacheVersion);
+	writer.Write((uint32_t)entries.size());
+
+	for (auto& entry : entries)
+	{
+		const ShaderReflection& r = entry.second;
+		writer.Write64(entry.first);
+		writer.Write(r.Version);
+		for (int i = 0; i < 3; i++)
+			writer.Write(r.ThreadGroupSize[i]);
+
+		writer.Write((uint32_t)r.Resources.size());
+		for (auto& resource : r.Resources)
+		{
+			writer.Write(resource.Name);
+			writer.Write(resource.Type);
+			writer.Write(resource.BindIndex);
+		}
+
+		writer.Write((uint32_t)r.Buffers.size());
+		for (auto& buffer : r.Buffers)
+		{
+			writer.Write(buffer.Name);
+			writer.Write(buffer.Type);
+			writer.Write(buffer.Size);
+			writer.Write(buffer.BindIndex);
+			writer.Write((uint32_t)buffer.Variables.size());
+			for (auto& variable : buffer.Variables)
+			{
+				writer.Write(variable.Name);
+				writer.Write(variable.ByteOffset);
+				writer.Write(variable.Size);
+			}
+		}
+
+		writer.Write((uint32_t)r.Inputs.size());
+		for (auto& input : r.Inputs)
+		{
+			writer.Write(input.SemanticName);
+			writer.Write(input.SemanticIndex);
+			writer.Write(input.ComponentType);
+			writer.Write(input.Mask);
+		}
+	}
+}
+
+bool ShaderReflectionCache::Deserialize(const uint8_t* bytes, size_t size)
+{
+	//Smallest encodings: an empty name plus its fields, or an empty entry
+	const size_t minResource = 12;
+	const size_t minBuffer = 20;
+	const size_t minVariable = 12;
+	const size_t minInput = 16;
+	const size_t minEntry = 36;
+
+	ByteReader reader = { bytes, size, 0, false };
+	if (reader.Read() != cacheMagic || reader.Read() != cacheVersion)
+		return false;
+
+	unordered_map<uint64_t, ShaderReflection> loaded;
+	uint32_t entryCount = reader.ReadCount(minEntry);
+	for (uint32_t e = 0; e < entryCount && !reader.Failed; e++)
+	{
+		uint64_t hash = reader.Read64();
+		ShaderReflection& r = loaded[hash];
+		r.Version = reader.Read();
+		for (int i = 0; i < 3; i++)
+			r.ThreadGroupSize[i] = reader.Read();
+
+		r.Resources.resize(reader.ReadCount(minResource));
+		for (auto& resource : r.Resources)
+		{
+			resource.Name = reader.ReadString();
+			resource.Type = reader.Read();
+			resource.BindIndex = reader.Read();
+		}
+
+		r.Buffers.resize(reader.ReadCount(minBuffer));
+		for (auto& buffer : r.Buffers)
+		{
+			buffer.Name = reader.ReadString();
+			buffer.Type = reader.Read();
+			buffer.Size = reader.Read();
+			buffer.BindIndex = reader.Read();
+			buffer.Variables.resize(reader.ReadCount(minVariable));
+			for (auto& variable : buffer.Variables)
+			{
+				variable.Name = reader.ReadString();
+				variable.ByteOffset = reader.Read();
+				variable.Size = reader.Read();
+			}
+		}
+
+		r.Inputs.resize(reader.ReadCount(minInput));
+		for (auto& input : r.Inputs)
+		{
+			input.SemanticName = reader.ReadString();
+			input.SemanticIndex = reader.Read();
+			input.ComponentType = reader.Read();
+			input.Mask = reader.Read();
+		}
+	}
+
+	if (reader.Failed || reader.Position != size)
+		return false;
+
+	lock_guard<mutex> lock(entryMutex);
+	entries.swap(loaded);
+	dirty = false;
+	return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+// A variable inside a constant buffer
+struct ReflectedVariable
+{
+	std::string Name;
+	uint32_t ByteOffset;
+	uint32_t Size;
+};
+
+// A constant buffer (or tbuffer), Type being its D3D_CBUFFER_TYPE
+struct ReflectedBuffer
+{
+	std::string Name;
+	uint32_t Type;
+	uint32_t Size;
+	uint32_t BindIndex;
+	std::vector<ReflectedVariable> Variables;
+};
+
+// A bound resource, Type being its D3D_SHADER_INPUT_TYPE
+struct ReflectedResource
+{
+	std::string Name;
+	uint32_t Type;
+	uint32_t BindIndex;
+};
+
+// A vertex shader input, for building the input layout
+struct ReflectedInput
+{
+	std::string SemanticName;
+	uint32_t SemanticIndex;
+	uint32_t ComponentType;
+	uint32_t Mask;
+};
+
+// Everything SimpleShader reads from D3DReflect, in plain data
+struct ShaderReflection
+{
+	uint32_t Version = 0;	// D3D11_SHADER_DESC::Version, which holds the shader type
+	uint32_t ThreadGroupSize[3] = {};
+	std::vector<ReflectedResource> Resources;
+	std::vector<ReflectedBuffer> Buffers;
+	std::vector<ReflectedInput> Inputs;
+};
+
+// Remembers the reflection of compiled shaders by a hash of their bytecode, so
+// shaders seen before skip D3DReflect.  Saved as one small binary file; a file that
+// is missing, from another format version or damaged just starts the cache empty.
+// Plain C++ with no D3D, so the format can be checked anywhere.
+class ShaderReflectionCache
+{
+public:
+	static uint64_t HashBlob(const void* data, size_t size);
+
+	bool Find(uint64_t hash, ShaderReflection& reflection);
+	void Store(uint64_t hash, const ShaderReflection& reflection);
+	size_t GetEntryCount();
+
+	bool Load(const std::string& path);
+	bool Save(const std::string& path);
+	// True when there are entries the file doesn't have yet
+	bool IsDirty() { return dirty; }
+
+	void Serialize(std::vector<uint8_t>& bytes);
+	bool Deserialize(const uint8_t* bytes, size_t size);
+
+private:
+	std::unordered_map<uint64_t, ShaderReflection> entries;
+	std::mutex entryMutex;
+	bool dirty = false;
+};
@@ -0,0 +1,158 @@
+#include "ShadowCascades.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+static float Dot(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static DirectX::XMFLOAT3 Cross(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+{
+	return DirectX::XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+static DirectX::XMFLOAT3 Normalize(const DirectX::XMFLOAT3& v)
+{
+	float length = sqrt(Dot(v, v));
+	return length > 0 ? DirectX::XMFLOAT3(v.x / length, v.y / length, v.z / length) : DirectX::XMFLOAT3(0, 0, 1);
+}
+
+ShadowCascades::ShadowCascades(unsigned int CascadeCount, unsigned int Resolution)
+	:
+	cascadeCount(min(max(CascadeCount, 1u), (unsigned int)MAX_SHADOW_CASCADES)),
+	resolution(max(Resolution, 2u)),
+	splitLambda(0.75f),
+	shadowDistance(50.0f),
+	lightView(),
+	cascades()
+{
+}
+
+void ShadowCascades::ComputeSplits(unsigned int cascadeCount, float nearClip, float farClip, float lambda, float* splits)
+{
+	for (unsigned int i = 0; i <= cascadeCount; i++)
+	{
+		float t = i / (float)cascadeCount;
+		float logarithmic = nearClip * pow(farClip / nearClip, t);
+		float uniform = nearClip + (farClip - nearClip) * t;
+		splits[i] = lambda * logarithmic + (1.0f - lambda) * uniform;
+	}
+
+	//Exactly the clip planes, whatever pow rounds to
+	splits[0] = nearClip;
+	splits[cascadeCount] = farClip;
+}
+
+void ShadowCascades::Fit(const DirectX::XMFLOAT4X4& view, float projectionX, float projectionY, float nearClip, float farClip, const DirectX::XMFLOAT3& lightDirection)
+{
+	//The light looks along its direction, with whichever up isn't parallel to it
+	DirectX::XMFLOAT3 forward = Normalize(lightDirection);
+	DirectX::XMFLOAT3 up = fabs(forward.y) > 0.99f ? DirectX::XMFLOAT3(0, 0, 1) : DirectX::XMFLOAT3(0, 1, 0);
+	DirectX::XMFLOAT3 right = Normalize(Cross(up, forward));
+	up = Cross(forward, right);
+
+	lightView = DirectX::XMFLOAT4X4();
+	const DirectX::XMFLOAT3 axes[3] = { right, up, forward };
+	for (int a = 0; a < 3; a++)
+	{
+		lightView.m[0][a] = axes[a].x;
+		lightView.m[1][a] = axes[a].y;
+		lightView.m[2][a] = axes[a].z;
+	}
+	lightView.m[3][3] = 1;
+
+	//Camera position and forward in world space, out of the view matrix's rotation and translation
+	DirectX::XMFLOAT3 cameraPosition;
+	float* position = &cameraPosition.x;
+	for (int i = 0; i < 3; i++)
+		position[i] = -(view.m[3][0] * view.m[i][0] + view.m[3][1] * view.m[i][1] + view.m[3][2] * view.m[i][2]);
+	DirectX::XMFLOAT3 cameraForward(view.m[0][2], view.m[1][2], view.m[2][2]);
+
+	float splits[MAX_SHADOW_CASCADES + 1];
+	float end = shadowDistance > nearClip ? min(shadowDistance, farClip) : farClip;
+	ComputeSplits(cascadeCount, nearClip, end, splitLambda, splits);
+
+	//Squared distance from the view axis to a frustum corner, per unit of depth
+	float cornerSlope = 1.0f / (projectionX * projectionX) + 1.0f / (projectionY * projectionY);
+
+	for (unsigned int c = 0; c < cascadeCount; c++)
+	{
+		ShadowCascade& cascade = cascades[c];
+		float n = splits[c];
+		float f = splits[c + 1];
+		cascade.SplitNear = n;
+		cascade.SplitFar = f;
+
+		//The smallest sphere through the near and far corners is centred on the view axis,
+		//or at the far plane when the slice is wide enough that the far corners decide it
+		float centerDepth = (f + n) * (1.0f + cornerSlope) * 0.5f;
+		float radius;
+		if (centerDepth >= f)
+		{
+			centerDepth = f;
+			radius = f * sqrt(cornerSlope);
+		}
+		else
+			radius = sqrt((centerDepth - n) * (centerDepth - n) + n * n * cornerSlope);
+
+		//Rounded up so float noise can't change the texel size from frame to frame
+		radius = ceil(radius * 16.0f) / 16.0f;
+		cascade.Radius = radius;
+		cascade.Center = DirectX::XMFLOAT3(
+			cameraPosition.x + cameraForward.x * centerDepth,
+			cameraPosition.y + cameraForward.y * centerDepth,
+			cameraPosition.z + cameraForward.z * centerDepth);
+
+		//One texel is left spare across the map, so the sphere still fits after the bounds
+		//are snapped down to whole texels
+		float texelSize = 2.0f * radius / (resolution - 1);
+		float width = texelSize * resolution;
+		cascade.TexelSize = texelSize;
+
+		float lightX = Dot(cascade.Center, right);
+		float lightY = Dot(cascade.Center, up);
+		float lightZ = Dot(cascade.Center, forward);
+		cascade.MinX = floor((lightX - radius) / texelSize) * texelSize;
+		cascade.MaxX = cascade.MinX + width;
+		cascade.MinY = floor((lightY - radius) / texelSize) * texelSize;
+		cascade.MaxY = cascade.MinY + width;
+		cascade.MinZ = lightZ - radius;
+		cascade.MaxZ = lightZ + radius;
+
+		//Off centre orthographic projection of those bounds, after the light's rotation
+		float depth = cascade.MaxZ - cascade.MinZ;
+		float projection[4][4] = {
+			{ 2.0f / width, 0, 0, 0 },
+			{ 0, 2.0f / width, 0, 0 },
+			{ 0, 0, 1.0f / depth, 0 },
+			{ -(cascade.MaxX + cascade.MinX) / width, -(cascade.MaxY + cascade.MinY) / width, -cascade.MinZ / depth, 1 } };
+
+		for (int i = 0; i < 4; i++)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				float sum = 0;
+				for (int k = 0; k < 4; k++)
+					sum += lightView.m[i][k] * projection[k][j];
+				cascade.ViewProjection.m[i][j] = sum;
+			}
+		}
+	}
+}
+
+bool ShadowCascades::IsVisible(unsigned int cascade, const DirectX::XMFLOAT3& center, float radius)
+{
+	const ShadowCascade& bounds = cascades[cascade];
+	float x = center.x * lightView.m[0][0] + center.y * lightView.m[1][0] + center.z * lightView.m[2][0];
+	float y = center.x * lightView.m[0][1] + center.y * lightView.m[1][1] + center.z * lightView.m[2][1];
+	float z = center.x * lightView.m[0][2] + center.y * lightView.m[1][2] + center.z * lightView.m[2][2];
+
+	//Anything nearer the light than the cascade can still shadow it, so only the far side counts
+	return
+		x + radius >= bounds.MinX && x - radius <= bounds.MaxX &&
+		y + radius >= bounds.MinY && y - radius <= bounds.MaxY &&
+		z - radius <= bounds.MaxZ;
+}
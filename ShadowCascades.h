@@ -0,0 +1,74 @@
+#pragma once
+#include <DirectXMath.h>
+
+// Most cascades a directional light can have.  Must match MAX_SHADOW_CASCADES in PixelShaderPBR.hlsl.
+#define MAX_SHADOW_CASCADES 4
+
+struct ShadowCascade
+{
+	// The slice of the camera's view it covers, as view depth
+	float SplitNear;
+	float SplitFar;
+
+	// Sphere around that slice of the frustum.  Its size only depends on the projection
+	// and the splits, so it doesn't change as the camera turns.
+	DirectX::XMFLOAT3 Center;
+	float Radius;
+
+	// World units across one shadow map texel
+	float TexelSize;
+
+	// Bounds in the light's view space.  There's no near bound: casters between the light
+	// and the cascade are clamped onto its near plane instead of being clipped.
+	float MinX;
+	float MaxX;
+	float MinY;
+	float MaxY;
+	float MinZ;
+	float MaxZ;
+
+	// The light's view then this cascade's orthographic projection, row vectors like the Camera's
+	DirectX::XMFLOAT4X4 ViewProjection;
+};
+
+// Fits cascaded shadow maps for one directional light to a camera.  The view is split
+// into slices between uniform and logarithmic spacing, and each slice gets a square
+// orthographic projection around its bounding sphere.  Projections are moved in whole
+// texels of the light's view, so shadow edges don't crawl as the camera moves.
+//
+// Everything is plain math on the camera's matrices, so nothing here needs D3D.
+class ShadowCascades
+{
+public:
+	ShadowCascades(unsigned int CascadeCount = MAX_SHADOW_CASCADES, unsigned int Resolution = 2048);
+
+	// 0 for evenly spaced splits, 1 for logarithmic ones
+	void SetSplitLambda(float lambda) { splitLambda = lambda; }
+	// Shadows end at this view depth, or at the far clip if it's closer
+	void SetShadowDistance(float distance) { shadowDistance = distance; }
+
+	// The view matrix as the Camera stores it (row vectors), the projection's x and y scale
+	// (_11 and _22), its clip planes and the direction the light travels in
+	void Fit(const DirectX::XMFLOAT4X4& view, float projectionX, float projectionY, float nearClip, float farClip, const DirectX::XMFLOAT3& lightDirection);
+
+	// Whether a bounding sphere in world space could cast a shadow into a cascade
+	bool IsVisible(unsigned int cascade, const DirectX::XMFLOAT3& center, float radius);
+
+	// cascadeCount + 1 view depths, from nearClip to farClip
+	static void ComputeSplits(unsigned int cascadeCount, float nearClip, float farClip, float lambda, float* splits);
+
+	unsigned int GetCascadeCount() { return cascadeCount; }
+	unsigned int GetResolution() { return resolution; }
+	const ShadowCascade& GetCascade(unsigned int cascade) { return cascades[cascade]; }
+	// Rotation only, shared by every cascade
+	const DirectX::XMFLOAT4X4& GetLightView() { return lightView; }
+
+private:
+	unsigned int cascadeCount;
+	unsigned int resolution;
+	float splitLambda;
+	float shadowDistance;
+
+	DirectX::XMFLOAT4X4 lightView;
+	ShadowCascade cascades[MAX_SHADOW_CASCADES];
+};
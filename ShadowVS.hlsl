@@ -0,0 +1,14 @@
+cbuffer externalData : register(b0)
+{
+	matrix world;
+	matrix viewProjection;
+};
+
+// --------------------------------------------------------
+// Depth only, for one shadow cascade.  Reads the mesh's
+// position only stream rather than whole vertices.
+// --------------------------------------------------------
+float4 main(float3 position : POSITION) : SV_POSITION
+{
+	return mul(viewProjection, mul(world, float4(position, 1.0f)));
+}
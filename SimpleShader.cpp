@@ -4,6 +4,9 @@
 bool ISimpleShader::ReportErrors = false;
 bool ISimpleShader::ReportWarnings = false;
 
+// No reflection cache unless the program sets one
+ShaderReflectionCache* ISimpleShader::ReflectionCache = 0;
+
 // To enable error reporting, use either or both 
 // of the following lines somewhere in your program, 
 // preferably before loading/using any shaders.
@@ -57,11 +60,15 @@ void ISimpleShader::CleanUp()
 		constantBufferCount = 0;
 	}
 
+	constantBuffers = 0;
+
 	for (unsigned int i = 0; i < shaderResourceViews.size(); i++)
 		delete shaderResourceViews[i];
+	shaderResourceViews.clear();
 	
 	for (unsigned int i = 0; i < samplerStates.size(); i++)
 		delete samplerStates[i];
+	samplerStates.clear();
 
 	// Clean up tables
 	varTable.clear();
@@ -81,7 +88,8 @@ void ISimpleShader::CleanUp()
 bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 {
 	// Load the shader to a blob and ensure it worked
-	HRESULT hr = D3DReadFileToBlob(shaderFile, shaderBlob.GetAddressOf());
+	Microsoft::WRL::ComPtr<ID3DBlob> fileBlob;
+	HRESULT hr = D3DReadFileToBlob(shaderFile, fileBlob.GetAddressOf());
 	if (hr != S_OK)
 	{
 		if (ReportErrors)
@@ -94,10 +102,7 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
-	// Create the shader - Calls an overloaded version of this abstract
-	// method in the appropriate child class
-	shaderValid = CreateShader(shaderBlob);
-	if (!shaderValid)
+	if (!LoadShaderBlob(fileBlob))
 	{
 		if (ReportErrors)
 		{
@@ -109,43 +114,58 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
-	// Set up shader reflection to get information about
-	// this shader and its variables,  buffers, etc.
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-	
-	// Get the description of the shader
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
+	return true;
+}
+
+// --------------------------------------------------------
+// Creates the shader from already loaded bytecode and
+// reflects it.  Safe to call again on a live shader, which
+// is how shaders are hot reloaded in place.
+//
+// blob - The compiled shader code
+//
+// Returns true if the shader was created, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::LoadShaderBlob(Microsoft::WRL::ComPtr<ID3DBlob> blob)
+{
+	// Get information about this shader and its variables, buffers,
+	// etc. first, as some shader types need it to create themselves.
+	// A bad blob leaves a live shader exactly as it was.
+	ShaderReflection newReflection;
+	if (!ReflectShader(blob, newReflection))
+		return false;
+
+	// Create the shader - Calls an overloaded version of this abstract
+	// method in the appropriate child class, which only cleans up
+	// the old shader once the new one exists
+	std::swap(reflection, newReflection);
+	if (!CreateShader(blob))
+	{
+		std::swap(reflection, newReflection);
+		return false;
+	}
+	shaderBlob = blob;
+	shaderValid = true;
 
 	// Create resource arrays
-	constantBufferCount = shaderDesc.ConstantBuffers;
+	constantBufferCount = (unsigned int)reflection.Buffers.size();
 	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
 	
 	// Handle bound resources (like shaders and samplers)
-	unsigned int resourceCount = shaderDesc.BoundResources;
-	for (unsigned int r = 0; r < resourceCount; r++)
+	for (auto& resource : reflection.Resources)
 	{
-		// Get this resource's description
-		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
-		refl->GetResourceBindingDesc(r, &resourceDesc);
-
 		// Check the type
-		switch (resourceDesc.Type)
+		switch (resource.Type)
 		{
 		case D3D_SIT_STRUCTURED: // Treat structured buffers as texture resources
 		case D3D_SIT_TEXTURE: // A texture resource
 		{
 			// Create the SRV wrapper
 			SimpleSRV* srv = new SimpleSRV();
-			srv->BindIndex = resourceDesc.BindPoint;				// Shader bind point
+			srv->BindIndex = resource.BindIndex;					// Shader bind point
 			srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
 
-			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceDesc.Name, srv));
+			textureTable.insert(std::pair<std::string, SimpleSRV*>(resource.Name, srv));
 			shaderResourceViews.push_back(srv);
 		}
 			break;
@@ -154,10 +174,10 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		{
 			// Create the sampler wrapper
 			SimpleSampler* samp = new SimpleSampler();
-			samp->BindIndex = resourceDesc.BindPoint;			// Shader bind point
+			samp->BindIndex = resource.BindIndex;				// Shader bind point
 			samp->Index = (unsigned int)samplerStates.size();	// Raw index
 
-			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceDesc.Name, samp));
+			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resource.Name, samp));
 			samplerStates.push_back(samp);
 		}
 			break;
@@ -167,31 +187,20 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	// Loop through all constant buffers
 	for (unsigned int b = 0; b < constantBufferCount; b++)
 	{
-		// Get this buffer
-		ID3D11ShaderReflectionConstantBuffer* cb =
-			refl->GetConstantBufferByIndex(b);
-		
-		// Get the description of this buffer
-		D3D11_SHADER_BUFFER_DESC bufferDesc;
-		cb->GetDesc(&bufferDesc);
+		const ReflectedBuffer& buffer = reflection.Buffers[b];
 
 		// Save the type, which we reference when setting these buffers
-		constantBuffers[b].Type = bufferDesc.Type;
-		
-		// Get the description of the resource binding, so
-		// we know exactly how it's bound in the shader
-		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
-		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+		constantBuffers[b].Type = (D3D_CBUFFER_TYPE)buffer.Type;
 		
 		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
-		constantBuffers[b].Name = bufferDesc.Name;
-		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
+		constantBuffers[b].BindIndex = buffer.BindIndex;
+		constantBuffers[b].Name = buffer.Name;
+		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(buffer.Name, &constantBuffers[b]));
 
 		// Create this constant buffer
 		D3D11_BUFFER_DESC newBuffDesc = {};
 		newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
-		newBuffDesc.ByteWidth = bufferDesc.Size;
+		newBuffDesc.ByteWidth = buffer.Size;
 		newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
 		newBuffDesc.CPUAccessFlags = 0;
 		newBuffDesc.MiscFlags = 0;
@@ -199,32 +208,21 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		device->CreateBuffer(&newBuffDesc, 0, constantBuffers[b].ConstantBuffer.GetAddressOf());
 
 		// Set up the data buffer for this constant buffer
-		constantBuffers[b].Size = bufferDesc.Size;
-		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
-		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+		constantBuffers[b].Size = buffer.Size;
+		constantBuffers[b].LocalDataBuffer = new unsigned char[buffer.Size];
+		ZeroMemory(constantBuffers[b].LocalDataBuffer, buffer.Size);
 
 		// Loop through all variables in this buffer
-		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		for (auto& variable : buffer.Variables)
 		{
-			// Get this variable
-			ID3D11ShaderReflectionVariable* var =
-				cb->GetVariableByIndex(v);
-			
-			// Get the description of the variable and its type
-			D3D11_SHADER_VARIABLE_DESC varDesc;
-			var->GetDesc(&varDesc);
-
 			// Create the variable struct
 			SimpleShaderVariable varStruct = {};
 			varStruct.ConstantBufferIndex = b;
-			varStruct.ByteOffset = varDesc.StartOffset;
-			varStruct.Size = varDesc.Size;
+			varStruct.ByteOffset = variable.ByteOffset;
+			varStruct.Size = variable.Size;
 			
-			// Get a string version
-			std::string varName(varDesc.Name);
-
 			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
+			varTable.insert(std::pair<std::string, SimpleShaderVariable>(variable.Name, varStruct));
 			constantBuffers[b].Variables.push_back(varStruct);
 		}
 	}
@@ -233,6 +231,101 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	return true;
 }
 
+// --------------------------------------------------------
+// Gets everything SimpleShader needs to know about a compiled
+// shader, from the reflection cache when one is set and has
+// seen this code before, or from shader reflection (which
+// then goes in the cache)
+//
+// blob       - The compiled shader code
+// reflection - Filled in with the shader's reflection
+//
+// Returns true if the shader could be reflected, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::ReflectShader(Microsoft::WRL::ComPtr<ID3DBlob> blob, ShaderReflection& reflection)
+{
+	// Already seen this exact code?
+	uint64_t hash = 0;
+	if (ReflectionCache)
+	{
+		hash = ShaderReflectionCache::HashBlob(blob->GetBufferPointer(), blob->GetBufferSize());
+		if (ReflectionCache->Find(hash, reflection))
+			return true;
+	}
+
+	// Set up shader reflection
+	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
+	HRESULT hr = D3DReflect(
+		blob->GetBufferPointer(),
+		blob->GetBufferSize(),
+		IID_ID3D11ShaderReflection,
+		(void**)refl.GetAddressOf());
+	if (FAILED(hr))
+		return false;
+
+	// Get the description of the shader
+	D3D11_SHADER_DESC shaderDesc;
+	refl->GetDesc(&shaderDesc);
+
+	reflection = ShaderReflection();
+	reflection.Version = shaderDesc.Version;
+	refl->GetThreadGroupSize(
+		&reflection.ThreadGroupSize[0],
+		&reflection.ThreadGroupSize[1],
+		&reflection.ThreadGroupSize[2]);
+
+	// All bound resources (textures, samplers, UAVs, etc.)
+	for (unsigned int r = 0; r < shaderDesc.BoundResources; r++)
+	{
+		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
+		refl->GetResourceBindingDesc(r, &resourceDesc);
+		reflection.Resources.push_back({ resourceDesc.Name, (uint32_t)resourceDesc.Type, resourceDesc.BindPoint });
+	}
+
+	// Constant buffers and their variables
+	for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
+	{
+		ID3D11ShaderReflectionConstantBuffer* cb = refl->GetConstantBufferByIndex(b);
+		D3D11_SHADER_BUFFER_DESC bufferDesc;
+		cb->GetDesc(&bufferDesc);
+
+		// Get the description of the resource binding, so
+		// we know exactly how it's bound in the shader
+		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
+		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+
+		ReflectedBuffer buffer;
+		buffer.Name = bufferDesc.Name;
+		buffer.Type = (uint32_t)bufferDesc.Type;
+		buffer.Size = bufferDesc.Size;
+		buffer.BindIndex = bindDesc.BindPoint;
+
+		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		{
+			D3D11_SHADER_VARIABLE_DESC varDesc;
+			cb->GetVariableByIndex(v)->GetDesc(&varDesc);
+			buffer.Variables.push_back({ varDesc.Name, varDesc.StartOffset, varDesc.Size });
+		}
+
+		reflection.Buffers.push_back(buffer);
+	}
+
+	// Vertex inputs, for building input layouts
+	if (D3D11_SHVER_GET_TYPE(shaderDesc.Version) == D3D11_SHVER_VERTEX_SHADER)
+	{
+		for (unsigned int i = 0; i < shaderDesc.InputParameters; i++)
+		{
+			D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
+			refl->GetInputParameterDesc(i, &paramDesc);
+			reflection.Inputs.push_back({ paramDesc.SemanticName, paramDesc.SemanticIndex, (uint32_t)paramDesc.ComponentType, paramDesc.Mask });
+		}
+	}
+
+	if (ReflectionCache)
+		ReflectionCache->Store(hash, reflection);
+	return true;
+}
+
 // --------------------------------------------------------
 // Helper for looking up a variable by name and also
 // verifying that it is the requested size
@@ -697,6 +790,7 @@ SimpleVertexShader::SimpleVertexShader(Microsoft::WRL::ComPtr<ID3D11Device> devi
 	// Ensure we set to zero to successfully trigger
 	// the Input Layout creation during LoadShaderFile()
 	this->perInstanceCompatible = false;
+	this->customInputLayout = false;
 
 	// Load the actual compiled shader file
 	this->LoadShaderFile(shaderFile);
@@ -711,8 +805,9 @@ SimpleVertexShader::SimpleVertexShader(Microsoft::WRL::ComPtr<ID3D11Device> devi
 SimpleVertexShader::SimpleVertexShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile, Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout, bool perInstanceCompatible)
 	: ISimpleShader(device, context)
 {
-	// Save the custom input layout
+	// Save the custom input layout, which reloads keep
 	this->inputLayout = inputLayout;
+	this->customInputLayout = true;
 
 	// Unable to determine from an input layout, require user to tell us
 	this->perInstanceCompatible = perInstanceCompatible;
@@ -735,6 +830,13 @@ SimpleVertexShader::~SimpleVertexShader()
 void SimpleVertexShader::CleanUp()
 {
 	ISimpleShader::CleanUp();
+
+	// A layout made from reflection belongs to the old code
+	if (!customInputLayout)
+	{
+		inputLayout.Reset();
+		perInstanceCompatible = false;
+	}
 }
 
 // --------------------------------------------------------
@@ -746,53 +848,39 @@ void SimpleVertexShader::CleanUp()
 // --------------------------------------------------------
 bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
 {
-	// Clean up first, in the event this method is
-	// called more than once on the same object
-	this->CleanUp();
-
-	// Create the shader from the blob
+	// Create the shader from the blob, leaving the current one
+	// in place if this fails
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> newShader;
 	HRESULT result = device->CreateVertexShader(
 		shaderBlob->GetBufferPointer(),
 		shaderBlob->GetBufferSize(),
 		0,
-		shader.GetAddressOf());
-
-	// Did the creation work?
+		newShader.GetAddressOf());
 	if (result != S_OK)
 		return false;
 
+	// Clean up the old shader's data, in the event this method
+	// is called more than once on the same object
+	this->CleanUp();
+	shader = newShader;
+
 	// Do we already have an input layout?
 	// (This would come from one of the constructor overloads)
 	if (inputLayout)
 		return true;
 
 	// Vertex shader was created successfully, so we now use the
-	// shader code to re-reflect and create an input layout that 
+	// shader's reflection to create an input layout that 
 	// matches what the vertex shader expects.  Code adapted from:
 	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
 
-	// Reflect shader info
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-	
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
-	// Read input layout description from shader info
+	// Read input layout description from the shader's reflection
 	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDesc;
-	for (unsigned int i = 0; i< shaderDesc.InputParameters; i++)
+	for (auto& paramDesc : reflection.Inputs)
 	{
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetInputParameterDesc(i, &paramDesc);
-
 		// Check the semantic name for "_PER_INSTANCE"
 		std::string perInstanceStr = "_PER_INSTANCE";
-		std::string sem = paramDesc.SemanticName;
+		const std::string& sem = paramDesc.SemanticName;
 		int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
 		bool isPerInstance = 
 			lenDiff >= 0 &&
@@ -800,7 +888,7 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 
 		// Fill out input element desc
 		D3D11_INPUT_ELEMENT_DESC elementDesc = {};
-		elementDesc.SemanticName = paramDesc.SemanticName;
+		elementDesc.SemanticName = paramDesc.SemanticName.c_str();
 		elementDesc.SemanticIndex = paramDesc.SemanticIndex;
 		elementDesc.InputSlot = 0;
 		elementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
@@ -853,7 +941,7 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 		(unsigned int)inputLayoutDesc.size(), 
 		shaderBlob->GetBufferPointer(), 
 		shaderBlob->GetBufferSize(),
-		inputLayout.GetAddressOf());
+		inputLayout.ReleaseAndGetAddressOf());
 
 	// All done, clean up
 	return true;
@@ -962,6 +1050,16 @@ SimplePixelShader::SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device
 	this->LoadShaderFile(shaderFile);
 }
 
+// --------------------------------------------------------
+// Constructor overload for shader code that's already
+// loaded or was compiled at runtime
+// --------------------------------------------------------
+SimplePixelShader::SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
+	: ISimpleShader(device, context)
+{
+	this->LoadShaderBlob(shaderBlob);
+}
+
 // --------------------------------------------------------
 // Destructor - Clean up actual shader (base will be called automatically)
 // --------------------------------------------------------
@@ -987,19 +1085,22 @@ void SimplePixelShader::CleanUp()
 // --------------------------------------------------------
 bool SimplePixelShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
 {
-	// Clean up first, in the event this method is
-	// called more than once on the same object
-	this->CleanUp();
-
-	// Create the shader from the blob
+	// Create the shader from the blob, leaving the current one
+	// in place if this fails
+	Microsoft::WRL::ComPtr<ID3D11PixelShader> newShader;
 	HRESULT result = device->CreatePixelShader(
 		shaderBlob->GetBufferPointer(),
 		shaderBlob->GetBufferSize(),
 		0,
-		shader.GetAddressOf());
+		newShader.GetAddressOf());
+	if (result != S_OK)
+		return false;
 
-	// Check the result
-	return (result == S_OK);
+	// Clean up the old shader's data, in the event this method
+	// is called more than once on the same object
+	this->CleanUp();
+	shader = newShader;
+	return true;
 }
 
 // --------------------------------------------------------
@@ -1131,19 +1232,22 @@ void SimpleDomainShader::CleanUp()
 // --------------------------------------------------------
 bool SimpleDomainShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
 {
-	// Clean up first, in the event this method is
-	// called more than once on the same object
-	this->CleanUp();
-
-	// Create the shader from the blob
+	// Create the shader from the blob, leaving the current one
+	// in place if this fails
+	Microsoft::WRL::ComPtr<ID3D11DomainShader> newShader;
 	HRESULT result = device->CreateDomainShader(
 		shaderBlob->GetBufferPointer(),
 		shaderBlob->GetBufferSize(),
 		0,
-		shader.GetAddressOf());
+		newShader.GetAddressOf());
+	if (result != S_OK)
+		return false;
 
-	// Check the result
-	return (result == S_OK);
+	// Clean up the old shader's data, in the event this method
+	// is called more than once on the same object
+	this->CleanUp();
+	shader = newShader;
+	return true;
 }
 
 // --------------------------------------------------------
@@ -1274,19 +1378,22 @@ void SimpleHullShader::CleanUp()
 // --------------------------------------------------------
 bool SimpleHullShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
 {
-	// Clean up first, in the event this method is
-	// called more than once on the same object
-	this->CleanUp();
-
-	// Create the shader from the blob
+	// Create the shader from the blob, leaving the current one
+	// in place if this fails
+	Microsoft::WRL::ComPtr<ID3D11HullShader> newShader;
 	HRESULT result = device->CreateHullShader(
 		shaderBlob->GetBufferPointer(),
 		shaderBlob->GetBufferSize(),
 		0,
-		shader.GetAddressOf());
+		newShader.GetAddressOf());
+	if (result != S_OK)
+		return false;
 
-	// Check the result
-	return (result == S_OK);
+	// Clean up the old shader's data, in the event this method
+	// is called more than once on the same object
+	this->CleanUp();
+	shader = newShader;
+	return true;
 }
 
 // --------------------------------------------------------
@@ -1422,23 +1529,26 @@ void SimpleGeometryShader::CleanUp()
 // --------------------------------------------------------
 bool SimpleGeometryShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
 {
-	// Clean up first, in the event this method is
-	// called more than once on the same object
-	this->CleanUp();
-
 	// Using stream out?
 	if (useStreamOut)
 		return this->CreateShaderWithStreamOut(shaderBlob);
 
-	// Create the shader from the blob
+	// Create the shader from the blob, leaving the current one
+	// in place if this fails
+	Microsoft::WRL::ComPtr<ID3D11GeometryShader> newShader;
 	HRESULT result = device->CreateGeometryShader(
 		shaderBlob->GetBufferPointer(),
 		shaderBlob->GetBufferSize(),
 		0,
-		shader.GetAddressOf());
+		newShader.GetAddressOf());
+	if (result != S_OK)
+		return false;
 
-	// Check the result
-	return (result == S_OK);
+	// Clean up the old shader's data, in the event this method
+	// is called more than once on the same object
+	this->CleanUp();
+	shader = newShader;
+	return true;
 }
 
 // --------------------------------------------------------
@@ -1451,10 +1561,6 @@ bool SimpleGeometryShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderB
 // --------------------------------------------------------
 bool SimpleGeometryShader::CreateShaderWithStreamOut(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
 {
-	// Clean up first, in the event this method is
-	// called more than once on the same object
-	this->CleanUp();
-
 	// Reflect shader info
 	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
 	D3DReflect(
@@ -1468,7 +1574,7 @@ bool SimpleGeometryShader::CreateShaderWithStreamOut(Microsoft::WRL::ComPtr<ID3D
 	refl->GetDesc(&shaderDesc);
 
 	// Set up the output signature
-	streamOutVertexSize = 0;
+	unsigned int vertexSize = 0;
 	std::vector<D3D11_SO_DECLARATION_ENTRY> soDecl;
 	for (unsigned int i = 0; i < shaderDesc.OutputParameters; i++)
 	{
@@ -1488,7 +1594,7 @@ bool SimpleGeometryShader::CreateShaderWithStreamOut(Microsoft::WRL::ComPtr<ID3D
 		entry.ComponentCount = CalcComponentCount(paramDesc.Mask);
 	
 		// Increment the size
-		streamOutVertexSize += entry.ComponentCount * sizeof(float);
+		vertexSize += entry.ComponentCount * sizeof(float);
 
 		// Add to the declaration
 		soDecl.push_back(entry);
@@ -1497,7 +1603,8 @@ bool SimpleGeometryShader::CreateShaderWithStreamOut(Microsoft::WRL::ComPtr<ID3D
 	// Rasterization allowed?
 	unsigned int rast = allowStreamOutRasterization ? 0 : D3D11_SO_NO_RASTERIZED_STREAM;
 
-	// Create the shader
+	// Create the shader, leaving the current one in place if this fails
+	Microsoft::WRL::ComPtr<ID3D11GeometryShader> newShader;
 	HRESULT result = device->CreateGeometryShaderWithStreamOutput(
 		shaderBlob->GetBufferPointer(), // Shader blob pointer
 		shaderBlob->GetBufferSize(),    // Shader blob size
@@ -1507,9 +1614,16 @@ bool SimpleGeometryShader::CreateShaderWithStreamOut(Microsoft::WRL::ComPtr<ID3D
 		0,                              // No buffer strides
 		rast,                           // Index of the stream to rasterize (if any)
 		NULL,                           // Not using class linkage
-		shader.GetAddressOf());
-	
-	return (result == S_OK);
+		newShader.GetAddressOf());
+	if (result != S_OK)
+		return false;
+
+	// Clean up the old shader's data, in the event this method
+	// is called more than once on the same object
+	this->CleanUp();
+	shader = newShader;
+	streamOutVertexSize = vertexSize;
+	return true;
 }
 
 // --------------------------------------------------------
@@ -1715,49 +1829,33 @@ void SimpleComputeShader::CleanUp()
 // --------------------------------------------------------
 bool SimpleComputeShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
 {
-	// Clean up first, in the event this method is
-	// called more than once on the same object
-	this->CleanUp();
-
-	// Create the shader from the blob
+	// Create the shader from the blob, leaving the current one
+	// in place if this fails
+	Microsoft::WRL::ComPtr<ID3D11ComputeShader> newShader;
 	HRESULT result = device->CreateComputeShader(
 		shaderBlob->GetBufferPointer(),
 		shaderBlob->GetBufferSize(),
 		0,
-		shader.GetAddressOf());
-
-	// Was the shader created correctly?
+		newShader.GetAddressOf());
 	if (result != S_OK)
 		return false;
 
-	// Set up shader reflection to get information about UAV's
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
+	// Clean up the old shader's data, in the event this method
+	// is called more than once on the same object
+	this->CleanUp();
+	shader = newShader;
 
-	// Get the description of the shader
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-	
-	// Grab the thread info
-	threadsTotal = refl->GetThreadGroupSize(
-		&threadsX,
-		&threadsY,
-		&threadsZ);
+	// Grab the thread info from the shader's reflection
+	threadsX = reflection.ThreadGroupSize[0];
+	threadsY = reflection.ThreadGroupSize[1];
+	threadsZ = reflection.ThreadGroupSize[2];
+	threadsTotal = threadsX * threadsY * threadsZ;
 
 	// Loop and get all UAV resources
-	unsigned int resourceCount = shaderDesc.BoundResources;
-	for (unsigned int r = 0; r < resourceCount; r++)
+	for (auto& resource : reflection.Resources)
 	{
-		// Get this resource's description
-		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
-		refl->GetResourceBindingDesc(r, &resourceDesc);
-
 		// Check the type, looking for any kind of UAV
-		switch (resourceDesc.Type)
+		switch (resource.Type)
 		{
 		case D3D_SIT_UAV_APPEND_STRUCTURED:
 		case D3D_SIT_UAV_CONSUME_STRUCTURED:
@@ -1765,7 +1863,7 @@ bool SimpleComputeShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBl
 		case D3D_SIT_UAV_RWSTRUCTURED:
 		case D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER:
 		case D3D_SIT_UAV_RWTYPED:
-			uavTable.insert(std::pair<std::string, unsigned int>(resourceDesc.Name, resourceDesc.BindPoint));
+			uavTable.insert(std::pair<std::string, unsigned int>(resource.Name, resource.BindIndex));
 		}
 	}
 
@@ -11,6 +11,8 @@
 #include <vector>
 #include <string>
 
+#include "ShaderReflectionCache.h"
+
 
 // --------------------------------------------------------
 // Used by simple shaders to store information about
@@ -118,10 +120,19 @@ public:
 	// Misc getters
 	Microsoft::WRL::ComPtr<ID3DBlob> GetShaderBlob() { return shaderBlob; }
 
+	// Rebuilds the shader from new bytecode, keeping this object (and everything pointing at it) valid
+	bool LoadShaderBlob(Microsoft::WRL::ComPtr<ID3DBlob> blob);
+
+	// Gets a shader's reflection, from ReflectionCache when possible
+	static bool ReflectShader(Microsoft::WRL::ComPtr<ID3DBlob> blob, ShaderReflection& reflection);
+
 	// Error reporting
 	static bool ReportErrors;
 	static bool ReportWarnings;
 
+	// When set, shaders seen before are set up without reflection
+	static ShaderReflectionCache* ReflectionCache;
+
 protected:
 	
 	bool shaderValid;
@@ -129,6 +140,9 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11Device> device;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext;
 
+	// Everything reflected from the shader code
+	ShaderReflection reflection;
+
 	// Resource counts
 	unsigned int constantBufferCount;
 	
@@ -183,6 +197,7 @@ public:
 
 protected:
 	bool perInstanceCompatible;
+	bool customInputLayout;
 	 Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
 	 Microsoft::WRL::ComPtr<ID3D11VertexShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
@@ -198,6 +213,7 @@ class SimplePixelShader : public ISimpleShader
 {
 public:
 	SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile);
+	SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	~SimplePixelShader();
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> GetDirectXShader() { return shader; }
 
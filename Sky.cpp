@@ -2,9 +2,21 @@
 #include "WICTextureLoader.h"
 #include "DDSTextureLoader.h"
 #include "Assets.h"
+#include "DDSFile.h"
+#include "IBLBaker.h"
+#include "ShaderReflectionCache.h"
+#include "TextureCooker.h"
+#include <chrono>
+#include <cstdio>
+#include <experimental/filesystem>
+#include <fstream>
+#include <vector>
 
 using namespace DirectX;
 
+// Bump when the IBL maps change in a way the hashed inputs don't show
+static const uint64_t iblCacheVersion = 2;
+
 Sky::Sky(
 	const wchar_t* cubemapDDSFile, 
 	std::shared_ptr<Mesh> mesh,
@@ -21,12 +33,22 @@ Sky::Sky(
 	this->samplerOptions = samplerOptions;
 	this->skyVS = skyVS;
 	this->skyPS = skyPS;
+	iblTimingIndex = 0;
+	for (auto& timings : iblTimings)
+		timings.Pending = false;
 
 	// Init render states
 	InitRenderStates();
 
-	// Load texture
+	// Load texture, already a cube with mips, so nothing is decoded or copied
+	auto start = std::chrono::steady_clock::now();
 	CreateDDSTextureFromFile(device.Get(), cubemapDDSFile, 0, skySRV.GetAddressOf());
+	WaitForGPU();
+	loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("Sky: Loaded one DDS cube in %.0f ms\n", loadMs);
+
+	const wchar_t* files[1] = { cubemapDDSFile };
+	InitIBL(files, 1);
 }
 
 Sky::Sky(
@@ -50,20 +72,65 @@ Sky::Sky(
 	this->samplerOptions = samplerOptions;
 	this->skyVS = skyVS;
 	this->skyPS = skyPS;
+	iblTimingIndex = 0;
+	for (auto& timings : iblTimings)
+		timings.Pending = false;
 
 	// Init render states
 	InitRenderStates();
 
 	// Create texture from 6 images
+	auto start = std::chrono::steady_clock::now();
 	skySRV = CreateCubemap(right, left, up, down, front, back);
+	WaitForGPU();
+	loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("Sky: Loaded six images in %.0f ms\n", loadMs);
+
+	const wchar_t* files[6] = { right, left, up, down, front, back };
+	InitIBL(files, 6);
+}
+
+void Sky::InitIBL(const wchar_t* const* files, int fileCount)
+{
+	mipLevels = max((int)(log2(iblCubeSize)) + 1 - mipLevelsToSkip, 1);
+
+	// Convolving is slow, so it only happens when nothing cached matches
+	uint64_t hash = HashIBLInputs(files, fileCount);
+	auto start = std::chrono::steady_clock::now();
+	auto elapsedMs = [&]() { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); };
+
+	double computeMs = 0;
+	if (fileCount == 1 && LoadBakedIBL(files[0], computeMs))
+	{
+		iblFromCache = true;
+		iblMs = elapsedMs();
+		printf("IBL: Loaded prebaked maps in %.0f ms, baked in %.0f ms\n", iblMs, computeMs);
+		return;
+	}
+
+	iblFromCache = LoadIBLCache(hash, computeMs);
+	if (iblFromCache)
+	{
+		iblMs = elapsedMs();
+		printf("IBL: Loaded from cache in %.0f ms, %.0f ms less than computing\n", iblMs, computeMs - iblMs);
+		return;
+	}
 
-	IBLCreateIrradianceMap();
+	IBLProjectIrradianceSH();
 	IBLCreateConvolvedSpecularMap();
 	IBLCreateBRDFLookUpTexture();
+	WaitForGPU();
+	iblMs = elapsedMs();
+
+	SaveIBLCache(hash, iblMs);
+	printf("IBL: Computed in %.0f ms and cached\n", iblMs);
 }
 
 Sky::~Sky()
 {
+	//A time sliced update's SH job writes into this sky
+	if (backSHJob.valid())
+		backSHJob.wait();
 }
 
 void Sky::Draw(std::shared_ptr<Camera> camera)
@@ -185,83 +252,82 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(const wchar_
 	return cubeSRV;
 }
 
-void Sky::IBLCreateIrradianceMap()
+void Sky::IBLProjectIrradianceSH()
 {
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> irrMapFinalTexture;
-	D3D11_TEXTURE2D_DESC texDesc = {};
-	texDesc.Width = iblCubeSize;
-	texDesc.Height = iblCubeSize;
-	texDesc.ArraySize = 6;
-	texDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-	texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	texDesc.MipLevels = 1;
-	texDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
-	texDesc.SampleDesc.Count = 1;
-	device->CreateTexture2D(&texDesc, 0, irrMapFinalTexture.GetAddressOf());
-
-	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
-	srvDesc.TextureCube.MipLevels = 1;
-	srvDesc.TextureCube.MostDetailedMip = 0;
-	srvDesc.Format = texDesc.Format;
-	device->CreateShaderResourceView(irrMapFinalTexture.Get(), &srvDesc, irradianceMap.GetAddressOf());
-
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> prevRTV;
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> prevDSV;
-	context->OMSetRenderTargets(1, prevRTV.GetAddressOf(), prevDSV.Get());
-
-	unsigned int vpCount = 1;
-	D3D11_VIEWPORT prevVP = {};
-	context->RSGetViewports(&vpCount, &prevVP);
-
-	D3D11_VIEWPORT vp = {};
-	vp.Width = (float)iblCubeSize;
-	vp.Height = (float)iblCubeSize;
-	vp.MinDepth = 0.0f;
-	vp.MaxDepth = 1.0f;
-	context->RSSetViewports(1, &vp);
-
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	//Diffuse lighting is low frequency enough for nine coefficients, projected from the
+	//sky's own texels on the CPU
+	irradianceSH = {};
+	DDSDescription description;
+	std::vector<uint8_t> pixels;
+	unsigned int size;
+	bool bgra;
+	if (!ReadTexture(skySRV, description, pixels) || !PrepareSHFaces(description, pixels, size, bgra))
+		return;
+
+	irradianceSH = SphericalHarmonics::ProjectIrradiance(pixels.data(), size, bgra, Assets::GetInstance().GetJobSystem());
+}
 
-	Assets::GetInstance().GetVertexShader("FullscreenVS")->SetShader();
-	Assets::GetInstance().GetPixelShader("IBLIrradianceMapPS")->SetShader();
-	Assets::GetInstance().GetPixelShader("IBLIrradianceMapPS")->SetShaderResourceView("EnvironmentMap", skySRV.Get());
-	Assets::GetInstance().GetPixelShader("IBLIrradianceMapPS")->SetSamplerState("BasicSampler", samplerOptions.Get());
+bool Sky::PrepareSHFaces(const DDSDescription& description, std::vector<uint8_t>& data, unsigned int& size, bool& bgra)
+{
+	bgra = description.Format == DXGI_FORMAT_B8G8R8A8_UNORM || description.Format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+	bool rgba = description.Format == DXGI_FORMAT_R8G8B8A8_UNORM || description.Format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+	bool bc7 = description.Format == DXGI_FORMAT_BC7_UNORM || description.Format == DXGI_FORMAT_BC7_UNORM_SRGB;
+	if ((!bgra && !rgba && !bc7) || description.ArraySize != 6 || description.Width != description.Height)
+	{
+		printf("IBL: Can't project a sky of format %u onto SH\n", description.Format);
+		return false;
+	}
 
+	//Nine coefficients don't need every texel, so a sky with mips projects from the first
+	//one no bigger than the IBL cube
+	unsigned int mip = 0;
+	while (mip + 1 < description.MipCount && (description.Width >> mip) > (unsigned int)iblCubeSize)
+		mip++;
+	size = max(description.Width >> mip, 1u);
+	if (!bc7 && description.MipCount == 1)
+		return true;
+
+	//Pull that mip out of each face's chain, decoding blocks back to 8 bit
+	DDSDescription face = description;
+	face.ArraySize = 1;
+	size_t faceBytes = DDSFile::TotalBytes(face);
+	size_t mipOffset = 0;
+	for (unsigned int m = 0; m < mip; m++)
+		mipOffset += DDSFile::MipBytes(description.Format, description.Width, description.Height, m);
+
+	std::vector<uint8_t> faces;
+	std::vector<uint8_t> decoded;
 	for (int i = 0; i < 6; i++)
 	{
-		D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
-		rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2DARRAY;
-		rtvDesc.Texture2DArray.ArraySize = 1;
-		rtvDesc.Texture2DArray.FirstArraySlice = i;
-		rtvDesc.Texture2DArray.MipSlice = 0;
-		rtvDesc.Format = texDesc.Format;
-
-		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> rtv;
-		device->CreateRenderTargetView(irrMapFinalTexture.Get(), &rtvDesc, rtv.GetAddressOf());
-
-		float black[4] = {};
-		context->ClearRenderTargetView(rtv.Get(), black);
-		context->OMSetRenderTargets(1, rtv.GetAddressOf(), 0);
-
-		Assets::GetInstance().GetPixelShader("IBLIrradianceMapPS")->SetInt("faceIndex", i);
-		Assets::GetInstance().GetPixelShader("IBLIrradianceMapPS")->CopyAllBufferData();
-
-		context->Draw(3, 0);
-
-		context->Flush();
+		const uint8_t* source = data.data() + i * faceBytes + mipOffset;
+		if (bc7)
+		{
+			TextureCooker::DecodeBlocks(source, COOKED_BC7, size, size, decoded);
+			faces.insert(faces.end(), decoded.begin(), decoded.end());
+		}
+		else
+			faces.insert(faces.end(), source, source + (size_t)size * size * 4);
 	}
-
-	context->OMSetRenderTargets(1, prevRTV.GetAddressOf(), prevDSV.Get());
-	context->RSSetViewports(1, &prevVP);
+	data.swap(faces);
+	return true;
 }
 
 void Sky::IBLCreateConvolvedSpecularMap()
 {
-	mipLevels = max((int)(log2(iblCubeSize)) + 1 - mipLevelsToSkip, 1);
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> specMapFinalTexture;
+	IBLCreateSpecularTexture(specMapFinalTexture, convolvedSpecularMap);
 
+	for (int i = 0; i < mipLevels; i++)
+	{
+		for (int j = 0; j < 6; j++)
+		{
+			IBLConvolveSpecularFace(specMapFinalTexture, i, j);
+		}
+	}
+}
 
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> specMapFinalTexture;
+void Sky::IBLCreateSpecularTexture(Microsoft::WRL::ComPtr<ID3D11Texture2D>& texture, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+{
 	D3D11_TEXTURE2D_DESC texDesc = {};
 	texDesc.Width = iblCubeSize;
 	texDesc.Height = iblCubeSize;
@@ -271,16 +337,18 @@ void Sky::IBLCreateConvolvedSpecularMap()
 	texDesc.MipLevels = mipLevels;
 	texDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
 	texDesc.SampleDesc.Count = 1;
-	device->CreateTexture2D(&texDesc, 0, specMapFinalTexture.GetAddressOf());
+	device->CreateTexture2D(&texDesc, 0, texture.ReleaseAndGetAddressOf());
 
 	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
 	srvDesc.TextureCube.MipLevels = mipLevels;
 	srvDesc.TextureCube.MostDetailedMip = 0;
 	srvDesc.Format = texDesc.Format;
-	device->CreateShaderResourceView(specMapFinalTexture.Get(), &srvDesc, convolvedSpecularMap.GetAddressOf());
-
+	device->CreateShaderResourceView(texture.Get(), &srvDesc, srv.ReleaseAndGetAddressOf());
+}
 
+void Sky::IBLConvolveSpecularFace(Microsoft::WRL::ComPtr<ID3D11Texture2D> texture, int mip, int face)
+{
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> prevRTV;
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> prevDSV;
 	context->OMSetRenderTargets(1, prevRTV.GetAddressOf(), prevDSV.Get());
@@ -297,42 +365,36 @@ void Sky::IBLCreateConvolvedSpecularMap()
 	Assets::GetInstance().GetPixelShader("IBLSpecularConvolutionPS")->SetShaderResourceView("EnvironmentMap", skySRV.Get());
 	Assets::GetInstance().GetPixelShader("IBLSpecularConvolutionPS")->SetSamplerState("BasicSampler", samplerOptions.Get());
 
-	for (int i = 0; i < mipLevels; i++)
-	{
-		for (int j = 0; j < 6; j++)
-		{
-			D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
-			rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2DARRAY;
-			rtvDesc.Texture2DArray.ArraySize = 1;
-			rtvDesc.Texture2DArray.FirstArraySlice = j;
-			rtvDesc.Texture2DArray.MipSlice = i;
-			rtvDesc.Format = texDesc.Format;
+	D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
+	rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2DARRAY;
+	rtvDesc.Texture2DArray.ArraySize = 1;
+	rtvDesc.Texture2DArray.FirstArraySlice = face;
+	rtvDesc.Texture2DArray.MipSlice = mip;
+	rtvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 
-			Microsoft::WRL::ComPtr<ID3D11RenderTargetView> rtv;
-			device->CreateRenderTargetView(specMapFinalTexture.Get(), &rtvDesc, rtv.GetAddressOf());
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> rtv;
+	device->CreateRenderTargetView(texture.Get(), &rtvDesc, rtv.GetAddressOf());
 
-			float black[4] = {};
-			context->ClearRenderTargetView(rtv.Get(), black);
-			context->OMSetRenderTargets(1, rtv.GetAddressOf(), 0);
+	float black[4] = {};
+	context->ClearRenderTargetView(rtv.Get(), black);
+	context->OMSetRenderTargets(1, rtv.GetAddressOf(), 0);
 
-			D3D11_VIEWPORT vp = {};
-			vp.Width = (float)pow(2, mipLevels + mipLevelsToSkip - 1 - i);
-			vp.Height = vp.Width;
-			vp.MinDepth = 0.0f;
-			vp.MaxDepth = 1.0f;
-			context->RSSetViewports(1, &vp);
+	D3D11_VIEWPORT vp = {};
+	vp.Width = (float)pow(2, mipLevels + mipLevelsToSkip - 1 - mip);
+	vp.Height = vp.Width;
+	vp.MinDepth = 0.0f;
+	vp.MaxDepth = 1.0f;
+	context->RSSetViewports(1, &vp);
 
-			Assets::GetInstance().GetPixelShader("IBLSpecularConvolutionPS")->SetFloat("roughness", i / (float)(mipLevels - 1));
-			Assets::GetInstance().GetPixelShader("IBLSpecularConvolutionPS")->SetInt("faceIndex", j);
-			Assets::GetInstance().GetPixelShader("IBLSpecularConvolutionPS")->SetInt("mipLevel", i);
-			Assets::GetInstance().GetPixelShader("IBLSpecularConvolutionPS")->CopyAllBufferData();
+	Assets::GetInstance().GetPixelShader("IBLSpecularConvolutionPS")->SetFloat("roughness", mip / (float)(mipLevels - 1));
+	Assets::GetInstance().GetPixelShader("IBLSpecularConvolutionPS")->SetInt("faceIndex", face);
+	Assets::GetInstance().GetPixelShader("IBLSpecularConvolutionPS")->SetInt("mipLevel", mip);
+	Assets::GetInstance().GetPixelShader("IBLSpecularConvolutionPS")->CopyAllBufferData();
 
 
-			context->Draw(3, 0);
+	context->Draw(3, 0);
 
-			context->Flush();
-		}
-	}
+	context->Flush();
 
 	context->OMSetRenderTargets(1, prevRTV.GetAddressOf(), prevDSV.Get());
 	context->RSSetViewports(1, &prevVP);
@@ -401,3 +463,355 @@ void Sky::IBLCreateBRDFLookUpTexture()
 	context->OMSetRenderTargets(1, prevRTV.GetAddressOf(), prevDSV.Get());
 	context->RSSetViewports(1, &prevVP);
 }
+
+uint64_t Sky::HashIBLInputs(const wchar_t* const* files, int fileCount)
+{
+	uint64_t hash = iblCacheVersion;
+	auto mix = [&](uint64_t part) { hash = (hash ^ part) * 1099511628211ull; };
+
+	for (int i = 0; i < fileCount; i++)
+	{
+		std::ifstream file(files[i], std::ios::binary);
+		std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		mix(ShaderReflectionCache::HashBlob(bytes.data(), bytes.size()));
+	}
+
+	mix(iblCubeSize);
+	mix(mipLevelsToSkip);
+	mix(lookUpSize);
+
+	//A changed shader changes the maps just as much as a changed face
+	const char* shaders[2] = { "IBLSpecularConvolutionPS", "IBLBrdfLookUpTablePS" };
+	for (int i = 0; i < 2; i++)
+	{
+		std::shared_ptr<SimplePixelShader> ps = Assets::GetInstance().GetPixelShader(shaders[i]);
+		Microsoft::WRL::ComPtr<ID3DBlob> blob = ps ? ps->GetShaderBlob() : 0;
+		if (blob)
+			mix(ShaderReflectionCache::HashBlob(blob->GetBufferPointer(), blob->GetBufferSize()));
+	}
+	return hash;
+}
+
+std::string Sky::GetIBLCachePath(uint64_t hash, const char* suffix)
+{
+	char name[64];
+	sprintf_s(name, "IBLCache/%016llx%s", (unsigned long long)hash, suffix);
+	return Assets::GetInstance().GetFullPathTo(name);
+}
+
+bool Sky::LoadIBLCache(uint64_t hash, double& computeMs)
+{
+	return LoadIBLFiles(GetIBLCachePath(hash, "_specular.dds"), GetIBLCachePath(hash, "_brdf.dds"), GetIBLCachePath(hash, ".txt"), computeMs);
+}
+
+bool Sky::LoadBakedIBL(const wchar_t* skyFile, double& bakeMs)
+{
+	std::wstring wideSky(skyFile);
+	std::string sky(wideSky.begin(), wideSky.end());
+	std::string summaryPath = IBLBaker::GetBakedPath(sky, "_ibl.txt");
+
+	//A sky cooked again since it was baked has stale maps
+	std::error_code error;
+	auto bakedTime = std::experimental::filesystem::last_write_time(summaryPath, error);
+	if (error)
+		return false;
+	auto skyTime = std::experimental::filesystem::last_write_time(sky, error);
+	if (error || bakedTime < skyTime)
+		return false;
+
+	if (!LoadIBLFiles(IBLBaker::GetBakedPath(sky, "_specular.dds"), IBLBaker::GetBakedPath(sky, "_brdf.dds"), summaryPath, bakeMs))
+		return false;
+
+	//Draws sample the specular mips by roughness and the slicer rebuilds at these sizes,
+	//so maps baked at others aren't used
+	Microsoft::WRL::ComPtr<ID3D11Resource> specular;
+	Microsoft::WRL::ComPtr<ID3D11Resource> brdf;
+	convolvedSpecularMap->GetResource(specular.GetAddressOf());
+	brdfLookUp->GetResource(brdf.GetAddressOf());
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> specularTexture;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> brdfTexture;
+	D3D11_TEXTURE2D_DESC specularDesc = {};
+	D3D11_TEXTURE2D_DESC brdfDesc = {};
+	if (SUCCEEDED(specular.As(&specularTexture)) && SUCCEEDED(brdf.As(&brdfTexture)))
+	{
+		specularTexture->GetDesc(&specularDesc);
+		brdfTexture->GetDesc(&brdfDesc);
+	}
+	if (specularDesc.Width != (UINT)iblCubeSize || specularDesc.MipLevels != (UINT)mipLevels || brdfDesc.Width != (UINT)lookUpSize)
+	{
+		printf("IBL: Ignoring maps baked at other sizes for %s\n", sky.c_str());
+		convolvedSpecularMap.Reset();
+		brdfLookUp.Reset();
+		return false;
+	}
+	return true;
+}
+
+bool Sky::LoadIBLFiles(const std::string& specularPath, const std::string& brdfPath, const std::string& summaryPath, double& computeMs)
+{
+	//The compute time and SH are written last, so their file only exists once the maps are complete
+	std::ifstream summary(summaryPath);
+	if (!(summary >> computeMs))
+		return false;
+	for (int i = 0; i < 9; i++)
+	{
+		DirectX::XMFLOAT4& coefficient = irradianceSH.Coefficients[i];
+		if (!(summary >> coefficient.x >> coefficient.y >> coefficient.z))
+			return false;
+		coefficient.w = 0;
+	}
+
+	std::string paths[2] = { specularPath, brdfPath };
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* srvs[2] = { &convolvedSpecularMap, &brdfLookUp };
+	for (int i = 0; i < 2; i++)
+	{
+		std::wstring path(paths[i].begin(), paths[i].end());
+		if (FAILED(CreateDDSTextureFromFile(device.Get(), path.c_str(), 0, srvs[i]->ReleaseAndGetAddressOf())))
+		{
+			convolvedSpecularMap.Reset();
+			brdfLookUp.Reset();
+			return false;
+		}
+	}
+	return true;
+}
+
+void Sky::SaveIBLCache(uint64_t hash, double computeMs)
+{
+	std::error_code error;
+	std::experimental::filesystem::create_directories(Assets::GetInstance().GetFullPathTo("IBLCache"), error);
+
+	if (!SaveTexture(convolvedSpecularMap, GetIBLCachePath(hash, "_specular.dds")) ||
+		!SaveTexture(brdfLookUp, GetIBLCachePath(hash, "_brdf.dds")))
+		return;
+
+	std::ofstream summary(GetIBLCachePath(hash, ".txt"));
+	summary.precision(9);
+	summary << computeMs;
+	for (int i = 0; i < 9; i++)
+		summary << " " << irradianceSH.Coefficients[i].x << " " << irradianceSH.Coefficients[i].y << " " << irradianceSH.Coefficients[i].z;
+}
+
+bool Sky::SaveTexture(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, const std::string& path)
+{
+	DDSDescription description;
+	std::vector<uint8_t> data;
+	return ReadTexture(srv, description, data) && DDSFile::Write(path, description, data.data(), data.size());
+}
+
+bool Sky::ReadTexture(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, DDSDescription& description, std::vector<uint8_t>& data)
+{
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> staging;
+	return CopyToStaging(srv, staging, description) && ReadStaging(staging, description, data);
+}
+
+bool Sky::CopyToStaging(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, Microsoft::WRL::ComPtr<ID3D11Texture2D>& staging, DDSDescription& description)
+{
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	srv->GetResource(resource.GetAddressOf());
+	resource.As(&texture);
+
+	//A CPU readable copy of the whole texture
+	D3D11_TEXTURE2D_DESC desc = {};
+	texture->GetDesc(&desc);
+	bool cube = (desc.MiscFlags & D3D11_RESOURCE_MISC_TEXTURECUBE) != 0;
+	desc.BindFlags = 0;
+	desc.MiscFlags = 0;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	desc.Usage = D3D11_USAGE_STAGING;
+
+	if (FAILED(device->CreateTexture2D(&desc, 0, staging.ReleaseAndGetAddressOf())))
+		return false;
+	context->CopyResource(staging.Get(), texture.Get());
+
+	description = { (uint32_t)desc.Format, desc.Width, desc.Height, desc.MipLevels, desc.ArraySize, cube };
+	return true;
+}
+
+bool Sky::ReadStaging(Microsoft::WRL::ComPtr<ID3D11Texture2D> staging, const DDSDescription& description, std::vector<uint8_t>& data)
+{
+	D3D11_TEXTURE2D_DESC desc = {};
+	staging->GetDesc(&desc);
+	data.resize(DDSFile::TotalBytes(description));
+	uint8_t* out = data.data();
+
+	//Each slice with its mip chain, rows packed without the driver's pitch
+	for (unsigned int slice = 0; slice < desc.ArraySize; slice++)
+	{
+		for (unsigned int mip = 0; mip < desc.MipLevels; mip++)
+		{
+			unsigned int subresource = D3D11CalcSubresource(mip, slice, desc.MipLevels);
+			D3D11_MAPPED_SUBRESOURCE mapped = {};
+			if (FAILED(context->Map(staging.Get(), subresource, D3D11_MAP_READ, 0, &mapped)))
+				return false;
+
+			size_t rowBytes = DDSFile::RowBytes(description.Format, desc.Width, mip);
+			size_t rows = rowBytes ? DDSFile::MipBytes(description.Format, desc.Width, desc.Height, mip) / rowBytes : 0;
+			for (size_t row = 0; row < rows; row++)
+			{
+				memcpy(out, (uint8_t*)mapped.pData + row * mapped.RowPitch, rowBytes);
+				out += rowBytes;
+			}
+			context->Unmap(staging.Get(), subresource);
+		}
+	}
+	return true;
+}
+
+void Sky::WaitForGPU()
+{
+	//The IBL passes are only queued until now, so timing them means waiting on an event
+	D3D11_QUERY_DESC queryDesc = {};
+	queryDesc.Query = D3D11_QUERY_EVENT;
+	Microsoft::WRL::ComPtr<ID3D11Query> query;
+	device->CreateQuery(&queryDesc, query.GetAddressOf());
+
+	context->End(query.Get());
+	BOOL done = FALSE;
+	while (context->GetData(query.Get(), &done, sizeof(done), 0) == S_FALSE)
+		;
+}
+
+void Sky::SetSkyTexture(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> sky)
+{
+	skySRV = sky;
+	BeginIBLUpdate();
+}
+
+void Sky::BeginIBLUpdate()
+{
+	//The last pass's SH job still reads the old pixels and writes backSH
+	if (backSHJob.valid())
+		backSHJob.get();
+
+	//Targets and a copy of the sky, every specular face of every mip, then the SH
+	iblSlicer.Start(6 * mipLevels + 2);
+}
+
+bool Sky::UpdateIBL(uint64_t budgetMicroseconds)
+{
+	ReadIBLTimings();
+	if (iblSlicer.IsRunning())
+	{
+		IBLTimings& timings = iblTimings[iblTimingIndex];
+		if (!timings.Disjoint)
+		{
+			D3D11_QUERY_DESC disjointDesc = {};
+			disjointDesc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+			device->CreateQuery(&disjointDesc, timings.Disjoint.GetAddressOf());
+		}
+
+		//Still not read after every other slice in flight, so it's dropped rather than waited on
+		timings.Items.clear();
+		context->Begin(timings.Disjoint.Get());
+		iblSlicer.Update(budgetMicroseconds, [&](unsigned int item) { RunIBLUpdateItem(item); });
+		context->End(timings.Disjoint.Get());
+		timings.Pending = !timings.Items.empty();
+		iblTimingIndex = (iblTimingIndex + 1) % GpuProfiler::FrameLatency;
+	}
+
+	//The faces are all done once the slicer is, but the SH may still be projecting
+	if (iblSlicer.IsRunning() || !backSHJob.valid() || backSHJob.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return false;
+
+	backSHJob.get();
+	convolvedSpecularMap = backSpecularMap;
+	irradianceSH = backSH;
+	backSpecularTexture.Reset();
+	backSpecularMap.Reset();
+	skyStaging.Reset();
+	return true;
+}
+
+void Sky::ReadIBLTimings()
+{
+	//Oldest first, stopping at the first slice the GPU hasn't finished
+	for (unsigned int i = 0; i < GpuProfiler::FrameLatency; i++)
+	{
+		IBLTimings& timings = iblTimings[(iblTimingIndex + i) % GpuProfiler::FrameLatency];
+		if (!timings.Pending)
+			continue;
+
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+		if (context->GetData(timings.Disjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			break;
+
+		timings.Pending = false;
+		if (disjoint.Disjoint || disjoint.Frequency == 0)
+			continue;
+
+		for (size_t j = 0; j < timings.Items.size(); j++)
+		{
+			UINT64 begin;
+			UINT64 end;
+			if (context->GetData(timings.Begins[j].Get(), &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+				context->GetData(timings.Ends[j].Get(), &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+				continue;
+			iblSlicer.ReportCost(timings.Items[j], (uint64_t)((double)(end - begin) * 1e6 / (double)disjoint.Frequency));
+		}
+	}
+}
+
+void Sky::RunIBLUpdateItem(unsigned int item)
+{
+	unsigned int lastItem = iblSlicer.GetItemCount() - 1;
+	if (item == 0)
+	{
+		//Read back at the very end, by which time the GPU is long done copying
+		IBLCreateSpecularTexture(backSpecularTexture, backSpecularMap);
+		if (!CopyToStaging(skySRV, skyStaging, skyStagingDescription))
+			skyStaging.Reset();
+	}
+	else if (item < lastItem)
+	{
+		IBLTimings& timings = iblTimings[iblTimingIndex];
+		size_t index = timings.Items.size();
+		if (index == timings.Begins.size())
+		{
+			D3D11_QUERY_DESC timestampDesc = {};
+			timestampDesc.Query = D3D11_QUERY_TIMESTAMP;
+			timings.Begins.emplace_back();
+			timings.Ends.emplace_back();
+			device->CreateQuery(&timestampDesc, timings.Begins.back().GetAddressOf());
+			device->CreateQuery(&timestampDesc, timings.Ends.back().GetAddressOf());
+		}
+
+		//The convolution is only queued here, so the slicer hears what it cost once the
+		//timestamps come back rather than waiting on the GPU
+		context->End(timings.Begins[index].Get());
+		IBLConvolveSpecularFace(backSpecularTexture, (item - 1) / 6, (item - 1) % 6);
+		context->End(timings.Ends[index].Get());
+		timings.Items.push_back(item);
+		iblSlicer.DeferCost();
+	}
+	else
+	{
+		//The old SH stays if the sky can't be projected
+		backSH = irradianceSH;
+		bool project = skyStaging && ReadStaging(skyStaging, skyStagingDescription, skyPixels);
+
+		//Projecting a large sky takes longer than a frame, so it runs on a worker, along
+		//with decoding a compressed one.  It doesn't split across the workers itself, as
+		//it would be waiting on jobs queued behind it.
+		auto projectSH = [this, project]()
+		{
+			unsigned int size;
+			bool bgra;
+			if (project && PrepareSHFaces(skyStagingDescription, skyPixels, size, bgra))
+				backSH = SphericalHarmonics::ProjectIrradiance(skyPixels.data(), size, bgra);
+		};
+
+		JobSystem* jobs = Assets::GetInstance().GetJobSystem();
+		if (jobs)
+			backSHJob = jobs->Submit(projectSH);
+		else
+		{
+			projectSH();
+			std::promise<void> done;
+			done.set_value();
+			backSHJob = done.get_future();
+		}
+	}
+}
@@ -1,10 +1,17 @@
 #pragma once
 
+#include <future>
 #include <memory>
+#include <string>
+#include <cstdint>
 
 #include "Mesh.h"
 #include "SimpleShader.h"
 #include "Camera.h"
+#include "DDSFile.h"
+#include "SphericalHarmonics.h"
+#include "TimeSlicer.h"
+#include "GpuProfiler.h"
 
 #include <wrl/client.h> // Used for ComPtr
 
@@ -12,7 +19,8 @@ class Sky
 {
 public:
 
-	// Constructor that loads a DDS cube map file
+	// Constructor that loads a DDS cube map file, like the ones Assets cooks from six
+	// faces.  The fast path, as the faces come in compressed with their mips.
 	Sky(
 		const wchar_t* cubemapDDSFile, 
 		std::shared_ptr<Mesh> mesh,
@@ -43,14 +51,34 @@ public:
 
 	void Draw(std::shared_ptr<Camera> camera);
 
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetIrradianceMap() { return irradianceMap; }
+	const SHIrradiance& GetIrradianceSH() { return irradianceSH; }
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> getConvolvedSpecularMap() { return convolvedSpecularMap; }
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetBrdfLookUp() { return brdfLookUp; }
 	int GetNumOfMipLevels() { return mipLevels; }
 
+	// Swaps in a new sky cube and starts re-convolving the IBL maps from it
+	void SetSkyTexture(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> sky);
+	// Re-convolves the IBL maps from the current sky a few faces at a time, into a second
+	// set that is swapped in once complete, restarting any update in progress.  Call
+	// UpdateIBL once a frame, outside any pass, with the time it may take; it returns
+	// true on the frame the new maps are swapped in.
+	void BeginIBLUpdate();
+	bool UpdateIBL(uint64_t budgetMicroseconds);
+	bool IsIBLUpdating() { return iblSlicer.IsRunning() || backSHJob.valid(); }
+	TimeSlicer& GetIBLSlicer() { return iblSlicer; }
+
+	// How long the sky texture took to load
+	double GetLoadMs() { return loadMs; }
+
+	// How long the IBL maps took this run, and whether they came from the cache
+	double GetIBLMs() { return iblMs; }
+	bool GetIBLFromCache() { return iblFromCache; }
+
 private:
 
 	void InitRenderStates();
+	// Builds the IBL maps from the sky texture, or loads them if the files are cached
+	void InitIBL(const wchar_t* const* files, int fileCount);
 
 	// Helper for creating a cubemap from 6 individual textures
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(
@@ -61,10 +89,33 @@ private:
 		const wchar_t* front,
 		const wchar_t* back);
 
-	void IBLCreateIrradianceMap();
+	void IBLProjectIrradianceSH();
 	void IBLCreateConvolvedSpecularMap();
+	void IBLCreateSpecularTexture(Microsoft::WRL::ComPtr<ID3D11Texture2D>& texture, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv);
+	void IBLConvolveSpecularFace(Microsoft::WRL::ComPtr<ID3D11Texture2D> texture, int mip, int face);
+	// Leaves the faces of a read back sky packed at 8 bits, ready to project
+	bool PrepareSHFaces(const DDSDescription& description, std::vector<uint8_t>& data, unsigned int& size, bool& bgra);
 	void IBLCreateBRDFLookUpTexture();
 
+	// The IBL maps are kept in a cache next to the executable, keyed by a hash of the
+	// sky's files, the sizes above and the shaders that compute them
+	uint64_t HashIBLInputs(const wchar_t* const* files, int fileCount);
+	std::string GetIBLCachePath(uint64_t hash, const char* suffix);
+	bool LoadIBLCache(uint64_t hash, double& computeMs);
+	// Maps IBLBake wrote next to a DDS sky, used over the cache when they're newer than
+	// the sky and the same sizes as computed ones
+	bool LoadBakedIBL(const wchar_t* skyFile, double& bakeMs);
+	bool LoadIBLFiles(const std::string& specularPath, const std::string& brdfPath, const std::string& summaryPath, double& computeMs);
+	void SaveIBLCache(uint64_t hash, double computeMs);
+	bool SaveTexture(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, const std::string& path);
+	// Every slice and mip, packed as in a DDS file
+	bool ReadTexture(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, DDSDescription& description, std::vector<uint8_t>& data);
+	bool CopyToStaging(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, Microsoft::WRL::ComPtr<ID3D11Texture2D>& staging, DDSDescription& description);
+	bool ReadStaging(Microsoft::WRL::ComPtr<ID3D11Texture2D> staging, const DDSDescription& description, std::vector<uint8_t>& data);
+	void RunIBLUpdateItem(unsigned int item);
+	void ReadIBLTimings();
+	void WaitForGPU();
+
 	// Skybox related resources
 	std::shared_ptr<SimpleVertexShader> skyVS;
 	std::shared_ptr<SimplePixelShader> skyPS;
@@ -75,10 +126,36 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> skyDepthState;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> skySRV;
 
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> irradianceMap;
+	SHIrradiance irradianceSH;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> convolvedSpecularMap;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> brdfLookUp;
 	int mipLevels;
+	double loadMs;
+	double iblMs;
+	bool iblFromCache;
+
+	// Time sliced updates build these, then swap them in
+	TimeSlicer iblSlicer;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> backSpecularTexture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> backSpecularMap;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> skyStaging;
+	DDSDescription skyStagingDescription;
+	std::vector<uint8_t> skyPixels;
+	SHIrradiance backSH;
+	std::future<void> backSHJob;
+
+	// Timestamps around each face convolved in a slice, read back a few frames later
+	// (the same way GpuProfiler does) and reported to the slicer as the faces' costs
+	struct IBLTimings
+	{
+		Microsoft::WRL::ComPtr<ID3D11Query> Disjoint;
+		std::vector<Microsoft::WRL::ComPtr<ID3D11Query>> Begins;
+		std::vector<Microsoft::WRL::ComPtr<ID3D11Query>> Ends;
+		std::vector<unsigned int> Items;
+		bool Pending;
+	};
+	IBLTimings iblTimings[GpuProfiler::FrameLatency];
+	unsigned int iblTimingIndex;
 
 	const int mipLevelsToSkip = 3;
 	const int iblCubeSize = 256;
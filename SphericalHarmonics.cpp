@@ -0,0 +1,270 @@
+#include "SphericalHarmonics.h"
+#include "CubeFaces.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SPHERICAL_HARMONICS_SSE
+#endif
+
+using namespace std;
+
+static const float pi = 3.14159265f;
+
+// Sums for one run of rows: nine coefficients per channel, then the total weight
+struct SHSums
+{
+	double Values[28];
+};
+
+// The nine real L2 basis functions for a unit direction
+static void EvaluateBasis(float x, float y, float z, float* basis)
+{
+	basis[0] = 0.282095f;
+	basis[1] = 0.488603f * y;
+	basis[2] = 0.488603f * z;
+	basis[3] = 0.488603f * x;
+	basis[4] = 1.092548f * x * y;
+	basis[5] = 1.092548f * y * z;
+	basis[6] = 0.315392f * (3.0f * z * z - 1.0f);
+	basis[7] = 1.092548f * x * z;
+	basis[8] = 0.546274f * (x * x - y * y);
+}
+
+// 8 bit channel to linear, as pow(c, 2.2) in the shaders
+static const float* GetGammaTable()
+{
+	static const vector<float> table = []()
+	{
+		vector<float> values(256);
+		for (int i = 0; i < 256; i++)
+			values[i] = pow(i / 255.0f, 2.2f);
+		return values;
+	}();
+	return table.data();
+}
+
+static void ProjectRows(const uint8_t* faces, unsigned int size, bool bgra, unsigned int firstRow, unsigned int endRow, const float* gamma, SHSums& sums)
+{
+	fill(begin(sums.Values), end(sums.Values), 0.0);
+	int red = bgra ? 2 : 0;
+	int blue = bgra ? 0 : 2;
+	float texelSize = 2.0f / size;
+
+	for (unsigned int row = firstRow; row < endRow; row++)
+	{
+		unsigned int face = row / size;
+		const float (&axes)[3][3] = CubeFaceAxes[face];
+		float v = ((row % size) + 0.5f) * texelSize - 1.0f;
+		const uint8_t* pixels = faces + (size_t)row * size * 4;
+
+		//Everything but u is fixed along a row
+		float rowDir[3];
+		for (int a = 0; a < 3; a++)
+			rowDir[a] = axes[1][a] * v + axes[2][a];
+
+		float rowSums[28] = {};
+		unsigned int x = 0;
+
+#ifdef SPHERICAL_HARMONICS_SSE
+		//Four texels at a time, with per-row sums kept in float lanes
+		__m128 accumulators[28];
+		for (int i = 0; i < 28; i++)
+			accumulators[i] = _mm_setzero_ps();
+
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+		for (; x + 4 <= size; x += 4)
+		{
+			__m128 u = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)x), laneOffsets), _mm_set1_ps(texelSize)), one);
+			__m128 dx = _mm_add_ps(_mm_mul_ps(u, _mm_set1_ps(axes[0][0])), _mm_set1_ps(rowDir[0]));
+			__m128 dy = _mm_add_ps(_mm_mul_ps(u, _mm_set1_ps(axes[0][1])), _mm_set1_ps(rowDir[1]));
+			__m128 dz = _mm_add_ps(_mm_mul_ps(u, _mm_set1_ps(axes[0][2])), _mm_set1_ps(rowDir[2]));
+
+			//Solid angle goes as 1 / length^3 of the unnormalized direction
+			__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			__m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSq));
+			__m128 weight = _mm_mul_ps(invLength, _mm_mul_ps(invLength, invLength));
+			dx = _mm_mul_ps(dx, invLength);
+			dy = _mm_mul_ps(dy, invLength);
+			dz = _mm_mul_ps(dz, invLength);
+
+			__m128 basis[9];
+			basis[0] = _mm_set1_ps(0.282095f);
+			basis[1] = _mm_mul_ps(_mm_set1_ps(0.488603f), dy);
+			basis[2] = _mm_mul_ps(_mm_set1_ps(0.488603f), dz);
+			basis[3] = _mm_mul_ps(_mm_set1_ps(0.488603f), dx);
+			basis[4] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(dx, dy));
+			basis[5] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(dy, dz));
+			basis[6] = _mm_mul_ps(_mm_set1_ps(0.315392f), _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), _mm_mul_ps(dz, dz)), one));
+			basis[7] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(dx, dz));
+			basis[8] = _mm_mul_ps(_mm_set1_ps(0.546274f), _mm_sub_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+
+			const uint8_t* p = pixels + x * 4;
+			__m128 colors[3] = {
+				_mm_mul_ps(weight, _mm_set_ps(gamma[p[12 + red]], gamma[p[8 + red]], gamma[p[4 + red]], gamma[p[red]])),
+				_mm_mul_ps(weight, _mm_set_ps(gamma[p[13]], gamma[p[9]], gamma[p[5]], gamma[p[1]])),
+				_mm_mul_ps(weight, _mm_set_ps(gamma[p[12 + blue]], gamma[p[8 + blue]], gamma[p[4 + blue]], gamma[p[blue]])) };
+
+			for (int c = 0; c < 3; c++)
+				for (int i = 0; i < 9; i++)
+					accumulators[c * 9 + i] = _mm_add_ps(accumulators[c * 9 + i], _mm_mul_ps(colors[c], basis[i]));
+			accumulators[27] = _mm_add_ps(accumulators[27], weight);
+		}
+
+		for (int i = 0; i < 28; i++)
+		{
+			float lanes[4];
+			_mm_storeu_ps(lanes, accumulators[i]);
+			rowSums[i] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+		}
+#endif
+
+		//Whatever doesn't fill four lanes, or the whole row without SSE
+		for (; x < size; x++)
+		{
+			float u = (x + 0.5f) * texelSize - 1.0f;
+			float d[3];
+			for (int a = 0; a < 3; a++)
+				d[a] = axes[0][a] * u + rowDir[a];
+
+			float invLength = 1.0f / sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+			float weight = invLength * invLength * invLength;
+			float basis[9];
+			EvaluateBasis(d[0] * invLength, d[1] * invLength, d[2] * invLength, basis);
+
+			const uint8_t* p = pixels + x * 4;
+			float colors[3] = { gamma[p[red]] * weight, gamma[p[1]] * weight, gamma[p[blue]] * weight };
+			for (int c = 0; c < 3; c++)
+				for (int i = 0; i < 9; i++)
+					rowSums[c * 9 + i] += colors[c] * basis[i];
+			rowSums[27] += weight;
+		}
+
+		for (int i = 0; i < 28; i++)
+			sums.Values[i] += rowSums[i];
+	}
+}
+
+SHIrradiance SphericalHarmonics::ProjectIrradiance(const uint8_t* faces, unsigned int size, bool bgra, JobSystem* jobs)
+{
+	const float* gamma = GetGammaTable();
+	unsigned int rows = size * 6;
+
+	//Workers take a run of rows each, summed separately and added up at the end
+	unsigned int batchCount = jobs ? min(jobs->GetThreadCount() + 1, rows) : 1;
+	vector<SHSums> batches(batchCount);
+	vector<future<void>> running;
+	for (unsigned int b = 1; b < batchCount; b++)
+	{
+		SHSums* sums = &batches[b];
+		unsigned int firstRow = rows * b / batchCount;
+		unsigned int endRow = rows * (b + 1) / batchCount;
+		running.push_back(jobs->Submit([=]() { ProjectRows(faces, size, bgra, firstRow, endRow, gamma, *sums); }));
+	}
+	ProjectRows(faces, size, bgra, 0, rows / batchCount, gamma, batches[0]);
+	for (auto& r : running)
+		r.get();
+
+	double totals[28] = {};
+	for (const SHSums& sums : batches)
+		for (int i = 0; i < 28; i++)
+			totals[i] += sums.Values[i];
+
+	//The weights cover the whole sphere, so scale them to 4 pi, then convolve with the
+	//cosine lobe (pi, 2pi/3 and pi/4 per band) and divide by pi
+	static const double bandScale[9] = { 1.0, 2.0 / 3.0, 2.0 / 3.0, 2.0 / 3.0, 0.25, 0.25, 0.25, 0.25, 0.25 };
+	double normalize = totals[27] > 0 ? 4.0 * pi / totals[27] : 0.0;
+
+	SHIrradiance sh = {};
+	for (int i = 0; i < 9; i++)
+	{
+		double scale = normalize * bandScale[i];
+		sh.Coefficients[i] = DirectX::XMFLOAT4((float)(totals[i] * scale), (float)(totals[9 + i] * scale), (float)(totals[18 + i] * scale), 0);
+	}
+	return sh;
+}
+
+DirectX::XMFLOAT3 SphericalHarmonics::Evaluate(const SHIrradiance& sh, const DirectX::XMFLOAT3& normal)
+{
+	float length = sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+	float basis[9];
+	EvaluateBasis(normal.x / length, normal.y / length, normal.z / length, basis);
+
+	float result[3] = {};
+	for (int i = 0; i < 9; i++)
+	{
+		result[0] += sh.Coefficients[i].x * basis[i];
+		result[1] += sh.Coefficients[i].y * basis[i];
+		result[2] += sh.Coefficients[i].z * basis[i];
+	}
+
+	//Ringing can dip below zero opposite a bright light
+	return DirectX::XMFLOAT3(max(result[0], 0.0f), max(result[1], 0.0f), max(result[2], 0.0f));
+}
+
+DirectX::XMFLOAT3 SphericalHarmonics::ReferenceIrradiance(const uint8_t* faces, unsigned int size, bool bgra, const DirectX::XMFLOAT3& normal, float step)
+{
+	const float* gamma = GetGammaTable();
+	int red = bgra ? 2 : 0;
+	int blue = bgra ? 0 : 2;
+
+	//Nearest texel in a direction
+	auto sample = [&](float x, float y, float z, float* color)
+	{
+		float u, v;
+		unsigned int face = GetCubeFace(x, y, z, u, v);
+
+		unsigned int tx = min((unsigned int)max((u + 1.0f) * 0.5f * size, 0.0f), size - 1);
+		unsigned int ty = min((unsigned int)max((v + 1.0f) * 0.5f * size, 0.0f), size - 1);
+		const uint8_t* p = faces + (((size_t)face * size + ty) * size + tx) * 4;
+		color[0] = gamma[p[red]];
+		color[1] = gamma[p[1]];
+		color[2] = gamma[p[blue]];
+	};
+
+	//Same tangent basis and loops as the shader, with an up that can't be parallel
+	float length = sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+	float zDir[3] = { normal.x / length, normal.y / length, normal.z / length };
+	float up[3] = { 0, 1, 0 };
+	if (fabs(zDir[1]) > 0.999f)
+	{
+		up[1] = 0;
+		up[2] = 1;
+	}
+	float xDir[3] = { up[1] * zDir[2] - up[2] * zDir[1], up[2] * zDir[0] - up[0] * zDir[2], up[0] * zDir[1] - up[1] * zDir[0] };
+	float xLength = sqrt(xDir[0] * xDir[0] + xDir[1] * xDir[1] + xDir[2] * xDir[2]);
+	for (int a = 0; a < 3; a++)
+		xDir[a] /= xLength;
+	float yDir[3] = { zDir[1] * xDir[2] - zDir[2] * xDir[1], zDir[2] * xDir[0] - zDir[0] * xDir[2], zDir[0] * xDir[1] - zDir[1] * xDir[0] };
+
+	double total[3] = {};
+	int sampleCount = 0;
+	for (float phi = 0.0f; phi < 2.0f * pi; phi += step)
+	{
+		float sinP = sin(phi), cosP = cos(phi);
+		for (float theta = 0.0f; theta < pi / 2.0f; theta += step)
+		{
+			float sinT = sin(theta), cosT = cos(theta);
+			float local[3] = { sinT * cosP, sinT * sinP, cosT };
+			float color[3];
+			sample(
+				local[0] * xDir[0] + local[1] * yDir[0] + local[2] * zDir[0],
+				local[0] * xDir[1] + local[1] * yDir[1] + local[2] * zDir[1],
+				local[0] * xDir[2] + local[1] * yDir[2] + local[2] * zDir[2],
+				color);
+			for (int c = 0; c < 3; c++)
+				total[c] += cosT * sinT * color[c];
+			sampleCount++;
+		}
+	}
+
+	return DirectX::XMFLOAT3(
+		(float)(pi * total[0] / sampleCount),
+		(float)(pi * total[1] / sampleCount),
+		(float)(pi * total[2] / sampleCount));
+}
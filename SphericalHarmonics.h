@@ -0,0 +1,33 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cstdint>
+
+class JobSystem;
+
+// Diffuse irradiance as an L2 spherical harmonic expansion: nine RGB coefficients, each
+// padded to a float4 so the set can go straight into a cbuffer.  They are already
+// convolved with the cosine lobe and divided by pi, so summing them against the basis
+// gives what the old irradiance cube held (linear, not gamma encoded).
+struct SHIrradiance
+{
+	DirectX::XMFLOAT4 Coefficients[9];
+};
+
+// Projects a cube map onto spherical harmonics on the CPU.  Faces are 8 bit RGBA (or
+// BGRA), square, tightly packed and in D3D's face order, and are gamma decoded with 2.2
+// the way the shaders sample them.
+//
+// Everything is plain math, so nothing here needs D3D.
+class SphericalHarmonics
+{
+public:
+	// Rows are spread across the job system's workers when one is given
+	static SHIrradiance ProjectIrradiance(const uint8_t* faces, unsigned int size, bool bgra, JobSystem* jobs = 0);
+
+	// Irradiance over pi around a normal, as the PBR shader evaluates it
+	static DirectX::XMFLOAT3 Evaluate(const SHIrradiance& sh, const DirectX::XMFLOAT3& normal);
+
+	// The brute force hemisphere integral the irradiance cube used to be rendered with
+	// (the default step, in radians, is the one it used), for checking the projection
+	static DirectX::XMFLOAT3 ReferenceIrradiance(const uint8_t* faces, unsigned int size, bool bgra, const DirectX::XMFLOAT3& normal, float step = 0.025f);
+};
@@ -0,0 +1,117 @@
+#include "AssetHandles.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+typedef AssetTable<std::shared_ptr<int>, TextureHandle> TestTable;
+
+TEST(AssetHandles, LiteralsHashAtCompileTime)
+{
+	constexpr AssetName name = "cobblestone_albedo"_asset;
+	static_assert(name.Id == AssetName::Hash("cobblestone_albedo"), "literal and runtime hashes differ");
+	EXPECT_EQ(name.Id, AssetName(std::string("cobblestone_albedo")).Id);
+}
+
+TEST(AssetHandles, NamesIgnoreCase)
+{
+	EXPECT_EQ(AssetName("sphere").Id, AssetName("Sphere").Id);
+	EXPECT_EQ(AssetName("MotionBlurPS").Id, AssetName(std::string("motionblurps")).Id);
+	EXPECT_NE(AssetName("sphere").Id, AssetName("spheres").Id);
+
+	//The same file asked for in two cases is one asset, not two copies
+	TestTable table;
+	TextureHandle lower = table.Add("sphere", std::make_shared<int>(1));
+	TextureHandle upper = table.Add("Sphere", std::make_shared<int>(2));
+	EXPECT_EQ(lower, upper);
+	EXPECT_EQ(1u, table.Size());
+	EXPECT_EQ(1, *table.Get(table.Find(AssetName("SPHERE"))));
+}
+
+// Two names hashing the same are forced here, since real 64 bit collisions are rare
+TEST(AssetHandles, CollidingNamesAreNotConfused)
+{
+	TestTable table;
+	TextureHandle rock = table.Add("rock", std::make_shared<int>(1));
+	TextureHandle collision = table.Add(AssetName("rock"), "moss", std::make_shared<int>(2));
+	EXPECT_FALSE(collision.IsValid());
+	EXPECT_EQ(1u, table.Size());
+	EXPECT_EQ(1, *table.Get(rock));
+
+	//The same name in another case is still the same asset
+	EXPECT_EQ(rock, table.Add(AssetName("rock"), "ROCK", std::make_shared<int>(3)));
+}
+
+TEST(AssetHandles, StaleHandlesDontResolve)
+{
+	TestTable table;
+	TextureHandle first = table.Add("first", std::make_shared<int>(1));
+	EXPECT_TRUE(table.IsCurrent(first));
+	EXPECT_FALSE(table.IsCurrent(TextureHandle()));
+
+	ASSERT_TRUE(table.Remove(first));
+	EXPECT_FALSE(table.Get(first));
+	EXPECT_FALSE(table.Find(AssetName("first")).IsValid());
+	EXPECT_FALSE(table.Remove(first));
+
+	//The slot is reused with a new generation, so the old handle stays dead
+	TextureHandle second = table.Add("second", std::make_shared<int>(2));
+	EXPECT_EQ(first.Index, second.Index);
+	EXPECT_NE(first.Generation, second.Generation);
+	EXPECT_FALSE(table.Get(first));
+	EXPECT_EQ(2, *table.Get(second));
+}
+
+TEST(AssetHandles, ReplaceKeepsTheHandle)
+{
+	TestTable table;
+	TextureHandle handle = table.Add("rock", std::make_shared<int>(1));
+	EXPECT_TRUE(table.Replace(handle, std::make_shared<int>(2)));
+	EXPECT_EQ(handle, table.Find(AssetName("rock")));
+	EXPECT_EQ(2, *table.Get(handle));
+}
+
+// Lookups per second through the string keyed maps the tables replaced, an interned
+// literal, and a handle kept from an earlier lookup
+TEST(AssetHandles, DISABLED_LookupThroughputBenchmark)
+{
+	const int assetCount = 500;
+	const int lookups = 2000000;
+	TestTable table;
+	std::unordered_map<std::string, std::shared_ptr<int>> stringMap;
+	for (int i = 0; i < assetCount; i++)
+	{
+		std::string name = "texture_" + std::to_string(i) + "_albedo";
+		auto value = std::make_shared<int>(i);
+		table.Add(name, value);
+		stringMap[name] = value;
+	}
+	table.Add("cobblestone_albedo", std::make_shared<int>(-1));
+	stringMap["cobblestone_albedo"] = std::make_shared<int>(-1);
+
+	auto lookupsPerSecond = [&](std::function<int()> lookup)
+	{
+		long long sum = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < lookups; i++)
+			sum += lookup();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		EXPECT_EQ(-(long long)lookups, sum);
+		return lookups / seconds;
+	};
+
+	//The old API built a std::string from the literal on every call
+	double strings = lookupsPerSecond([&]() { return *stringMap[std::string("cobblestone_albedo")]; });
+	double interned = lookupsPerSecond([&]() { return *table.Get(table.Find("cobblestone_albedo"_asset)); });
+	TextureHandle handle = table.Find("cobblestone_albedo"_asset);
+	double handles = lookupsPerSecond([&]() { return *table.Get(handle); });
+
+	printf("Lookups per second: string map %.1fM, interned name %.1fM, handle %.1fM\n", strings / 1e6, interned / 1e6, handles / 1e6);
+	RecordProperty("StringLookupsPerSecond", (int)strings);
+	RecordProperty("InternedLookupsPerSecond", (int)interned);
+	RecordProperty("HandleLookupsPerSecond", (int)handles);
+}
@@ -0,0 +1,288 @@
+#include "AssetLoader.h"
+#include "DDSFile.h"
+#include "MeshData.h"
+#include <gtest/gtest.h>
+
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include <experimental/filesystem>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+	const int GridSize = 48;
+	const unsigned int TextureSize = 256;
+
+	// A flat grid of quads, two triangles each, with every line a vertex needs
+	void WriteGridOBJ(const std::string& path)
+	{
+		std::ofstream obj(path);
+		for (int y = 0; y <= GridSize; y++)
+		{
+			for (int x = 0; x <= GridSize; x++)
+			{
+				obj << "v " << x << " 0 " << y << "\n";
+				obj << "vt " << (float)x / GridSize << " " << (float)y / GridSize << "\n";
+				obj << "vn 0 1 0\n";
+			}
+		}
+		for (int y = 0; y < GridSize; y++)
+		{
+			for (int x = 0; x < GridSize; x++)
+			{
+				int a = y * (GridSize + 1) + x + 1;
+				int b = a + 1;
+				int c = a + GridSize + 1;
+				int d = c + 1;
+				obj << "f " << a << "/" << a << "/" << a << " " << c << "/" << c << "/" << c << " " << b << "/" << b << "/" << b << "\n";
+				obj << "f " << b << "/" << b << "/" << b << " " << c << "/" << c << "/" << c << " " << d << "/" << d << "/" << d << "\n";
+			}
+		}
+	}
+
+	// RGBA8 with a full mip chain
+	void WriteTextureDDS(const std::string& path, uint8_t seed)
+	{
+		DDSDescription description = {};
+		description.Format = 28;
+		description.Width = TextureSize;
+		description.Height = TextureSize;
+		description.ArraySize = 1;
+		while ((TextureSize >> description.MipCount) > 0)
+			description.MipCount++;
+
+		std::vector<uint8_t> data(DDSFile::TotalBytes(description));
+		for (size_t i = 0; i < data.size(); i++)
+			data[i] = (uint8_t)(i * 31 + seed);
+		ASSERT_TRUE(DDSFile::Write(path, description, data.data(), data.size()));
+	}
+
+	// A tree of meshes and textures in its own directory, so runs never share files
+	class AssetTree : public testing::Test
+	{
+	protected:
+		static const int MeshCount = 8;
+		static const int TextureCount = 8;
+
+		void SetUp() override
+		{
+			const testing::TestInfo* test = testing::UnitTest::GetInstance()->current_test_info();
+			root = fs::temp_directory_path() / (std::string("AssetLoading_") + test->name() + "_" +
+				std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+			fs::create_directories(root / "Models");
+			fs::create_directories(root / "Textures");
+
+			for (int i = 0; i < MeshCount; i++)
+				WriteGridOBJ((root / "Models" / ("grid" + std::to_string(i) + ".obj")).string());
+			for (int i = 0; i < TextureCount; i++)
+				WriteTextureDDS((root / "Textures" / ("texture" + std::to_string(i) + ".dds")).string(), (uint8_t)i);
+		}
+
+		void TearDown() override
+		{
+			std::error_code error;
+			fs::remove_all(root, error);
+		}
+
+		// Queues the whole tree and finishes it, the way Assets does at startup.  Finishing a
+		// mesh gives its vertex count, and a texture its byte count.
+		double LoadTree(AssetLoader& loader)
+		{
+			AssetLoadQueue<MeshData, size_t> meshes(loader);
+			AssetLoadQueue<std::vector<uint8_t>, size_t> textures(loader);
+			loader.Restart();
+
+			for (auto& entry : fs::recursive_directory_iterator(root))
+			{
+				fs::path path = entry.path();
+				std::string name = path.stem().string();
+				if (path.extension() == ".obj")
+				{
+					meshes.Queue(path.string(), name, "Mesh", MeshData(), [](AssetLoadQueue<MeshData, size_t>::Pending& pending) {
+						return LoadOBJ(pending.Path.c_str(), pending.Decoded);
+					});
+				}
+				else if (path.extension() == ".dds")
+				{
+					textures.Queue(path.string(), name, "DDSTexture", std::vector<uint8_t>(), [](AssetLoadQueue<std::vector<uint8_t>, size_t>::Pending& pending) {
+						DDSDescription description;
+						return DDSFile::Read(pending.Path, description, pending.Decoded);
+					});
+				}
+			}
+
+			while (meshes.Size() + textures.Size() > 0)
+			{
+				meshes.FinishReady([](AssetLoadQueue<MeshData, size_t>::Pending& pending) {
+					EXPECT_FALSE(pending.Failed) << pending.Path;
+					return pending.Decoded.Vertices.size();
+				});
+				textures.FinishReady([](AssetLoadQueue<std::vector<uint8_t>, size_t>::Pending& pending) {
+					EXPECT_FALSE(pending.Failed) << pending.Path;
+					return pending.Decoded.size();
+				});
+				std::this_thread::yield();
+			}
+			return loader.GetClockMs();
+		}
+
+		fs::path root;
+	};
+
+	void ExpectCompleteTimeline(const std::vector<AssetLoadTiming>& timeline, int meshCount, int textureCount, bool onWorkers)
+	{
+		ASSERT_EQ((size_t)(meshCount + textureCount), timeline.size());
+		int meshes = 0;
+		int textures = 0;
+		for (auto& t : timeline)
+		{
+			if (t.Type == "Mesh")
+				meshes++;
+			else if (t.Type == "DDSTexture")
+				textures++;
+
+			EXPECT_FALSE(t.Name.empty());
+			EXPECT_LE(0.0, t.QueuedMs);
+			EXPECT_LE(t.QueuedMs, t.DecodeStartMs) << t.Name;
+			EXPECT_LE(t.DecodeStartMs, t.DecodeEndMs) << t.Name;
+			EXPECT_LE(t.DecodeEndMs, t.CreateStartMs) << t.Name;
+			EXPECT_LE(t.CreateStartMs, t.CreateEndMs) << t.Name;
+			if (onWorkers)
+			{
+				EXPECT_LE(0, t.WorkerIndex) << t.Name;
+			}
+			else
+			{
+				EXPECT_EQ(-1, t.WorkerIndex) << t.Name;
+			}
+		}
+		EXPECT_EQ(meshCount, meshes);
+		EXPECT_EQ(textureCount, textures);
+	}
+}
+
+TEST_F(AssetTree, SerialLoadDecodesOnTheCallingThread)
+{
+	AssetLoader loader;
+	LoadTree(loader);
+	ExpectCompleteTimeline(loader.GetTimeline(), MeshCount, TextureCount, false);
+
+	//Nothing overlaps, so each decode ends before the next asset is even queued
+	std::vector<AssetLoadTiming> timeline = loader.GetTimeline();
+	std::sort(timeline.begin(), timeline.end(), [](const AssetLoadTiming& a, const AssetLoadTiming& b) { return a.QueuedMs < b.QueuedMs; });
+	for (size_t i = 1; i < timeline.size(); i++)
+		EXPECT_LE(timeline[i - 1].DecodeEndMs, timeline[i].QueuedMs);
+}
+
+TEST_F(AssetTree, JobLoadDecodesOnWorkers)
+{
+	JobSystem jobs(4);
+	AssetLoader loader(&jobs);
+	LoadTree(loader);
+	ExpectCompleteTimeline(loader.GetTimeline(), MeshCount, TextureCount, true);
+}
+
+// Times the startup load both ways.  Whether jobs win depends on the machine's cores, so
+// the times are recorded rather than compared.
+TEST_F(AssetTree, SerialAgainstJobs)
+{
+	AssetLoader serialLoader;
+	double serialMs = LoadTree(serialLoader);
+
+	JobSystem jobs;
+	AssetLoader jobLoader(&jobs);
+	double jobMs = LoadTree(jobLoader);
+
+	ExpectCompleteTimeline(serialLoader.GetTimeline(), MeshCount, TextureCount, false);
+	ExpectCompleteTimeline(jobLoader.GetTimeline(), MeshCount, TextureCount, true);
+
+	RecordProperty("SerialMs", std::to_string(serialMs));
+	RecordProperty("JobMs", std::to_string(jobMs));
+	RecordProperty("Workers", std::to_string(jobs.GetThreadCount()));
+	printf("Loaded %d assets: serial %.2f ms, %u workers %.2f ms (%.2fx)\n",
+		MeshCount + TextureCount, serialMs, jobs.GetThreadCount(), jobMs, serialMs / jobMs);
+}
+
+// Each decode waits for all of them to start, which only finishes if they overlap
+TEST(AssetLoader, DecodesRunTogether)
+{
+	const int assetCount = 4;
+	JobSystem jobs(assetCount);
+	AssetLoader loader(&jobs);
+	AssetLoadQueue<int, int> queue(loader);
+
+	std::mutex mutex;
+	std::condition_variable allStarted;
+	int started = 0;
+	for (int i = 0; i < assetCount; i++)
+	{
+		queue.Queue("", "asset" + std::to_string(i), "Mesh", i, [&](AssetLoadQueue<int, int>::Pending&) {
+			std::unique_lock<std::mutex> lock(mutex);
+			started++;
+			allStarted.notify_all();
+			return allStarted.wait_for(lock, std::chrono::seconds(10), [&]() { return started == assetCount; });
+		});
+	}
+
+	for (int i = 0; i < assetCount; i++)
+	{
+		int result = -1;
+		ASSERT_TRUE(queue.Finish("asset" + std::to_string(i), [](AssetLoadQueue<int, int>::Pending& pending) {
+			EXPECT_FALSE(pending.Failed);
+			return pending.Decoded;
+		}, result));
+		EXPECT_EQ(i, result);
+	}
+	EXPECT_EQ(0u, queue.Size());
+	ExpectCompleteTimeline(loader.GetTimeline(), assetCount, 0, true);
+}
+
+TEST(AssetLoader, PendingNamesIgnoreCase)
+{
+	AssetLoader loader;
+	AssetLoadQueue<int, int> queue(loader);
+	auto decode = [](AssetLoadQueue<int, int>::Pending&) { return true; };
+	auto finish = [](AssetLoadQueue<int, int>::Pending& pending) { return pending.Decoded * 2; };
+
+	EXPECT_TRUE(queue.Queue("Models/Sphere.obj", "Sphere", "Mesh", 21, decode));
+	EXPECT_FALSE(queue.Queue("models/sphere.obj", "SPHERE", "Mesh", 5, decode));
+	EXPECT_EQ(1u, queue.Size());
+	EXPECT_TRUE(queue.IsPending("sphere"));
+
+	std::shared_future<int> result;
+	ASSERT_TRUE(queue.GetResult("sPhErE", result));
+	EXPECT_EQ(std::future_status::timeout, result.wait_for(std::chrono::seconds(0)));
+
+	int created = 0;
+	ASSERT_TRUE(queue.Finish("SPHERE", finish, created));
+	EXPECT_EQ(42, created);
+	EXPECT_EQ(42, result.get());
+	EXPECT_FALSE(queue.IsPending("Sphere"));
+	EXPECT_FALSE(queue.Finish("Sphere", finish, created));
+
+	ASSERT_EQ(1u, loader.GetTimeline().size());
+	EXPECT_EQ("Sphere", loader.GetTimeline()[0].Name);
+}
+
+TEST(AssetLoader, FailedDecodesStillFinish)
+{
+	AssetLoader loader;
+	AssetLoadQueue<MeshData, bool> queue(loader);
+	queue.Queue("no/such/file.obj", "missing", "Mesh", MeshData(), [](AssetLoadQueue<MeshData, bool>::Pending& pending) {
+		return LoadOBJ(pending.Path.c_str(), pending.Decoded);
+	});
+
+	bool failed = false;
+	queue.FinishReady([&](AssetLoadQueue<MeshData, bool>::Pending& pending) { failed = pending.Failed; return !pending.Failed; });
+	EXPECT_TRUE(failed);
+	EXPECT_EQ(0u, queue.Size());
+	EXPECT_EQ(1u, loader.GetTimeline().size());
+}
@@ -0,0 +1,145 @@
+#include "BenchmarkReport.h"
+#include "JsonReader.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const uint64_t Ms = 1000000;
+
+static ProfileEvent Scope(const char* name, uint64_t startMs, uint64_t endMs, ProfileTrack track = PROFILE_TRACK_CPU)
+{
+	return { name, startMs * Ms, endMs * Ms, 0, 0, (uint16_t)track };
+}
+
+TEST(BenchmarkReport, PercentilesAreNearestRank)
+{
+	//1 to 100 shuffled, so each percentile is its own rank
+	std::vector<double> samples;
+	for (int i = 0; i < 100; i++)
+		samples.push_back((i * 37) % 100 + 1);
+
+	BenchmarkStats stats = BenchmarkReport::Summarize(samples);
+	EXPECT_DOUBLE_EQ(50.5, stats.Mean);
+	EXPECT_DOUBLE_EQ(1, stats.Min);
+	EXPECT_DOUBLE_EQ(50, stats.P50);
+	EXPECT_DOUBLE_EQ(90, stats.P90);
+	EXPECT_DOUBLE_EQ(95, stats.P95);
+	EXPECT_DOUBLE_EQ(99, stats.P99);
+	EXPECT_DOUBLE_EQ(100, stats.Max);
+}
+
+TEST(BenchmarkReport, PercentilesOfFewFramesAreMeasuredValues)
+{
+	//Ranks round up: ceil(0.5 * 5) = 3, ceil(0.9 * 5) = 5
+	BenchmarkStats stats = BenchmarkReport::Summarize({ 4, 1, 5, 2, 3 });
+	EXPECT_DOUBLE_EQ(3, stats.Mean);
+	EXPECT_DOUBLE_EQ(3, stats.P50);
+	EXPECT_DOUBLE_EQ(5, stats.P90);
+	EXPECT_DOUBLE_EQ(5, stats.P99);
+
+	BenchmarkStats one = BenchmarkReport::Summarize({ 7 });
+	EXPECT_DOUBLE_EQ(7, one.Min);
+	EXPECT_DOUBLE_EQ(7, one.P50);
+	EXPECT_DOUBLE_EQ(7, one.P99);
+
+	BenchmarkStats none = BenchmarkReport::Summarize({});
+	EXPECT_DOUBLE_EQ(0, none.Mean);
+	EXPECT_DOUBLE_EQ(0, none.Max);
+}
+
+TEST(BenchmarkReport, ScopesAreTotalledPerFrameAndZeroFilled)
+{
+	BenchmarkReport report;
+	report.AddFrame(10 * Ms, { Scope("Update", 0, 2), Scope("Update", 3, 4) });
+	//A scope first seen late counts as zero in the frames before
+	report.AddFrame(20 * Ms, { Scope("Update", 0, 1), Scope("Draw", 1, 9), Scope("GpuDraw", 0, 50, PROFILE_TRACK_GPU) });
+	//And frames it skips count as zero after
+	report.AddFrame(30 * Ms, { Scope("Update", 0, 3) });
+	report.AddFrame(40 * Ms, {});
+
+	EXPECT_EQ(4u, report.GetFrameCount());
+	BenchmarkStats frames = report.GetFrameStats();
+	EXPECT_DOUBLE_EQ(25, frames.Mean);
+	EXPECT_DOUBLE_EQ(10, frames.Min);
+	EXPECT_DOUBLE_EQ(40, frames.Max);
+
+	JsonValue json;
+	ASSERT_TRUE(JsonValue::Parse(report.ToJson(), json));
+	const JsonValue& scopes = json["scopes"];
+	ASSERT_EQ(2u, scopes.Items.size());
+
+	//In the order first seen, with GPU events left out.  Update's two calls in the first
+	//frame add up to 3 ms.
+	const JsonValue& update = scopes[0];
+	EXPECT_EQ("Update", update["name"].StringValue);
+	EXPECT_DOUBLE_EQ(1.0, update["calls_per_frame"].NumberValue);
+	EXPECT_DOUBLE_EQ(1.75, update["mean"].NumberValue);
+	EXPECT_DOUBLE_EQ(0, update["min"].NumberValue);
+	EXPECT_DOUBLE_EQ(3, update["max"].NumberValue);
+
+	const JsonValue& draw = scopes[1];
+	EXPECT_EQ("Draw", draw["name"].StringValue);
+	EXPECT_DOUBLE_EQ(0.25, draw["calls_per_frame"].NumberValue);
+	EXPECT_DOUBLE_EQ(2, draw["mean"].NumberValue);
+	EXPECT_DOUBLE_EQ(0, draw["min"].NumberValue);
+	EXPECT_DOUBLE_EQ(0, draw["p50"].NumberValue);
+	EXPECT_DOUBLE_EQ(8, draw["p90"].NumberValue);
+	EXPECT_DOUBLE_EQ(8, draw["max"].NumberValue);
+}
+
+TEST(BenchmarkReport, JsonHasTheSceneFramesAndScopes)
+{
+	BenchmarkReport report;
+	report.AddParameter("lights", 256);
+	report.AddParameter("scale", 0.1);
+	report.AddParameter("device", "null \"device\"");
+	report.AddFrame(16 * Ms, { Scope("Frame", 0, 16) });
+	report.AddFrame(17 * Ms, { Scope("Frame", 0, 17) });
+
+	JsonValue json;
+	std::string text = report.ToJson();
+	ASSERT_TRUE(JsonValue::Parse(text, json)) << text;
+	EXPECT_EQ((std::vector<std::string>{ "scene", "frames", "frame_ms", "scopes" }), json.Order);
+
+	//Parameters keep their order and exact values
+	const JsonValue& scene = json["scene"];
+	EXPECT_EQ((std::vector<std::string>{ "lights", "scale", "device" }), scene.Order);
+	EXPECT_EQ(256, scene["lights"].NumberValue);
+	EXPECT_EQ(0.1, scene["scale"].NumberValue);
+	EXPECT_EQ("null \"device\"", scene["device"].StringValue);
+
+	EXPECT_EQ(2, json["frames"].NumberValue);
+	const JsonValue& frameMs = json["frame_ms"];
+	for (const char* stat : { "mean", "min", "p50", "p90", "p95", "p99", "max" })
+		EXPECT_EQ(JsonValue::Number, frameMs[stat].Kind) << stat;
+	EXPECT_DOUBLE_EQ(16.5, frameMs["mean"].NumberValue);
+	EXPECT_DOUBLE_EQ(16, frameMs["p50"].NumberValue);
+	EXPECT_DOUBLE_EQ(17, frameMs["p99"].NumberValue);
+
+	ASSERT_EQ(1u, json["scopes"].Items.size());
+	EXPECT_EQ("Frame", json["scopes"][0]["name"].StringValue);
+	EXPECT_DOUBLE_EQ(16.5, json["scopes"][0]["mean"].NumberValue);
+
+	//What's written is what ToJson gives
+	std::string path = testing::TempDir() + "BenchmarkReportTest.json";
+	ASSERT_TRUE(report.WriteJson(path));
+	std::ifstream file(path, std::ios::binary);
+	std::stringstream written;
+	written << file.rdbuf();
+	EXPECT_EQ(text, written.str());
+	file.close();
+	remove(path.c_str());
+}
+
+TEST(BenchmarkReport, EmptyReportIsValidJson)
+{
+	BenchmarkReport report;
+	JsonValue json;
+	ASSERT_TRUE(JsonValue::Parse(report.ToJson(), json));
+	EXPECT_EQ(0, json["frames"].NumberValue);
+	EXPECT_TRUE(json["scopes"].Items.empty());
+	EXPECT_TRUE(json["scene"].Members.empty());
+}
@@ -0,0 +1,207 @@
+#include "DirtyRanges.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+static std::vector<unsigned int> Flatten(DirtyRanges& dirty)
+{
+	std::vector<unsigned int> flat;
+	for (const DirtyRange& range : dirty.GetRanges())
+	{
+		flat.push_back(range.First);
+		flat.push_back(range.Count);
+	}
+	return flat;
+}
+
+TEST(DirtyRanges, GapsUpToMergeGapAreJoined)
+{
+	DirtyRanges dirty(4);
+	dirty.Resize(100);
+	dirty.Clear();
+
+	//Four clean elements between them, so one range
+	dirty.Mark(10);
+	dirty.Mark(15);
+	EXPECT_EQ((std::vector<unsigned int>{ 10, 6 }), Flatten(dirty));
+
+	//Five is one too many
+	dirty.Mark(21);
+	EXPECT_EQ((std::vector<unsigned int>{ 10, 6, 21, 1 }), Flatten(dirty));
+
+	//Touching ranges join with no gap at all
+	DirtyRanges exact(0);
+	exact.Resize(100);
+	exact.Clear();
+	exact.Mark(0, 5);
+	exact.Mark(5, 5);
+	exact.Mark(11, 1);
+	EXPECT_EQ((std::vector<unsigned int>{ 0, 10, 11, 1 }), Flatten(exact));
+}
+
+TEST(DirtyRanges, OutOfOrderMarksAreSortedAndMerged)
+{
+	DirtyRanges dirty(2);
+	dirty.Resize(100);
+	dirty.Clear();
+
+	dirty.Mark(50, 5);
+	dirty.Mark(10);
+	dirty.Mark(57);
+	dirty.Mark(12, 3);
+	dirty.Mark(80);
+	dirty.Mark(52, 10);
+	dirty.Mark(11);
+	EXPECT_EQ((std::vector<unsigned int>{ 10, 5, 50, 12, 80, 1 }), Flatten(dirty));
+	EXPECT_EQ(18u, dirty.GetDirtyCount());
+
+	//Marking inside what's already dirty changes nothing
+	dirty.Mark(51, 3);
+	EXPECT_EQ((std::vector<unsigned int>{ 10, 5, 50, 12, 80, 1 }), Flatten(dirty));
+}
+
+TEST(DirtyRanges, MarksPastTheEndAreClipped)
+{
+	DirtyRanges dirty;
+	dirty.Resize(10);
+	dirty.Clear();
+
+	dirty.Mark(8, 100);
+	dirty.Mark(10);
+	dirty.Mark(3, 0);
+	EXPECT_EQ((std::vector<unsigned int>{ 8, 2 }), Flatten(dirty));
+}
+
+TEST(DirtyRanges, ShrinkingClipsAndDropsRanges)
+{
+	DirtyRanges dirty(1);
+	dirty.Resize(100);
+	dirty.Clear();
+	dirty.Mark(5, 5);
+	dirty.Mark(30, 20);
+	dirty.Mark(70, 10);
+
+	dirty.Resize(40);
+	EXPECT_EQ(40u, dirty.GetSize());
+	EXPECT_EQ((std::vector<unsigned int>{ 5, 5, 30, 10 }), Flatten(dirty));
+	EXPECT_EQ(15u, dirty.GetDirtyCount());
+
+	//Ending exactly where a range starts drops it
+	dirty.Resize(30);
+	EXPECT_EQ((std::vector<unsigned int>{ 5, 5 }), Flatten(dirty));
+
+	dirty.Resize(0);
+	EXPECT_TRUE(dirty.IsClean());
+	EXPECT_EQ(0u, dirty.GetDirtyCount());
+}
+
+TEST(DirtyRanges, GrowingMarksTheNewTail)
+{
+	DirtyRanges dirty(0);
+	dirty.Resize(16);
+	EXPECT_EQ((std::vector<unsigned int>{ 0, 16 }), Flatten(dirty));
+
+	dirty.Clear();
+	EXPECT_TRUE(dirty.IsClean());
+	dirty.Mark(2);
+	dirty.Resize(24);
+	EXPECT_EQ((std::vector<unsigned int>{ 2, 1, 16, 8 }), Flatten(dirty));
+	EXPECT_EQ(9u, dirty.GetDirtyCount());
+
+	//Resizing to the same size marks nothing
+	dirty.Clear();
+	dirty.Resize(24);
+	EXPECT_TRUE(dirty.IsClean());
+}
+
+TEST(DirtyRanges, MarkAllCoversEverything)
+{
+	DirtyRanges dirty;
+	dirty.MarkAll();
+	EXPECT_TRUE(dirty.IsClean());
+
+	dirty.Resize(40);
+	dirty.Clear();
+	dirty.Mark(3);
+	dirty.MarkAll();
+	EXPECT_EQ((std::vector<unsigned int>{ 0, 40 }), Flatten(dirty));
+	EXPECT_EQ(40u, dirty.GetDirtyCount());
+}
+
+// Random marks and resizes, checked against a flag per element.  The ranges must cover
+// every dirty element, start on one, and hold no clean run longer than the merge gap.
+TEST(DirtyRanges, MatchesPerElementFlags)
+{
+	std::mt19937 random(7);
+	for (unsigned int mergeGap : { 0u, 1u, 4u, 16u })
+	{
+		SCOPED_TRACE(testing::Message() << "merge gap " << mergeGap);
+		DirtyRanges dirty(mergeGap);
+		std::vector<bool> flags;
+
+		for (int step = 0; step < 2000; step++)
+		{
+			unsigned int action = random() % 100;
+			if (action < 5)
+			{
+				unsigned int size = random() % 300;
+				if (size > flags.size())
+					flags.resize(size, true);
+				else
+					flags.resize(size);
+				dirty.Resize(size);
+			}
+			else if (action < 7)
+			{
+				dirty.Clear();
+				flags.assign(flags.size(), false);
+			}
+			else
+			{
+				//Mostly single elements, sometimes runs that may pass the end
+				unsigned int first = random() % 320;
+				unsigned int count = random() % 4 ? 1 : random() % 40;
+				dirty.Mark(first, count);
+				for (unsigned int i = first; i < first + count && i < flags.size(); i++)
+					flags[i] = true;
+			}
+
+			//Checking merges the marks, so only look every few steps to leave some unmerged
+			if (step % 7)
+				continue;
+
+			const std::vector<DirtyRange>& ranges = dirty.GetRanges();
+			std::vector<bool> covered(flags.size(), false);
+			unsigned int dirtyCount = 0;
+			for (size_t r = 0; r < ranges.size(); r++)
+			{
+				const DirtyRange& range = ranges[r];
+				ASSERT_GT(range.Count, 0u);
+				ASSERT_LE(range.First + range.Count, flags.size());
+				ASSERT_TRUE(flags[range.First]);
+				if (r > 0)
+				{
+					ASSERT_GT(range.First, ranges[r - 1].First + ranges[r - 1].Count + mergeGap);
+				}
+
+				unsigned int cleanRun = 0;
+				for (unsigned int i = range.First; i < range.First + range.Count; i++)
+				{
+					covered[i] = true;
+					cleanRun = flags[i] ? 0 : cleanRun + 1;
+					ASSERT_LE(cleanRun, mergeGap);
+				}
+				dirtyCount += range.Count;
+			}
+
+			bool anyDirty = false;
+			for (size_t i = 0; i < flags.size(); i++)
+			{
+				ASSERT_TRUE(!flags[i] || covered[i]) << "element " << i;
+				anyDirty = anyDirty || flags[i];
+			}
+			ASSERT_EQ(dirtyCount, dirty.GetDirtyCount());
+			ASSERT_EQ(!anyDirty, dirty.IsClean());
+		}
+	}
+}
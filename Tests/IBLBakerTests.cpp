@@ -0,0 +1,317 @@
+#include "IBLBaker.h"
+#include "CubeFaces.h"
+#include "JobSystem.h"
+#include "SphericalHarmonics.h"
+#include "TextureCooker.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+// RGBA faces of a daylight sky with a sun, so each face and mip comes out different:
+// blue overhead fading to a pale horizon, brown ground, and a small bright disc
+static std::vector<uint8_t> MakeSky(unsigned int size)
+{
+	std::vector<uint8_t> faces((size_t)6 * size * size * 4);
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int y = 0; y < size; y++)
+		{
+			for (unsigned int x = 0; x < size; x++)
+			{
+				float d[3];
+				GetCubeTexelDirection(face, x, y, size, d);
+
+				uint8_t* p = &faces[(((size_t)face * size + y) * size + x) * 4];
+				float t = std::max(d[1], 0.0f);
+				p[0] = d[1] < 0 ? 90 : (uint8_t)(200 - 140 * t);
+				p[1] = d[1] < 0 ? 70 : (uint8_t)(210 - 90 * t);
+				p[2] = d[1] < 0 ? 50 : (uint8_t)(230 - 10 * t);
+				p[3] = 255;
+				if ((d[0] * 0.5f + d[1] * 0.7f + d[2] * 0.5f) / sqrtf(0.99f) > 0.97f)
+				{
+					p[0] = 255;
+					p[1] = 250;
+					p[2] = 220;
+				}
+			}
+		}
+	}
+	return faces;
+}
+
+// Scale and bias of a LUT texel, back to 0 to 1
+static void LookUp(const std::vector<uint8_t>& data, unsigned int size, unsigned int x, unsigned int y, float& scale, float& bias)
+{
+	const uint16_t* texel = (const uint16_t*)data.data() + ((size_t)y * size + x) * 2;
+	scale = texel[0] / 65535.0f;
+	bias = texel[1] / 65535.0f;
+}
+
+// Average colour of one face of one mip, the layout DDSFile writes
+static void AverageFace(const std::vector<uint8_t>& data, const DDSDescription& description, unsigned int face, unsigned int mip, float* average)
+{
+	size_t faceBytes = DDSFile::TotalBytes({ description.Format, description.Width, description.Height, description.MipCount, 1, false });
+	size_t offset = face * faceBytes;
+	for (unsigned int m = 0; m < mip; m++)
+		offset += DDSFile::MipBytes(description.Format, description.Width, description.Height, m);
+
+	unsigned int mipSize = std::max(description.Width >> mip, 1u);
+	double sums[3] = {};
+	for (unsigned int i = 0; i < mipSize * mipSize; i++)
+	{
+		for (int c = 0; c < 3; c++)
+			sums[c] += data[offset + i * 4 + c];
+	}
+	for (int c = 0; c < 3; c++)
+		average[c] = (float)(sums[c] / (mipSize * mipSize));
+}
+
+TEST(IBLBaker, RadicalInverse)
+{
+	EXPECT_EQ(0.0f, IBLBaker::RadicalInverse(0));
+	EXPECT_EQ(0.5f, IBLBaker::RadicalInverse(1));
+	EXPECT_EQ(0.25f, IBLBaker::RadicalInverse(2));
+	EXPECT_EQ(0.75f, IBLBaker::RadicalInverse(3));
+	EXPECT_EQ(0.125f, IBLBaker::RadicalInverse(4));
+}
+
+// Values recorded from the baker at its default 4096 samples.  Rows are roughness and
+// columns nDotV; a smooth surface seen head on reflects everything, and grazing angles
+// and rough surfaces lose more to shadowing.
+TEST(IBLBaker, BRDFLookUpMatchesReference)
+{
+	const unsigned int size = 32;
+	struct Expected
+	{
+		unsigned int X;
+		unsigned int Y;
+		float Scale;
+		float Bias;
+	};
+	const Expected expected[] = {
+		{ 0, 0, 0.0746f, 0.9100f },
+		{ 10, 0, 0.8626f, 0.1368f },
+		{ 30, 0, 1.0000f, 0.0000f },
+		{ 0, 5, 0.2023f, 0.4335f },
+		{ 15, 5, 0.9312f, 0.0360f },
+		{ 5, 10, 0.5240f, 0.1716f },
+		{ 25, 10, 0.9529f, 0.0009f },
+		{ 0, 15, 0.6535f, 0.1387f },
+		{ 15, 15, 0.7317f, 0.0215f },
+		{ 10, 20, 0.6139f, 0.0243f },
+		{ 30, 20, 0.7380f, 0.0001f },
+		{ 5, 25, 0.6021f, 0.0227f },
+		{ 20, 25, 0.5367f, 0.0026f },
+		{ 0, 30, 0.6113f, 0.0219f },
+		{ 15, 30, 0.4426f, 0.0032f },
+		{ 30, 30, 0.3592f, 0.0001f },
+	};
+
+	IBLBaker baker;
+	DDSDescription description;
+	std::vector<uint8_t> data;
+	baker.BakeBRDFLookUp(size, description, data);
+	ASSERT_EQ(35u, description.Format);
+	ASSERT_EQ(size, description.Width);
+	ASSERT_EQ(size, description.Height);
+	ASSERT_EQ(1u, description.MipCount);
+	ASSERT_FALSE(description.Cube);
+	ASSERT_EQ(DDSFile::TotalBytes(description), data.size());
+
+	for (const Expected& e : expected)
+	{
+		SCOPED_TRACE(testing::Message() << "nDotV texel " << e.X << ", roughness texel " << e.Y);
+		float scale, bias;
+		LookUp(data, size, e.X, e.Y, scale, bias);
+		EXPECT_NEAR(e.Scale, scale, 1e-3f);
+		EXPECT_NEAR(e.Bias, bias, 1e-3f);
+	}
+
+	//Nothing is gained along the way, so scale and bias never add up to more than one
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			float scale, bias;
+			LookUp(data, size, x, y, scale, bias);
+			ASSERT_LE(scale + bias, 1.0f + 1e-3f);
+		}
+	}
+}
+
+// Average of each face of each mip of a sky with a sun, recorded from the baker at its
+// default 4096 samples, in 8 bit steps.  Roughness goes from 0 at mip 0 to 1 at mip 4.
+TEST(IBLBaker, SpecularMatchesReference)
+{
+	const float expected[5][6][3] = {
+		{ { 121.74f, 125.04f, 137.83f }, { 118.46f, 122.88f, 137.91f }, { 103.08f, 148.04f, 221.36f }, { 90.00f, 70.00f, 50.00f }, { 121.74f, 125.04f, 137.83f }, { 118.46f, 122.88f, 137.91f } },
+		{ { 124.55f, 129.06f, 145.31f }, { 120.23f, 126.44f, 145.36f }, { 107.11f, 149.16f, 221.44f }, { 90.05f, 70.31f, 50.77f }, { 124.58f, 129.06f, 145.27f }, { 120.23f, 126.44f, 145.33f } },
+		{ { 127.06f, 134.06f, 156.38f }, { 121.44f, 130.69f, 156.38f }, { 116.25f, 152.56f, 220.56f }, { 92.75f, 75.00f, 60.00f }, { 127.06f, 134.06f, 156.38f }, { 121.56f, 130.69f, 156.38f } },
+		{ { 126.25f, 135.50f, 162.00f }, { 120.50f, 132.00f, 162.00f }, { 123.25f, 155.25f, 218.00f }, { 97.00f, 83.00f, 75.00f }, { 126.25f, 135.25f, 162.00f }, { 120.75f, 132.00f, 162.00f } },
+		{ { 129.00f, 139.00f, 167.00f }, { 122.00f, 134.00f, 167.00f }, { 123.00f, 157.00f, 223.00f }, { 90.00f, 70.00f, 50.00f }, { 129.00f, 139.00f, 167.00f }, { 122.00f, 134.00f, 167.00f } },
+	};
+
+	IBLBaker baker;
+	DDSDescription description;
+	std::vector<uint8_t> data;
+	std::vector<uint8_t> sky = MakeSky(32);
+	baker.BakeSpecular(sky.data(), 32, false, 16, 5, description, data);
+	ASSERT_EQ(28u, description.Format);
+	ASSERT_EQ(16u, description.Width);
+	ASSERT_EQ(5u, description.MipCount);
+	ASSERT_EQ(6u, description.ArraySize);
+	ASSERT_TRUE(description.Cube);
+	ASSERT_EQ(DDSFile::TotalBytes(description), data.size());
+
+	for (unsigned int mip = 0; mip < 5; mip++)
+	{
+		for (unsigned int face = 0; face < 6; face++)
+		{
+			SCOPED_TRACE(testing::Message() << "mip " << mip << ", face " << face);
+			float average[3];
+			AverageFace(data, description, face, mip, average);
+			for (int c = 0; c < 3; c++)
+				EXPECT_NEAR(expected[mip][face][c], average[c], 0.5f);
+		}
+	}
+}
+
+// The smooth mip at the environment's own size samples each texel's centre, so it's the
+// environment again, give or take the trip through linear
+TEST(IBLBaker, SmoothMipIsTheEnvironment)
+{
+	IBLBaker baker;
+	DDSDescription description;
+	std::vector<uint8_t> data;
+	std::vector<uint8_t> sky = MakeSky(16);
+	baker.BakeSpecular(sky.data(), 16, false, 16, 3, description, data);
+
+	size_t faceBytes = DDSFile::TotalBytes({ description.Format, 16, 16, 3, 1, false });
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int i = 0; i < 16 * 16 * 4; i++)
+			ASSERT_NEAR(sky[face * 16 * 16 * 4 + i], data[face * faceBytes + i], 1);
+	}
+}
+
+TEST(IBLBaker, ConstantEnvironmentStaysConstant)
+{
+	std::vector<uint8_t> grey((size_t)6 * 8 * 8 * 4, 128);
+	IBLBaker baker(0, 256);
+	DDSDescription description;
+	std::vector<uint8_t> data;
+	baker.BakeSpecular(grey.data(), 8, false, 8, 4, description, data);
+	for (size_t i = 0; i < data.size(); i += 4)
+	{
+		ASSERT_NEAR(128, data[i], 1);
+		ASSERT_NEAR(128, data[i + 1], 1);
+		ASSERT_NEAR(128, data[i + 2], 1);
+	}
+}
+
+TEST(IBLBaker, ThreadsMatch)
+{
+	JobSystem jobs(4);
+	IBLBaker serial(0, 512);
+	IBLBaker threaded(&jobs, 512);
+	DDSDescription description;
+	std::vector<uint8_t> serialData;
+	std::vector<uint8_t> threadedData;
+
+	serial.BakeBRDFLookUp(30, description, serialData);
+	threaded.BakeBRDFLookUp(30, description, threadedData);
+	EXPECT_EQ(serialData, threadedData);
+
+	std::vector<uint8_t> sky = MakeSky(16);
+	serial.BakeSpecular(sky.data(), 16, false, 16, 5, description, serialData);
+	threaded.BakeSpecular(sky.data(), 16, false, 16, 5, description, threadedData);
+	EXPECT_EQ(serialData, threadedData);
+}
+
+TEST(IBLBaker, BakedPathsReplaceTheExtension)
+{
+	EXPECT_EQ("Skies/Clouds/cubemap_brdf.dds", IBLBaker::GetBakedPath("Skies/Clouds/cubemap.dds", "_brdf.dds"));
+	EXPECT_EQ("Skies\\Night.v2\\cubemap_ibl.txt", IBLBaker::GetBakedPath("Skies\\Night.v2\\cubemap.dds", "_ibl.txt"));
+	EXPECT_EQ("Skies/Night.v2/cubemap_ibl.txt", IBLBaker::GetBakedPath("Skies/Night.v2/cubemap", "_ibl.txt"));
+}
+
+// What BakeSky writes is what baking in memory gives, read back the way Sky loads it
+TEST(IBLBaker, BakeSkyWritesItsMaps)
+{
+	const unsigned int size = 16;
+	std::vector<uint8_t> sky = MakeSky(size);
+	std::string path = testing::TempDir() + "BakedSky.dds";
+	ASSERT_TRUE(DDSFile::Write(path, { 28, size, size, 1, 6, true }, sky.data(), sky.size()));
+
+	IBLBaker baker(0, 256);
+	ASSERT_TRUE(baker.BakeSky(path, size, 3, 8));
+
+	DDSDescription expected, description;
+	std::vector<uint8_t> expectedData, data;
+	baker.BakeSpecular(sky.data(), size, false, size, 3, expected, expectedData);
+	ASSERT_TRUE(DDSFile::Read(IBLBaker::GetBakedPath(path, "_specular.dds"), description, data));
+	EXPECT_TRUE(description.Cube);
+	EXPECT_EQ(6u, description.ArraySize);
+	EXPECT_EQ(3u, description.MipCount);
+	EXPECT_EQ(expectedData, data);
+
+	baker.BakeBRDFLookUp(8, expected, expectedData);
+	ASSERT_TRUE(DDSFile::Read(IBLBaker::GetBakedPath(path, "_brdf.dds"), description, data));
+	EXPECT_EQ(expected.Format, description.Format);
+	EXPECT_EQ(8u, description.Width);
+	EXPECT_EQ(expectedData, data);
+
+	SHIrradiance sh = SphericalHarmonics::ProjectIrradiance(sky.data(), size, false);
+	double bakeMs = -1;
+	{
+		std::ifstream summary(IBLBaker::GetBakedPath(path, "_ibl.txt"));
+		ASSERT_TRUE((bool)(summary >> bakeMs));
+		EXPECT_LE(0, bakeMs);
+		for (int i = 0; i < 9; i++)
+		{
+			float rgb[3];
+			ASSERT_TRUE((bool)(summary >> rgb[0] >> rgb[1] >> rgb[2]));
+			EXPECT_FLOAT_EQ(sh.Coefficients[i].x, rgb[0]);
+			EXPECT_FLOAT_EQ(sh.Coefficients[i].y, rgb[1]);
+			EXPECT_FLOAT_EQ(sh.Coefficients[i].z, rgb[2]);
+		}
+	}
+
+	for (const char* suffix : { ".dds", "_specular.dds", "_brdf.dds", "_ibl.txt" })
+		std::remove(IBLBaker::GetBakedPath(path, suffix).c_str());
+}
+
+// A cooked sky is BC7 with mips, and bakes from the first mip no bigger than the cube
+TEST(IBLBaker, EnvironmentsComeFromCookedSkies)
+{
+	const unsigned int size = 32;
+	std::vector<uint8_t> sky = MakeSky(size);
+	CookedTexture cooked[6];
+	TextureCooker::CookCube(sky.data(), size, COOKED_BC7, cooked, 1);
+	std::string path = testing::TempDir() + "CookedSky.dds";
+	ASSERT_TRUE(TextureCooker::WriteCubeDDS(path, cooked));
+
+	std::vector<uint8_t> faces;
+	unsigned int faceSize = 0;
+	ASSERT_TRUE(IBLBaker::ReadEnvironment(path, 8, faces, faceSize));
+	EXPECT_EQ(8u, faceSize);
+	ASSERT_EQ((size_t)6 * 8 * 8 * 4, faces.size());
+
+	std::vector<uint8_t> expected;
+	for (int face = 0; face < 6; face++)
+	{
+		TextureCooker::Decode(cooked[face], 2, expected);
+		for (size_t i = 0; i < expected.size(); i++)
+			ASSERT_EQ(expected[i], faces[face * expected.size() + i]) << "face " << face;
+	}
+
+	//A sky no bigger than the cube bakes from its top mip
+	ASSERT_TRUE(IBLBaker::ReadEnvironment(path, 256, faces, faceSize));
+	EXPECT_EQ(size, faceSize);
+	std::remove(path.c_str());
+
+	EXPECT_FALSE(IBLBaker::ReadEnvironment(testing::TempDir() + "NoSuchSky.dds", 256, faces, faceSize));
+}
@@ -0,0 +1,187 @@
+#pragma once
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+// Just enough of a JSON reader for tests to check what the engine writes.  Parse
+// fails on anything that isn't strictly valid, trailing commas and all.
+struct JsonValue
+{
+	enum Type { Null, Bool, Number, String, Array, Object };
+
+	Type Kind = Null;
+	bool BoolValue = false;
+	double NumberValue = 0;
+	std::string StringValue;
+	std::vector<JsonValue> Items;
+	std::map<std::string, JsonValue> Members;
+	// Member names in the order they were written
+	std::vector<std::string> Order;
+
+	bool Has(const std::string& name) const { return Members.count(name) != 0; }
+	const JsonValue& operator[](const std::string& name) const { return Members.at(name); }
+	const JsonValue& operator[](size_t index) const { return Items.at(index); }
+
+	static bool Parse(const std::string& text, JsonValue& value)
+	{
+		size_t at = 0;
+		return ParseValue(text, at, value) && SkipSpace(text, at) == text.size();
+	}
+
+private:
+	static size_t SkipSpace(const std::string& text, size_t& at)
+	{
+		while (at < text.size() && (text[at] == ' ' || text[at] == '\n' || text[at] == '\r' || text[at] == '\t'))
+			at++;
+		return at;
+	}
+
+	static bool Expect(const std::string& text, size_t& at, const char* literal)
+	{
+		for (; *literal; literal++, at++)
+		{
+			if (at >= text.size() || text[at] != *literal)
+				return false;
+		}
+		return true;
+	}
+
+	static bool ParseString(const std::string& text, size_t& at, std::string& value)
+	{
+		if (!Expect(text, at, "\""))
+			return false;
+
+		for (; at < text.size(); at++)
+		{
+			char c = text[at];
+			if (c == '"')
+			{
+				at++;
+				return true;
+			}
+			if ((unsigned char)c < 0x20)
+				return false;
+			if (c == '\\')
+			{
+				if (++at >= text.size())
+					return false;
+				switch (text[at])
+				{
+				case '"': value += '"'; break;
+				case '\\': value += '\\'; break;
+				case '/': value += '/'; break;
+				case 'n': value += '\n'; break;
+				case 't': value += '\t'; break;
+				case 'r': value += '\r'; break;
+				case 'b': value += '\b'; break;
+				case 'f': value += '\f'; break;
+				//Tests only write ASCII, so code points are kept as written
+				case 'u':
+					if (at + 4 >= text.size())
+						return false;
+					value += text.substr(at - 1, 6);
+					at += 4;
+					break;
+				default: return false;
+				}
+			}
+			else
+				value += c;
+		}
+		return false;
+	}
+
+	static bool ParseNumber(const std::string& text, size_t& at, double& value)
+	{
+		size_t start = at;
+		if (at < text.size() && text[at] == '-')
+			at++;
+		if (at >= text.size() || text[at] < '0' || text[at] > '9')
+			return false;
+		if (text[at] == '0' && at + 1 < text.size() && text[at + 1] >= '0' && text[at + 1] <= '9')
+			return false;
+
+		while (at < text.size() && ((text[at] >= '0' && text[at] <= '9') || text[at] == '.' || text[at] == 'e' || text[at] == 'E' || text[at] == '+' || text[at] == '-'))
+			at++;
+
+		std::string number = text.substr(start, at - start);
+		char* end = 0;
+		value = strtod(number.c_str(), &end);
+		return end == number.c_str() + number.size();
+	}
+
+	static bool ParseValue(const std::string& text, size_t& at, JsonValue& value)
+	{
+		if (SkipSpace(text, at) >= text.size())
+			return false;
+
+		switch (text[at])
+		{
+		case '{':
+		{
+			value.Kind = Object;
+			at++;
+			if (SkipSpace(text, at) < text.size() && text[at] == '}')
+			{
+				at++;
+				return true;
+			}
+			while (true)
+			{
+				std::string name;
+				SkipSpace(text, at);
+				if (!ParseString(text, at, name) || value.Has(name))
+					return false;
+				SkipSpace(text, at);
+				if (!Expect(text, at, ":") || !ParseValue(text, at, value.Members[name]))
+					return false;
+				value.Order.push_back(name);
+
+				SkipSpace(text, at);
+				if (at < text.size() && text[at] == ',')
+					at++;
+				else
+					return Expect(text, at, "}");
+			}
+		}
+		case '[':
+		{
+			value.Kind = Array;
+			at++;
+			if (SkipSpace(text, at) < text.size() && text[at] == ']')
+			{
+				at++;
+				return true;
+			}
+			while (true)
+			{
+				value.Items.push_back(JsonValue());
+				if (!ParseValue(text, at, value.Items.back()))
+					return false;
+
+				SkipSpace(text, at);
+				if (at < text.size() && text[at] == ',')
+					at++;
+				else
+					return Expect(text, at, "]");
+			}
+		}
+		case '"':
+			value.Kind = String;
+			return ParseString(text, at, value.StringValue);
+		case 't':
+			value.Kind = Bool;
+			value.BoolValue = true;
+			return Expect(text, at, "true");
+		case 'f':
+			value.Kind = Bool;
+			return Expect(text, at, "false");
+		case 'n':
+			return Expect(text, at, "null");
+		default:
+			value.Kind = Number;
+			return ParseNumber(text, at, value.NumberValue);
+		}
+	}
+};
@@ -0,0 +1,147 @@
+#include "LightClusters.h"
+#include "JobSystem.h"
+#include "TestHelpers.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// Camera's defaults
+static const float nearClip = 0.01f;
+static const float farClip = 100.0f;
+
+// Mostly point and spot lights spread around the origin, with a few directional ones mixed in
+static std::vector<Light> RandomLights(std::mt19937& random, unsigned int count)
+{
+	std::vector<Light> lights;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Light light = {};
+		unsigned int kind = random() % 16;
+		light.Type = kind == 0 ? LIGHT_TYPE_DIRECTIONAL : (kind < 4 ? LIGHT_TYPE_SPOT : LIGHT_TYPE_POINT);
+		light.Direction = XMFLOAT3(RandomFloat(random, -1, 1), -1, RandomFloat(random, -1, 1));
+		light.Position = XMFLOAT3(RandomFloat(random, -30, 30), RandomFloat(random, -8, 8), RandomFloat(random, -30, 30));
+		light.Range = RandomFloat(random, 0.25f, 12.0f);
+		light.Intensity = 1.0f;
+		light.SpotFalloff = 20.0f;
+		lights.push_back(light);
+	}
+	return lights;
+}
+
+static void ExpectSameClusters(LightClusters& built, LightClusters& reference)
+{
+	ASSERT_EQ(reference.GetGlobalLightCount(), built.GetGlobalLightCount());
+	ASSERT_EQ(reference.GetRanges().size(), built.GetRanges().size());
+	for (size_t c = 0; c < reference.GetRanges().size(); c++)
+	{
+		SCOPED_TRACE(testing::Message() << "cluster " << c);
+		ASSERT_EQ(reference.GetRanges()[c].Offset, built.GetRanges()[c].Offset);
+		ASSERT_EQ(reference.GetRanges()[c].Count, built.GetRanges()[c].Count);
+	}
+	ASSERT_EQ(reference.GetIndices(), built.GetIndices());
+}
+
+TEST(LightClusters, DirectionalLightsComeFirst)
+{
+	std::vector<Light> lights(3);
+	lights[0].Type = LIGHT_TYPE_POINT;
+	lights[0].Position = XMFLOAT3(0, 0, 5);
+	lights[0].Range = 2.0f;
+	lights[1].Type = LIGHT_TYPE_DIRECTIONAL;
+	lights[2].Type = LIGHT_TYPE_DIRECTIONAL;
+
+	LightClusters clusters;
+	clusters.Build(lights, ViewMatrix(XMFLOAT3(0, 0, 0), 0, 0), 1.0f, 1.0f, nearClip, farClip);
+	ASSERT_EQ(2u, clusters.GetGlobalLightCount());
+	EXPECT_EQ(1u, clusters.GetIndices()[0]);
+	EXPECT_EQ(2u, clusters.GetIndices()[1]);
+
+	//The point light straight ahead is in the middle tiles, and only near its depth
+	uint32_t found = 0;
+	for (uint32_t k = 0; k < clusters.GetSlices(); k++)
+	{
+		for (uint32_t y = 0; y < clusters.GetTilesY(); y++)
+		{
+			for (uint32_t x = 0; x < clusters.GetTilesX(); x++)
+			{
+				const LightClusterRange& range = clusters.GetRanges()[clusters.GetClusterIndex(x, y, k)];
+				for (uint32_t i = 0; i < range.Count; i++)
+				{
+					EXPECT_EQ(0u, clusters.GetIndices()[range.Offset + i]);
+					found++;
+				}
+			}
+		}
+	}
+	EXPECT_GT(found, 0u);
+	EXPECT_LT(found, clusters.GetClusterCount() / 4);
+}
+
+TEST(LightClusters, LightsBehindTheCameraAreInNoCluster)
+{
+	std::vector<Light> lights(1);
+	lights[0].Type = LIGHT_TYPE_POINT;
+	lights[0].Position = XMFLOAT3(0, 0, -20);
+	lights[0].Range = 5.0f;
+
+	LightClusters clusters;
+	clusters.Build(lights, ViewMatrix(XMFLOAT3(0, 0, 0), 0, 0), 1.0f, 1.0f, nearClip, farClip);
+	EXPECT_EQ(0u, clusters.GetGlobalLightCount());
+	EXPECT_TRUE(clusters.GetIndices().empty());
+}
+
+// Build against the plain every-light-against-every-cluster reference, from random
+// cameras, with the work on the calling thread and split across workers, and for grids
+// that don't divide into rows of four
+TEST(LightClusters, MatchesReference)
+{
+	struct Grid
+	{
+		uint32_t TilesX;
+		uint32_t TilesY;
+		uint32_t Slices;
+	};
+	const Grid grids[] = {
+		{ LightClusters::DefaultTilesX, LightClusters::DefaultTilesY, LightClusters::DefaultSlices },
+		{ 7, 5, 11 },
+		{ 1, 1, 1 },
+	};
+
+	JobSystem jobs(4);
+	std::mt19937 random(41);
+	size_t binned = 0;
+	for (const Grid& grid : grids)
+	{
+		LightClusters reference;
+		LightClusters serial;
+		LightClusters threaded(&jobs);
+		reference.SetGrid(grid.TilesX, grid.TilesY, grid.Slices);
+		serial.SetGrid(grid.TilesX, grid.TilesY, grid.Slices);
+		threaded.SetGrid(grid.TilesX, grid.TilesY, grid.Slices);
+
+		for (int camera = 0; camera < 40; camera++)
+		{
+			SCOPED_TRACE(testing::Message() << "grid " << grid.TilesX << "x" << grid.TilesY << "x" << grid.Slices << ", camera " << camera);
+
+			//Both small scenes that stay on one thread and big ones that get split up
+			std::vector<Light> lights = RandomLights(random, camera % 2 ? 300 : 12);
+			XMFLOAT3 position(RandomFloat(random, -20, 20), RandomFloat(random, -5, 5), RandomFloat(random, -20, 20));
+			XMFLOAT4X4 view = ViewMatrix(position, RandomFloat(random, -1.2f, 1.2f), RandomFloat(random, -3.14f, 3.14f));
+			float projectionY = 1.0f / tanf(RandomFloat(random, 0.2f, 0.6f) * 3.14159265f * 0.5f);
+			float projectionX = projectionY / RandomFloat(random, 0.75f, 2.5f);
+
+			reference.BuildReference(lights, view, projectionX, projectionY, nearClip, farClip);
+			serial.Build(lights, view, projectionX, projectionY, nearClip, farClip);
+			threaded.Build(lights, view, projectionX, projectionY, nearClip, farClip);
+			ExpectSameClusters(serial, reference);
+			ExpectSameClusters(threaded, reference);
+			binned += reference.GetIndices().size() - reference.GetGlobalLightCount();
+		}
+	}
+
+	//Enough lights landed in clusters for the comparison to mean something
+	EXPECT_GT(binned, 10000u);
+}
@@ -0,0 +1,139 @@
+#include "ParticleSimulation.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstring>
+
+using namespace DirectX;
+
+// A small emitter whose particles live half a second, so the pool recycles well within
+// the recorded frames.  Each frame's seed is different, like Emitter's.
+static ParticleSimulationConstants MakeConstants()
+{
+	ParticleSimulationConstants c = {};
+	c.EmitterPosition = XMFLOAT3(1.0f, 2.0f, -3.0f);
+	c.Lifetime = 0.5f;
+	c.InvLifetime = 1.0f / c.Lifetime;
+	c.StartingVelocity = XMFLOAT3(0.0f, 4.0f, 0.0f);
+	c.VelocityRange = XMFLOAT3(1.0f, 0.5f, 1.0f);
+	c.DeltaTime = 1.0f / 60.0f;
+	c.EmitCount = 3;
+	c.MaxParticles = 128;
+	return c;
+}
+
+static void StepFrame(ParticleSimulationReference& reference, ParticleSimulationConstants& c, unsigned int frame)
+{
+	c.EmitSeed = frame * 7919u + 1;
+	reference.Update(c);
+	reference.Emit(c);
+}
+
+static uint32_t Bits(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+// Recorded from the reference, as bit patterns since the GPU has to match it exactly
+struct RecordedParticle
+{
+	unsigned int Frame;
+	unsigned int Index;
+	uint32_t Age;
+	uint32_t Time;
+	uint32_t Velocity[3];
+};
+
+static const RecordedParticle recordedParticles[] =
+{
+	{ 29, 64, 0x3e888889, 0x3e088889, { 0x3f59eb9c, 0x407bf068, 0xbf787d72 } },
+	{ 29, 100, 0x3f2aaaad, 0x3eaaaaad, { 0xbf178376, 0x406f81f2, 0xbf019030 } },
+	{ 29, 126, 0x3f77777e, 0x3ef7777e, { 0xbf54ddda, 0x408e8410, 0xbeb912f4 } },
+	{ 29, 127, 0x3f77777e, 0x3ef7777e, { 0x3ea2fba8, 0x408d254a, 0xbf391fd4 } },
+	{ 30, 64, 0x3e99999a, 0x3e19999a, { 0x3f59eb9c, 0x407bf068, 0xbf787d72 } },
+	{ 30, 100, 0x3f333336, 0x3eb33336, { 0xbf178376, 0x406f81f2, 0xbf019030 } },
+	{ 30, 126, 0x00000000, 0x00000000, { 0xbf3531fa, 0x40804664, 0x3f25675c } },
+	{ 30, 127, 0x00000000, 0x00000000, { 0xbdaf62f0, 0x4073028a, 0x3e8af968 } },
+	{ 89, 64, 0x3e888889, 0x3e088889, { 0xbf7bdcf2, 0x407462f1, 0x3d10ad00 } },
+	{ 89, 100, 0x3f2aaaad, 0x3eaaaaad, { 0x3e7a0c20, 0x4081674d, 0xbf0ccd56 } },
+	{ 89, 126, 0x3f77777e, 0x3ef7777e, { 0xbe9009a8, 0x40737699, 0x3f23d4a6 } },
+	{ 89, 127, 0x3f77777e, 0x3ef7777e, { 0x3f0fc32a, 0x40890f73, 0xbf15c97a } },
+};
+
+TEST(ParticleSimulation, HashMatchesPCG)
+{
+	EXPECT_EQ(129708002u, ParticleHash(0));
+	EXPECT_EQ(2831084092u, ParticleHash(1));
+	EXPECT_EQ(1730779506u, ParticleHash(0xdeadbeef));
+}
+
+TEST(ParticleSimulation, RandomSignedStaysInRange)
+{
+	EXPECT_EQ(-1.0f, ParticleRandomSigned(0));
+	EXPECT_LT(ParticleRandomSigned(0xffffffff), 1.0f);
+	for (unsigned int i = 0; i < 10000; i++)
+	{
+		float r = ParticleRandomSigned(ParticleHash(i));
+		EXPECT_GE(r, -1.0f);
+		EXPECT_LT(r, 1.0f);
+	}
+}
+
+TEST(ParticleSimulation, InitStartsEveryParticleDead)
+{
+	ParticleSimulationConstants c = MakeConstants();
+	ParticleSimulationReference reference(c);
+	EXPECT_EQ(c.MaxParticles, reference.GetDeadCount());
+	EXPECT_TRUE(reference.GetDrawList().empty());
+	for (auto& p : reference.GetParticles())
+		EXPECT_TRUE(ParticleIsDead(p, c));
+}
+
+TEST(ParticleSimulation, EveryParticleIsDrawnOrDead)
+{
+	ParticleSimulationConstants c = MakeConstants();
+	ParticleSimulationReference reference(c);
+	for (unsigned int frame = 0; frame < 90; frame++)
+	{
+		StepFrame(reference, c, frame);
+		ASSERT_EQ(c.MaxParticles, reference.GetDeadCount() + reference.GetDrawList().size()) << "frame " << frame;
+		for (unsigned int index : reference.GetDrawList())
+			ASSERT_FALSE(ParticleIsDead(reference.GetParticles()[index], c)) << "frame " << frame;
+	}
+
+	//Three a frame for thirty frames are alive at once
+	EXPECT_EQ(90u, reference.GetDrawList().size());
+}
+
+TEST(ParticleSimulation, EmitStopsWhenThePoolIsFull)
+{
+	ParticleSimulationConstants c = MakeConstants();
+	c.EmitCount = 100;
+	ParticleSimulationReference reference(c);
+	StepFrame(reference, c, 0);
+	StepFrame(reference, c, 1);
+	EXPECT_EQ(0u, reference.GetDeadCount());
+	EXPECT_EQ(c.MaxParticles, reference.GetDrawList().size());
+}
+
+TEST(ParticleSimulation, MatchesRecordedStates)
+{
+	ParticleSimulationConstants c = MakeConstants();
+	ParticleSimulationReference reference(c);
+	unsigned int frame = 0;
+	for (auto& recorded : recordedParticles)
+	{
+		for (; frame <= recorded.Frame; frame++)
+			StepFrame(reference, c, frame);
+
+		const Particle& p = reference.GetParticles()[recorded.Index];
+		SCOPED_TRACE(testing::Message() << "frame " << recorded.Frame << ", particle " << recorded.Index);
+		EXPECT_EQ(recorded.Age, Bits(p.Age));
+		EXPECT_EQ(recorded.Time, Bits(p.Time));
+		EXPECT_EQ(recorded.Velocity[0], Bits(p.Velocity.x));
+		EXPECT_EQ(recorded.Velocity[1], Bits(p.Velocity.y));
+		EXPECT_EQ(recorded.Velocity[2], Bits(p.Velocity.z));
+		EXPECT_EQ(Bits(c.EmitterPosition.x), Bits(p.Position.x));
+	}
+}
@@ -0,0 +1,283 @@
+#include "Profiler.h"
+#include "JsonReader.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <thread>
+#include <vector>
+
+// The profiler is global and its rings outlive their threads, so each test records on
+// threads of its own and only looks at what those threads wrote
+static uint32_t GetThreadIndex()
+{
+	//A marker no other thread records, to find the calling thread's ring by
+	static std::atomic<uint64_t> nextMarker(1ull << 62);
+	uint64_t marker = nextMarker++;
+	Profiler::Record("Marker", marker, marker, 0);
+
+	std::vector<ProfileEvent> events;
+	Profiler::Collect(events);
+	for (auto& e : events)
+	{
+		if (e.StartNs == marker && strcmp(e.Name, "Marker") == 0)
+			return e.Thread;
+	}
+	return ~0u;
+}
+
+static uint32_t RunOnNewThread(std::function<void()> body)
+{
+	uint32_t threadIndex = 0;
+	std::thread thread([&]() {
+		threadIndex = GetThreadIndex();
+		body();
+	});
+	thread.join();
+	return threadIndex;
+}
+
+static std::vector<ProfileEvent> CollectNamed(const char* name, const std::vector<uint32_t>& threads)
+{
+	std::vector<ProfileEvent> all;
+	Profiler::Collect(all);
+	std::vector<ProfileEvent> named;
+	for (auto& e : all)
+	{
+		if (strcmp(e.Name, name) == 0 && std::find(threads.begin(), threads.end(), e.Thread) != threads.end())
+			named.push_back(e);
+	}
+	return named;
+}
+
+TEST(Profiler, NestedScopesFinishInnerFirst)
+{
+	std::vector<ProfileEvent> frame;
+	RunOnNewThread([&]() {
+		Profiler::BeginFrame();
+		{
+			PROFILE_SCOPE("Outer");
+			{
+				PROFILE_SCOPE("Middle");
+				PROFILE_SCOPE("Inner");
+			}
+			PROFILE_SCOPE("Sibling");
+		}
+		Profiler::BeginFrame();
+		Profiler::CollectLastFrame(frame);
+	});
+
+	//Scopes are recorded as they close
+	ASSERT_EQ(4u, frame.size());
+	const char* names[] = { "Inner", "Middle", "Sibling", "Outer" };
+	uint16_t depths[] = { 2, 1, 1, 0 };
+	for (size_t i = 0; i < frame.size(); i++)
+	{
+		EXPECT_STREQ(names[i], frame[i].Name);
+		EXPECT_EQ(depths[i], frame[i].Depth);
+		EXPECT_EQ(frame[3].Thread, frame[i].Thread);
+		EXPECT_LE(frame[i].StartNs, frame[i].EndNs);
+	}
+
+	//Children sit inside their parents
+	EXPECT_LE(frame[1].StartNs, frame[0].StartNs);
+	EXPECT_GE(frame[1].EndNs, frame[0].EndNs);
+	EXPECT_LE(frame[3].StartNs, frame[1].StartNs);
+	EXPECT_GE(frame[3].EndNs, frame[2].EndNs);
+	EXPECT_LE(frame[1].EndNs, frame[2].StartNs);
+}
+
+TEST(Profiler, DisabledScopesRecordNothing)
+{
+	std::vector<ProfileEvent> frame;
+	RunOnNewThread([&]() {
+		Profiler::BeginFrame();
+		Profiler::SetEnabled(false);
+		{
+			PROFILE_SCOPE("Disabled");
+		}
+		Profiler::SetEnabled(true);
+		Profiler::BeginFrame();
+		Profiler::CollectLastFrame(frame);
+	});
+	EXPECT_TRUE(frame.empty());
+}
+
+TEST(Profiler, RingKeepsTheNewestEvents)
+{
+	const uint64_t extra = 100;
+	uint32_t thread = RunOnNewThread([&]() {
+		for (uint64_t i = 0; i < Profiler::RingSize + extra; i++)
+			Profiler::Record("Wrapped", i, i + 1, 0);
+	});
+
+	std::vector<ProfileEvent> events = CollectNamed("Wrapped", { thread });
+	ASSERT_EQ((size_t)Profiler::RingSize, events.size());
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		ASSERT_EQ(extra + i, events[i].StartNs);
+		ASSERT_EQ(extra + i + 1, events[i].EndNs);
+	}
+}
+
+TEST(Profiler, LastFrameIsBetweenTheLastTwoBeginFrames)
+{
+	std::vector<ProfileEvent> frame;
+	RunOnNewThread([&]() {
+		Profiler::BeginFrame();
+		uint64_t before = Profiler::Now();
+		Profiler::Record("Previous", before, before, 0);
+
+		Profiler::BeginFrame();
+		uint64_t start = Profiler::Now();
+		Profiler::Record("Inside", start, start, 0);
+		Profiler::Record("Gpu", start, start, 0, PROFILE_TRACK_GPU);
+		//Started last frame, so it isn't wholly in this one
+		Profiler::Record("Straddling", before, Profiler::Now(), 0);
+
+		Profiler::BeginFrame();
+		uint64_t after = Profiler::Now();
+		Profiler::Record("Current", after, after, 0);
+		Profiler::CollectLastFrame(frame);
+	});
+
+	ASSERT_EQ(1u, frame.size());
+	EXPECT_STREQ("Inside", frame[0].Name);
+}
+
+TEST(Profiler, ThreadsKeepTheirNames)
+{
+	std::vector<uint32_t> threads;
+	const char* names[2] = { "Loader", "Quoted \"Worker\"" };
+	for (int i = 0; i < 2; i++)
+	{
+		threads.push_back(RunOnNewThread([&]() {
+			Profiler::SetThreadName(names[i]);
+			Profiler::Record("Named", 0, 1, 0);
+		}));
+	}
+	std::vector<ProfileEvent> events = CollectNamed("Named", threads);
+	ASSERT_EQ(2u, events.size());
+	EXPECT_EQ(threads[0], events[0].Thread);
+	EXPECT_EQ(threads[1], events[1].Thread);
+	EXPECT_NE(threads[0], threads[1]);
+
+	JsonValue trace;
+	ASSERT_TRUE(JsonValue::Parse(Profiler::ExportChromeTrace(), trace));
+	std::map<uint32_t, std::string> threadNames;
+	for (auto& e : trace["traceEvents"].Items)
+	{
+		if (e["ph"].StringValue == "M")
+			threadNames[(uint32_t)e["tid"].NumberValue] = e["args"]["name"].StringValue;
+	}
+	EXPECT_EQ(names[0], threadNames[threads[0]]);
+	EXPECT_EQ(names[1], threadNames[threads[1]]);
+}
+
+TEST(Profiler, ChromeTraceIsValidJson)
+{
+	uint32_t thread = RunOnNewThread([&]() {
+		Profiler::SetThreadName("Trace");
+		Profiler::Record("Trace \\ \"Cpu\"", 2000, 5500, 0);
+		Profiler::Record("TraceGpu", 3000, 4000, 0, PROFILE_TRACK_GPU);
+	});
+
+	JsonValue trace;
+	ASSERT_TRUE(JsonValue::Parse(Profiler::ExportChromeTrace(), trace));
+	EXPECT_EQ("ms", trace["displayTimeUnit"].StringValue);
+	ASSERT_EQ(JsonValue::Array, trace["traceEvents"].Kind);
+
+	int cpuFound = 0;
+	int gpuFound = 0;
+	uint32_t gpuThread = 0;
+	for (auto& e : trace["traceEvents"].Items)
+	{
+		if (e["ph"].StringValue == "M" && e["args"]["name"].StringValue == "GPU")
+			gpuThread = (uint32_t)e["tid"].NumberValue;
+	}
+	for (auto& e : trace["traceEvents"].Items)
+	{
+		if (e["ph"].StringValue != "X")
+			continue;
+
+		//Microseconds, like Chrome expects
+		if (e["name"].StringValue == "Trace \\ \"Cpu\"" && (uint32_t)e["tid"].NumberValue == thread)
+		{
+			cpuFound++;
+			EXPECT_EQ("cpu", e["cat"].StringValue);
+			EXPECT_DOUBLE_EQ(2.0, e["ts"].NumberValue);
+			EXPECT_DOUBLE_EQ(3.5, e["dur"].NumberValue);
+		}
+		//Every thread's GPU timings share one timeline
+		else if (e["name"].StringValue == "TraceGpu")
+		{
+			gpuFound++;
+			EXPECT_EQ("gpu", e["cat"].StringValue);
+			EXPECT_EQ(gpuThread, (uint32_t)e["tid"].NumberValue);
+		}
+	}
+	EXPECT_EQ(1, cpuFound);
+	EXPECT_LE(1, gpuFound);
+}
+
+// Writers wrap their rings many times over while a reader collects.  Every event the
+// reader gets must be one that was written whole.
+TEST(Profiler, ConcurrentWritersNeverTear)
+{
+	const int writerCount = 4;
+	const uint64_t eventsPerWriter = Profiler::RingSize * 4;
+	std::atomic<int> running(writerCount);
+	std::atomic<int> started(0);
+	std::vector<uint32_t> threads(writerCount);
+	std::vector<std::thread> writers;
+	for (int w = 0; w < writerCount; w++)
+	{
+		writers.emplace_back([&, w]() {
+			threads[w] = GetThreadIndex();
+			started++;
+
+			//Each field follows from the start time, so a torn event can't look whole
+			for (uint64_t i = 0; i < eventsPerWriter; i++)
+			{
+				uint64_t start = i * writerCount + w;
+				Profiler::Record("Stress", start, start * 3 + 7, (uint16_t)(start % 60000));
+			}
+			running--;
+		});
+	}
+
+	while (started < writerCount)
+		std::this_thread::yield();
+
+	size_t checked = 0;
+	do
+	{
+		std::vector<ProfileEvent> events = CollectNamed("Stress", threads);
+		std::map<uint32_t, uint64_t> lastStart;
+		for (auto& e : events)
+		{
+			ASSERT_EQ(e.StartNs * 3 + 7, e.EndNs);
+			ASSERT_EQ(e.StartNs % 60000, e.Depth);
+			ASSERT_EQ(PROFILE_TRACK_CPU, e.Track);
+
+			//Oldest first within a thread, with nothing skipped
+			auto last = lastStart.find(e.Thread);
+			if (last != lastStart.end())
+			{
+				ASSERT_EQ(last->second + writerCount, e.StartNs);
+			}
+			lastStart[e.Thread] = e.StartNs;
+		}
+		checked += events.size();
+	} while (running > 0);
+
+	for (auto& writer : writers)
+		writer.join();
+
+	//Once the writers are done, each ring holds its last RingSize events
+	std::vector<ProfileEvent> events = CollectNamed("Stress", threads);
+	EXPECT_EQ((size_t)writerCount * Profiler::RingSize, events.size());
+	RecordProperty("EventsChecked", (int)checked);
+}
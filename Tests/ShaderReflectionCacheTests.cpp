@@ -0,0 +1,247 @@
+#include "ShaderReflectionCache.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Recorded from D3DReflect on VertexShader.hlsl: vs_5_0, its one constant buffer of
+// seven matrices, and its four inputs
+static ShaderReflection VertexShaderReflection()
+{
+	ShaderReflection r;
+	r.Version = 0x10050;
+	r.Resources = { { "externalData", 0, 0 } };
+
+	ReflectedBuffer buffer = { "externalData", 0, 448, 0, {} };
+	const char* matrices[7] = { "world", "prevWorld", "worldInverseTranspose", "view", "projection", "prevView", "prevProjection" };
+	for (uint32_t i = 0; i < 7; i++)
+		buffer.Variables.push_back({ matrices[i], i * 64, 64 });
+	r.Buffers = { buffer };
+
+	r.Inputs = {
+		{ "POSITION", 0, 3, 7 },
+		{ "TEXCOORD", 0, 3, 3 },
+		{ "NORMAL", 0, 3, 7 },
+		{ "TANGENT", 0, 3, 7 },
+	};
+	return r;
+}
+
+// And a compute shader's, with a thread group size and an unordered access view
+static ShaderReflection ComputeShaderReflection()
+{
+	ShaderReflection r;
+	r.Version = 0x50050;
+	r.ThreadGroupSize[0] = 64;
+	r.ThreadGroupSize[1] = 1;
+	r.ThreadGroupSize[2] = 1;
+	r.Resources = { { "simulation", 0, 0 }, { "ParticlePool", 6, 0 }, { "DeadList", 8, 1 } };
+	r.Buffers = { { "simulation", 0, 64, 0, { { "emitterPosition", 0, 12 }, { "deltaTime", 12, 4 }, { "maxParticles", 16, 4 } } } };
+	return r;
+}
+
+static void ExpectSame(const ShaderReflection& a, const ShaderReflection& b)
+{
+	EXPECT_EQ(a.Version, b.Version);
+	for (int i = 0; i < 3; i++)
+		EXPECT_EQ(a.ThreadGroupSize[i], b.ThreadGroupSize[i]);
+
+	ASSERT_EQ(a.Resources.size(), b.Resources.size());
+	for (size_t i = 0; i < a.Resources.size(); i++)
+	{
+		EXPECT_EQ(a.Resources[i].Name, b.Resources[i].Name);
+		EXPECT_EQ(a.Resources[i].Type, b.Resources[i].Type);
+		EXPECT_EQ(a.Resources[i].BindIndex, b.Resources[i].BindIndex);
+	}
+
+	ASSERT_EQ(a.Buffers.size(), b.Buffers.size());
+	for (size_t i = 0; i < a.Buffers.size(); i++)
+	{
+		EXPECT_EQ(a.Buffers[i].Name, b.Buffers[i].Name);
+		EXPECT_EQ(a.Buffers[i].Type, b.Buffers[i].Type);
+		EXPECT_EQ(a.Buffers[i].Size, b.Buffers[i].Size);
+		EXPECT_EQ(a.Buffers[i].BindIndex, b.Buffers[i].BindIndex);
+		ASSERT_EQ(a.Buffers[i].Variables.size(), b.Buffers[i].Variables.size());
+		for (size_t v = 0; v < a.Buffers[i].Variables.size(); v++)
+		{
+			EXPECT_EQ(a.Buffers[i].Variables[v].Name, b.Buffers[i].Variables[v].Name);
+			EXPECT_EQ(a.Buffers[i].Variables[v].ByteOffset, b.Buffers[i].Variables[v].ByteOffset);
+			EXPECT_EQ(a.Buffers[i].Variables[v].Size, b.Buffers[i].Variables[v].Size);
+		}
+	}
+
+	ASSERT_EQ(a.Inputs.size(), b.Inputs.size());
+	for (size_t i = 0; i < a.Inputs.size(); i++)
+	{
+		EXPECT_EQ(a.Inputs[i].SemanticName, b.Inputs[i].SemanticName);
+		EXPECT_EQ(a.Inputs[i].SemanticIndex, b.Inputs[i].SemanticIndex);
+		EXPECT_EQ(a.Inputs[i].ComponentType, b.Inputs[i].ComponentType);
+		EXPECT_EQ(a.Inputs[i].Mask, b.Inputs[i].Mask);
+	}
+}
+
+static std::vector<uint8_t> SerializedCache()
+{
+	ShaderReflectionCache cache;
+	cache.Store(1, VertexShaderReflection());
+	cache.Store(2, ComputeShaderReflection());
+	std::vector<uint8_t> bytes;
+	cache.Serialize(bytes);
+	return bytes;
+}
+
+TEST(ShaderReflectionCache, HashIsFNV1aWithSize)
+{
+	EXPECT_EQ(0xcbf29ce484222325ull, ShaderReflectionCache::HashBlob("", 0));
+	const char blob[] = "DXBC shader bytes";
+	uint64_t whole = ShaderReflectionCache::HashBlob(blob, sizeof(blob) - 1);
+	EXPECT_NE(whole, ShaderReflectionCache::HashBlob(blob, sizeof(blob) - 2));
+}
+
+TEST(ShaderReflectionCache, RoundTrips)
+{
+	std::vector<uint8_t> bytes = SerializedCache();
+	ShaderReflectionCache loaded;
+	ASSERT_TRUE(loaded.Deserialize(bytes.data(), bytes.size()));
+	EXPECT_EQ(2u, loaded.GetEntryCount());
+	EXPECT_FALSE(loaded.IsDirty());
+
+	ShaderReflection reflection;
+	ASSERT_TRUE(loaded.Find(1, reflection));
+	ExpectSame(VertexShaderReflection(), reflection);
+	ASSERT_TRUE(loaded.Find(2, reflection));
+	ExpectSame(ComputeShaderReflection(), reflection);
+	EXPECT_FALSE(loaded.Find(3, reflection));
+}
+
+// A cache of the vertex shader alone, as version 1 of the format writes it.  A change
+// to the layout has to bump the version, or old files would load as garbage.
+static const uint8_t recordedCache[] =
+{
+	0x53, 0x53, 0x52, 0x43, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x88, 0x77, 0x66, 0x55,
+	0x44, 0x33, 0x22, 0x11, 0x50, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x65, 0x78, 0x74, 0x65,
+	0x72, 0x6e, 0x61, 0x6c, 0x44, 0x61, 0x74, 0x61, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x01, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x00, 0x00, 0x65, 0x78, 0x74, 0x65, 0x72, 0x6e, 0x61, 0x6c,
+	0x44, 0x61, 0x74, 0x61, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x07, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x77, 0x6f, 0x72, 0x6c, 0x64, 0x00, 0x00, 0x00,
+	0x00, 0x40, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x70, 0x72, 0x65, 0x76, 0x57, 0x6f, 0x72,
+	0x6c, 0x64, 0x40, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x15, 0x00, 0x00, 0x00, 0x77, 0x6f,
+	0x72, 0x6c, 0x64, 0x49, 0x6e, 0x76, 0x65, 0x72, 0x73, 0x65, 0x54, 0x72, 0x61, 0x6e, 0x73, 0x70,
+	0x6f, 0x73, 0x65, 0x80, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x76,
+	0x69, 0x65, 0x77, 0xc0, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00, 0x70,
+	0x72, 0x6f, 0x6a, 0x65, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x00, 0x01, 0x00, 0x00, 0x40, 0x00, 0x00,
+	0x00, 0x08, 0x00, 0x00, 0x00, 0x70, 0x72, 0x65, 0x76, 0x56, 0x69, 0x65, 0x77, 0x40, 0x01, 0x00,
+	0x00, 0x40, 0x00, 0x00, 0x00, 0x0e, 0x00, 0x00, 0x00, 0x70, 0x72, 0x65, 0x76, 0x50, 0x72, 0x6f,
+	0x6a, 0x65, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x80, 0x01, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x04,
+	0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x50, 0x4f, 0x53, 0x49, 0x54, 0x49, 0x4f, 0x4e, 0x00,
+	0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x54,
+	0x45, 0x58, 0x43, 0x4f, 0x4f, 0x52, 0x44, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x03,
+	0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x4e, 0x4f, 0x52, 0x4d, 0x41, 0x4c, 0x00, 0x00, 0x00,
+	0x00, 0x03, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00, 0x54, 0x41, 0x4e,
+	0x47, 0x45, 0x4e, 0x54, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x00,
+};
+
+TEST(ShaderReflectionCache, ReadsTheRecordedFormat)
+{
+	ShaderReflectionCache cache;
+	cache.Store(0x1122334455667788ull, VertexShaderReflection());
+	std::vector<uint8_t> bytes;
+	cache.Serialize(bytes);
+	EXPECT_EQ(std::vector<uint8_t>(recordedCache, recordedCache + sizeof(recordedCache)), bytes);
+
+	ShaderReflectionCache loaded;
+	ASSERT_TRUE(loaded.Deserialize(recordedCache, sizeof(recordedCache)));
+	ShaderReflection reflection;
+	ASSERT_TRUE(loaded.Find(0x1122334455667788ull, reflection));
+	ExpectSame(VertexShaderReflection(), reflection);
+}
+
+// Every shorter prefix of a good file is what a crash mid save leaves behind
+TEST(ShaderReflectionCache, RejectsTruncatedInput)
+{
+	std::vector<uint8_t> bytes = SerializedCache();
+	for (size_t size = 0; size < bytes.size(); size++)
+	{
+		ShaderReflectionCache cache;
+		cache.Store(7, ComputeShaderReflection());
+		ASSERT_FALSE(cache.Deserialize(bytes.data(), size)) << size << " bytes";
+
+		//A failed load leaves what was there alone
+		ShaderReflection reflection;
+		ASSERT_EQ(1u, cache.GetEntryCount());
+		ASSERT_TRUE(cache.Find(7, reflection));
+	}
+}
+
+TEST(ShaderReflectionCache, RejectsCorruptInput)
+{
+	std::vector<uint8_t> good(recordedCache, recordedCache + sizeof(recordedCache));
+	auto loads = [](std::vector<uint8_t> bytes) {
+		ShaderReflectionCache cache;
+		return cache.Deserialize(bytes.data(), bytes.size());
+	};
+	auto patched = [&](size_t offset, uint32_t value) {
+		std::vector<uint8_t> bytes = good;
+		for (int i = 0; i < 4; i++)
+			bytes[offset + i] = (uint8_t)(value >> (i * 8));
+		return bytes;
+	};
+	ASSERT_TRUE(loads(good));
+
+	//Magic, version, and an entry count the file can't hold
+	EXPECT_FALSE(loads(patched(0, 0x43525354)));
+	EXPECT_FALSE(loads(patched(4, 2)));
+	EXPECT_FALSE(loads(patched(8, 0xffffffff)));
+	EXPECT_FALSE(loads(patched(8, 2)));
+
+	//A resource count and a name length that run past the end
+	EXPECT_FALSE(loads(patched(36, 0x10000000)));
+	EXPECT_FALSE(loads(patched(40, 0xfffffff0)));
+
+	//Bytes left over after the last entry
+	std::vector<uint8_t> trailing = good;
+	trailing.push_back(0);
+	EXPECT_FALSE(loads(trailing));
+}
+
+// Random damage has to fail cleanly or load something, never read out of bounds
+TEST(ShaderReflectionCache, SurvivesRandomDamage)
+{
+	std::vector<uint8_t> good = SerializedCache();
+	std::mt19937 random(37);
+	int rejected = 0;
+	for (int trial = 0; trial < 2000; trial++)
+	{
+		std::vector<uint8_t> bytes = good;
+		int flips = 1 + random() % 4;
+		for (int f = 0; f < flips; f++)
+			bytes[random() % bytes.size()] ^= (uint8_t)(1 + random() % 255);
+		bytes.resize(bytes.size() - random() % 3);
+
+		ShaderReflectionCache cache;
+		rejected += !cache.Deserialize(bytes.data(), bytes.size());
+	}
+	EXPECT_GT(rejected, 0);
+}
+
+TEST(ShaderReflectionCache, SavesAndLoads)
+{
+	std::string path = testing::TempDir() + "ShaderReflectionCacheTest.bin";
+	ShaderReflectionCache cache;
+	cache.Store(1, VertexShaderReflection());
+	EXPECT_TRUE(cache.IsDirty());
+	ASSERT_TRUE(cache.Save(path));
+	EXPECT_FALSE(cache.IsDirty());
+
+	ShaderReflectionCache loaded;
+	ASSERT_TRUE(loaded.Load(path));
+	ShaderReflection reflection;
+	ASSERT_TRUE(loaded.Find(1, reflection));
+	ExpectSame(VertexShaderReflection(), reflection);
+	std::remove(path.c_str());
+
+	//A missing file fails to load and leaves the cache as it was
+	EXPECT_FALSE(loaded.Load(path));
+	EXPECT_EQ(1u, loaded.GetEntryCount());
+}
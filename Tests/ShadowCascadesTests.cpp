@@ -0,0 +1,210 @@
+#include "ShadowCascades.h"
+#include "TestHelpers.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+
+// Camera's defaults
+static const float nearClip = 0.01f;
+static const float farClip = 100.0f;
+
+// A point with the row vector convention, for the orthographic matrices here (w stays 1)
+static XMFLOAT3 TransformPoint(const XMFLOAT3& p, const XMFLOAT4X4& m)
+{
+	return XMFLOAT3(
+		p.x * m._11 + p.y * m._21 + p.z * m._31 + m._41,
+		p.x * m._12 + p.y * m._22 + p.z * m._32 + m._42,
+		p.x * m._13 + p.y * m._23 + p.z * m._33 + m._43);
+}
+
+static float Distance(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	float x = a.x - b.x;
+	float y = a.y - b.y;
+	float z = a.z - b.z;
+	return sqrtf(x * x + y * y + z * z);
+}
+
+// A random camera somewhere around the scene, and the light the game shadows with or a random one
+struct RandomView
+{
+	XMFLOAT3 Position;
+	XMFLOAT4X4 View;
+	float ProjectionX;
+	float ProjectionY;
+	XMFLOAT3 LightDirection;
+};
+
+static RandomView MakeRandomView(std::mt19937& random, int index)
+{
+	RandomView v;
+	v.Position = XMFLOAT3(RandomFloat(random, -50, 50), RandomFloat(random, -5, 20), RandomFloat(random, -50, 50));
+	v.View = ViewMatrix(v.Position, RandomFloat(random, -1.4f, 1.4f), RandomFloat(random, -3.14f, 3.14f));
+	v.ProjectionY = 1.0f / tanf(RandomFloat(random, 0.15f, 0.6f) * 3.14159265f * 0.5f);
+	v.ProjectionX = v.ProjectionY / RandomFloat(random, 0.75f, 2.5f);
+
+	//Straight down is where the light's up has to switch axes
+	if (index % 8 == 0)
+		v.LightDirection = XMFLOAT3(1, -1, 1);
+	else if (index % 8 == 1)
+		v.LightDirection = XMFLOAT3(0, -1, 0.001f * RandomFloat(random, -1, 1));
+	else
+		v.LightDirection = XMFLOAT3(RandomFloat(random, -1, 1), RandomFloat(random, -1, -0.05f), RandomFloat(random, -1, 1));
+	return v;
+}
+
+TEST(ShadowCascades, SplitsRunFromNearToFar)
+{
+	float splits[MAX_SHADOW_CASCADES + 1];
+	ShadowCascades::ComputeSplits(4, 0.1f, 50.0f, 0.0f, splits);
+	for (int i = 0; i <= 4; i++)
+		EXPECT_NEAR(0.1f + 49.9f * i / 4.0f, splits[i], 1e-4f);
+
+	ShadowCascades::ComputeSplits(4, 0.1f, 50.0f, 1.0f, splits);
+	EXPECT_EQ(0.1f, splits[0]);
+	EXPECT_EQ(50.0f, splits[4]);
+	for (int i = 1; i < 4; i++)
+		EXPECT_NEAR(splits[i] / splits[i - 1], splits[i + 1] / splits[i], 1e-3f);
+}
+
+TEST(ShadowCascades, CountIsClamped)
+{
+	EXPECT_EQ(1u, ShadowCascades(0).GetCascadeCount());
+	EXPECT_EQ((unsigned int)MAX_SHADOW_CASCADES, ShadowCascades(MAX_SHADOW_CASCADES + 3).GetCascadeCount());
+}
+
+// Every cascade from random cameras and lights: the splits are continuous out to the
+// shadow distance, the sphere holds its slice of the frustum, the bounds hold the sphere,
+// and the projection takes the slice into the map
+TEST(ShadowCascades, CascadesCoverTheirSlices)
+{
+	std::mt19937 random(44);
+	for (int i = 0; i < 500; i++)
+	{
+		SCOPED_TRACE(testing::Message() << "camera " << i);
+		RandomView v = MakeRandomView(random, i);
+		ShadowCascades cascades(1 + i % MAX_SHADOW_CASCADES, 1024);
+		cascades.SetShadowDistance(i % 3 ? 50.0f : 200.0f);
+		cascades.Fit(v.View, v.ProjectionX, v.ProjectionY, nearClip, farClip, v.LightDirection);
+
+		XMFLOAT3 right(v.View._11, v.View._21, v.View._31);
+		XMFLOAT3 up(v.View._12, v.View._22, v.View._32);
+		XMFLOAT3 forward(v.View._13, v.View._23, v.View._33);
+		float end = i % 3 ? 50.0f : farClip;
+
+		for (unsigned int c = 0; c < cascades.GetCascadeCount(); c++)
+		{
+			SCOPED_TRACE(testing::Message() << "cascade " << c);
+			const ShadowCascade& cascade = cascades.GetCascade(c);
+			ASSERT_EQ(c == 0 ? nearClip : cascades.GetCascade(c - 1).SplitFar, cascade.SplitNear);
+			ASSERT_LT(cascade.SplitNear, cascade.SplitFar);
+			if (c + 1 == cascades.GetCascadeCount())
+			{
+				ASSERT_EQ(end, cascade.SplitFar);
+			}
+
+			ASSERT_NEAR(2.0f * cascade.Radius / (cascades.GetResolution() - 1), cascade.TexelSize, 1e-6f);
+			ASSERT_NEAR(cascade.TexelSize * cascades.GetResolution(), cascade.MaxX - cascade.MinX, cascade.TexelSize * 1e-2f);
+			ASSERT_NEAR(cascade.TexelSize * cascades.GetResolution(), cascade.MaxY - cascade.MinY, cascade.TexelSize * 1e-2f);
+
+			for (int corner = 0; corner < 8; corner++)
+			{
+				float depth = corner & 4 ? cascade.SplitFar : cascade.SplitNear;
+				float sx = (corner & 1 ? 1.0f : -1.0f) * depth / v.ProjectionX;
+				float sy = (corner & 2 ? 1.0f : -1.0f) * depth / v.ProjectionY;
+				XMFLOAT3 p(
+					v.Position.x + forward.x * depth + right.x * sx + up.x * sy,
+					v.Position.y + forward.y * depth + right.y * sx + up.y * sy,
+					v.Position.z + forward.z * depth + right.z * sx + up.z * sy);
+
+				//Some slack for float rounding, relative to the size of the cascade
+				float slack = cascade.Radius * 1e-4f + 1e-4f;
+				ASSERT_LE(Distance(p, cascade.Center), cascade.Radius + slack);
+
+				XMFLOAT3 clip = TransformPoint(p, cascade.ViewProjection);
+				ASSERT_GE(clip.x, -1.0f - 1e-4f);
+				ASSERT_LE(clip.x, 1.0f + 1e-4f);
+				ASSERT_GE(clip.y, -1.0f - 1e-4f);
+				ASSERT_LE(clip.y, 1.0f + 1e-4f);
+				ASSERT_GE(clip.z, -1e-4f);
+				ASSERT_LE(clip.z, 1.0f + 1e-4f);
+				ASSERT_TRUE(cascades.IsVisible(c, p, 0));
+			}
+		}
+	}
+}
+
+// Turning the camera doesn't resize a cascade, and moving it only moves the bounds by
+// whole texels, so shadow edges stay put
+TEST(ShadowCascades, BoundsSnapToTexels)
+{
+	std::mt19937 random(440);
+	for (int i = 0; i < 200; i++)
+	{
+		SCOPED_TRACE(testing::Message() << "camera " << i);
+		RandomView v = MakeRandomView(random, i);
+		ShadowCascades cascades(MAX_SHADOW_CASCADES, 2048);
+		cascades.Fit(v.View, v.ProjectionX, v.ProjectionY, nearClip, farClip, v.LightDirection);
+		ShadowCascade before[MAX_SHADOW_CASCADES];
+		for (unsigned int c = 0; c < MAX_SHADOW_CASCADES; c++)
+			before[c] = cascades.GetCascade(c);
+
+		XMFLOAT3 moved(v.Position.x + RandomFloat(random, -0.5f, 0.5f), v.Position.y + RandomFloat(random, -0.5f, 0.5f), v.Position.z + RandomFloat(random, -0.5f, 0.5f));
+		XMFLOAT4X4 view = ViewMatrix(moved, RandomFloat(random, -1.4f, 1.4f), RandomFloat(random, -3.14f, 3.14f));
+		cascades.Fit(view, v.ProjectionX, v.ProjectionY, nearClip, farClip, v.LightDirection);
+
+		for (unsigned int c = 0; c < MAX_SHADOW_CASCADES; c++)
+		{
+			SCOPED_TRACE(testing::Message() << "cascade " << c);
+			const ShadowCascade& after = cascades.GetCascade(c);
+			ASSERT_EQ(before[c].Radius, after.Radius);
+			ASSERT_EQ(before[c].TexelSize, after.TexelSize);
+
+			//Both are whole numbers of texels from the light's origin
+			float texels = (after.MinX - before[c].MinX) / after.TexelSize;
+			ASSERT_NEAR(std::round(texels), texels, 1e-2f + fabs(after.MinX / after.TexelSize) * 1e-6f);
+			texels = (after.MinY - before[c].MinY) / after.TexelSize;
+			ASSERT_NEAR(std::round(texels), texels, 1e-2f + fabs(after.MinY / after.TexelSize) * 1e-6f);
+		}
+	}
+}
+
+TEST(ShadowCascades, CullsCastersOutsideTheCascade)
+{
+	std::mt19937 random(4400);
+	for (int i = 0; i < 200; i++)
+	{
+		SCOPED_TRACE(testing::Message() << "camera " << i);
+		RandomView v = MakeRandomView(random, i);
+		ShadowCascades cascades;
+		cascades.Fit(v.View, v.ProjectionX, v.ProjectionY, nearClip, farClip, v.LightDirection);
+
+		//Along the light's own axes
+		const XMFLOAT4X4& light = cascades.GetLightView();
+		XMFLOAT3 right(light._11, light._21, light._31);
+		XMFLOAT3 forward(light._13, light._23, light._33);
+
+		for (unsigned int c = 0; c < cascades.GetCascadeCount(); c++)
+		{
+			const ShadowCascade& cascade = cascades.GetCascade(c);
+			XMFLOAT3 center = cascade.Center;
+			float r = cascade.Radius;
+			ASSERT_TRUE(cascades.IsVisible(c, center, 1.0f));
+
+			//Any distance towards the light still casts into the cascade
+			XMFLOAT3 towardsLight(center.x - forward.x * r * 10, center.y - forward.y * r * 10, center.z - forward.z * r * 10);
+			ASSERT_TRUE(cascades.IsVisible(c, towardsLight, 1.0f));
+
+			//Past the far side, or off to the side, it can't
+			XMFLOAT3 beyond(center.x + forward.x * (r + 2), center.y + forward.y * (r + 2), center.z + forward.z * (r + 2));
+			ASSERT_FALSE(cascades.IsVisible(c, beyond, 1.0f));
+			XMFLOAT3 aside(center.x + right.x * (r * 2 + 2), center.y + right.y * (r * 2 + 2), center.z + right.z * (r * 2 + 2));
+			ASSERT_FALSE(cascades.IsVisible(c, aside, 1.0f));
+
+			//Until it's big enough to reach back in
+			ASSERT_TRUE(cascades.IsVisible(c, aside, r + 4));
+		}
+	}
+}
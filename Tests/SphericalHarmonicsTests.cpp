@@ -0,0 +1,167 @@
+#include "SphericalHarmonics.h"
+#include "CubeFaces.h"
+#include "JobSystem.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+using namespace DirectX;
+
+typedef std::function<void(const XMFLOAT3& direction, uint8_t* rgb)> Environment;
+
+// RGBA faces with each texel's colour from the environment in its direction
+static std::vector<uint8_t> MakeCube(unsigned int size, const Environment& environment)
+{
+	std::vector<uint8_t> faces((size_t)6 * size * size * 4);
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int y = 0; y < size; y++)
+		{
+			for (unsigned int x = 0; x < size; x++)
+			{
+				float direction[3];
+				GetCubeTexelDirection(face, x, y, size, direction);
+				XMFLOAT3 d(direction[0], direction[1], direction[2]);
+
+				uint8_t* p = &faces[(((size_t)face * size + y) * size + x) * 4];
+				environment(d, p);
+				p[3] = 255;
+			}
+		}
+	}
+	return faces;
+}
+
+// A daylight sky: blue overhead fading to a pale horizon, and brown ground below
+static void Sky(const XMFLOAT3& d, uint8_t* rgb)
+{
+	float t = std::max(d.y, 0.0f);
+	rgb[0] = (uint8_t)(200 - 140 * t);
+	rgb[1] = (uint8_t)(210 - 90 * t);
+	rgb[2] = (uint8_t)(230 - 10 * t);
+	if (d.y < 0)
+	{
+		rgb[0] = 90;
+		rgb[1] = 70;
+		rgb[2] = 50;
+	}
+}
+
+// The same sky with a small, saturated sun, which L2 can only blur
+static void SkyWithSun(const XMFLOAT3& d, uint8_t* rgb)
+{
+	Sky(d, rgb);
+	float sunDot = (d.x * 0.5f + d.y * 0.7f + d.z * 0.5f) / sqrtf(0.99f);
+	if (sunDot > 0.98f)
+	{
+		rgb[0] = 255;
+		rgb[1] = 250;
+		rgb[2] = 220;
+	}
+}
+
+// Directions spread evenly over the sphere (a Fibonacci spiral), plus the axes where the
+// reference's tangent basis switches its up vector
+static std::vector<XMFLOAT3> TestNormals(unsigned int count)
+{
+	std::vector<XMFLOAT3> normals;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float y = 1.0f - 2.0f * (i + 0.5f) / count;
+		float r = sqrtf(1.0f - y * y);
+		float phi = i * 2.39996323f;
+		normals.push_back(XMFLOAT3(cosf(phi) * r, y, sinf(phi) * r));
+	}
+	normals.push_back(XMFLOAT3(0, 1, 0));
+	normals.push_back(XMFLOAT3(0, -1, 0));
+	normals.push_back(XMFLOAT3(1, 0, 0));
+	normals.push_back(XMFLOAT3(0, 0, -1));
+	return normals;
+}
+
+// Largest difference between the projection and the brute force integral over the test
+// normals, relative to the brightest reference value
+static float MaxRelativeError(const std::vector<uint8_t>& faces, unsigned int size)
+{
+	SHIrradiance sh = SphericalHarmonics::ProjectIrradiance(faces.data(), size, false);
+	float worst = 0;
+	float brightest = 0;
+	for (const XMFLOAT3& n : TestNormals(64))
+	{
+		XMFLOAT3 projected = SphericalHarmonics::Evaluate(sh, n);
+		XMFLOAT3 reference = SphericalHarmonics::ReferenceIrradiance(faces.data(), size, false, n);
+		worst = std::max(worst, std::max(fabsf(projected.x - reference.x), std::max(fabsf(projected.y - reference.y), fabsf(projected.z - reference.z))));
+		brightest = std::max(brightest, std::max(reference.x, std::max(reference.y, reference.z)));
+	}
+	return worst / brightest;
+}
+
+TEST(SphericalHarmonics, ConstantEnvironmentIsExact)
+{
+	std::vector<uint8_t> faces = MakeCube(16, [](const XMFLOAT3&, uint8_t* rgb) { rgb[0] = 64; rgb[1] = 128; rgb[2] = 255; });
+	SHIrradiance sh = SphericalHarmonics::ProjectIrradiance(faces.data(), 16, false);
+
+	//Only the constant band, and the value comes back everywhere
+	for (int i = 1; i < 9; i++)
+	{
+		EXPECT_NEAR(0, sh.Coefficients[i].x, 1e-5f);
+		EXPECT_NEAR(0, sh.Coefficients[i].y, 1e-5f);
+		EXPECT_NEAR(0, sh.Coefficients[i].z, 1e-5f);
+	}
+	for (const XMFLOAT3& n : TestNormals(16))
+	{
+		XMFLOAT3 projected = SphericalHarmonics::Evaluate(sh, n);
+		XMFLOAT3 reference = SphericalHarmonics::ReferenceIrradiance(faces.data(), 16, false, n);
+		EXPECT_NEAR(powf(64 / 255.0f, 2.2f), projected.x, 1e-4f);
+		EXPECT_NEAR(powf(128 / 255.0f, 2.2f), projected.y, 1e-4f);
+		EXPECT_NEAR(1.0f, projected.z, 1e-4f);
+		//The reference's fixed angle steps lose a fraction of a percent
+		EXPECT_NEAR(reference.x, projected.x, 5e-3f);
+		EXPECT_NEAR(reference.y, projected.y, 5e-3f);
+		EXPECT_NEAR(reference.z, projected.z, 5e-3f);
+	}
+}
+
+// Irradiance is smooth enough that L2 holds it to under a percent, even with a sun, and
+// these bounds sit just above what the projection measures (0.68% and 0.57%)
+TEST(SphericalHarmonics, MatchesBruteForceIntegral)
+{
+	float skyError = MaxRelativeError(MakeCube(32, Sky), 32);
+	float sunError = MaxRelativeError(MakeCube(64, SkyWithSun), 64);
+	printf("Sky: %.4f, with sun: %.4f\n", skyError, sunError);
+	EXPECT_LT(skyError, 0.008f);
+	EXPECT_LT(sunError, 0.007f);
+}
+
+TEST(SphericalHarmonics, BgraAndThreadsMatch)
+{
+	const unsigned int size = 48;
+	std::vector<uint8_t> rgba = MakeCube(size, SkyWithSun);
+	std::vector<uint8_t> bgra = rgba;
+	for (size_t i = 0; i < bgra.size(); i += 4)
+		std::swap(bgra[i], bgra[i + 2]);
+
+	JobSystem jobs(4);
+	SHIrradiance serial = SphericalHarmonics::ProjectIrradiance(rgba.data(), size, false);
+	SHIrradiance swapped = SphericalHarmonics::ProjectIrradiance(bgra.data(), size, true);
+	SHIrradiance threaded = SphericalHarmonics::ProjectIrradiance(rgba.data(), size, false, &jobs);
+	for (int i = 0; i < 9; i++)
+	{
+		EXPECT_EQ(serial.Coefficients[i].x, swapped.Coefficients[i].x);
+		EXPECT_EQ(serial.Coefficients[i].y, swapped.Coefficients[i].y);
+		EXPECT_EQ(serial.Coefficients[i].z, swapped.Coefficients[i].z);
+		EXPECT_NEAR(serial.Coefficients[i].x, threaded.Coefficients[i].x, 1e-5f);
+		EXPECT_NEAR(serial.Coefficients[i].y, threaded.Coefficients[i].y, 1e-5f);
+		EXPECT_NEAR(serial.Coefficients[i].z, threaded.Coefficients[i].z, 1e-5f);
+	}
+
+	XMFLOAT3 n(0.3f, -0.2f, 0.9f);
+	XMFLOAT3 a = SphericalHarmonics::ReferenceIrradiance(rgba.data(), size, false, n);
+	XMFLOAT3 b = SphericalHarmonics::ReferenceIrradiance(bgra.data(), size, true, n);
+	EXPECT_EQ(a.x, b.x);
+	EXPECT_EQ(a.y, b.y);
+	EXPECT_EQ(a.z, b.z);
+}
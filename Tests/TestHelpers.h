@@ -0,0 +1,19 @@
+#pragma once
+#include <DirectXMath.h>
+#include <random>
+
+#include "SceneSetup.h"
+
+// A float in [low, high) from the raw generator, so it's the same on every standard library
+inline float RandomFloat(std::mt19937& random, float low, float high)
+{
+	return low + (high - low) * (random() / 4294967296.0f);
+}
+
+// The view matrix Camera builds (XMMatrixLookToLH, row vectors) for a position, pitch and yaw
+inline DirectX::XMFLOAT4X4 ViewMatrix(const DirectX::XMFLOAT3& position, float pitch, float yaw)
+{
+	DirectX::XMFLOAT4X4 view;
+	BuildViewMatrix(position, pitch, yaw, view);
+	return view;
+}
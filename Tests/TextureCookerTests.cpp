@@ -0,0 +1,412 @@
+#include "TextureCooker.h"
+#include "TextureResidency.h"
+#include "DDSFile.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <vector>
+
+typedef std::vector<uint8_t> Image;
+
+static uint8_t ToByte(float value)
+{
+	return (uint8_t)std::min(std::max(value * 255.0f + 0.5f, 0.0f), 255.0f);
+}
+
+// Smooth ramps in every channel, alpha included
+static Image Gradient(unsigned int width, unsigned int height)
+{
+	Image rgba((size_t)width * height * 4);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			float u = x / (float)(width - 1);
+			float v = y / (float)(height - 1);
+			uint8_t* p = &rgba[((size_t)y * width + x) * 4];
+			p[0] = ToByte(u);
+			p[1] = ToByte(v);
+			p[2] = ToByte(1.0f - 0.5f * (u + v));
+			p[3] = ToByte(0.25f + 0.75f * u * v);
+		}
+	}
+	return rgba;
+}
+
+// Value noise on an 8 texel grid, like the mottled albedo of rock or dirt.  Uses the raw
+// generator so every standard library makes the same image.
+static Image Noise(unsigned int width, unsigned int height, unsigned int seed)
+{
+	const unsigned int cell = 8;
+	unsigned int gridWide = width / cell + 2;
+	unsigned int gridHigh = height / cell + 2;
+	std::mt19937 random(seed);
+	std::vector<float> grid(gridWide * gridHigh * 3);
+	for (auto& g : grid)
+		g = (random() & 0xffff) / 65535.0f;
+
+	Image rgba((size_t)width * height * 4);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			unsigned int gx = x / cell;
+			unsigned int gy = y / cell;
+			float fx = (x % cell) / (float)cell;
+			float fy = (y % cell) / (float)cell;
+			uint8_t* p = &rgba[((size_t)y * width + x) * 4];
+			for (int c = 0; c < 3; c++)
+			{
+				auto at = [&](unsigned int i, unsigned int j) { return grid[((gy + j) * gridWide + gx + i) * 3 + c]; };
+				float top = at(0, 0) + (at(1, 0) - at(0, 0)) * fx;
+				float bottom = at(0, 1) + (at(1, 1) - at(0, 1)) * fx;
+				p[c] = ToByte(top + (bottom - top) * fy);
+			}
+			p[3] = 255;
+		}
+	}
+	return rgba;
+}
+
+// Hard edged two color tiles that don't line up with the blocks
+static Image Checker(unsigned int width, unsigned int height)
+{
+	Image rgba((size_t)width * height * 4);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			bool light = ((x + 3) / 6 + (y + 1) / 5) % 2 == 0;
+			uint8_t* p = &rgba[((size_t)y * width + x) * 4];
+			p[0] = light ? 230 : 40;
+			p[1] = light ? 200 : 60;
+			p[2] = light ? 90 : 120;
+			p[3] = 255;
+		}
+	}
+	return rgba;
+}
+
+// A tangent space normal map of overlapping ripples
+static Image Normals(unsigned int width, unsigned int height)
+{
+	Image rgba((size_t)width * height * 4);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			float dx = 0.6f * cosf(x * 0.21f) * cosf(y * 0.07f);
+			float dy = 0.5f * sinf(y * 0.17f + x * 0.05f);
+			float length = sqrtf(dx * dx + dy * dy + 1.0f);
+			uint8_t* p = &rgba[((size_t)y * width + x) * 4];
+			p[0] = ToByte(dx / length * 0.5f + 0.5f);
+			p[1] = ToByte(dy / length * 0.5f + 0.5f);
+			p[2] = ToByte(1.0f / length * 0.5f + 0.5f);
+			p[3] = 255;
+		}
+	}
+	return rgba;
+}
+
+// The single channel maps only read red, so a grey scale noise stands in for roughness
+static Image Mask(unsigned int width, unsigned int height)
+{
+	Image rgba = Noise(width, height, 35);
+	for (size_t i = 0; i < rgba.size(); i += 4)
+		rgba[i + 1] = rgba[i + 2] = rgba[i];
+	return rgba;
+}
+
+// The source mip the cooker would have encoded, for comparing lower mips
+static Image SourceMip(const Image& rgba, unsigned int width, unsigned int height, unsigned int mip)
+{
+	Image level = rgba;
+	for (unsigned int m = 0; m < mip; m++)
+	{
+		Image half;
+		TextureCooker::DownsampleRGBA8(level.data(), width, height, half);
+		level.swap(half);
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+	}
+	return level;
+}
+
+struct QualityCase
+{
+	const char* Name;
+	Image Pixels;
+	unsigned int Width;
+	unsigned int Height;
+	CookedFormat Format;
+	// Lowest acceptable PSNR over the format's channels, at mip 0 and at any mip
+	double MinPSNR;
+	double MinMipPSNR;
+};
+
+static unsigned int ChannelCount(CookedFormat format)
+{
+	return format == COOKED_BC7 ? 4 : format == COOKED_BC5 ? 2 : 1;
+}
+
+// Thresholds sit a little under what the encoder reaches today, so a change that costs
+// quality fails here instead of on screen.  Small mips of the gradient and noise are
+// low because mode 6 fits a single line through each block's colors, and a whole
+// image's worth of two dimensional ramp in one block isn't one.
+static std::vector<QualityCase> QualityCases()
+{
+	return {
+		{ "gradient", Gradient(128, 128), 128, 128, COOKED_BC7, 46.0, 16.0 },
+		{ "noise", Noise(128, 128, 7), 128, 128, COOKED_BC7, 31.5, 21.0 },
+		{ "checker", Checker(128, 128), 128, 128, COOKED_BC7, 53.0, 41.0 },
+		{ "odd size noise", Noise(100, 60, 11), 100, 60, COOKED_BC7, 31.5, 21.0 },
+		{ "normals", Normals(128, 128), 128, 128, COOKED_BC5, 47.0, 35.0 },
+		{ "mask", Mask(128, 128), 128, 128, COOKED_BC4, 40.0, 33.5 },
+		{ "gradient red", Gradient(128, 128), 128, 128, COOKED_BC4, 50.0, 31.0 },
+	};
+}
+
+TEST(TextureCooker, MeetsMinimumPSNR)
+{
+	for (auto& test : QualityCases())
+	{
+		SCOPED_TRACE(test.Name);
+		CookedTexture cooked;
+		TextureCooker::Cook(test.Pixels.data(), test.Width, test.Height, test.Format, cooked, 1);
+		ASSERT_EQ(TextureResidency::MipCountFor(test.Width, test.Height), cooked.MipCount);
+
+		unsigned int channels = ChannelCount(test.Format);
+		for (unsigned int mip = 0; mip < cooked.MipCount; mip++)
+		{
+			unsigned int width = std::max(test.Width >> mip, 1u);
+			unsigned int height = std::max(test.Height >> mip, 1u);
+			Image decoded;
+			TextureCooker::Decode(cooked, mip, decoded);
+			Image source = SourceMip(test.Pixels, test.Width, test.Height, mip);
+			double psnr = TextureCooker::PSNR(source.data(), decoded.data(), width * height, channels);
+			EXPECT_GE(psnr, mip == 0 ? test.MinPSNR : test.MinMipPSNR) << "mip " << mip;
+			if (mip == 0)
+				printf("%s: %.2f dB\n", test.Name, psnr);
+		}
+	}
+}
+
+// The workers pull batches of blocks in whatever order they get to them, and must still
+// write every block exactly where one thread would
+TEST(TextureCooker, ThreadedCookMatchesSingleThreaded)
+{
+	Image noise = Noise(256, 192, 3);
+	Image normals = Normals(256, 192);
+	Image mask = Mask(256, 192);
+	const Image* sources[COOKED_FORMAT_COUNT] = { &noise, &normals, &mask };
+	for (int format = 0; format < COOKED_FORMAT_COUNT; format++)
+	{
+		SCOPED_TRACE(testing::Message() << "format " << format);
+		CookedTexture single;
+		CookedTexture threaded;
+		TextureCooker::Cook(sources[format]->data(), 256, 192, (CookedFormat)format, single, 1);
+		TextureCooker::Cook(sources[format]->data(), 256, 192, (CookedFormat)format, threaded, 4);
+		EXPECT_EQ(single.MipCount, threaded.MipCount);
+		EXPECT_TRUE(single.Data == threaded.Data);
+
+		//And the threaded cook holds the same quality bar
+		Image decoded;
+		TextureCooker::Decode(threaded, 0, decoded);
+		double psnr = TextureCooker::PSNR(sources[format]->data(), decoded.data(), 256 * 192, ChannelCount((CookedFormat)format));
+		EXPECT_GE(psnr, format == COOKED_BC7 ? 31.5 : format == COOKED_BC5 ? 47.0 : 40.0);
+	}
+}
+
+TEST(TextureCooker, BC4KeepsFlatAndTwoLevelBlocks)
+{
+	uint8_t values[16];
+	uint8_t block[8];
+	uint8_t decoded[16];
+	for (int v : { 0, 1, 128, 254, 255 })
+	{
+		std::fill(values, values + 16, (uint8_t)v);
+		TextureCooker::EncodeBC4Block(values, block);
+		TextureCooker::DecodeBC4Block(block, decoded);
+		EXPECT_TRUE(std::equal(values, values + 16, decoded)) << v;
+	}
+
+	for (int p = 0; p < 16; p++)
+		values[p] = p % 3 ? 17 : 201;
+	TextureCooker::EncodeBC4Block(values, block);
+	TextureCooker::DecodeBC4Block(block, decoded);
+	EXPECT_TRUE(std::equal(values, values + 16, decoded));
+}
+
+// One channel of an RGBA8 image moved into red, the way the shader reads it back out
+static Image Unpack(const Image& rgba, int channel)
+{
+	Image red(rgba.size(), 0);
+	for (size_t i = 0; i < rgba.size(); i += 4)
+		red[i] = rgba[i + channel];
+	return red;
+}
+
+TEST(TextureCooker, PackedChannelsUnpackToTheirMaps)
+{
+	Image roughness = Mask(64, 64);
+	Image metal = Gradient(64, 64);
+	PackSource sources[3] = { { roughness.data(), 64, 64 }, { metal.data(), 64, 64 }, { nullptr, 0, 0 } };
+
+	Image packed;
+	unsigned int width;
+	unsigned int height;
+	TextureCooker::PackChannels(sources, 3, packed, width, height);
+	ASSERT_EQ(64u, width);
+	ASSERT_EQ(64u, height);
+
+	//Same sized maps come back exactly, and the missing AO and the unused alpha are white
+	EXPECT_TRUE(Unpack(packed, 0) == Unpack(roughness, 0));
+	EXPECT_TRUE(Unpack(packed, 1) == Unpack(metal, 0));
+	for (size_t i = 0; i < packed.size(); i += 4)
+	{
+		ASSERT_EQ(255, packed[i + 2]);
+		ASSERT_EQ(255, packed[i + 3]);
+	}
+}
+
+TEST(TextureCooker, PackingScalesSmallerMaps)
+{
+	//A 32 texel ramp stretched over 64 texels, sampled at texel centers
+	Image roughness = Mask(64, 64);
+	Image ramp(32 * 32 * 4, 0);
+	for (unsigned int y = 0; y < 32; y++)
+		for (unsigned int x = 0; x < 32; x++)
+			ramp[(y * 32 + x) * 4] = (uint8_t)(x * 8);
+	PackSource sources[3] = { { roughness.data(), 64, 64 }, { nullptr, 0, 0 }, { ramp.data(), 32, 32 } };
+
+	Image packed;
+	unsigned int width;
+	unsigned int height;
+	TextureCooker::PackChannels(sources, 3, packed, width, height);
+	ASSERT_EQ(64u, width);
+
+	for (unsigned int y = 0; y < 64; y++)
+	{
+		EXPECT_EQ(0, packed[(y * 64) * 4 + 2]);
+		EXPECT_EQ(248, packed[(y * 64 + 63) * 4 + 2]);
+		for (unsigned int x = 1; x < 63; x++)
+		{
+			ASSERT_NEAR(4.0 * x - 2.0, packed[(y * 64 + x) * 4 + 2], 1.0) << x << ", " << y;
+			ASSERT_EQ(255, packed[(y * 64 + x) * 4 + 1]);
+		}
+	}
+}
+
+// What the shader sees of each map after cooking: the packed texture through BC7,
+// unpacked channel by channel
+TEST(TextureCooker, CookedPackedChannelsMatchTheirMaps)
+{
+	Image maps[3] = { Mask(128, 128), Checker(128, 128), Gradient(128, 128) };
+	PackSource sources[3];
+	for (int i = 0; i < 3; i++)
+		sources[i] = { maps[i].data(), 128, 128 };
+
+	Image packed;
+	unsigned int width;
+	unsigned int height;
+	TextureCooker::PackChannels(sources, 3, packed, width, height);
+	CookedTexture cooked;
+	TextureCooker::Cook(packed.data(), width, height, COOKED_BC7, cooked);
+
+	Image decoded;
+	TextureCooker::Decode(cooked, 0, decoded);
+	const char* names[3] = { "roughness", "metal", "AO" };
+	//Three unrelated maps share each block's one color line, so noisy roughness pays
+	//for the other two being sharp
+	const double minPSNR[3] = { 24.5, 42.5, 41.5 };
+	for (int c = 0; c < 3; c++)
+	{
+		double psnr = TextureCooker::PSNR(Unpack(maps[c], 0).data(), Unpack(decoded, c).data(), width * height, 1);
+		printf("%s: %.2f dB\n", names[c], psnr);
+		EXPECT_GE(psnr, minPSNR[c]) << names[c];
+	}
+}
+
+// A small sky through the same cook Assets::CookSky does: six faces of one colour each,
+// cooked to BC7 and written as a cube DDS that reads back with every face and mip
+TEST(TextureCooker, CookedCubeIsACubeDDS)
+{
+	const unsigned int size = 32;
+	const uint8_t colors[6][3] = { { 255, 0, 0 }, { 0, 255, 0 }, { 0, 0, 255 }, { 255, 255, 0 }, { 0, 255, 255 }, { 255, 0, 255 } };
+	Image images[6];
+	PackSource faces[6];
+	for (int face = 0; face < 6; face++)
+	{
+		images[face].resize((size_t)size * size * 4);
+		for (size_t i = 0; i < images[face].size(); i += 4)
+		{
+			images[face][i] = colors[face][0];
+			images[face][i + 1] = colors[face][1];
+			images[face][i + 2] = colors[face][2];
+			images[face][i + 3] = 255;
+		}
+		faces[face] = { images[face].data(), size, size };
+	}
+
+	CookedTexture cooked[6];
+	ASSERT_TRUE(TextureCooker::CookCube(faces, COOKED_BC7, cooked, 1));
+	std::string path = testing::TempDir() + "CookedCube.dds";
+	ASSERT_TRUE(TextureCooker::WriteCubeDDS(path, cooked));
+
+	//What DDSTextureLoader looks at: the cube caps, and a DX10 header holding one BC7 cube
+	uint32_t header[32];
+	uint32_t dx10[5];
+	{
+		std::ifstream file(path, std::ios::binary);
+		ASSERT_TRUE((bool)file.read((char*)header, sizeof(header)));
+		ASSERT_TRUE((bool)file.read((char*)dx10, sizeof(dx10)));
+	}
+	EXPECT_EQ(0x20534444u, header[0]);
+	EXPECT_EQ(size, header[3]);
+	EXPECT_EQ(size, header[4]);
+	EXPECT_EQ(6u, header[7]);
+	EXPECT_EQ(0xFE00u, header[28]);
+	EXPECT_EQ(98u, dx10[0]);
+	EXPECT_EQ(3u, dx10[1]);
+	EXPECT_EQ(0x4u, dx10[2]);
+	EXPECT_EQ(1u, dx10[3]);
+
+	DDSDescription description;
+	std::vector<uint8_t> data;
+	ASSERT_TRUE(DDSFile::Read(path, description, data));
+	std::remove(path.c_str());
+	EXPECT_EQ(98u, description.Format);
+	EXPECT_EQ(size, description.Width);
+	EXPECT_EQ(size, description.Height);
+	EXPECT_EQ(6u, description.MipCount);
+	EXPECT_EQ(6u, description.ArraySize);
+	EXPECT_TRUE(description.Cube);
+	ASSERT_EQ(DDSFile::TotalBytes(description), data.size());
+
+	//Each face's whole mip chain in turn, every mip still its face's colour
+	const uint8_t* blocks = data.data();
+	for (int face = 0; face < 6; face++)
+	{
+		for (unsigned int mip = 0; mip < description.MipCount; mip++)
+		{
+			SCOPED_TRACE(testing::Message() << "face " << face << ", mip " << mip);
+			unsigned int mipSize = std::max(size >> mip, 1u);
+			Image decoded;
+			TextureCooker::DecodeBlocks(blocks, COOKED_BC7, mipSize, mipSize, decoded);
+			for (size_t i = 0; i < decoded.size(); i += 4)
+			{
+				ASSERT_NEAR(colors[face][0], decoded[i], 2);
+				ASSERT_NEAR(colors[face][1], decoded[i + 1], 2);
+				ASSERT_NEAR(colors[face][2], decoded[i + 2], 2);
+			}
+			blocks += DDSFile::MipBytes(description.Format, size, size, mip);
+		}
+	}
+
+	//Faces that don't make a cube aren't cooked
+	faces[3].Width = size / 2;
+	EXPECT_FALSE(TextureCooker::CookCube(faces, COOKED_BC7, cooked));
+}
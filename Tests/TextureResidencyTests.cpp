@@ -0,0 +1,296 @@
+#include "TextureResidency.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// A 1024 BC7 texture, the most common kind in the scene
+static int AddBC7(TextureResidency& residency, int priority = 0)
+{
+	return residency.AddTexture(1024, 1024, 8, true, priority);
+}
+
+static uint64_t BC7Bytes(unsigned int firstMip)
+{
+	return TextureResidency::MipChainBytes(1024, 1024, 8, true, firstMip);
+}
+
+TEST(TextureResidency, MipMath)
+{
+	EXPECT_EQ(11u, TextureResidency::MipCountFor(1024, 1024));
+	EXPECT_EQ(11u, TextureResidency::MipCountFor(1024, 16));
+	EXPECT_EQ(1u, TextureResidency::MipCountFor(1, 1));
+	EXPECT_EQ(4u, TextureResidency::TailMipFor(1024, 1024, 64));
+	EXPECT_EQ(0u, TextureResidency::TailMipFor(32, 32, 64));
+
+	//4x4 blocks round the small mips up: 4x4, 2x2 and 1x1 are a block each
+	EXPECT_EQ(16u + 16 + 16, TextureResidency::MipChainBytes(4, 4, 8, true, 0));
+	EXPECT_EQ(16u * 4 + 4 * 2 * 2 + 4, TextureResidency::MipChainBytes(4, 4, 32, false, 0));
+	EXPECT_EQ(1024u * 1024 + BC7Bytes(1), BC7Bytes(0));
+}
+
+TEST(TextureResidency, StartsWithTails)
+{
+	TextureResidency residency(1 << 30);
+	int texture = AddBC7(residency);
+	EXPECT_EQ(residency.GetTailMip(texture), residency.GetResidentMip(texture));
+	EXPECT_EQ(BC7Bytes(4), residency.GetResidentBytes());
+	EXPECT_TRUE(residency.Update().empty());
+
+	residency.RemoveTexture(texture);
+	EXPECT_EQ(0u, residency.GetResidentBytes());
+	residency.RemoveTexture(texture);
+	EXPECT_EQ(0u, residency.GetResidentBytes());
+}
+
+TEST(TextureResidency, UpgradesToTheRequest)
+{
+	TextureResidency residency(1 << 30);
+	int texture = AddBC7(residency);
+	residency.RequestMip(texture, 2);
+	residency.RequestMip(texture, 3);
+
+	auto changes = residency.Update();
+	ASSERT_EQ(1u, changes.size());
+	EXPECT_EQ(texture, changes[0].Texture);
+	EXPECT_EQ(4u, changes[0].FromMip);
+	EXPECT_EQ(2u, changes[0].ToMip);
+	EXPECT_EQ(BC7Bytes(2), residency.GetResidentBytes());
+
+	//Nothing asked for, but nothing needs the room either
+	EXPECT_TRUE(residency.Update().empty());
+	EXPECT_EQ(2u, residency.GetResidentMip(texture));
+}
+
+TEST(TextureResidency, SettlesForACoarserMip)
+{
+	TextureResidency residency(BC7Bytes(2));
+	int texture = AddBC7(residency);
+	residency.RequestMip(texture, 0);
+	residency.Update();
+	EXPECT_EQ(2u, residency.GetResidentMip(texture));
+	EXPECT_EQ(BC7Bytes(2), residency.GetResidentBytes());
+}
+
+TEST(TextureResidency, EvictsLeastRecentlyUsedFirst)
+{
+	//Room for the tails and two textures at mip 1
+	uint64_t budget = 3 * BC7Bytes(4) + 2 * (BC7Bytes(1) - BC7Bytes(4));
+	TextureResidency residency(budget);
+	int a = AddBC7(residency);
+	int b = AddBC7(residency);
+	int c = AddBC7(residency);
+
+	residency.RequestMip(a, 1);
+	residency.Update();
+	residency.RequestMip(b, 1);
+	residency.Update();
+	residency.RequestMip(c, 1);
+	residency.Update();
+
+	EXPECT_EQ(4u, residency.GetResidentMip(a));
+	EXPECT_EQ(1u, residency.GetResidentMip(b));
+	EXPECT_EQ(1u, residency.GetResidentMip(c));
+	EXPECT_EQ(budget, residency.GetResidentBytes());
+}
+
+TEST(TextureResidency, TrimsOnlyWhatIsNeeded)
+{
+	//Room for one texture at mip 0 and the other at its tail
+	uint64_t budget = BC7Bytes(0) + BC7Bytes(4);
+	TextureResidency residency(budget);
+	int a = AddBC7(residency);
+	int b = AddBC7(residency);
+	residency.RequestMip(a, 0);
+	residency.Update();
+	ASSERT_EQ(0u, residency.GetResidentMip(a));
+
+	//Mip 2 for b only costs a its top mip
+	residency.RequestMip(b, 2);
+	auto changes = residency.Update();
+	EXPECT_EQ(1u, residency.GetResidentMip(a));
+	EXPECT_EQ(2u, residency.GetResidentMip(b));
+	EXPECT_EQ(2u, changes.size());
+	EXPECT_LE(residency.GetResidentBytes(), budget);
+}
+
+TEST(TextureResidency, PriorityTakesRequestedMips)
+{
+	uint64_t budget = BC7Bytes(0) + BC7Bytes(4);
+	TextureResidency residency(budget);
+	int low = AddBC7(residency, 0);
+	int high = AddBC7(residency, 1);
+
+	//Both want everything, and only the higher priority gets it
+	residency.RequestMip(low, 0);
+	residency.RequestMip(high, 0);
+	residency.Update();
+	EXPECT_EQ(4u, residency.GetResidentMip(low));
+	EXPECT_EQ(0u, residency.GetResidentMip(high));
+
+	//An equal priority can't take mips that are being asked for
+	residency.SetPriority(low, 1);
+	residency.RequestMip(low, 0);
+	residency.RequestMip(high, 0);
+	residency.Update();
+	EXPECT_EQ(4u, residency.GetResidentMip(low));
+	EXPECT_EQ(0u, residency.GetResidentMip(high));
+
+	residency.SetPriority(low, 2);
+	residency.RequestMip(low, 0);
+	residency.RequestMip(high, 0);
+	residency.Update();
+	EXPECT_EQ(0u, residency.GetResidentMip(low));
+	EXPECT_EQ(4u, residency.GetResidentMip(high));
+}
+
+TEST(TextureResidency, FailedUpgradeEvictsNothing)
+{
+	//The other texture is in use, so nothing can be freed for mip 0
+	uint64_t budget = BC7Bytes(1) + BC7Bytes(4);
+	TextureResidency residency(budget);
+	int a = AddBC7(residency);
+	int b = AddBC7(residency);
+	residency.RequestMip(a, 1);
+	residency.Update();
+
+	residency.RequestMip(a, 1);
+	residency.RequestMip(b, 0);
+	EXPECT_TRUE(residency.Update().empty());
+	EXPECT_EQ(1u, residency.GetResidentMip(a));
+	EXPECT_EQ(4u, residency.GetResidentMip(b));
+}
+
+TEST(TextureResidency, LimitsUpgradesPerUpdate)
+{
+	TextureResidency residency(1 << 30, 64, 2);
+	std::vector<int> textures;
+	for (int i = 0; i < 5; i++)
+		textures.push_back(AddBC7(residency));
+
+	for (int frame = 0; frame < 3; frame++)
+	{
+		for (int texture : textures)
+			residency.RequestMip(texture, 0);
+		EXPECT_EQ(frame < 2 ? 2u : 1u, residency.Update().size());
+	}
+}
+
+TEST(TextureResidency, LowerBudgetTrimsToTails)
+{
+	TextureResidency residency(1 << 30);
+	int a = AddBC7(residency);
+	int b = AddBC7(residency);
+	residency.RequestMip(a, 0);
+	residency.RequestMip(b, 0);
+	residency.Update();
+
+	//Not even the tails fit, so everything goes as far as it can
+	residency.SetBudget(BC7Bytes(4));
+	auto changes = residency.Update();
+	EXPECT_EQ(2u, changes.size());
+	EXPECT_EQ(4u, residency.GetResidentMip(a));
+	EXPECT_EQ(4u, residency.GetResidentMip(b));
+	EXPECT_EQ(2 * BC7Bytes(4), residency.GetResidentBytes());
+}
+
+// A camera flying past a field of textures of mixed sizes, formats and priorities.  Each
+// frame asks for the mip its distance calls for, and the policy's own bookkeeping is
+// checked against a copy rebuilt from the changes it returns.
+TEST(TextureResidency, DemandTraceKeepsTheBooks)
+{
+	struct Placed
+	{
+		unsigned int Width;
+		unsigned int Height;
+		unsigned int Bits;
+		bool Compressed;
+		float X;
+		int Id;
+		unsigned int Mip;
+		bool Alive;
+	};
+
+	const unsigned int maxUpgrades = 4;
+	std::mt19937 random(34);
+	TextureResidency residency(24ull << 20, 64, maxUpgrades);
+	std::vector<Placed> placed;
+	for (int i = 0; i < 64; i++)
+	{
+		Placed p;
+		p.Width = 256u << (random() % 4);
+		p.Height = p.Width >> (random() % 2);
+		p.Compressed = random() % 4 != 0;
+		p.Bits = p.Compressed ? (random() % 2 ? 8 : 4) : 32;
+		p.X = (float)(random() % 400);
+		p.Id = residency.AddTexture(p.Width, p.Height, p.Bits, p.Compressed, (int)(random() % 3));
+		p.Mip = residency.GetResidentMip(p.Id);
+		p.Alive = true;
+		placed.push_back(p);
+	}
+
+	uint64_t upgraded = 0;
+	for (int frame = 0; frame < 600; frame++)
+	{
+		SCOPED_TRACE(testing::Message() << "frame " << frame);
+		float cameraX = frame < 400 ? (float)frame : 400.0f - (frame - 400) * 2.0f;
+
+		//Part way through the budget drops and a few textures unload
+		if (frame == 300)
+			residency.SetBudget(12ull << 20);
+		if (frame == 450)
+		{
+			for (int i = 0; i < 64; i += 8)
+			{
+				residency.RemoveTexture(placed[i].Id);
+				placed[i].Alive = false;
+			}
+		}
+
+		std::vector<unsigned int> requested(placed.size(), ~0u);
+		for (size_t i = 0; i < placed.size(); i++)
+		{
+			float distance = std::fabs(placed[i].X - cameraX);
+			if (!placed[i].Alive || distance > 60.0f)
+				continue;
+			requested[i] = (unsigned int)std::log2(std::max(distance, 1.0f) / 2.0f + 1.0f);
+			residency.RequestMip(placed[i].Id, requested[i]);
+		}
+
+		auto changes = residency.Update();
+		unsigned int upgrades = 0;
+		for (auto& change : changes)
+		{
+			Placed& p = placed[change.Texture];
+			ASSERT_TRUE(p.Alive);
+			ASSERT_EQ(p.Mip, change.FromMip);
+			ASSERT_NE(change.FromMip, change.ToMip);
+			ASSERT_LE(change.ToMip, residency.GetTailMip(p.Id));
+			upgrades += change.ToMip < change.FromMip;
+
+			//Only what was asked for comes in
+			if (change.ToMip < change.FromMip)
+			{
+				ASSERT_GE(change.ToMip, requested[change.Texture]);
+			}
+			p.Mip = change.ToMip;
+		}
+		ASSERT_LE(upgrades, maxUpgrades);
+		upgraded += upgrades;
+
+		uint64_t bytes = 0;
+		for (auto& p : placed)
+		{
+			if (!p.Alive)
+				continue;
+			ASSERT_EQ(p.Mip, residency.GetResidentMip(p.Id));
+			bytes += TextureResidency::MipChainBytes(p.Width, p.Height, p.Bits, p.Compressed, p.Mip);
+		}
+		ASSERT_EQ(bytes, residency.GetResidentBytes());
+		ASSERT_LE(bytes, residency.GetBudget());
+	}
+
+	//Demand moved around enough to stream plenty in
+	EXPECT_GT(upgraded, 100u);
+}
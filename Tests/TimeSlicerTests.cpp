@@ -0,0 +1,155 @@
+#include "TimeSlicer.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+// A clock that only moves when an item says it took time
+struct FakeWork
+{
+	uint64_t Now = 0;
+	std::vector<uint64_t> Costs;
+	std::vector<unsigned int> Ran;
+
+	TimeSlicer::Clock Clock() { return [this]() { return Now; }; }
+	std::function<void(unsigned int)> Item()
+	{
+		return [this](unsigned int item)
+		{
+			Ran.push_back(item);
+			Now += Costs[item];
+		};
+	}
+};
+
+TEST(TimeSlicer, FitsItemsInTheBudget)
+{
+	FakeWork work;
+	work.Costs.assign(8, 100);
+	TimeSlicer slicer(work.Clock());
+	slicer.Start(8);
+
+	//Nothing is timed at first, so the first item is guessed at nothing
+	EXPECT_FALSE(slicer.Update(350, work.Item()));
+	EXPECT_EQ(3u, slicer.GetLastSliceItems());
+	EXPECT_EQ(300u, slicer.GetLastSliceMicroseconds());
+	EXPECT_EQ(100u, slicer.PredictCost(7));
+
+	EXPECT_FALSE(slicer.Update(350, work.Item()));
+	EXPECT_EQ(3u, slicer.GetLastSliceItems());
+	EXPECT_TRUE(slicer.Update(350, work.Item()));
+	EXPECT_EQ(2u, slicer.GetLastSliceItems());
+	EXPECT_FALSE(slicer.IsRunning());
+	EXPECT_EQ(3u, slicer.GetLastPassSlices());
+
+	//Done, so further updates run nothing
+	EXPECT_FALSE(slicer.Update(350, work.Item()));
+	EXPECT_EQ(0u, slicer.GetLastSliceItems());
+	EXPECT_EQ((std::vector<unsigned int>{ 0, 1, 2, 3, 4, 5, 6, 7 }), work.Ran);
+}
+
+TEST(TimeSlicer, RunsAtLeastOneItem)
+{
+	FakeWork work;
+	work.Costs.assign(4, 1000);
+	TimeSlicer slicer(work.Clock());
+	slicer.Start(4);
+	for (int i = 0; i < 3; i++)
+	{
+		EXPECT_FALSE(slicer.Update(100, work.Item()));
+		EXPECT_EQ(1u, slicer.GetLastSliceItems());
+		EXPECT_EQ(1000u, slicer.GetLastSliceMicroseconds());
+	}
+	EXPECT_TRUE(slicer.Update(0, work.Item()));
+	EXPECT_EQ(4u, slicer.GetLastPassSlices());
+}
+
+TEST(TimeSlicer, CostsCarryOverToTheSameItems)
+{
+	FakeWork work;
+	work.Costs = { 50, 400, 50, 50, 400, 50 };
+	TimeSlicer slicer(work.Clock());
+	slicer.Start(6);
+	while (!slicer.Update(1000000, work.Item()))
+		;
+
+	//Each item's own cost now, so the slices fill the budget exactly
+	slicer.Start(6);
+	EXPECT_EQ(400u, slicer.PredictCost(1));
+	std::vector<unsigned int> sliceItems;
+	while (slicer.IsRunning())
+	{
+		slicer.Update(500, work.Item());
+		sliceItems.push_back(slicer.GetLastSliceItems());
+	}
+	EXPECT_EQ((std::vector<unsigned int>{ 3, 3 }), sliceItems);
+
+	//Different items, so it starts over
+	slicer.Start(5);
+	EXPECT_EQ(0u, slicer.PredictCost(1));
+}
+
+TEST(TimeSlicer, CancelEndsThePass)
+{
+	FakeWork work;
+	work.Costs.assign(4, 100);
+	TimeSlicer slicer(work.Clock());
+	slicer.Start(4);
+	slicer.Update(250, work.Item());
+	EXPECT_EQ(2u, slicer.GetNextItem());
+
+	slicer.Cancel();
+	EXPECT_FALSE(slicer.IsRunning());
+	EXPECT_FALSE(slicer.Update(250, work.Item()));
+	EXPECT_EQ(2u, work.Ran.size());
+	EXPECT_EQ(0u, slicer.GetLastPassSlices());
+}
+
+// Items queued for the GPU take no time on the clock, and their costs come back a slice
+// later, the way the sky's timestamps do
+TEST(TimeSlicer, DeferredCostsAreChargedWhenReported)
+{
+	FakeWork work;
+	TimeSlicer slicer(work.Clock());
+	const uint64_t gpuCost = 300;
+	std::vector<unsigned int> queued;
+	auto queue = [&](unsigned int item)
+	{
+		queued.push_back(item);
+		slicer.DeferCost();
+	};
+	auto update = [&]()
+	{
+		std::vector<unsigned int> finished;
+		finished.swap(queued);
+		for (unsigned int item : finished)
+			slicer.ReportCost(item, gpuCost);
+		return slicer.Update(1000, queue);
+	};
+
+	//Nothing reported to guess from, so each slice stops after its first item
+	slicer.Start(6);
+	EXPECT_FALSE(update());
+	EXPECT_EQ(1u, slicer.GetLastSliceItems());
+	EXPECT_EQ(1000u, slicer.GetLastSliceMicroseconds());
+
+	//Then the rest are guessed at the reported cost
+	EXPECT_FALSE(update());
+	EXPECT_EQ(3u, slicer.GetLastSliceItems());
+	EXPECT_EQ(900u, slicer.GetLastSliceMicroseconds());
+	EXPECT_TRUE(update());
+	EXPECT_EQ(2u, slicer.GetLastSliceItems());
+	EXPECT_EQ(3u, slicer.GetLastPassSlices());
+
+	//The second pass knows every item's cost
+	update();
+	slicer.Start(6);
+	EXPECT_EQ(gpuCost, slicer.PredictCost(5));
+	EXPECT_FALSE(update());
+	EXPECT_EQ(3u, slicer.GetLastSliceItems());
+	EXPECT_TRUE(update());
+	EXPECT_EQ(2u, slicer.GetLastPassSlices());
+
+	//Reports for items a smaller pass doesn't have are dropped
+	slicer.Start(2);
+	slicer.ReportCost(5, gpuCost);
+	EXPECT_EQ(0u, slicer.PredictCost(1));
+}
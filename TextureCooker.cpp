@@ -0,0 +1,727 @@
+#include "TextureCooker.h"
+#include "DDSFile.h"
+#include "TextureResidency.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+using namespace std;
+
+// Mode 6 interpolation weights, out of 64
+static const int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Packs fields into a block least significant bit first, as BC7 lays them out
+struct BlockBits
+{
+	uint8_t* Bytes;
+	unsigned int Position;
+
+	void Write(unsigned int value, unsigned int count)
+	{
+		for (unsigned int i = 0; i < count; i++, Position++)
+		{
+			if (value & (1u << i))
+				Bytes[Position >> 3] |= (uint8_t)(1u << (Position & 7));
+		}
+	}
+
+	unsigned int Read(unsigned int count)
+	{
+		unsigned int value = 0;
+		for (unsigned int i = 0; i < count; i++, Position++)
+			value |= ((Bytes[Position >> 3] >> (Position & 7)) & 1u) << i;
+		return value;
+	}
+};
+
+// A quantized mode 6 block: 7 bit endpoints, a p-bit per endpoint and an index per pixel
+struct Mode6Block
+{
+	int Endpoints[2][4];
+	int PBits[2];
+	int Indices[16];
+	float Error;
+};
+
+static int InterpolateBC7(int e0, int e1, int weight)
+{
+	return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+}
+
+// Quantizes float endpoints with each p-bit pairing and picks the best indices for each
+static void FitMode6(const uint8_t pixels[64], const float e0[4], const float e1[4], Mode6Block& best)
+{
+	best.Error = numeric_limits<float>::max();
+	for (int pbits = 0; pbits < 4; pbits++)
+	{
+		Mode6Block candidate;
+		candidate.PBits[0] = pbits & 1;
+		candidate.PBits[1] = pbits >> 1;
+		candidate.Error = 0;
+
+		int palette[16][4];
+		int low[4];
+		int span[4];
+		int spanSquared = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			candidate.Endpoints[0][c] = min(max((int)floorf((e0[c] - candidate.PBits[0]) * 0.5f + 0.5f), 0), 127);
+			candidate.Endpoints[1][c] = min(max((int)floorf((e1[c] - candidate.PBits[1]) * 0.5f + 0.5f), 0), 127);
+			low[c] = (candidate.Endpoints[0][c] << 1) | candidate.PBits[0];
+			int high = (candidate.Endpoints[1][c] << 1) | candidate.PBits[1];
+			span[c] = high - low[c];
+			spanSquared += span[c] * span[c];
+			for (int i = 0; i < 16; i++)
+				palette[i][c] = InterpolateBC7(low[c], high, bc7Weights[i]);
+		}
+
+		for (int p = 0; p < 16; p++)
+		{
+			//Project onto the endpoint line for a first guess, then check its neighbors
+			int guess = 0;
+			if (spanSquared > 0)
+			{
+				int dot = 0;
+				for (int c = 0; c < 4; c++)
+					dot += (pixels[p * 4 + c] - low[c]) * span[c];
+				guess = min(max((int)floorf(dot * 15.0f / spanSquared + 0.5f), 0), 15);
+			}
+
+			int bestIndex = 0;
+			int bestError = numeric_limits<int>::max();
+			for (int i = max(guess - 1, 0); i <= min(guess + 1, 15); i++)
+			{
+				int error = 0;
+				for (int c = 0; c < 4; c++)
+				{
+					int d = palette[i][c] - pixels[p * 4 + c];
+					error += d * d;
+				}
+				if (error < bestError)
+				{
+					bestError = error;
+					bestIndex = i;
+				}
+			}
+			candidate.Indices[p] = bestIndex;
+			candidate.Error += bestError;
+		}
+
+		if (candidate.Error < best.Error)
+			best = candidate;
+	}
+}
+
+// Least squares endpoints for a fixed set of indices.  Returns false if they're degenerate.
+static bool RefitMode6(const uint8_t pixels[64], const Mode6Block& block, float e0[4], float e1[4])
+{
+	float aa = 0, ab = 0, bb = 0;
+	float xa[4] = {};
+	float xb[4] = {};
+	for (int p = 0; p < 16; p++)
+	{
+		float w = bc7Weights[block.Indices[p]] / 64.0f;
+		aa += (1 - w) * (1 - w);
+		ab += (1 - w) * w;
+		bb += w * w;
+		for (int c = 0; c < 4; c++)
+		{
+			xa[c] += (1 - w) * pixels[p * 4 + c];
+			xb[c] += w * pixels[p * 4 + c];
+		}
+	}
+
+	float det = aa * bb - ab * ab;
+	if (fabsf(det) < 1e-6f)
+		return false;
+
+	for (int c = 0; c < 4; c++)
+	{
+		e0[c] = min(max((bb * xa[c] - ab * xb[c]) / det, 0.0f), 255.0f);
+		e1[c] = min(max((aa * xb[c] - ab * xa[c]) / det, 0.0f), 255.0f);
+	}
+	return true;
+}
+
+void TextureCooker::EncodeBC7Block(const uint8_t pixels[64], uint8_t block[16])
+{
+	//Principal axis of the block's colors, by power iteration on the covariance
+	float mean[4] = {};
+	for (int p = 0; p < 16; p++)
+		for (int c = 0; c < 4; c++)
+			mean[c] += pixels[p * 4 + c] / 16.0f;
+
+	float covariance[4][4] = {};
+	for (int p = 0; p < 16; p++)
+	{
+		float d[4];
+		for (int c = 0; c < 4; c++)
+			d[c] = pixels[p * 4 + c] - mean[c];
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				covariance[i][j] += d[i] * d[j];
+	}
+
+	float axis[4] = { 1, 1, 1, 1 };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				next[i] += covariance[i][j] * axis[j];
+
+		float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+		if (length < 1e-6f)
+			break;
+		for (int c = 0; c < 4; c++)
+			axis[c] = next[c] / length;
+	}
+
+	float tMin = numeric_limits<float>::max();
+	float tMax = -numeric_limits<float>::max();
+	for (int p = 0; p < 16; p++)
+	{
+		float t = 0;
+		for (int c = 0; c < 4; c++)
+			t += (pixels[p * 4 + c] - mean[c]) * axis[c];
+		tMin = min(tMin, t);
+		tMax = max(tMax, t);
+	}
+
+	float e0[4];
+	float e1[4];
+	for (int c = 0; c < 4; c++)
+	{
+		e0[c] = min(max(mean[c] + tMin * axis[c], 0.0f), 255.0f);
+		e1[c] = min(max(mean[c] + tMax * axis[c], 0.0f), 255.0f);
+	}
+
+	Mode6Block best;
+	FitMode6(pixels, e0, e1, best);
+
+	//A couple of least squares passes, kept only when they help
+	Mode6Block current = best;
+	for (int iteration = 0; iteration < 2 && best.Error > 0; iteration++)
+	{
+		if (!RefitMode6(pixels, current, e0, e1))
+			break;
+
+		FitMode6(pixels, e0, e1, current);
+		if (current.Error < best.Error)
+			best = current;
+	}
+
+	//The first pixel's index is stored with its top bit implied zero
+	if (best.Indices[0] >= 8)
+	{
+		for (int c = 0; c < 4; c++)
+			swap(best.Endpoints[0][c], best.Endpoints[1][c]);
+		swap(best.PBits[0], best.PBits[1]);
+		for (int p = 0; p < 16; p++)
+			best.Indices[p] = 15 - best.Indices[p];
+	}
+
+	memset(block, 0, 16);
+	BlockBits bits = { block, 0 };
+	bits.Write(1u << 6, 7);
+	for (int c = 0; c < 4; c++)
+	{
+		bits.Write(best.Endpoints[0][c], 7);
+		bits.Write(best.Endpoints[1][c], 7);
+	}
+	bits.Write(best.PBits[0], 1);
+	bits.Write(best.PBits[1], 1);
+	for (int p = 0; p < 16; p++)
+		bits.Write(best.Indices[p], p == 0 ? 3 : 4);
+}
+
+void TextureCooker::DecodeBC7Block(const uint8_t block[16], uint8_t pixels[64])
+{
+	uint8_t copy[16];
+	memcpy(copy, block, 16);
+	BlockBits bits = { copy, 0 };
+
+	//Only mode 6 is written here, anything else decodes to black
+	if (bits.Read(7) != (1u << 6))
+	{
+		memset(pixels, 0, 64);
+		return;
+	}
+
+	int endpoints[2][4];
+	for (int c = 0; c < 4; c++)
+	{
+		endpoints[0][c] = bits.Read(7);
+		endpoints[1][c] = bits.Read(7);
+	}
+	int p0 = bits.Read(1);
+	int p1 = bits.Read(1);
+
+	for (int p = 0; p < 16; p++)
+	{
+		int index = bits.Read(p == 0 ? 3 : 4);
+		for (int c = 0; c < 4; c++)
+			pixels[p * 4 + c] = (uint8_t)InterpolateBC7((endpoints[0][c] << 1) | p0, (endpoints[1][c] << 1) | p1, bc7Weights[index]);
+	}
+}
+
+// The eight values a BC4 block can produce.  Red0 > red1 interpolates six values
+// between them, otherwise four with 0 and 255 at the end.
+static void BC4Palette(int red0, int red1, int palette[8])
+{
+	palette[0] = red0;
+	palette[1] = red1;
+	if (red0 > red1)
+	{
+		for (int i = 2; i < 8; i++)
+			palette[i] = (int)floorf(((8 - i) * red0 + (i - 1) * red1) / 7.0f + 0.5f);
+	}
+	else
+	{
+		for (int i = 2; i < 6; i++)
+			palette[i] = (int)floorf(((6 - i) * red0 + (i - 1) * red1) / 5.0f + 0.5f);
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+static int FitBC4(const uint8_t values[16], int red0, int red1, int indices[16])
+{
+	int palette[8];
+	BC4Palette(red0, red1, palette);
+
+	int total = 0;
+	for (int p = 0; p < 16; p++)
+	{
+		int bestIndex = 0;
+		int bestError = numeric_limits<int>::max();
+		for (int i = 0; i < 8; i++)
+		{
+			int d = palette[i] - values[p];
+			if (d * d < bestError)
+			{
+				bestError = d * d;
+				bestIndex = i;
+			}
+		}
+		indices[p] = bestIndex;
+		total += bestError;
+	}
+	return total;
+}
+
+void TextureCooker::EncodeBC4Block(const uint8_t values[16], uint8_t block[8])
+{
+	int low = 255;
+	int high = 0;
+	int innerLow = 255;
+	int innerHigh = 0;
+	for (int p = 0; p < 16; p++)
+	{
+		low = min(low, (int)values[p]);
+		high = max(high, (int)values[p]);
+
+		//The six value mode has 0 and 255 for free, so fit between the rest
+		if (values[p] != 0 && values[p] != 255)
+		{
+			innerLow = min(innerLow, (int)values[p]);
+			innerHigh = max(innerHigh, (int)values[p]);
+		}
+	}
+	if (innerLow > innerHigh)
+		innerLow = innerHigh = low;
+
+	int red0 = high;
+	int red1 = low;
+	int indices[16];
+	int error = FitBC4(values, red0, red1, indices);
+
+	int sixIndices[16];
+	int sixError = FitBC4(values, innerLow, innerHigh, sixIndices);
+	if (sixError < error)
+	{
+		red0 = innerLow;
+		red1 = innerHigh;
+		memcpy(indices, sixIndices, sizeof(indices));
+	}
+
+	memset(block, 0, 8);
+	BlockBits bits = { block, 0 };
+	bits.Write(red0, 8);
+	bits.Write(red1, 8);
+	for (int p = 0; p < 16; p++)
+		bits.Write(indices[p], 3);
+}
+
+void TextureCooker::DecodeBC4Block(const uint8_t block[8], uint8_t values[16])
+{
+	uint8_t copy[8];
+	memcpy(copy, block, 8);
+	BlockBits bits = { copy, 0 };
+
+	int red0 = bits.Read(8);
+	int red1 = bits.Read(8);
+	int palette[8];
+	BC4Palette(red0, red1, palette);
+	for (int p = 0; p < 16; p++)
+		values[p] = (uint8_t)palette[bits.Read(3)];
+}
+
+bool TextureCooker::ChooseFormat(const std::string& name, CookedFormat& format)
+{
+	struct Suffix
+	{
+		const char* Text;
+		CookedFormat Format;
+	};
+	static const Suffix suffixes[] =
+	{
+		{ "_albedo", COOKED_BC7 },
+		{ "_normals", COOKED_BC5 },
+		{ "_roughness", COOKED_BC4 },
+		{ "_metal", COOKED_BC4 },
+		{ "_ao", COOKED_BC4 },
+	};
+
+	for (auto& suffix : suffixes)
+	{
+		size_t length = strlen(suffix.Text);
+		if (name.size() >= length && name.compare(name.size() - length, length, suffix.Text) == 0)
+		{
+			format = suffix.Format;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Normals are renormalized at every mip, since averaging shortens them
+static void RenormalizeNormals(std::vector<uint8_t>& rgba)
+{
+	for (size_t i = 0; i < rgba.size(); i += 4)
+	{
+		float n[3];
+		for (int c = 0; c < 3; c++)
+			n[c] = rgba[i + c] / 255.0f * 2.0f - 1.0f;
+
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length < 1e-6f)
+		{
+			n[0] = n[1] = 0;
+			n[2] = length = 1;
+		}
+		for (int c = 0; c < 3; c++)
+			rgba[i + c] = (uint8_t)floorf((n[c] / length * 0.5f + 0.5f) * 255.0f + 0.5f);
+	}
+}
+
+void TextureCooker::Cook(const uint8_t* rgba, unsigned int width, unsigned int height, CookedFormat format, CookedTexture& cooked, unsigned int threadCount)
+{
+	cooked.Width = width;
+	cooked.Height = height;
+	cooked.MipCount = TextureResidency::MipCountFor(width, height);
+	cooked.Format = format;
+
+	size_t totalBytes = 0;
+	for (unsigned int mip = 0; mip < cooked.MipCount; mip++)
+		totalBytes += MipBytes(format, width, height, mip);
+	cooked.Data.assign(totalBytes, 0);
+
+	if (threadCount == 0)
+		threadCount = max(thread::hardware_concurrency(), 1u);
+
+	vector<uint8_t> level(rgba, rgba + (size_t)width * height * 4);
+	if (format == COOKED_BC5)
+		RenormalizeNormals(level);
+
+	size_t offset = 0;
+	unsigned int levelWidth = width;
+	unsigned int levelHeight = height;
+	for (unsigned int mip = 0; mip < cooked.MipCount; mip++)
+	{
+		EncodeMip(level.data(), levelWidth, levelHeight, format, &cooked.Data[offset], threadCount);
+		offset += MipBytes(format, width, height, mip);
+
+		if (mip + 1 == cooked.MipCount)
+			break;
+
+		vector<uint8_t> half;
+		DownsampleRGBA8(level.data(), levelWidth, levelHeight, half);
+		if (format == COOKED_BC5)
+			RenormalizeNormals(half);
+		level.swap(half);
+		levelWidth = max(levelWidth / 2, 1u);
+		levelHeight = max(levelHeight / 2, 1u);
+	}
+}
+
+void TextureCooker::EncodeMip(const uint8_t* rgba, unsigned int width, unsigned int height, CookedFormat format, uint8_t* blocks, unsigned int threadCount)
+{
+	unsigned int blocksWide = (width + 3) / 4;
+	unsigned int blocksHigh = (height + 3) / 4;
+	unsigned int blockCount = blocksWide * blocksHigh;
+	unsigned int blockBytes = BlockBytes(format);
+
+	//Workers pull small batches of blocks until the mip is done
+	const unsigned int batchSize = 16;
+	atomic<unsigned int> nextBlock(0);
+	auto work = [&]() {
+		for (;;)
+		{
+			unsigned int first = nextBlock.fetch_add(batchSize);
+			if (first >= blockCount)
+				return;
+
+			unsigned int last = min(first + batchSize, blockCount);
+			for (unsigned int b = first; b < last; b++)
+			{
+				unsigned int bx = b % blocksWide;
+				unsigned int by = b / blocksWide;
+
+				//Blocks hanging off the edge of small mips repeat the edge pixels
+				uint8_t pixels[64];
+				for (unsigned int y = 0; y < 4; y++)
+				{
+					unsigned int sy = min(by * 4 + y, height - 1);
+					for (unsigned int x = 0; x < 4; x++)
+					{
+						unsigned int sx = min(bx * 4 + x, width - 1);
+						memcpy(&pixels[(y * 4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+					}
+				}
+				EncodeBlock(pixels, format, blocks + (size_t)b * blockBytes);
+			}
+		}
+	};
+
+	unsigned int workerCount = min(threadCount, (blockCount + batchSize - 1) / batchSize);
+	vector<thread> workers;
+	for (unsigned int i = 1; i < workerCount; i++)
+		workers.emplace_back(work);
+	work();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void TextureCooker::EncodeBlock(const uint8_t pixels[64], CookedFormat format, uint8_t* block)
+{
+	if (format == COOKED_BC7)
+	{
+		EncodeBC7Block(pixels, block);
+		return;
+	}
+
+	uint8_t channel[16];
+	for (int p = 0; p < 16; p++)
+		channel[p] = pixels[p * 4];
+	EncodeBC4Block(channel, block);
+
+	if (format == COOKED_BC5)
+	{
+		for (int p = 0; p < 16; p++)
+			channel[p] = pixels[p * 4 + 1];
+		EncodeBC4Block(channel, block + 8);
+	}
+}
+
+size_t TextureCooker::MipBytes(CookedFormat format, unsigned int width, unsigned int height, unsigned int mip)
+{
+	size_t blocksWide = (max(width >> mip, 1u) + 3) / 4;
+	size_t blocksHigh = (max(height >> mip, 1u) + 3) / 4;
+	return blocksWide * blocksHigh * BlockBytes(format);
+}
+
+uint32_t TextureCooker::DXGIFormat(CookedFormat format)
+{
+	//DXGI_FORMAT_BC7_UNORM, DXGI_FORMAT_BC5_UNORM and DXGI_FORMAT_BC4_UNORM
+	switch (format)
+	{
+	case COOKED_BC7: return 98;
+	case COOKED_BC5: return 83;
+	default: return 80;
+	}
+}
+
+bool TextureCooker::WriteDDS(const std::string& path, const CookedTexture& cooked)
+{
+	DDSDescription description = { DXGIFormat(cooked.Format), cooked.Width, cooked.Height, cooked.MipCount, 1, false };
+	return DDSFile::Write(path, description, cooked.Data.data(), cooked.Data.size());
+}
+
+void TextureCooker::CookCube(const uint8_t* faces, unsigned int size, CookedFormat format, CookedTexture cookedFaces[6], unsigned int threadCount)
+{
+	//Each face already spreads its blocks over every thread
+	size_t faceBytes = (size_t)size * size * 4;
+	for (int face = 0; face < 6; face++)
+		Cook(faces + face * faceBytes, size, size, format, cookedFaces[face], threadCount);
+}
+
+bool TextureCooker::CookCube(const PackSource faces[6], CookedFormat format, CookedTexture cookedFaces[6], unsigned int threadCount)
+{
+	unsigned int size = faces[0].Width;
+	vector<uint8_t> packed;
+	for (int face = 0; face < 6; face++)
+	{
+		if (!faces[face].Pixels || faces[face].Width != size || faces[face].Height != size)
+			return false;
+		packed.insert(packed.end(), faces[face].Pixels, faces[face].Pixels + (size_t)size * size * 4);
+	}
+
+	CookCube(packed.data(), size, format, cookedFaces, threadCount);
+	return true;
+}
+
+bool TextureCooker::WriteCubeDDS(const std::string& path, const CookedTexture cookedFaces[6])
+{
+	//DDS cubes hold each face's whole mip chain in turn, which is how the faces were cooked
+	vector<uint8_t> data;
+	for (int face = 0; face < 6; face++)
+		data.insert(data.end(), cookedFaces[face].Data.begin(), cookedFaces[face].Data.end());
+
+	const CookedTexture& first = cookedFaces[0];
+	DDSDescription description = { DXGIFormat(first.Format), first.Width, first.Height, first.MipCount, 6, true };
+	return DDSFile::Write(path, description, data.data(), data.size());
+}
+
+void TextureCooker::Decode(const CookedTexture& cooked, unsigned int mip, std::vector<uint8_t>& rgba)
+{
+	size_t offset = 0;
+	for (unsigned int m = 0; m < mip; m++)
+		offset += MipBytes(cooked.Format, cooked.Width, cooked.Height, m);
+
+	DecodeBlocks(&cooked.Data[offset], cooked.Format, max(cooked.Width >> mip, 1u), max(cooked.Height >> mip, 1u), rgba);
+}
+
+void TextureCooker::DecodeBlocks(const uint8_t* blocks, CookedFormat format, unsigned int width, unsigned int height, std::vector<uint8_t>& rgba)
+{
+	unsigned int blocksWide = (width + 3) / 4;
+	unsigned int blocksHigh = (height + 3) / 4;
+	rgba.assign((size_t)width * height * 4, 0);
+
+	for (unsigned int by = 0; by < blocksHigh; by++)
+	{
+		for (unsigned int bx = 0; bx < blocksWide; bx++)
+		{
+			const uint8_t* block = blocks + ((size_t)by * blocksWide + bx) * BlockBytes(format);
+			uint8_t pixels[64] = {};
+			if (format == COOKED_BC7)
+				DecodeBC7Block(block, pixels);
+			else
+			{
+				uint8_t red[16];
+				uint8_t green[16] = {};
+				DecodeBC4Block(block, red);
+				if (format == COOKED_BC5)
+					DecodeBC4Block(block + 8, green);
+
+				for (int p = 0; p < 16; p++)
+				{
+					pixels[p * 4 + 0] = red[p];
+					pixels[p * 4 + 1] = green[p];
+					pixels[p * 4 + 3] = 255;
+					if (format == COOKED_BC5)
+					{
+						float x = red[p] / 255.0f * 2.0f - 1.0f;
+						float y = green[p] / 255.0f * 2.0f - 1.0f;
+						float z = sqrtf(max(1.0f - x * x - y * y, 0.0f));
+						pixels[p * 4 + 2] = (uint8_t)floorf((z * 0.5f + 0.5f) * 255.0f + 0.5f);
+					}
+				}
+			}
+
+			for (unsigned int y = 0; y < 4 && by * 4 + y < height; y++)
+				for (unsigned int x = 0; x < 4 && bx * 4 + x < width; x++)
+					memcpy(&rgba[(((size_t)by * 4 + y) * width + bx * 4 + x) * 4], &pixels[(y * 4 + x) * 4], 4);
+		}
+	}
+}
+
+double TextureCooker::PSNR(const uint8_t* a, const uint8_t* b, unsigned int pixelCount, unsigned int channelCount)
+{
+	double squaredError = 0;
+	for (unsigned int p = 0; p < pixelCount; p++)
+	{
+		for (unsigned int c = 0; c < channelCount; c++)
+		{
+			double d = (double)a[p * 4 + c] - b[p * 4 + c];
+			squaredError += d * d;
+		}
+	}
+
+	double mse = squaredError / ((double)pixelCount * channelCount);
+	if (mse == 0)
+		return numeric_limits<double>::infinity();
+	return 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+void TextureCooker::PackChannels(const PackSource* sources, unsigned int sourceCount, std::vector<uint8_t>& rgba, unsigned int& width, unsigned int& height)
+{
+	width = 1;
+	height = 1;
+	for (unsigned int i = 0; i < sourceCount; i++)
+	{
+		if (!sources[i].Pixels)
+			continue;
+		width = max(width, sources[i].Width);
+		height = max(height, sources[i].Height);
+	}
+
+	rgba.assign((size_t)width * height * 4, 255);
+	for (unsigned int i = 0; i < sourceCount && i < 4; i++)
+	{
+		const PackSource& source = sources[i];
+		if (!source.Pixels)
+			continue;
+
+		for (unsigned int y = 0; y < height; y++)
+		{
+			//Texel centers line up, as they would when sampling the smaller map on its own
+			float sy = max((y + 0.5f) * source.Height / height - 0.5f, 0.0f);
+			unsigned int y0 = min((unsigned int)sy, source.Height - 1);
+			unsigned int y1 = min(y0 + 1, source.Height - 1);
+			float fy = sy - y0;
+
+			for (unsigned int x = 0; x < width; x++)
+			{
+				float sx = max((x + 0.5f) * source.Width / width - 0.5f, 0.0f);
+				unsigned int x0 = min((unsigned int)sx, source.Width - 1);
+				unsigned int x1 = min(x0 + 1, source.Width - 1);
+				float fx = sx - x0;
+
+				float top = source.Pixels[((size_t)y0 * source.Width + x0) * 4] * (1 - fx) + source.Pixels[((size_t)y0 * source.Width + x1) * 4] * fx;
+				float bottom = source.Pixels[((size_t)y1 * source.Width + x0) * 4] * (1 - fx) + source.Pixels[((size_t)y1 * source.Width + x1) * 4] * fx;
+				rgba[((size_t)y * width + x) * 4 + i] = (uint8_t)floorf(top * (1 - fy) + bottom * fy + 0.5f);
+			}
+		}
+	}
+}
+
+void TextureCooker::DownsampleRGBA8(const uint8_t* rgba, unsigned int width, unsigned int height, std::vector<uint8_t>& half)
+{
+	unsigned int halfWidth = max(width / 2, 1u);
+	unsigned int halfHeight = max(height / 2, 1u);
+	half.resize((size_t)halfWidth * halfHeight * 4);
+
+	for (unsigned int y = 0; y < halfHeight; y++)
+	{
+		unsigned int y0 = min(y * 2, height - 1);
+		unsigned int y1 = min(y * 2 + 1, height - 1);
+		for (unsigned int x = 0; x < halfWidth; x++)
+		{
+			unsigned int x0 = min(x * 2, width - 1);
+			unsigned int x1 = min(x * 2 + 1, width - 1);
+			for (unsigned int c = 0; c < 4; c++)
+			{
+				unsigned int sum =
+					rgba[((size_t)y0 * width + x0) * 4 + c] +
+					rgba[((size_t)y0 * width + x1) * 4 + c] +
+					rgba[((size_t)y1 * width + x0) * 4 + c] +
+					rgba[((size_t)y1 * width + x1) * 4 + c];
+				half[((size_t)y * halfWidth + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+			}
+		}
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Block compressed formats textures are cooked to, by what they hold
+enum CookedFormat
+{
+	COOKED_BC7,	// Color, RGBA
+	COOKED_BC5,	// Tangent space normals, XY with Z rebuilt in the shader
+	COOKED_BC4,	// Single channel maps, from red
+	COOKED_FORMAT_COUNT
+};
+
+// One input to channel packing.  Null pixels stand for a missing, all white map.
+struct PackSource
+{
+	const uint8_t* Pixels;
+	unsigned int Width;
+	unsigned int Height;
+};
+
+// A texture and its full mip chain, blocks for each mip packed one after another
+struct CookedTexture
+{
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int MipCount;
+	CookedFormat Format;
+	std::vector<uint8_t> Data;
+};
+
+// Converts RGBA8 images into block compressed DDS files with precomputed mips, so
+// they load without decoding or mip generation.  Plain C++ with no D3D or WIC, so
+// it builds and can be checked anywhere.
+//
+// BC7 uses mode 6 only (one subset, 7777 endpoints with p-bits, 4 bit indices),
+// fit along the block's principal axis and refined with a least squares pass.
+class TextureCooker
+{
+public:
+	// Picks the format from the name's suffix (_albedo, _normals, _roughness, _metal or
+	// _ao).  Returns false for textures that aren't cooked.
+	static bool ChooseFormat(const std::string& name, CookedFormat& format);
+
+	// Encodes blocks on threadCount threads, all hardware threads when zero
+	static void Cook(const uint8_t* rgba, unsigned int width, unsigned int height, CookedFormat format, CookedTexture& cooked, unsigned int threadCount = 0);
+	static bool WriteDDS(const std::string& path, const CookedTexture& cooked);
+
+	// Cooks six square faces, tightly packed in D3D's face order, each with its own full
+	// mip chain.  Faces are filtered on their own, so mips don't blend across edges.
+	static void CookCube(const uint8_t* faces, unsigned int size, CookedFormat format, CookedTexture cookedFaces[6], unsigned int threadCount = 0);
+	// The same for six separate images, as a sky's faces are decoded.  Returns false
+	// unless they're all the same square size.
+	static bool CookCube(const PackSource faces[6], CookedFormat format, CookedTexture cookedFaces[6], unsigned int threadCount = 0);
+	static bool WriteCubeDDS(const std::string& path, const CookedTexture cookedFaces[6]);
+
+	// Packs the red channel of up to four maps into one RGBA8 image, roughness/metal/AO
+	// style.  Smaller maps are bilinearly scaled up to the largest one's size.
+	static void PackChannels(const PackSource* sources, unsigned int sourceCount, std::vector<uint8_t>& rgba, unsigned int& width, unsigned int& height);
+
+	// Decodes one mip back to RGBA8, for checking quality.  Unused channels are 0, or
+	// 255 for alpha, and BC5 rebuilds Z into blue.
+	static void Decode(const CookedTexture& cooked, unsigned int mip, std::vector<uint8_t>& rgba);
+	// The same for one mip's blocks from anywhere, a DDS file's for instance
+	static void DecodeBlocks(const uint8_t* blocks, CookedFormat format, unsigned int width, unsigned int height, std::vector<uint8_t>& rgba);
+	// Over the first channelCount channels of two RGBA8 images
+	static double PSNR(const uint8_t* a, const uint8_t* b, unsigned int pixelCount, unsigned int channelCount);
+
+	// Box filters to half size, rounding sizes down like D3D mips
+	static void DownsampleRGBA8(const uint8_t* rgba, unsigned int width, unsigned int height, std::vector<uint8_t>& half);
+
+	static unsigned int BlockBytes(CookedFormat format) { return format == COOKED_BC4 ? 8 : 16; }
+	static size_t MipBytes(CookedFormat format, unsigned int width, unsigned int height, unsigned int mip);
+	static uint32_t DXGIFormat(CookedFormat format);
+
+	static void EncodeBC7Block(const uint8_t pixels[64], uint8_t block[16]);
+	static void DecodeBC7Block(const uint8_t block[16], uint8_t pixels[64]);
+	static void EncodeBC4Block(const uint8_t values[16], uint8_t block[8]);
+	static void DecodeBC4Block(const uint8_t block[8], uint8_t values[16]);
+
+private:
+	static void EncodeMip(const uint8_t* rgba, unsigned int width, unsigned int height, CookedFormat format, uint8_t* blocks, unsigned int threadCount);
+	static void EncodeBlock(const uint8_t pixels[64], CookedFormat format, uint8_t* block);
+};
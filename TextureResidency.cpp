@@ -0,0 +1,244 @@
+#include "TextureResidency.h"
+#include <algorithm>
+
+using namespace std;
+
+TextureResidency::TextureResidency(uint64_t BudgetBytes, unsigned int TailSize, unsigned int MaxUpgradesPerUpdate)
+{
+	budget = BudgetBytes;
+	residentBytes = 0;
+	frame = 0;
+	tailSize = TailSize;
+	maxUpgradesPerUpdate = MaxUpgradesPerUpdate;
+}
+
+int TextureResidency::AddTexture(unsigned int width, unsigned int height, unsigned int bitsPerTexel, bool blockCompressed, int priority)
+{
+	Texture t;
+	t.Width = width;
+	t.Height = height;
+	t.BitsPerTexel = bitsPerTexel;
+	t.BlockCompressed = blockCompressed;
+	t.MipCount = MipCountFor(width, height);
+	t.TailMip = TailMipFor(width, height, tailSize);
+	t.ResidentMip = t.TailMip;
+	t.StartMip = t.TailMip;
+	t.RequestedMip = t.MipCount;
+	t.Priority = priority;
+	t.LastUsedFrame = frame;
+	t.Alive = true;
+
+	residentBytes += ChainBytes(t, t.ResidentMip);
+	textures.push_back(t);
+	return (int)textures.size() - 1;
+}
+
+void TextureResidency::RemoveTexture(int texture)
+{
+	Texture& t = textures[texture];
+	if (!t.Alive)
+		return;
+
+	residentBytes -= ChainBytes(t, t.ResidentMip);
+	t.Alive = false;
+}
+
+void TextureResidency::SetPriority(int texture, int priority)
+{
+	textures[texture].Priority = priority;
+}
+
+void TextureResidency::RequestMip(int texture, unsigned int mip)
+{
+	Texture& t = textures[texture];
+	t.RequestedMip = min(t.RequestedMip, min(mip, t.MipCount - 1));
+	t.LastUsedFrame = frame;
+}
+
+std::vector<TextureResidencyChange> TextureResidency::Update()
+{
+	for (auto& t : textures)
+		t.StartMip = t.ResidentMip;
+
+	//A lowered budget is met as far as the tails allow
+	if (residentBytes > budget)
+		Evict(residentBytes - budget, -1);
+
+	vector<int> upgrades;
+	for (int i = 0; i < (int)textures.size(); i++)
+	{
+		Texture& t = textures[i];
+		if (t.Alive && IsRequested(t) && t.RequestedMip < t.ResidentMip)
+			upgrades.push_back(i);
+	}
+
+	//Highest priority first, then the textures furthest from what they need
+	sort(upgrades.begin(), upgrades.end(), [this](int a, int b) {
+		Texture& ta = textures[a];
+		Texture& tb = textures[b];
+		if (ta.Priority != tb.Priority)
+			return ta.Priority > tb.Priority;
+		unsigned int gapA = ta.ResidentMip - ta.RequestedMip;
+		unsigned int gapB = tb.ResidentMip - tb.RequestedMip;
+		if (gapA != gapB)
+			return gapA > gapB;
+		return a < b;
+	});
+
+	unsigned int upgradeCount = 0;
+	for (int i : upgrades)
+	{
+		if (upgradeCount >= maxUpgradesPerUpdate)
+			break;
+
+		Texture& t = textures[i];
+		for (unsigned int target = t.RequestedMip; target < t.ResidentMip; target++)
+		{
+			uint64_t extra = ChainBytes(t, target) - ChainBytes(t, t.ResidentMip);
+			if (residentBytes + extra > budget && !Evict(residentBytes + extra - budget, i))
+				continue;
+
+			residentBytes += extra;
+			t.ResidentMip = target;
+			upgradeCount++;
+			break;
+		}
+	}
+
+	vector<TextureResidencyChange> changes;
+	for (int i = 0; i < (int)textures.size(); i++)
+	{
+		Texture& t = textures[i];
+		if (t.Alive && t.ResidentMip != t.StartMip)
+			changes.push_back({ i, t.StartMip, t.ResidentMip });
+		t.RequestedMip = t.MipCount;
+	}
+
+	frame++;
+	return changes;
+}
+
+unsigned int TextureResidency::MipCountFor(unsigned int width, unsigned int height)
+{
+	unsigned int size = max(width, height);
+	unsigned int count = 1;
+	while (size > 1)
+	{
+		size >>= 1;
+		count++;
+	}
+	return count;
+}
+
+unsigned int TextureResidency::TailMipFor(unsigned int width, unsigned int height, unsigned int tailSize)
+{
+	unsigned int mip = 0;
+	unsigned int lastMip = MipCountFor(width, height) - 1;
+	while (mip < lastMip && max(width >> mip, height >> mip) > tailSize)
+		mip++;
+	return mip;
+}
+
+uint64_t TextureResidency::MipChainBytes(unsigned int width, unsigned int height, unsigned int bitsPerTexel, bool blockCompressed, unsigned int firstMip)
+{
+	uint64_t bytes = 0;
+	unsigned int mipCount = MipCountFor(width, height);
+	for (unsigned int mip = firstMip; mip < mipCount; mip++)
+	{
+		uint64_t w = max(width >> mip, 1u);
+		uint64_t h = max(height >> mip, 1u);
+
+		//Block compressed mips are stored in whole 4x4 blocks
+		if (blockCompressed)
+		{
+			w = (w + 3) / 4 * 4;
+			h = (h + 3) / 4 * 4;
+		}
+		bytes += w * h * bitsPerTexel / 8;
+	}
+	return bytes;
+}
+
+uint64_t TextureResidency::ChainBytes(const Texture& t, unsigned int firstMip)
+{
+	return MipChainBytes(t.Width, t.Height, t.BitsPerTexel, t.BlockCompressed, firstMip);
+}
+
+bool TextureResidency::Evict(uint64_t bytes, int requester)
+{
+	//Each victim can be trimmed down to a floor mip, in tiers:
+	//  0 - not requested this frame, down to the tail
+	//  1 - requested, down to what was asked for
+	//  2 - requested at a lower priority than the requester, down to the tail
+	struct Victim
+	{
+		int Texture;
+		int Tier;
+		unsigned int FloorMip;
+	};
+
+	vector<Victim> victims;
+	for (int i = 0; i < (int)textures.size(); i++)
+	{
+		Texture& t = textures[i];
+		if (!t.Alive || i == requester)
+			continue;
+
+		if (!IsRequested(t))
+		{
+			victims.push_back({ i, 0, t.TailMip });
+			continue;
+		}
+
+		//A request coarser than the tail still keeps the tail
+		victims.push_back({ i, 1, min(t.RequestedMip, t.TailMip) });
+		if (requester >= 0 && t.Priority < textures[requester].Priority)
+			victims.push_back({ i, 2, t.TailMip });
+	}
+
+	sort(victims.begin(), victims.end(), [this](const Victim& a, const Victim& b) {
+		if (a.Tier != b.Tier)
+			return a.Tier < b.Tier;
+		Texture& ta = textures[a.Texture];
+		Texture& tb = textures[b.Texture];
+		if (ta.Priority != tb.Priority)
+			return ta.Priority < tb.Priority;
+		if (ta.LastUsedFrame != tb.LastUsedFrame)
+			return ta.LastUsedFrame < tb.LastUsedFrame;
+		return a.Texture < b.Texture;
+	});
+
+	//Plan a mip at a time, so victims only lose what is needed
+	vector<unsigned int> planned(textures.size());
+	for (int i = 0; i < (int)textures.size(); i++)
+		planned[i] = textures[i].ResidentMip;
+
+	uint64_t freed = 0;
+	for (auto& v : victims)
+	{
+		Texture& t = textures[v.Texture];
+		unsigned int& mip = planned[v.Texture];
+		while (mip < v.FloorMip && freed < bytes)
+		{
+			freed += ChainBytes(t, mip) - ChainBytes(t, mip + 1);
+			mip++;
+		}
+		if (freed >= bytes)
+			break;
+	}
+
+	//An upgrade that can't be made to fit shouldn't cost anyone their mips
+	if (freed < bytes && requester >= 0)
+		return false;
+
+	for (int i = 0; i < (int)textures.size(); i++)
+	{
+		Texture& t = textures[i];
+		if (planned[i] == t.ResidentMip)
+			continue;
+
+		residentBytes -= ChainBytes(t, t.ResidentMip) - ChainBytes(t, planned[i]);
+		t.ResidentMip = planned[i];
+	}
+	return freed >= bytes;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// A texture whose resident mips changed.  Everything from ToMip down to the
+// smallest mip should be in memory once the change is applied.
+struct TextureResidencyChange
+{
+	int Texture;
+	unsigned int FromMip;
+	unsigned int ToMip;
+};
+
+// Decides which mips of each streamed texture are resident, keeping the total under
+// a memory budget.  Only bookkeeping: the caller uploads or drops mips to match the
+// changes Update returns, so the policy can be driven by made up demand.
+//
+// Mip 0 is full resolution.  Each texture always keeps its tail (the mips no larger
+// than the tail size), and finer mips are added when requested.  When an upgrade
+// doesn't fit, textures not requested this frame are trimmed back to their tails,
+// lowest priority and least recently used first, then finer mips beyond what each
+// texture asked for, then lower priority textures.  An upgrade that still doesn't
+// fit settles for a coarser mip.
+class TextureResidency
+{
+public:
+	TextureResidency(uint64_t BudgetBytes, unsigned int TailSize = 64, unsigned int MaxUpgradesPerUpdate = 4);
+
+	// Returns the id of the new texture, which starts with only its tail resident
+	int AddTexture(unsigned int width, unsigned int height, unsigned int bitsPerTexel, bool blockCompressed, int priority = 0);
+	void RemoveTexture(int texture);
+	void SetPriority(int texture, int priority);
+
+	// Asks for a mip this frame, the most detailed request winning
+	void RequestMip(int texture, unsigned int mip);
+
+	// Ends the frame, returning the residency changes to apply
+	std::vector<TextureResidencyChange> Update();
+
+	unsigned int GetResidentMip(int texture) { return textures[texture].ResidentMip; }
+	unsigned int GetTailMip(int texture) { return textures[texture].TailMip; }
+	unsigned int GetMipCount(int texture) { return textures[texture].MipCount; }
+	uint64_t GetLastUsedFrame(int texture) { return textures[texture].LastUsedFrame; }
+	size_t GetTextureCount() { return textures.size(); }
+
+	uint64_t GetResidentBytes() { return residentBytes; }
+	uint64_t GetBudget() { return budget; }
+	// A lower budget is enforced at the next Update
+	void SetBudget(uint64_t bytes) { budget = bytes; }
+	uint64_t GetFrame() { return frame; }
+
+	static unsigned int MipCountFor(unsigned int width, unsigned int height);
+	static unsigned int TailMipFor(unsigned int width, unsigned int height, unsigned int tailSize);
+	// Size of the chain from firstMip down to 1x1
+	static uint64_t MipChainBytes(unsigned int width, unsigned int height, unsigned int bitsPerTexel, bool blockCompressed, unsigned int firstMip);
+
+private:
+	struct Texture
+	{
+		unsigned int Width;
+		unsigned int Height;
+		unsigned int BitsPerTexel;
+		bool BlockCompressed;
+		unsigned int MipCount;
+		unsigned int TailMip;
+		unsigned int ResidentMip;
+		unsigned int StartMip;
+		unsigned int RequestedMip;
+		int Priority;
+		uint64_t LastUsedFrame;
+		bool Alive;
+	};
+
+	uint64_t ChainBytes(const Texture& t, unsigned int firstMip);
+	bool IsRequested(const Texture& t) { return t.RequestedMip < t.MipCount; }
+	// Frees at least the given number of bytes.  Budget trims (no requester) free what they
+	// can, while upgrades free nothing unless enough can be.
+	bool Evict(uint64_t bytes, int requester);
+
+	std::vector<Texture> textures;
+	uint64_t budget;
+	uint64_t residentBytes;
+	uint64_t frame;
+	unsigned int tailSize;
+	unsigned int maxUpgradesPerUpdate;
+};
@@ -0,0 +1,120 @@
+#include "TimeSlicer.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+TimeSlicer::TimeSlicer(Clock TimeSource)
+	:
+	clock(TimeSource),
+	itemCount(0),
+	nextItem(0),
+	passSlices(0),
+	costDeferred(false),
+	costReported(false),
+	lastSliceItems(0),
+	lastSliceMicroseconds(0),
+	lastPassSlices(0)
+{
+	if (!clock)
+	{
+		clock = []()
+		{
+			return (uint64_t)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+		};
+	}
+}
+
+void TimeSlicer::Start(unsigned int count)
+{
+	//Different items, so nothing learned about the old ones applies
+	if (count != itemCount)
+	{
+		itemCosts.assign(count, 0);
+		itemTimed.assign(count, false);
+		costReported = false;
+	}
+
+	itemCount = count;
+	nextItem = 0;
+	passSlices = 0;
+}
+
+void TimeSlicer::Cancel()
+{
+	nextItem = itemCount;
+	passSlices = 0;
+}
+
+uint64_t TimeSlicer::PredictCost(unsigned int item)
+{
+	if (itemTimed[item])
+		return itemCosts[item];
+
+	uint64_t total = 0;
+	unsigned int timed = 0;
+	for (unsigned int i = 0; i < itemCount; i++)
+	{
+		if (itemTimed[i])
+		{
+			total += itemCosts[i];
+			timed++;
+		}
+	}
+	return timed ? total / timed : 0;
+}
+
+void TimeSlicer::ReportCost(unsigned int item, uint64_t microseconds)
+{
+	//Late reports from a pass over different items don't apply
+	if (item >= itemCount)
+		return;
+
+	itemCosts[item] = microseconds;
+	itemTimed[item] = true;
+	costReported = true;
+}
+
+bool TimeSlicer::Update(uint64_t budgetMicroseconds, const std::function<void(unsigned int)>& runItem)
+{
+	lastSliceItems = 0;
+	lastSliceMicroseconds = 0;
+	if (!IsRunning())
+		return false;
+
+	uint64_t elapsed = 0;
+	while (nextItem < itemCount)
+	{
+		if (lastSliceItems > 0 && elapsed + PredictCost(nextItem) > budgetMicroseconds)
+			break;
+
+		unsigned int item = nextItem++;
+		lastSliceItems++;
+		costDeferred = false;
+		uint64_t itemStart = clock();
+		runItem(item);
+		uint64_t itemEnd = clock();
+
+		if (!costDeferred)
+		{
+			itemCosts[item] = itemEnd - itemStart;
+			itemTimed[item] = true;
+			elapsed += itemEnd - itemStart;
+		}
+		else if (costReported)
+			elapsed += PredictCost(item);
+		else
+		{
+			elapsed = max(elapsed, budgetMicroseconds);
+			break;
+		}
+	}
+
+	lastSliceMicroseconds = elapsed;
+	passSlices++;
+	if (nextItem < itemCount)
+		return false;
+
+	lastPassSlices = passSlices;
+	return true;
+}
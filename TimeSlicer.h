@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Spreads a fixed list of work items over frames under a time budget.  Each item's cost
+// is remembered from the last time it ran (items nobody has timed yet are guessed at the
+// average), and an item predicted to go over the budget waits for the next frame.  At
+// least one item runs per Update, so a pass always finishes.
+//
+// Time comes from a clock that can be swapped out, so the scheduling can be driven by a
+// fake one without any rendering.  Work the clock can't see, like GPU passes that are
+// only queued, has its cost reported later instead.
+class TimeSlicer
+{
+public:
+	// Microseconds since any fixed point
+	typedef std::function<uint64_t()> Clock;
+
+	// Without a clock, std::chrono's steady_clock is used
+	TimeSlicer(Clock TimeSource = Clock());
+
+	// Begins a pass over items 0 to count - 1, dropping any pass in progress.  Costs
+	// learned for the same items carry over.
+	void Start(unsigned int count);
+	void Cancel();
+
+	// Runs items in order until the next one wouldn't fit.  Returns true on the call that
+	// finishes the pass.
+	bool Update(uint64_t budgetMicroseconds, const std::function<void(unsigned int)>& runItem);
+
+	bool IsRunning() { return nextItem < itemCount; }
+	unsigned int GetNextItem() { return nextItem; }
+	unsigned int GetItemCount() { return itemCount; }
+
+	// What the last Update did, and the Updates the last finished pass needed
+	unsigned int GetLastSliceItems() { return lastSliceItems; }
+	uint64_t GetLastSliceMicroseconds() { return lastSliceMicroseconds; }
+	unsigned int GetLastPassSlices() { return lastPassSlices; }
+
+	// How long an item is expected to take
+	uint64_t PredictCost(unsigned int item);
+
+	// Called by runItem when the clock won't see the item's real cost.  The slice is
+	// charged the item's last reported cost, or a guess from the others; before anything
+	// has been reported there's nothing to guess from, so the slice ends with it.
+	void DeferCost() { costDeferred = true; }
+
+	// The real cost of an item that deferred it, whenever it's known
+	void ReportCost(unsigned int item, uint64_t microseconds);
+
+private:
+	Clock clock;
+
+	unsigned int itemCount;
+	unsigned int nextItem;
+	unsigned int passSlices;
+
+	// Zero until an item has been timed
+	std::vector<uint64_t> itemCosts;
+	std::vector<bool> itemTimed;
+	bool costDeferred;
+	bool costReported;
+
+	unsigned int lastSliceItems;
+	uint64_t lastSliceMicroseconds;
+	unsigned int lastPassSlices;
+};
@@ -40,9 +40,11 @@ VertexToPixel main(VertexShaderInput input)
 	// Set up output
 	VertexToPixel output;
 
-	// Calculate output position
+	// Calculate output position.  Precise, so it matches the depth
+	// prepass exactly and the opaque pass's equal depth test passes.
 	matrix worldViewProj = mul(projection, mul(view, world));
-	output.screenPosition = mul(worldViewProj, float4(input.position, 1.0f));
+	precise float4 screenPosition = mul(worldViewProj, float4(input.position, 1.0f));
+	output.screenPosition = screenPosition;
 	output.currentScreenPos = output.screenPosition;
 
 	matrix prevWorldViewProj = mul(prevProjection, mul(prevView, prevWorld));